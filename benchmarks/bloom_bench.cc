@@ -0,0 +1,94 @@
+// Copyright (c) 2012 The LevelDB Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file. See the AUTHORS file for names of contributors.
+
+#include <cstdio>
+#include <string>
+#include <vector>
+
+#include "benchmark/benchmark.h"
+#include "leveldb/filter_policy.h"
+#include "leveldb/slice.h"
+#include "util/random.h"
+
+namespace leveldb {
+
+namespace {
+
+// Returns "n" distinct 16-byte keys, tagged with "tag" so that keys made
+// with different tags never collide.
+std::vector<std::string> MakeKeys(int n, char tag) {
+  std::vector<std::string> keys;
+  keys.reserve(n);
+  Random rnd(301 + tag);
+  for (int i = 0; i < n; i++) {
+    char buf[32];
+    std::snprintf(buf, sizeof(buf), "%c%07x%08x", tag, rnd.Next() & 0xfffffff,
+                  i);
+    keys.push_back(buf);
+  }
+  return keys;
+}
+
+// Policy 0 is the standard bloom filter, 1 the blocked one and 2 the
+// ribbon filter.
+const FilterPolicy* NewPolicy(int policy) {
+  switch (policy) {
+    case 1:
+      return NewBlockedBloomFilterPolicy(10);
+    case 2:
+      return NewRibbonFilterPolicy(10);
+    default:
+      return NewBloomFilterPolicy(10);
+  }
+}
+
+// Builds a filter for range(1) keys with policy range(0).
+void BM_BloomCreate(benchmark::State& state) {
+  const FilterPolicy* policy = NewPolicy(state.range(0));
+  const std::vector<std::string> keys = MakeKeys(state.range(1), 'k');
+  const std::vector<Slice> slices(keys.begin(), keys.end());
+  std::string filter;
+  for (auto st : state) {
+    filter.clear();
+    policy->CreateFilter(slices.data(), slices.size(), &filter);
+  }
+  state.SetItemsProcessed(state.iterations() * keys.size());
+  state.counters["bits_per_key"] = filter.size() * 8.0 / keys.size();
+  delete policy;
+}
+
+// Probes a filter of range(1) keys built with policy range(0) for keys it
+// does not hold.  Large filters do not fit in the CPU caches,
+// so that every probed cache line is likely a miss.
+void BM_BloomMissingKey(benchmark::State& state) {
+  const FilterPolicy* policy = NewPolicy(state.range(0));
+  const std::vector<std::string> keys = MakeKeys(state.range(1), 'k');
+  const std::vector<Slice> slices(keys.begin(), keys.end());
+  std::string filter;
+  policy->CreateFilter(slices.data(), slices.size(), &filter);
+  const std::vector<std::string> missing = MakeKeys(1 << 16, 'm');
+  size_t i = 0;
+  int matches = 0;
+  for (auto st : state) {
+    const bool match = policy->KeyMayMatch(missing[i], filter);
+    matches += match;
+    // Make the next probe wait for this one, as the probes of successive
+    // reads would, so that cache misses are not overlapped.
+    i = (i + 1 + match) & (missing.size() - 1);
+  }
+  benchmark::DoNotOptimize(matches);
+  state.SetItemsProcessed(state.iterations());
+  state.counters["fp_rate"] =
+      static_cast<double>(matches) / state.iterations();
+  delete policy;
+}
+
+BENCHMARK(BM_BloomCreate)->ArgsProduct({{0, 1, 2}, {10000}});
+BENCHMARK(BM_BloomMissingKey)->ArgsProduct({{0, 1, 2}, {10000, 10000000}});
+
+}  // namespace
+
+}  // namespace leveldb
+
+BENCHMARK_MAIN();
@@ -13,6 +13,8 @@
 #include "leveldb/db.h"
 #include "leveldb/env.h"
 #include "leveldb/filter_policy.h"
+#include "leveldb/rate_limiter.h"
+#include "leveldb/slice_transform.h"
 #include "leveldb/write_batch.h"
 #include "port/port.h"
 #include "util/crc32c.h"
@@ -88,10 +90,18 @@ static bool FLAGS_comparisons = false;
 // (initialized to default value by "main")
 static int FLAGS_write_buffer_size = 0;
 
+// Number of memtables that may be held in memory at once
+// (initialized to default value by "main")
+static int FLAGS_max_write_buffer_number = 0;
+
 // Number of bytes written to each file.
 // (initialized to default value by "main")
 static int FLAGS_max_file_size = 0;
 
+// Values of at least this many bytes are moved to blob files.  Zero keeps
+// every value in the tables.
+static int FLAGS_min_blob_size = 0;
+
 // Approximate size of user data packed per block (before compression.
 // (initialized to default value by "main")
 static int FLAGS_block_size = 0;
@@ -103,13 +113,32 @@ static int FLAGS_cache_size = -1;
 // Maximum number of files to keep open at the same time (use default if == 0)
 static int FLAGS_open_files = 0;
 
+// If true, open the table files when the database is opened.
+static bool FLAGS_open_files_on_startup = false;
+
 // Bloom filter bits per key.
 // Negative means use default settings.
 static int FLAGS_bloom_bits = -1;
 
+// If true, --bloom_bits builds cache-line-blocked bloom filters.
+static bool FLAGS_blocked_bloom = false;
+
+// If true, --bloom_bits builds ribbon filters with the false positive rate
+// of bloom filters of that many bits per key.
+static bool FLAGS_ribbon_filter = false;
+
+// Bytes per second of background I/O allowed to flushes and compactions.
+// Zero means unlimited.
+static int FLAGS_rate_limit_bytes_per_sec = 0;
+
 // Common key prefix length.
 static int FLAGS_key_prefix = 0;
 
+// If positive, the first this many bytes of the keys are recorded in the
+// table filters as their prefix, and seekrandom reads with
+// ReadOptions::prefix_same_as_start.
+static int FLAGS_prefix_size = 0;
+
 // If true, do not destroy the existing database.  If you set this
 // flag and also specify a benchmark that wants a fresh database, that
 // benchmark will fail.
@@ -118,9 +147,52 @@ static bool FLAGS_use_existing_db = false;
 // If true, reuse existing log/MANIFEST files when re-opening a database.
 static bool FLAGS_reuse_logs = false;
 
+// If true, readrandom reads values into a PinnableSlice instead of a
+// string.
+static bool FLAGS_pinned_get = false;
+
+// If true, write the log as snappy-compressed groups of records.
+static bool FLAGS_wal_compression = false;
+
+// Bytes of log records buffered per group if --wal_compression is set.
+static int FLAGS_wal_bytes_per_flush = 0;
+
+// Number of obsolete log files to keep for reuse by new logs.
+static int FLAGS_recycle_log_file_num = 0;
+
+// If true, back memtables with huge pages.
+static bool FLAGS_memtable_huge_pages = false;
+
+// If true, index memtables with a hash table instead of a skiplist.
+static bool FLAGS_hash_memtable = false;
+
 // If true, use compression.
 static bool FLAGS_compression = true;
 
+// If true, add a hash index to each data block.
+static bool FLAGS_data_block_hash_index = false;
+
+// If true, partition the index and filter blocks of each table.
+static bool FLAGS_partition_index_and_filters = false;
+
+// If true, build one filter over each whole table.
+static bool FLAGS_whole_table_filter = false;
+
+// If true, keep index and filter blocks in the block cache, with half of
+// it set aside for them.
+static bool FLAGS_cache_index_and_filter_blocks = false;
+
+// If true, pin the index and filter blocks of level-0 tables in the block
+// cache.  Requires --cache_index_and_filter_blocks.
+static bool FLAGS_pin_l0_index_and_filter_blocks_in_cache = false;
+
+// Comma-separated list of CompressionType values, one per level, that
+// overrides --compression (e.g. "0,0,1,2" for zstd below level 2).
+static const char* FLAGS_compression_per_level = nullptr;
+
+// Compression level used for zstd compressed blocks.
+static int FLAGS_zstd_compression_level = 1;
+
 // Use the db with the following name.
 static const char* FLAGS_db = nullptr;
 
@@ -373,6 +445,8 @@ class Benchmark {
  private:
   Cache* cache_;
   const FilterPolicy* filter_policy_;
+  const SliceTransform* prefix_extractor_;
+  RateLimiter* rate_limiter_;
   DB* db_;
   int num_;
   int value_size_;
@@ -463,10 +537,23 @@ class Benchmark {
 
  public:
   Benchmark()
-      : cache_(FLAGS_cache_size >= 0 ? NewLRUCache(FLAGS_cache_size) : nullptr),
-        filter_policy_(FLAGS_bloom_bits >= 0
-                           ? NewBloomFilterPolicy(FLAGS_bloom_bits)
-                           : nullptr),
+      : cache_(FLAGS_cache_size >= 0
+                   ? NewLRUCache(FLAGS_cache_size,
+                                 FLAGS_cache_index_and_filter_blocks ? 0.5 : 0)
+                   : nullptr),
+        filter_policy_(FLAGS_bloom_bits < 0 ? nullptr
+                       : FLAGS_ribbon_filter
+                           ? NewRibbonFilterPolicy(FLAGS_bloom_bits)
+                       : FLAGS_blocked_bloom
+                           ? NewBlockedBloomFilterPolicy(FLAGS_bloom_bits)
+                           : NewBloomFilterPolicy(FLAGS_bloom_bits)),
+        prefix_extractor_(FLAGS_prefix_size > 0
+                              ? NewFixedPrefixTransform(FLAGS_prefix_size)
+                              : nullptr),
+        rate_limiter_(FLAGS_rate_limit_bytes_per_sec > 0
+                          ? NewGenericRateLimiter(
+                                FLAGS_rate_limit_bytes_per_sec)
+                          : nullptr),
         db_(nullptr),
         num_(FLAGS_num),
         value_size_(FLAGS_value_size),
@@ -491,6 +578,8 @@ class Benchmark {
     delete db_;
     delete cache_;
     delete filter_policy_;
+    delete prefix_extractor_;
+    delete rate_limiter_;
   }
 
   void Run() {
@@ -766,16 +855,45 @@ class Benchmark {
     options.create_if_missing = !FLAGS_use_existing_db;
     options.block_cache = cache_;
     options.write_buffer_size = FLAGS_write_buffer_size;
+    options.max_write_buffer_number = FLAGS_max_write_buffer_number;
     options.max_file_size = FLAGS_max_file_size;
+    options.min_blob_size = FLAGS_min_blob_size;
     options.block_size = FLAGS_block_size;
     if (FLAGS_comparisons) {
       options.comparator = &count_comparator_;
     }
     options.max_open_files = FLAGS_open_files;
+    options.open_files_on_startup = FLAGS_open_files_on_startup;
     options.filter_policy = filter_policy_;
+    options.prefix_extractor = prefix_extractor_;
+    options.rate_limiter = rate_limiter_;
     options.reuse_logs = FLAGS_reuse_logs;
+    options.wal_compression =
+        FLAGS_wal_compression ? kSnappyCompression : kNoCompression;
+    options.wal_bytes_per_flush = FLAGS_wal_bytes_per_flush;
+    options.recycle_log_file_num = FLAGS_recycle_log_file_num;
+    options.memtable_huge_pages = FLAGS_memtable_huge_pages;
+    options.memtable_rep =
+        FLAGS_hash_memtable ? kHashMemTable : kSkipListMemTable;
     options.compression =
         FLAGS_compression ? kSnappyCompression : kNoCompression;
+    if (FLAGS_compression_per_level != nullptr) {
+      const char* p = FLAGS_compression_per_level;
+      while (*p != '\0') {
+        options.compression_per_level.push_back(
+            static_cast<CompressionType>(std::strtol(p, nullptr, 10)));
+        p = strchr(p, ',');
+        if (p == nullptr) break;
+        p++;
+      }
+    }
+    options.zstd_compression_level = FLAGS_zstd_compression_level;
+    options.data_block_hash_index = FLAGS_data_block_hash_index;
+    options.partition_index_and_filters = FLAGS_partition_index_and_filters;
+    options.whole_table_filter = FLAGS_whole_table_filter;
+    options.cache_index_and_filter_blocks = FLAGS_cache_index_and_filter_blocks;
+    options.pin_l0_index_and_filter_blocks_in_cache =
+        FLAGS_pin_l0_index_and_filter_blocks_in_cache;
     Status s = DB::Open(options, FLAGS_db, &db_);
     if (!s.ok()) {
       std::fprintf(stderr, "open error: %s\n", s.ToString().c_str());
@@ -854,12 +972,15 @@ class Benchmark {
   void ReadRandom(ThreadState* thread) {
     ReadOptions options;
     std::string value;
+    PinnableSlice pinned;
     int found = 0;
     KeyBuffer key;
     for (int i = 0; i < reads_; i++) {
       const int k = thread->rand.Uniform(FLAGS_num);
       key.Set(k);
-      if (db_->Get(options, key.slice(), &value).ok()) {
+      Status s = FLAGS_pinned_get ? db_->Get(options, key.slice(), &pinned)
+                                  : db_->Get(options, key.slice(), &value);
+      if (s.ok()) {
         found++;
       }
       thread->stats.FinishedSingleOp();
@@ -897,6 +1018,7 @@ class Benchmark {
 
   void SeekRandom(ThreadState* thread) {
     ReadOptions options;
+    options.prefix_same_as_start = FLAGS_prefix_size > 0;
     int found = 0;
     KeyBuffer key;
     for (int i = 0; i < reads_; i++) {
@@ -1025,6 +1147,7 @@ class Benchmark {
 
 int main(int argc, char** argv) {
   FLAGS_write_buffer_size = leveldb::Options().write_buffer_size;
+  FLAGS_max_write_buffer_number = leveldb::Options().max_write_buffer_number;
   FLAGS_max_file_size = leveldb::Options().max_file_size;
   FLAGS_block_size = leveldb::Options().block_size;
   FLAGS_open_files = leveldb::Options().max_open_files;
@@ -1050,9 +1173,52 @@ int main(int argc, char** argv) {
     } else if (sscanf(argv[i], "--reuse_logs=%d%c", &n, &junk) == 1 &&
                (n == 0 || n == 1)) {
       FLAGS_reuse_logs = n;
+    } else if (sscanf(argv[i], "--pinned_get=%d%c", &n, &junk) == 1 &&
+               (n == 0 || n == 1)) {
+      FLAGS_pinned_get = n;
+    } else if (sscanf(argv[i], "--wal_compression=%d%c", &n, &junk) == 1 &&
+               (n == 0 || n == 1)) {
+      FLAGS_wal_compression = n;
+    } else if (sscanf(argv[i], "--wal_bytes_per_flush=%d%c", &n, &junk) ==
+               1) {
+      FLAGS_wal_bytes_per_flush = n;
+    } else if (sscanf(argv[i], "--recycle_log_file_num=%d%c", &n, &junk) ==
+               1) {
+      FLAGS_recycle_log_file_num = n;
+    } else if (sscanf(argv[i], "--memtable_huge_pages=%d%c", &n, &junk) == 1 &&
+               (n == 0 || n == 1)) {
+      FLAGS_memtable_huge_pages = n;
+    } else if (sscanf(argv[i], "--hash_memtable=%d%c", &n, &junk) == 1 &&
+               (n == 0 || n == 1)) {
+      FLAGS_hash_memtable = n;
     } else if (sscanf(argv[i], "--compression=%d%c", &n, &junk) == 1 &&
                (n == 0 || n == 1)) {
       FLAGS_compression = n;
+    } else if (sscanf(argv[i], "--data_block_hash_index=%d%c", &n, &junk) ==
+                   1 &&
+               (n == 0 || n == 1)) {
+      FLAGS_data_block_hash_index = n;
+    } else if (sscanf(argv[i], "--partition_index_and_filters=%d%c", &n,
+                      &junk) == 1 &&
+               (n == 0 || n == 1)) {
+      FLAGS_partition_index_and_filters = n;
+    } else if (sscanf(argv[i], "--whole_table_filter=%d%c", &n, &junk) == 1 &&
+               (n == 0 || n == 1)) {
+      FLAGS_whole_table_filter = n;
+    } else if (sscanf(argv[i], "--cache_index_and_filter_blocks=%d%c", &n,
+                      &junk) == 1 &&
+               (n == 0 || n == 1)) {
+      FLAGS_cache_index_and_filter_blocks = n;
+    } else if (sscanf(argv[i],
+                      "--pin_l0_index_and_filter_blocks_in_cache=%d%c", &n,
+                      &junk) == 1 &&
+               (n == 0 || n == 1)) {
+      FLAGS_pin_l0_index_and_filter_blocks_in_cache = n;
+    } else if (strncmp(argv[i], "--compression_per_level=", 24) == 0) {
+      FLAGS_compression_per_level = argv[i] + 24;
+    } else if (sscanf(argv[i], "--zstd_compression_level=%d%c", &n, &junk) ==
+               1) {
+      FLAGS_zstd_compression_level = n;
     } else if (sscanf(argv[i], "--num=%d%c", &n, &junk) == 1) {
       FLAGS_num = n;
     } else if (sscanf(argv[i], "--reads=%d%c", &n, &junk) == 1) {
@@ -1063,18 +1229,38 @@ int main(int argc, char** argv) {
       FLAGS_value_size = n;
     } else if (sscanf(argv[i], "--write_buffer_size=%d%c", &n, &junk) == 1) {
       FLAGS_write_buffer_size = n;
+    } else if (sscanf(argv[i], "--max_write_buffer_number=%d%c", &n, &junk) ==
+               1) {
+      FLAGS_max_write_buffer_number = n;
     } else if (sscanf(argv[i], "--max_file_size=%d%c", &n, &junk) == 1) {
       FLAGS_max_file_size = n;
+    } else if (sscanf(argv[i], "--min_blob_size=%d%c", &n, &junk) == 1) {
+      FLAGS_min_blob_size = n;
     } else if (sscanf(argv[i], "--block_size=%d%c", &n, &junk) == 1) {
       FLAGS_block_size = n;
     } else if (sscanf(argv[i], "--key_prefix=%d%c", &n, &junk) == 1) {
       FLAGS_key_prefix = n;
+    } else if (sscanf(argv[i], "--prefix_size=%d%c", &n, &junk) == 1) {
+      FLAGS_prefix_size = n;
     } else if (sscanf(argv[i], "--cache_size=%d%c", &n, &junk) == 1) {
       FLAGS_cache_size = n;
     } else if (sscanf(argv[i], "--bloom_bits=%d%c", &n, &junk) == 1) {
       FLAGS_bloom_bits = n;
+    } else if (sscanf(argv[i], "--blocked_bloom=%d%c", &n, &junk) == 1 &&
+               (n == 0 || n == 1)) {
+      FLAGS_blocked_bloom = n;
+    } else if (sscanf(argv[i], "--ribbon_filter=%d%c", &n, &junk) == 1 &&
+               (n == 0 || n == 1)) {
+      FLAGS_ribbon_filter = n;
+    } else if (sscanf(argv[i], "--rate_limit_bytes_per_sec=%d%c", &n,
+                      &junk) == 1) {
+      FLAGS_rate_limit_bytes_per_sec = n;
     } else if (sscanf(argv[i], "--open_files=%d%c", &n, &junk) == 1) {
       FLAGS_open_files = n;
+    } else if (sscanf(argv[i], "--open_files_on_startup=%d%c", &n, &junk) ==
+                   1 &&
+               (n == 0 || n == 1)) {
+      FLAGS_open_files_on_startup = n;
     } else if (strncmp(argv[i], "--db=", 5) == 0) {
       FLAGS_db = argv[i] + 5;
     } else {
@@ -0,0 +1,77 @@
+// Copyright (c) 2011 The LevelDB Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file. See the AUTHORS file for names of contributors.
+
+#include <cstdio>
+#include <string>
+#include <vector>
+
+#include "benchmark/benchmark.h"
+#include "db/dbformat.h"
+#include "db/memtable.h"
+#include "leveldb/comparator.h"
+#include "util/random.h"
+
+namespace leveldb {
+
+namespace {
+
+// Returns "n" distinct 16-byte keys in random order.
+std::vector<std::string> MakeKeys(int n) {
+  std::vector<std::string> keys;
+  keys.reserve(n);
+  Random rnd(301);
+  for (int i = 0; i < n; i++) {
+    char buf[32];
+    std::snprintf(buf, sizeof(buf), "%08x%08x", rnd.Next(), i);
+    keys.push_back(buf);
+  }
+  return keys;
+}
+
+MemTable* NewFilledMemTable(const InternalKeyComparator& cmp,
+                            const std::vector<std::string>& keys) {
+  MemTable* mem = new MemTable(cmp);
+  mem->Ref();
+  SequenceNumber seq = 1;
+  for (const std::string& key : keys) {
+    mem->Add(seq++, kTypeValue, key, "value");
+  }
+  return mem;
+}
+
+// Inserts range(0) keys into an empty memtable.
+void BM_SkipListInsert(benchmark::State& state) {
+  const std::vector<std::string> keys = MakeKeys(state.range(0));
+  InternalKeyComparator cmp(BytewiseComparator());
+  for (auto st : state) {
+    MemTable* mem = NewFilledMemTable(cmp, keys);
+    mem->Unref();
+  }
+  state.SetItemsProcessed(state.iterations() * keys.size());
+}
+
+// Looks up random keys in a memtable holding range(0) keys.
+void BM_SkipListGet(benchmark::State& state) {
+  const std::vector<std::string> keys = MakeKeys(state.range(0));
+  InternalKeyComparator cmp(BytewiseComparator());
+  MemTable* mem = NewFilledMemTable(cmp, keys);
+  Random rnd(42);
+  std::string value;
+  for (auto st : state) {
+    LookupKey lkey(keys[rnd.Uniform(keys.size())], kMaxSequenceNumber);
+    Status s;
+    benchmark::DoNotOptimize(mem->Get(lkey, &value, &s));
+  }
+  state.SetItemsProcessed(state.iterations());
+  mem->Unref();
+}
+
+BENCHMARK(BM_SkipListInsert)->Arg(1000)->Arg(100000);
+BENCHMARK(BM_SkipListGet)->Arg(1000)->Arg(100000)->Arg(1000000);
+
+}  // namespace
+
+}  // namespace leveldb
+
+BENCHMARK_MAIN();
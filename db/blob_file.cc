@@ -0,0 +1,116 @@
+// Copyright (c) 2011 The LevelDB Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file. See the AUTHORS file for names of contributors.
+
+#include "db/blob_file.h"
+
+#include "db/filename.h"
+#include "leveldb/env.h"
+#include "util/coding.h"
+#include "util/crc32c.h"
+
+namespace leveldb {
+
+void BlobIndex::EncodeTo(std::string* dst) const {
+  PutVarint64(dst, file_number);
+  PutVarint64(dst, offset);
+  PutVarint64(dst, size);
+}
+
+bool BlobIndex::DecodeFrom(Slice input) {
+  return GetVarint64(&input, &file_number) && GetVarint64(&input, &offset) &&
+         GetVarint64(&input, &size) && input.empty();
+}
+
+BlobFileBuilder::BlobFileBuilder(WritableFile* file, uint64_t file_number)
+    : file_(file), file_number_(file_number), offset_(0), num_entries_(0) {}
+
+Status BlobFileBuilder::Add(const Slice& value, BlobIndex* index) {
+  char header[kBlobRecordHeaderSize];
+  EncodeFixed32(header, crc32c::Mask(crc32c::Value(value.data(),
+                                                   value.size())));
+  Status s = file_->Append(Slice(header, sizeof(header)));
+  if (s.ok()) {
+    s = file_->Append(value);
+  }
+  if (s.ok()) {
+    index->file_number = file_number_;
+    index->offset = offset_;
+    index->size = value.size();
+    offset_ += index->RecordSize();
+    num_entries_++;
+  }
+  return s;
+}
+
+static void DeleteEntry(const Slice& key, void* value) {
+  delete reinterpret_cast<RandomAccessFile*>(value);
+}
+
+BlobFileCache::BlobFileCache(const std::string& dbname, Env* env, int entries)
+    : env_(env), dbname_(dbname), cache_(NewLRUCache(entries)) {}
+
+BlobFileCache::~BlobFileCache() { delete cache_; }
+
+Status BlobFileCache::FindFile(uint64_t file_number, Cache::Handle** handle) {
+  Status s;
+  char buf[sizeof(file_number)];
+  EncodeFixed64(buf, file_number);
+  Slice key(buf, sizeof(buf));
+  *handle = cache_->Lookup(key);
+  if (*handle == nullptr) {
+    RandomAccessFile* file;
+    s = env_->NewRandomAccessFile(BlobFileName(dbname_, file_number), &file);
+    if (s.ok()) {
+      *handle = cache_->Insert(key, file, 1, &DeleteEntry);
+    }
+  }
+  return s;
+}
+
+Status BlobFileCache::Get(const ReadOptions& options, const BlobIndex& index,
+                          std::string* value) {
+  Cache::Handle* handle = nullptr;
+  Status s = FindFile(index.file_number, &handle);
+  if (!s.ok()) {
+    return s;
+  }
+  RandomAccessFile* file =
+      reinterpret_cast<RandomAccessFile*>(cache_->Value(handle));
+  const size_t n = index.RecordSize();
+  char* scratch = nullptr;
+  if (!file->ReadsInPlace()) {
+    value->resize(n);
+    scratch = &(*value)[0];
+  }
+  Slice contents;
+  s = file->Read(index.offset, n, &contents, scratch);
+  if (s.ok() && contents.size() != n) {
+    s = Status::Corruption("truncated blob record");
+  }
+  if (s.ok() && options.verify_checksums) {
+    const uint32_t crc = crc32c::Unmask(DecodeFixed32(contents.data()));
+    if (crc32c::Value(contents.data() + kBlobRecordHeaderSize, index.size) !=
+        crc) {
+      s = Status::Corruption("blob record checksum mismatch");
+    }
+  }
+  if (!s.ok()) {
+    value->clear();
+  } else if (scratch != nullptr && contents.data() == scratch) {
+    value->erase(0, kBlobRecordHeaderSize);
+  } else {
+    // The data is held by the file (e.g. an mmap-ed file).
+    value->assign(contents.data() + kBlobRecordHeaderSize, index.size);
+  }
+  cache_->Release(handle);
+  return s;
+}
+
+void BlobFileCache::Evict(uint64_t file_number) {
+  char buf[sizeof(file_number)];
+  EncodeFixed64(buf, file_number);
+  cache_->Erase(Slice(buf, sizeof(buf)));
+}
+
+}  // namespace leveldb
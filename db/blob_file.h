@@ -0,0 +1,100 @@
+// Copyright (c) 2011 The LevelDB Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file. See the AUTHORS file for names of contributors.
+//
+// Blob files hold the values that Options::min_blob_size moves out of the
+// tables.  A blob file is a sequence of records, written once and never
+// modified:
+//
+//    record := checksum: fixed32  // masked crc32c of value
+//              value: uint8[n]
+//
+// The table entry of such a value has type kTypeBlobIndex, and its value
+// is the encoded BlobIndex of the record.
+
+#ifndef STORAGE_LEVELDB_DB_BLOB_FILE_H_
+#define STORAGE_LEVELDB_DB_BLOB_FILE_H_
+
+#include <cstdint>
+#include <string>
+
+#include "leveldb/cache.h"
+#include "leveldb/options.h"
+#include "leveldb/slice.h"
+#include "leveldb/status.h"
+
+namespace leveldb {
+
+class Env;
+class WritableFile;
+
+static const size_t kBlobRecordHeaderSize = 4;
+
+// The location of a value in a blob file.
+struct BlobIndex {
+  uint64_t file_number;
+  uint64_t offset;  // Of the record
+  uint64_t size;    // Of the value
+
+  // Bytes taken by the record in the blob file.
+  uint64_t RecordSize() const { return kBlobRecordHeaderSize + size; }
+
+  void EncodeTo(std::string* dst) const;
+  bool DecodeFrom(Slice input);
+};
+
+// Appends records to a blob file.  Does not close or delete the file.
+class BlobFileBuilder {
+ public:
+  BlobFileBuilder(WritableFile* file, uint64_t file_number);
+
+  BlobFileBuilder(const BlobFileBuilder&) = delete;
+  BlobFileBuilder& operator=(const BlobFileBuilder&) = delete;
+
+  // Append a record holding "value" and store its location in *index.
+  Status Add(const Slice& value, BlobIndex* index);
+
+  // Number of records added so far.
+  uint64_t NumEntries() const { return num_entries_; }
+
+  // Size of the file generated so far.
+  uint64_t FileSize() const { return offset_; }
+
+ private:
+  WritableFile* const file_;
+  const uint64_t file_number_;
+  uint64_t offset_;
+  uint64_t num_entries_;
+};
+
+// Keeps blob files open for reading.
+//
+// Thread-safe (provides internal synchronization)
+class BlobFileCache {
+ public:
+  BlobFileCache(const std::string& dbname, Env* env, int entries);
+
+  BlobFileCache(const BlobFileCache&) = delete;
+  BlobFileCache& operator=(const BlobFileCache&) = delete;
+
+  ~BlobFileCache();
+
+  // Store in *value the value of the record that "index" points to.  The
+  // checksum of the record is verified if options.verify_checksums is set.
+  Status Get(const ReadOptions& options, const BlobIndex& index,
+             std::string* value);
+
+  // Evict any entry for the specified file number
+  void Evict(uint64_t file_number);
+
+ private:
+  Status FindFile(uint64_t file_number, Cache::Handle** handle);
+
+  Env* const env_;
+  const std::string dbname_;
+  Cache* cache_;
+};
+
+}  // namespace leveldb
+
+#endif  // STORAGE_LEVELDB_DB_BLOB_FILE_H_
@@ -0,0 +1,118 @@
+// Copyright (c) 2011 The LevelDB Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file. See the AUTHORS file for names of contributors.
+
+#include "db/blob_file.h"
+
+#include <memory>
+#include <vector>
+
+#include "db/filename.h"
+#include "gtest/gtest.h"
+#include "helpers/memenv/memenv.h"
+#include "leveldb/env.h"
+
+namespace leveldb {
+
+class BlobFileTest : public testing::Test {
+ public:
+  BlobFileTest()
+      : env_(NewMemEnv(Env::Default())),
+        cache_(new BlobFileCache("/blobs", env_.get(), 4)) {
+    env_->CreateDir("/blobs");
+  }
+
+  // Write "values" to blob file "number" and store their locations in
+  // *indexes.
+  void Write(uint64_t number, const std::vector<std::string>& values,
+             std::vector<BlobIndex>* indexes) {
+    WritableFile* file;
+    ASSERT_TRUE(env_->NewWritableFile(BlobFileName("/blobs", number), &file)
+                    .ok());
+    BlobFileBuilder builder(file, number);
+    uint64_t size = 0;
+    for (const std::string& value : values) {
+      BlobIndex index;
+      ASSERT_TRUE(builder.Add(value, &index).ok());
+      ASSERT_EQ(number, index.file_number);
+      ASSERT_EQ(size, index.offset);
+      size += index.RecordSize();
+      indexes->push_back(index);
+    }
+    ASSERT_EQ(values.size(), builder.NumEntries());
+    ASSERT_EQ(size, builder.FileSize());
+    ASSERT_TRUE(file->Close().ok());
+    delete file;
+  }
+
+  std::unique_ptr<Env> env_;
+  std::unique_ptr<BlobFileCache> cache_;
+};
+
+TEST_F(BlobFileTest, EncodeDecodeIndex) {
+  BlobIndex index;
+  index.file_number = 1ull << 40;
+  index.offset = 12345;
+  index.size = 1 << 20;
+  std::string encoded;
+  index.EncodeTo(&encoded);
+
+  BlobIndex decoded;
+  ASSERT_TRUE(decoded.DecodeFrom(encoded));
+  ASSERT_EQ(index.file_number, decoded.file_number);
+  ASSERT_EQ(index.offset, decoded.offset);
+  ASSERT_EQ(index.size, decoded.size);
+
+  ASSERT_FALSE(decoded.DecodeFrom(Slice(encoded.data(), encoded.size() - 1)));
+  ASSERT_FALSE(decoded.DecodeFrom(encoded + "x"));
+}
+
+TEST_F(BlobFileTest, ReadBack) {
+  std::vector<std::string> values = {"", "small", std::string(100000, 'x'),
+                                     "last"};
+  std::vector<BlobIndex> indexes;
+  Write(7, values, &indexes);
+  std::vector<std::string> others = {"other"};
+  std::vector<BlobIndex> other_indexes;
+  Write(8, others, &other_indexes);
+
+  ReadOptions options;
+  options.verify_checksums = true;
+  std::string value;
+  for (int i = values.size() - 1; i >= 0; i--) {
+    ASSERT_TRUE(cache_->Get(options, indexes[i], &value).ok());
+    ASSERT_EQ(values[i], value);
+  }
+  ASSERT_TRUE(cache_->Get(options, other_indexes[0], &value).ok());
+  ASSERT_EQ("other", value);
+
+  BlobIndex missing = indexes[0];
+  missing.file_number = 9;
+  ASSERT_FALSE(cache_->Get(options, missing, &value).ok());
+  BlobIndex past_end = indexes[3];
+  past_end.size += 10;
+  ASSERT_TRUE(cache_->Get(options, past_end, &value).IsCorruption());
+}
+
+TEST_F(BlobFileTest, Checksum) {
+  std::vector<BlobIndex> indexes;
+  Write(3, {"first", "second"}, &indexes);
+
+  const std::string fname = BlobFileName("/blobs", 3);
+  std::string contents;
+  ASSERT_TRUE(ReadFileToString(env_.get(), fname, &contents).ok());
+  contents[indexes[1].offset + kBlobRecordHeaderSize] ^= 1;
+  ASSERT_TRUE(WriteStringToFile(env_.get(), contents, fname).ok());
+  cache_->Evict(3);
+
+  ReadOptions options;
+  std::string value;
+  ASSERT_TRUE(cache_->Get(options, indexes[1], &value).ok());
+  ASSERT_EQ("recond", value);
+  options.verify_checksums = true;
+  ASSERT_TRUE(cache_->Get(options, indexes[0], &value).ok());
+  ASSERT_EQ("first", value);
+  ASSERT_TRUE(cache_->Get(options, indexes[1], &value).IsCorruption());
+}
+
+}  // namespace leveldb
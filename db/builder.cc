@@ -4,49 +4,163 @@
 
 #include "db/builder.h"
 
+#include <algorithm>
+
+#include "db/blob_file.h"
 #include "db/dbformat.h"
 #include "db/filename.h"
 #include "db/table_cache.h"
 #include "db/version_edit.h"
+#include "leveldb/comparator.h"
 #include "leveldb/db.h"
 #include "leveldb/env.h"
 #include "leveldb/iterator.h"
+#include "util/rate_limiter.h"
 
 namespace leveldb {
 
+CompressionType CompressionForLevel(const Options& options, int level) {
+  const std::vector<CompressionType>& per_level =
+      options.compression_per_level;
+  if (per_level.empty()) {
+    return options.compression;
+  }
+  return per_level[std::min<size_t>(level, per_level.size() - 1)];
+}
+
 Status BuildTable(const std::string& dbname, Env* env, const Options& options,
-                  TableCache* table_cache, Iterator* iter, FileMetaData* meta) {
+                  TableCache* table_cache, Iterator* iter,
+                  Iterator* range_del_iter, FileMetaData* meta,
+                  BlobFileMetaData* blob) {
   Status s;
   meta->file_size = 0;
+  meta->num_entries = 0;
+  meta->num_deletions = 0;
+  meta->num_range_deletions = 0;
   iter->SeekToFirst();
+  if (range_del_iter != nullptr) {
+    range_del_iter->SeekToFirst();
+  }
+
+  if (blob != nullptr) {
+    blob->total_count = 0;
+    blob->total_bytes = 0;
+  }
 
   std::string fname = TableFileName(dbname, meta->number);
-  if (iter->Valid()) {
+  WritableFile* blob_file = nullptr;
+  BlobFileBuilder* blob_builder = nullptr;
+  if (iter->Valid() ||
+      (range_del_iter != nullptr && range_del_iter->Valid())) {
     WritableFile* file;
     s = env->NewWritableFile(fname, &file);
     if (!s.ok()) {
       return s;
     }
-
-    TableBuilder* builder = new TableBuilder(options, file);
-    meta->smallest.DecodeFrom(iter->key());
-    Slice key;
-    for (; iter->Valid(); iter->Next()) {
-      key = iter->key();
-      builder->Add(key, iter->value());
+    if (options.rate_limiter != nullptr) {
+      file = NewRateLimitedWritableFile(file, options.rate_limiter,
+                                        RateLimiter::kHigh);
     }
-    if (!key.empty()) {
+
+    Options table_options = options;
+    table_options.compression = CompressionForLevel(options, 0);
+    TableBuilder* builder = new TableBuilder(table_options, file);
+    const Comparator* icmp = options.comparator;
+    bool has_bounds = false;
+    if (iter->Valid()) {
+      Slice key;
+      ParsedInternalKey ikey;
+      std::string blob_key, blob_value;
+      for (; iter->Valid(); iter->Next()) {
+        key = iter->key();
+        const bool parsed = ParseInternalKey(key, &ikey);
+        if (parsed && ikey.type == kTypeValue && blob != nullptr &&
+            iter->value().size() >= options.min_blob_size) {
+          // Move the value to the blob file, and point to it.
+          if (blob_builder == nullptr) {
+            s = env->NewWritableFile(BlobFileName(dbname, blob->number),
+                                     &blob_file);
+            if (!s.ok()) {
+              break;
+            }
+            if (options.rate_limiter != nullptr) {
+              blob_file = NewRateLimitedWritableFile(
+                  blob_file, options.rate_limiter, RateLimiter::kHigh);
+            }
+            blob_builder = new BlobFileBuilder(blob_file, blob->number);
+          }
+          BlobIndex index;
+          s = blob_builder->Add(iter->value(), &index);
+          if (!s.ok()) {
+            break;
+          }
+          blob_key.clear();
+          AppendInternalKey(&blob_key, ParsedInternalKey(ikey.user_key,
+                                                         ikey.sequence,
+                                                         kTypeBlobIndex));
+          blob_value.clear();
+          index.EncodeTo(&blob_value);
+          key = blob_key;
+          builder->Add(key, blob_value);
+        } else {
+          builder->Add(key, iter->value());
+        }
+        if (!has_bounds) {
+          meta->smallest.DecodeFrom(key);
+          has_bounds = true;
+        }
+        if (parsed && ikey.type == kTypeDeletion) {
+          meta->num_deletions++;
+        }
+      }
       meta->largest.DecodeFrom(key);
     }
 
+    // The file must claim the whole span of its tombstones.  The upper
+    // bound is exclusive, so use the earliest possible internal key for it.
+    for (; range_del_iter != nullptr && range_del_iter->Valid();
+         range_del_iter->Next()) {
+      Slice key = range_del_iter->key();
+      Slice end = range_del_iter->value();
+      builder->AddRangeTombstone(key, end);
+      InternalKey sentinel(end, kMaxSequenceNumber, kTypeRangeDeletion);
+      if (!has_bounds || icmp->Compare(key, meta->smallest.Encode()) < 0) {
+        meta->smallest.DecodeFrom(key);
+      }
+      if (!has_bounds ||
+          icmp->Compare(sentinel.Encode(), meta->largest.Encode()) > 0) {
+        meta->largest = sentinel;
+      }
+      has_bounds = true;
+    }
+    meta->num_entries = builder->NumEntries();
+    meta->num_range_deletions = builder->NumRangeTombstones();
+
     // Finish and check for builder errors
-    s = builder->Finish();
+    if (s.ok()) {
+      s = builder->Finish();
+    } else {
+      builder->Abandon();
+    }
     if (s.ok()) {
       meta->file_size = builder->FileSize();
       assert(meta->file_size > 0);
     }
     delete builder;
 
+    if (blob_builder != nullptr) {
+      blob->total_count = blob_builder->NumEntries();
+      blob->total_bytes = blob_builder->FileSize();
+      delete blob_builder;
+      if (s.ok()) {
+        s = blob_file->Sync();
+      }
+      if (s.ok()) {
+        s = blob_file->Close();
+      }
+      delete blob_file;
+    }
+
     // Finish and check for file errors
     if (s.ok()) {
       s = file->Sync();
@@ -70,11 +184,19 @@ Status BuildTable(const std::string& dbname, Env* env, const Options& options,
   if (!iter->status().ok()) {
     s = iter->status();
   }
+  if (range_del_iter != nullptr && !range_del_iter->status().ok()) {
+    s = range_del_iter->status();
+  }
 
   if (s.ok() && meta->file_size > 0) {
     // Keep it
   } else {
     env->RemoveFile(fname);
+    if (blob_file != nullptr) {
+      env->RemoveFile(BlobFileName(dbname, blob->number));
+      blob->total_count = 0;
+      blob->total_bytes = 0;
+    }
   }
   return s;
 }
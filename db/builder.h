@@ -5,11 +5,12 @@
 #ifndef STORAGE_LEVELDB_DB_BUILDER_H_
 #define STORAGE_LEVELDB_DB_BUILDER_H_
 
+#include "leveldb/options.h"
 #include "leveldb/status.h"
 
 namespace leveldb {
 
-struct Options;
+struct BlobFileMetaData;
 struct FileMetaData;
 
 class Env;
@@ -17,13 +18,25 @@ class Iterator;
 class TableCache;
 class VersionEdit;
 
-// Build a Table file from the contents of *iter.  The generated file
+// Return the compression to use for the tables written to "level".
+CompressionType CompressionForLevel(const Options& options, int level);
+
+// Build a Table file from the contents of *iter and the range tombstones
+// of *range_del_iter (which may be nullptr).  The generated file
 // will be named according to meta->number.  On success, the rest of
 // *meta will be filled with metadata about the generated table.
-// If no data is present in *iter, meta->file_size will be set to
-// zero, and no Table file will be produced.
+// If no data is present in either iterator, meta->file_size will be set to
+// zero, and no Table file will be produced.  The table is compressed as
+// a level-0 table.
+//
+// If "blob" is non-null, values of at least options.min_blob_size bytes
+// are written to the blob file named according to blob->number instead of
+// the table, and blob->total_count and blob->total_bytes are set to the
+// records written there.  The blob file is created only if there are any.
 Status BuildTable(const std::string& dbname, Env* env, const Options& options,
-                  TableCache* table_cache, Iterator* iter, FileMetaData* meta);
+                  TableCache* table_cache, Iterator* iter,
+                  Iterator* range_del_iter, FileMetaData* meta,
+                  BlobFileMetaData* blob = nullptr);
 
 }  // namespace leveldb
 
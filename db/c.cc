@@ -16,6 +16,7 @@
 #include "leveldb/filter_policy.h"
 #include "leveldb/iterator.h"
 #include "leveldb/options.h"
+#include "leveldb/pinnable_slice.h"
 #include "leveldb/status.h"
 #include "leveldb/write_batch.h"
 
@@ -33,6 +34,7 @@ using leveldb::Logger;
 using leveldb::NewBloomFilterPolicy;
 using leveldb::NewLRUCache;
 using leveldb::Options;
+using leveldb::PinnableSlice;
 using leveldb::RandomAccessFile;
 using leveldb::Range;
 using leveldb::ReadOptions;
@@ -85,6 +87,9 @@ struct leveldb_logger_t {
 struct leveldb_filelock_t {
   FileLock* rep;
 };
+struct leveldb_pinnableslice_t {
+  PinnableSlice rep;
+};
 
 struct leveldb_comparator_t : public Comparator {
   ~leveldb_comparator_t() override { (*destructor_)(state_); }
@@ -193,6 +198,15 @@ void leveldb_delete(leveldb_t* db, const leveldb_writeoptions_t* options,
   SaveError(errptr, db->rep->Delete(options->rep, Slice(key, keylen)));
 }
 
+void leveldb_delete_range(leveldb_t* db, const leveldb_writeoptions_t* options,
+                          const char* start_key, size_t start_key_len,
+                          const char* limit_key, size_t limit_key_len,
+                          char** errptr) {
+  SaveError(errptr, db->rep->DeleteRange(options->rep,
+                                         Slice(start_key, start_key_len),
+                                         Slice(limit_key, limit_key_len)));
+}
+
 void leveldb_write(leveldb_t* db, const leveldb_writeoptions_t* options,
                    leveldb_writebatch_t* batch, char** errptr) {
   SaveError(errptr, db->rep->Write(options->rep, &batch->rep));
@@ -216,6 +230,21 @@ char* leveldb_get(leveldb_t* db, const leveldb_readoptions_t* options,
   return result;
 }
 
+leveldb_pinnableslice_t* leveldb_get_pinned(
+    leveldb_t* db, const leveldb_readoptions_t* options, const char* key,
+    size_t keylen, char** errptr) {
+  leveldb_pinnableslice_t* result = new leveldb_pinnableslice_t;
+  Status s = db->rep->Get(options->rep, Slice(key, keylen), &result->rep);
+  if (!s.ok()) {
+    delete result;
+    result = nullptr;
+    if (!s.IsNotFound()) {
+      SaveError(errptr, s);
+    }
+  }
+  return result;
+}
+
 leveldb_iterator_t* leveldb_create_iterator(
     leveldb_t* db, const leveldb_readoptions_t* options) {
   leveldb_iterator_t* result = new leveldb_iterator_t;
@@ -321,6 +350,16 @@ void leveldb_iter_get_error(const leveldb_iterator_t* iter, char** errptr) {
   SaveError(errptr, iter->rep->status());
 }
 
+void leveldb_pinnableslice_destroy(leveldb_pinnableslice_t* slice) {
+  delete slice;
+}
+
+const char* leveldb_pinnableslice_value(const leveldb_pinnableslice_t* slice,
+                                        size_t* vlen) {
+  *vlen = slice->rep.size();
+  return slice->rep.data();
+}
+
 leveldb_writebatch_t* leveldb_writebatch_create() {
   return new leveldb_writebatch_t;
 }
@@ -339,6 +378,15 @@ void leveldb_writebatch_delete(leveldb_writebatch_t* b, const char* key,
   b->rep.Delete(Slice(key, klen));
 }
 
+void leveldb_writebatch_delete_range(leveldb_writebatch_t* b,
+                                     const char* start_key,
+                                     size_t start_key_len,
+                                     const char* limit_key,
+                                     size_t limit_key_len) {
+  b->rep.DeleteRange(Slice(start_key, start_key_len),
+                     Slice(limit_key, limit_key_len));
+}
+
 void leveldb_writebatch_iterate(const leveldb_writebatch_t* b, void* state,
                                 void (*put)(void*, const char* k, size_t klen,
                                             const char* v, size_t vlen),
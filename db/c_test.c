@@ -59,10 +59,22 @@ static void CheckGet(
   char* err = NULL;
   size_t val_len;
   char* val;
+  leveldb_pinnableslice_t* pinned;
   val = leveldb_get(db, options, key, strlen(key), &val_len, &err);
   CheckNoError(err);
   CheckEqual(expected, val, val_len);
   Free(&val);
+
+  pinned = leveldb_get_pinned(db, options, key, strlen(key), &err);
+  CheckNoError(err);
+  if (expected == NULL) {
+    CheckCondition(pinned == NULL);
+  } else {
+    CheckCondition(pinned != NULL);
+    CheckEqual(expected, leveldb_pinnableslice_value(pinned, &val_len),
+               val_len);
+    leveldb_pinnableslice_destroy(pinned);
+  }
 }
 
 static void CheckIter(leveldb_iterator_t* iter,
@@ -290,6 +302,16 @@ int main(int argc, char** argv) {
     CheckCondition(sizes[1] > 0);
   }
 
+  StartPhase("deleterange");
+  {
+    leveldb_delete_range(db, woptions, "k00000000000000000000", 21,
+                         "k00000000000000010000", 21, &err);
+    CheckNoError(err);
+    CheckGet(db, roptions, "k00000000000000000005", NULL);
+    CheckGet(db, roptions, "k00000000000000010000", "v00000000000000010000");
+    CheckGet(db, roptions, "box", "c");
+  }
+
   StartPhase("property");
   {
     char* prop = leveldb_property_value(db, "nosuchprop");
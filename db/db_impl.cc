@@ -8,10 +8,13 @@
 #include <atomic>
 #include <cstdint>
 #include <cstdio>
+#include <deque>
+#include <memory>
 #include <set>
 #include <string>
 #include <vector>
 
+#include "db/blob_file.h"
 #include "db/builder.h"
 #include "db/db_iter.h"
 #include "db/dbformat.h"
@@ -22,6 +25,7 @@
 #include "db/table_cache.h"
 #include "db/version_set.h"
 #include "db/write_batch_internal.h"
+#include "db/write_controller.h"
 #include "leveldb/db.h"
 #include "leveldb/env.h"
 #include "leveldb/status.h"
@@ -31,15 +35,22 @@
 #include "table/block.h"
 #include "table/merger.h"
 #include "table/two_level_iterator.h"
+#include "util/arena.h"
 #include "util/coding.h"
 #include "util/logging.h"
 #include "util/mutexlock.h"
+#include "util/rate_limiter.h"
 #include "mod/config.h"
 
 namespace leveldb {
 
 const int kNumNonTableCacheFiles = 10;
 
+// Blob files are only opened for reads of the values moved to them, and
+// there are few of them compared to tables, so a small cache keeps the
+// recently read ones open.
+const int kBlobCacheFiles = 16;
+
 // Information kept for every waiting writer
 struct DBImpl::Writer {
   explicit Writer(port::Mutex* mu)
@@ -52,12 +63,34 @@ struct DBImpl::Writer {
   port::CondVar cv;
 };
 
+// A batch group waiting for its log sync.  Groups are made visible in the
+// order they were logged.
+struct DBImpl::LogSync {
+  explicit LogSync(DBImpl* db)
+      : db(db),
+        batch(nullptr),
+        synced(false),
+        last_sequence(0),
+        cv(&db->mutex_) {}
+
+  DBImpl* const db;
+  WriteBatch* batch;  // The group's updates, applied once synced
+  std::unique_ptr<WriteBatch> owned_batch;  // Set if batch was tmp_batch_
+  Status status;
+  bool synced;  // Has the sync finished, or was none needed?
+  SequenceNumber last_sequence;
+  port::CondVar cv;
+};
+
 struct DBImpl::CompactionState {
   // Files produced by compaction
   struct Output {
     uint64_t number;
     uint64_t file_size;
     InternalKey smallest, largest;
+    uint64_t num_entries;
+    uint64_t num_deletions;
+    uint64_t num_range_deletions;
   };
 
   Output* current_output() { return &outputs[outputs.size() - 1]; }
@@ -67,7 +100,14 @@ struct DBImpl::CompactionState {
         smallest_snapshot(0),
         outfile(nullptr),
         builder(nullptr),
-        total_bytes(0) {}
+        total_bytes(0),
+        range_del(nullptr),
+        has_output_lower_bound(false),
+        blob_outfile(nullptr),
+        blob_builder(nullptr),
+        blob_bytes_read(0) {}
+
+  ~CompactionState() { delete range_del; }
 
   Compaction* const compaction;
 
@@ -84,6 +124,29 @@ struct DBImpl::CompactionState {
   TableBuilder* builder;
 
   uint64_t total_bytes;
+
+  // Range tombstones of the input files, or nullptr if there are none.
+  // Only tombstones at or below smallest_snapshot take part in coverage
+  // queries.
+  RangeDelAggregator* range_del;
+
+  // When range tombstones are present, outputs are cut between user keys
+  // and each output only carries the part of a tombstone that falls in
+  // [output_lower_bound, next cut).  has_output_lower_bound is false for
+  // the first output.
+  std::string output_lower_bound;
+  bool has_output_lower_bound;
+
+  // Blob files that hold enough garbage for their live values to be moved
+  // to the blob file of this compaction.
+  std::set<uint64_t> blob_gc_files;
+
+  // State kept for the blob file that moved values are written to, which
+  // is opened on the first one.
+  BlobFileMetaData blob_output;
+  WritableFile* blob_outfile;
+  BlobFileBuilder* blob_builder;
+  uint64_t blob_bytes_read;  // By the moves
 };
 
 // Fix user-supplied options to be reasonable
@@ -100,7 +163,9 @@ Options SanitizeOptions(const std::string& dbname,
   result.comparator = icmp;
   result.filter_policy = (src.filter_policy != nullptr) ? ipolicy : nullptr;
   ClipToRange(&result.max_open_files, 64 + kNumNonTableCacheFiles, 50000);
+  ClipToRange(&result.max_file_opening_threads, 1, 64);
   ClipToRange(&result.write_buffer_size, 64 << 10, 1 << 30);
+  ClipToRange(&result.max_write_buffer_number, 2, 64);
   ClipToRange(&result.max_file_size, 1 << 20, 1 << 30);
   ClipToRange(&result.block_size, 1 << 10, 4 << 20);
   if (result.info_log == nullptr) {
@@ -114,7 +179,8 @@ Options SanitizeOptions(const std::string& dbname,
     }
   }
   if (result.block_cache == nullptr) {
-    result.block_cache = NewLRUCache(8 << 20);
+    result.block_cache =
+        NewLRUCache(8 << 20, src.cache_index_and_filter_blocks ? 0.5 : 0);
   }
   return result;
 }
@@ -124,6 +190,20 @@ static int TableCacheSize(const Options& sanitized_options) {
   return sanitized_options.max_open_files - kNumNonTableCacheFiles;
 }
 
+static ArenaRegionPool* NewMemTableRegionPool(
+    const Options& sanitized_options) {
+  if (!sanitized_options.memtable_huge_pages) {
+    return nullptr;
+  }
+  // A memtable is switched out once it exceeds write_buffer_size, which
+  // may happen in the middle of a group commit of up to 1MB.  Up to
+  // max_write_buffer_number memtables are live at once, so keep the
+  // regions of all but the active one around for the memtables that
+  // replace them.
+  return new ArenaRegionPool(sanitized_options.write_buffer_size + (1 << 20),
+                             sanitized_options.max_write_buffer_number - 1);
+}
+
 DBImpl::DBImpl(const Options& raw_options, const std::string& dbname)
     : env_(raw_options.env),
       internal_comparator_(raw_options.comparator),
@@ -134,21 +214,29 @@ DBImpl::DBImpl(const Options& raw_options, const std::string& dbname)
       owns_cache_(options_.block_cache != raw_options.block_cache),
       dbname_(dbname),
       table_cache_(new TableCache(dbname_, options_, TableCacheSize(options_))),
+      blob_cache_(new BlobFileCache(dbname_, env_, kBlobCacheFiles)),
+      memtable_region_pool_(NewMemTableRegionPool(options_)),
       db_lock_(nullptr),
       shutting_down_(false),
       background_work_finished_signal_(&mutex_),
       mem_(nullptr),
-      imm_(nullptr),
       has_imm_(false),
       logfile_(nullptr),
       logfile_number_(0),
       log_(nullptr),
+      log_recycle_floor_(0),
       seed_(0),
       tmp_batch_(new WriteBatch),
+      log_syncs_drained_signal_(&mutex_),
       background_compaction_scheduled_(false),
       manual_compaction_(nullptr),
       versions_(new VersionSet(dbname_, &options_, table_cache_,
-                               &internal_comparator_)) {}
+                               &internal_comparator_)),
+      forced_compaction_pressure_(-1),
+      num_delayed_writes_(0),
+      num_stopped_writes_(0),
+      write_stall_micros_(0),
+      recovery_micros_(0) {}
 
 DBImpl::~DBImpl() {
   // Wait for background work to finish.
@@ -165,11 +253,22 @@ DBImpl::~DBImpl() {
 
   delete versions_;
   if (mem_ != nullptr) mem_->Unref();
-  if (imm_ != nullptr) imm_->Unref();
+  for (const ImmutableMemTable& imm : imm_) {
+    imm.mem->Unref();
+  }
   delete tmp_batch_;
+  if (log_ != nullptr) {
+    // Write out buffered records
+    Status s = log_->Flush();
+    if (!s.ok()) {
+      Log(options_.info_log, "Error flushing log: %s", s.ToString().c_str());
+    }
+  }
   delete log_;
   delete logfile_;
   delete table_cache_;
+  delete blob_cache_;
+  delete memtable_region_pool_;
 
   if (owns_info_log_) {
     delete options_.info_log;
@@ -179,6 +278,37 @@ DBImpl::~DBImpl() {
   }
 }
 
+MemTable* DBImpl::NewMemTable() const {
+  size_t hash_buckets = 0;
+  if (options_.memtable_rep == kHashMemTable) {
+    // About one bucket per 256 bytes of write buffer, which is a few
+    // small entries per bucket once the memtable is full.
+    hash_buckets = std::max<size_t>(options_.write_buffer_size >> 8, 16);
+  }
+  return new MemTable(internal_comparator_, memtable_region_pool_,
+                      hash_buckets);
+}
+
+bool DBImpl::LogBuffersRecords() const {
+  return options_.wal_compression != kNoCompression;
+}
+
+log::Writer* DBImpl::NewLogWriter(WritableFile* file, uint64_t file_length,
+                                  uint64_t log_number) const {
+  log::WriterOptions log_options;
+  if (LogBuffersRecords()) {
+    log_options.group = true;
+    log_options.compression = options_.wal_compression;
+    log_options.zstd_compression_level = options_.zstd_compression_level;
+    log_options.group_bytes = options_.wal_bytes_per_flush;
+  }
+  if (options_.recycle_log_file_num > 0 && file_length == 0) {
+    log_options.recyclable = true;
+    log_options.log_number = log_number;
+  }
+  return new log::Writer(file, file_length, log_options);
+}
+
 Status DBImpl::NewDB() {
   VersionEdit new_db;
   new_db.SetComparatorName(user_comparator()->Name());
@@ -247,7 +377,8 @@ void DBImpl::RemoveObsoleteFiles() {
       switch (type) {
         case kLogFile:
           keep = ((number >= versions_->LogNumber()) ||
-                  (number == versions_->PrevLogNumber()));
+                  (number == versions_->PrevLogNumber()) ||
+                  RecycleLogFile(number));
           break;
         case kDescriptorFile:
           // Keep my manifest file, and any newer incarnations'
@@ -255,6 +386,7 @@ void DBImpl::RemoveObsoleteFiles() {
           keep = (number >= versions_->ManifestFileNumber());
           break;
         case kTableFile:
+        case kBlobFile:
           keep = (live.find(number) != live.end());
           break;
         case kTempFile:
@@ -273,6 +405,8 @@ void DBImpl::RemoveObsoleteFiles() {
         files_to_delete.push_back(std::move(filename));
         if (type == kTableFile) {
           table_cache_->Evict(number);
+        } else if (type == kBlobFile) {
+          blob_cache_->Evict(number);
         }
         Log(options_.info_log, "Delete type=%d #%lld\n", static_cast<int>(type),
             static_cast<unsigned long long>(number));
@@ -290,6 +424,242 @@ void DBImpl::RemoveObsoleteFiles() {
   mutex_.Lock();
 }
 
+bool DBImpl::RecycleLogFile(uint64_t number) {
+  mutex_.AssertHeld();
+  if (std::find(recycled_logs_.begin(), recycled_logs_.end(), number) !=
+      recycled_logs_.end()) {
+    return true;
+  }
+  if (number <= log_recycle_floor_) {
+    return false;
+  }
+  // Directory listings are unordered, so logs below this one that become
+  // obsolete at the same time are deleted.  That is rare and harmless.
+  log_recycle_floor_ = number;
+  if (recycled_logs_.size() >= options_.recycle_log_file_num) {
+    return false;
+  }
+  Log(options_.info_log, "Recycle log #%llu\n",
+      static_cast<unsigned long long>(number));
+  recycled_logs_.push_back(number);
+  return true;
+}
+
+Status DBImpl::NewLogFile(uint64_t number, WritableFile** result) {
+  mutex_.AssertHeld();
+  const std::string fname = LogFileName(dbname_, number);
+  Status s;
+  *result = nullptr;
+  if (!recycled_logs_.empty()) {
+    const uint64_t old_number = recycled_logs_.front();
+    recycled_logs_.pop_front();
+    // On failure the old file is deleted along with other obsolete files.
+    env_->ReuseWritableFile(fname, LogFileName(dbname_, old_number), result);
+  }
+  if (*result == nullptr) {
+    s = env_->NewWritableFile(fname, result);
+  }
+  if (s.ok()) {
+    // The log grows to a little over the size of a memtable.  Reserving
+    // the space up front saves the file system from allocating it on
+    // every synced append.  This is only a hint, so errors are ignored.
+    (*result)->Preallocate(options_.write_buffer_size +
+                           options_.write_buffer_size / 10);
+  }
+  return s;
+}
+
+// Number of log files that recovery reads ahead of the one it replays.
+static const size_t kRecoveryReadAheadLogs = 2;
+
+// Reads the records of a log file on a separate thread, ahead of the
+// thread replaying them, so that reading and checksumming the log overlaps
+// with inserting into memtables and writing level-0 tables.
+class DBImpl::LogPrefetcher {
+ public:
+  // Open log file "number" and start reading it.
+  LogPrefetcher(Env* env, Logger* info_log, bool paranoid_checks,
+                const std::string& dbname, uint64_t number)
+      : info_log_(info_log),
+        paranoid_checks_(paranoid_checks),
+        number_(number),
+        fname_(LogFileName(dbname, number)),
+        file_(nullptr),
+        cv_(&mu_),
+        buffered_bytes_(0),
+        started_(false),
+        done_(false),
+        stop_(false),
+        grouped_(false),
+        recyclable_(false) {
+    status_ = env->NewSequentialFile(fname_, &file_);
+    if (status_.ok()) {
+      started_ = true;
+      env->StartThread(&LogPrefetcher::ReadWork, this);
+    }
+  }
+
+  LogPrefetcher(const LogPrefetcher&) = delete;
+  LogPrefetcher& operator=(const LogPrefetcher&) = delete;
+
+  ~LogPrefetcher() {
+    MutexLock l(&mu_);
+    stop_ = true;
+    cv_.SignalAll();
+    while (started_ && !done_) {
+      cv_.Wait();
+    }
+  }
+
+  uint64_t number() const { return number_; }
+
+  // Store the next record in *record, which remains valid until the next
+  // call.  Returns false at the end of the log, or at the first
+  // corruption if paranoid_checks is set.
+  bool ReadRecord(Slice* record) {
+    while (input_.empty()) {
+      MutexLock l(&mu_);
+      buffered_bytes_ -= current_.size();
+      current_.clear();
+      while (chunks_.empty() && !done_) {
+        cv_.Wait();
+      }
+      if (chunks_.empty()) {
+        return false;
+      }
+      current_.swap(chunks_.front());
+      chunks_.pop_front();
+      cv_.SignalAll();
+      input_ = current_;
+    }
+    return GetLengthPrefixedSlice(&input_, record);
+  }
+
+  // Returns the error hit opening the log or, once ReadRecord() has
+  // returned false, reading it.  Corruptions are only reported if
+  // paranoid_checks is set.
+  Status status() {
+    MutexLock l(&mu_);
+    return status_;
+  }
+
+  // Once ReadRecord() has returned false, returns true if the log can be
+  // appended to by a plain log::Writer.  Logs that switched to grouped
+  // records need a grouping writer, and logs in the recyclable format may
+  // be followed by the leftovers of the file they overwrote.
+  bool grouped() {
+    MutexLock l(&mu_);
+    return grouped_;
+  }
+  bool recyclable() {
+    MutexLock l(&mu_);
+    return recyclable_;
+  }
+
+ private:
+  // Records are handed over in chunks of about this many bytes, and at
+  // most kMaxBufferedBytes of them are read ahead.
+  static const size_t kChunkBytes = 1 << 20;
+  static const size_t kMaxBufferedBytes = 4 << 20;
+
+  struct LogReporter : public log::Reader::Reporter {
+    Logger* info_log;
+    const char* fname;
+    bool paranoid_checks;
+    Status status;
+    void Corruption(size_t bytes, const Status& s) override {
+      Log(info_log, "%s%s: dropping %d bytes; %s",
+          (paranoid_checks ? "" : "(ignoring error) "), fname,
+          static_cast<int>(bytes), s.ToString().c_str());
+      if (paranoid_checks && status.ok()) status = s;
+    }
+  };
+
+  static void ReadWork(void* arg) {
+    reinterpret_cast<LogPrefetcher*>(arg)->Read();
+  }
+
+  void Read() {
+    LogReporter reporter;
+    reporter.info_log = info_log_;
+    reporter.fname = fname_.c_str();
+    reporter.paranoid_checks = paranoid_checks_;
+    // We intentionally make log::Reader do checksumming even if
+    // paranoid_checks==false so that corruptions cause entire commits
+    // to be skipped instead of propagating bad information (like overly
+    // large sequence numbers).
+    log::Reader reader(file_, &reporter, true /*checksum*/,
+                       0 /*initial_offset*/, number_);
+    std::string scratch;
+    Slice record;
+    std::string chunk;
+    bool stopped = false;
+    while (!stopped && reader.ReadRecord(&record, &scratch) &&
+           reporter.status.ok()) {
+      if (record.size() < 12) {
+        reporter.Corruption(record.size(),
+                            Status::Corruption("log record too small"));
+        continue;
+      }
+      PutLengthPrefixedSlice(&chunk, record);
+      if (chunk.size() >= kChunkBytes) {
+        stopped = !Publish(&chunk);
+      }
+    }
+    delete file_;
+    file_ = nullptr;
+
+    MutexLock l(&mu_);
+    if (!chunk.empty()) {
+      buffered_bytes_ += chunk.size();
+      chunks_.push_back(std::move(chunk));
+    }
+    status_ = reporter.status;
+    grouped_ = reader.grouped();
+    recyclable_ = reader.recyclable();
+    done_ = true;
+    cv_.SignalAll();
+  }
+
+  // Hand *chunk over to the reader and clear it.  Returns false if the
+  // reader has lost interest.
+  bool Publish(std::string* chunk) {
+    MutexLock l(&mu_);
+    while (buffered_bytes_ >= kMaxBufferedBytes && !stop_) {
+      cv_.Wait();
+    }
+    if (stop_) {
+      return false;
+    }
+    buffered_bytes_ += chunk->size();
+    chunks_.push_back(std::move(*chunk));
+    chunk->clear();
+    cv_.SignalAll();
+    return true;
+  }
+
+  Logger* const info_log_;
+  const bool paranoid_checks_;
+  const uint64_t number_;
+  const std::string fname_;
+  SequentialFile* file_;  // Owned by the reading thread once started
+
+  // Accessed only by the thread replaying the records.
+  std::string current_;  // Chunk holding input_
+  Slice input_;          // Records of current_ not yet returned
+
+  port::Mutex mu_;
+  port::CondVar cv_ GUARDED_BY(mu_);
+  std::deque<std::string> chunks_ GUARDED_BY(mu_);
+  size_t buffered_bytes_ GUARDED_BY(mu_);
+  bool started_ GUARDED_BY(mu_);
+  bool done_ GUARDED_BY(mu_);
+  bool stop_ GUARDED_BY(mu_);
+  bool grouped_ GUARDED_BY(mu_);
+  bool recyclable_ GUARDED_BY(mu_);
+  Status status_ GUARDED_BY(mu_);
+};
+
 Status DBImpl::Recover(VersionEdit* edit, bool* save_manifest) {
   mutex_.AssertHeld();
 
@@ -322,10 +692,12 @@ Status DBImpl::Recover(VersionEdit* edit, bool* save_manifest) {
     }
   }
 
+  const uint64_t start_micros = env_->NowMicros();
   s = versions_->Recover(save_manifest);
   if (!s.ok()) {
     return s;
   }
+  const uint64_t manifest_micros = env_->NowMicros() - start_micros;
   SequenceNumber max_sequence(0);
 
   // Recover from all newer log files than the ones named in the
@@ -361,11 +733,23 @@ Status DBImpl::Recover(VersionEdit* edit, bool* save_manifest) {
     return Status::Corruption(buf, TableFileName(dbname_, *(expected.begin())));
   }
 
-  // Recover in the order in which the logs were generated
+  // Recover in the order in which the logs were generated, reading a few
+  // logs ahead of the one being replayed.
   std::sort(logs.begin(), logs.end());
+  std::deque<std::unique_ptr<LogPrefetcher>> prefetchers;
+  size_t next_prefetch = 0;
   for (size_t i = 0; i < logs.size(); i++) {
-    s = RecoverLogFile(logs[i], (i == logs.size() - 1), save_manifest, edit,
-                       &max_sequence);
+    while (next_prefetch < logs.size() &&
+           next_prefetch <= i + kRecoveryReadAheadLogs) {
+      prefetchers.emplace_back(
+          new LogPrefetcher(env_, options_.info_log, options_.paranoid_checks,
+                            dbname_, logs[next_prefetch]));
+      next_prefetch++;
+    }
+    std::unique_ptr<LogPrefetcher> log = std::move(prefetchers.front());
+    prefetchers.pop_front();
+    s = RecoverLogFile(log.get(), (i == logs.size() - 1), save_manifest,
+                       edit, &max_sequence);
     if (!s.ok()) {
       return s;
     }
@@ -380,66 +764,163 @@ Status DBImpl::Recover(VersionEdit* edit, bool* save_manifest) {
     versions_->SetLastSequence(max_sequence);
   }
 
+  Log(options_.info_log,
+      "Recovered MANIFEST in %llu micros and %d log files in %llu micros",
+      static_cast<unsigned long long>(manifest_micros),
+      static_cast<int>(logs.size()),
+      static_cast<unsigned long long>(env_->NowMicros() - start_micros -
+                                      manifest_micros));
   return Status::OK();
 }
 
-Status DBImpl::RecoverLogFile(uint64_t log_number, bool last_log,
-                              bool* save_manifest, VersionEdit* edit,
-                              SequenceNumber* max_sequence) {
-  struct LogReporter : public log::Reader::Reporter {
-    Env* env;
-    Logger* info_log;
-    const char* fname;
-    Status* status;  // null if options_.paranoid_checks==false
-    void Corruption(size_t bytes, const Status& s) override {
-      Log(info_log, "%s%s: dropping %d bytes; %s",
-          (this->status == nullptr ? "(ignoring error) " : ""), fname,
-          static_cast<int>(bytes), s.ToString().c_str());
-      if (this->status != nullptr && this->status->ok()) *this->status = s;
+// A memtable filled during recovery that is being written to level-0.
+struct DBImpl::RecoveryFlush {
+  explicit RecoveryFlush(DBImpl* db, VersionEdit* edit)
+      : db(db), edit(edit), mem(nullptr) {}
+
+  DBImpl* const db;
+  VersionEdit* const edit;
+  MemTable* mem;  // Non-null while the flush is running
+  Status status;
+};
+
+void DBImpl::StartRecoveryFlush(RecoveryFlush* flush) {
+  mutex_.AssertHeld();
+  assert(flush->mem != nullptr);
+  env_->StartThread(&DBImpl::RecoveryFlushWork, flush);
+}
+
+void DBImpl::RecoveryFlushWork(void* arg) {
+  RecoveryFlush* flush = reinterpret_cast<RecoveryFlush*>(arg);
+  DBImpl* db = flush->db;
+  MutexLock l(&db->mutex_);
+  flush->status = db->WriteLevel0Table(flush->mem, flush->edit, nullptr);
+  flush->mem->Unref();
+  flush->mem = nullptr;
+  db->background_work_finished_signal_.SignalAll();
+}
+
+Status DBImpl::WaitForRecoveryFlush(RecoveryFlush* flush) {
+  mutex_.AssertHeld();
+  while (flush->mem != nullptr) {
+    background_work_finished_signal_.Wait();
+  }
+  return flush->status;
+}
+
+// Table files being opened by OpenTableFiles().
+struct DBImpl::TableFileOpener {
+  TableFileOpener(TableCache* table_cache, bool verify_sizes)
+      : table_cache(table_cache),
+        verify_sizes(verify_sizes),
+        next(0),
+        cv(&mu),
+        running(0) {}
+
+  TableCache* const table_cache;
+  const bool verify_sizes;
+  std::vector<std::pair<uint64_t, uint64_t>> files;  // (number, size)
+  std::atomic<size_t> next;  // Index in files of the next file to open
+
+  port::Mutex mu;
+  port::CondVar cv;
+  int running GUARDED_BY(mu);    // Number of threads still opening files
+  Status status GUARDED_BY(mu);  // First error hit by any thread
+};
+
+void DBImpl::OpenTableFilesWork(void* arg) {
+  TableFileOpener* opener = reinterpret_cast<TableFileOpener*>(arg);
+  Status status;
+  while (true) {
+    const size_t i = opener->next.fetch_add(1, std::memory_order_relaxed);
+    if (i >= opener->files.size()) {
+      break;
     }
-  };
+    Status s = opener->table_cache->Prewarm(
+        opener->files[i].first, opener->files[i].second, opener->verify_sizes);
+    if (status.ok()) {
+      status = s;
+    }
+  }
+  MutexLock l(&opener->mu);
+  if (opener->status.ok()) {
+    opener->status = status;
+  }
+  opener->running--;
+  opener->cv.Signal();
+}
 
+Status DBImpl::OpenTableFiles() {
   mutex_.AssertHeld();
+  const uint64_t start_micros = env_->NowMicros();
+  TableFileOpener opener(table_cache_, options_.paranoid_checks);
+  // Files beyond what the table cache holds would only evict each other.
+  const size_t capacity = TableCacheSize(options_);
+  Version* current = versions_->current();
+  for (int level = 0; level < config::kNumLevels; level++) {
+    for (FileMetaData* f : current->files(level)) {
+      if (opener.files.size() < capacity) {
+        opener.files.emplace_back(f->number, f->file_size);
+      }
+    }
+  }
 
-  // Open the log file
-  std::string fname = LogFileName(dbname_, log_number);
-  SequentialFile* file;
-  Status status = env_->NewSequentialFile(fname, &file);
+  // Nothing else uses the DB before DB::Open() returns, so the files of
+  // the current version cannot be deleted in the meantime.
+  mutex_.Unlock();
+  const int threads = static_cast<int>(std::min<size_t>(
+      options_.max_file_opening_threads, opener.files.size()));
+  opener.mu.Lock();
+  for (int i = 0; i < threads; i++) {
+    opener.running++;
+    env_->StartThread(&DBImpl::OpenTableFilesWork, &opener);
+  }
+  while (opener.running > 0) {
+    opener.cv.Wait();
+  }
+  Status s = opener.status;
+  opener.mu.Unlock();
+  mutex_.Lock();
+
+  Log(options_.info_log, "Opened %d table files in %llu micros: %s",
+      static_cast<int>(opener.files.size()),
+      static_cast<unsigned long long>(env_->NowMicros() - start_micros),
+      s.ToString().c_str());
+  if (!options_.paranoid_checks) {
+    // Reads of the file will report the problem.
+    s = Status::OK();
+  }
+  return s;
+}
+
+Status DBImpl::RecoverLogFile(LogPrefetcher* log, bool last_log,
+                              bool* save_manifest, VersionEdit* edit,
+                              SequenceNumber* max_sequence) {
+  mutex_.AssertHeld();
+  Status status = log->status();
   if (!status.ok()) {
+    // The log file could not be opened, or it was read ahead of replay
+    // and a corruption was found (only reported with paranoid_checks).
     MaybeIgnoreError(&status);
     return status;
   }
-
-  // Create the log reader.
-  LogReporter reporter;
-  reporter.env = env_;
-  reporter.info_log = options_.info_log;
-  reporter.fname = fname.c_str();
-  reporter.status = (options_.paranoid_checks ? &status : nullptr);
-  // We intentionally make log::Reader do checksumming even if
-  // paranoid_checks==false so that corruptions cause entire commits
-  // to be skipped instead of propagating bad information (like overly
-  // large sequence numbers).
-  log::Reader reader(file, &reporter, true /*checksum*/, 0 /*initial_offset*/);
   Log(options_.info_log, "Recovering log #%llu",
-      (unsigned long long)log_number);
+      (unsigned long long)log->number());
 
-  // Read all the records and add to a memtable
-  std::string scratch;
+  // Read all the records and add to a memtable.  Once the memtable is
+  // full it is written to level-0 by a separate thread while the next
+  // one is being filled.  The mutex is only needed for the writes.
+  RecoveryFlush flush(this, edit);
   Slice record;
   WriteBatch batch;
   int compactions = 0;
   MemTable* mem = nullptr;
-  while (reader.ReadRecord(&record, &scratch) && status.ok()) {
-    if (record.size() < 12) {
-      reporter.Corruption(record.size(),
-                          Status::Corruption("log record too small"));
-      continue;
-    }
+  mutex_.Unlock();
+  while (log->ReadRecord(&record)) {
     WriteBatchInternal::SetContents(&batch, record);
 
     if (mem == nullptr) {
-      mem = new MemTable(internal_comparator_);
+      mem = NewMemTable();
       mem->Ref();
     }
     status = WriteBatchInternal::InsertInto(&batch, mem);
@@ -456,9 +937,16 @@ Status DBImpl::RecoverLogFile(uint64_t log_number, bool last_log,
     if (mem->ApproximateMemoryUsage() > options_.write_buffer_size) {
       compactions++;
       *save_manifest = true;
-      status = WriteLevel0Table(mem, edit, nullptr);
-      mem->Unref();
-      mem = nullptr;
+      mutex_.Lock();
+      // Flushes complete in order, so level-0 files are numbered in the
+      // order of the updates they hold.
+      status = WaitForRecoveryFlush(&flush);
+      if (status.ok()) {
+        flush.mem = mem;
+        mem = nullptr;
+        StartRecoveryFlush(&flush);
+      }
+      mutex_.Unlock();
       if (!status.ok()) {
         // Reflect errors immediately so that conditions like full
         // file-systems cause the DB::Open() to fail.
@@ -466,26 +954,39 @@ Status DBImpl::RecoverLogFile(uint64_t log_number, bool last_log,
       }
     }
   }
+  mutex_.Lock();
+  Status flush_status = WaitForRecoveryFlush(&flush);
+  if (status.ok()) {
+    status = flush_status;
+  }
+  if (status.ok()) {
+    // Corruption found while reading, if paranoid_checks is set.
+    status = log->status();
+  }
 
-  delete file;
-
-  // See if we should keep reusing the last log file.
-  if (status.ok() && options_.reuse_logs && last_log && compactions == 0) {
+  // See if we should keep reusing the last log file.  A log that switched
+  // to grouped records can only be appended to by a grouping writer, and a
+  // log in the recyclable format may end before the end of its file.
+  if (status.ok() && options_.reuse_logs && last_log && compactions == 0 &&
+      (options_.wal_compression != kNoCompression || !log->grouped()) &&
+      !log->recyclable()) {
     assert(logfile_ == nullptr);
     assert(log_ == nullptr);
     assert(mem_ == nullptr);
+    const std::string fname = LogFileName(dbname_, log->number());
     uint64_t lfile_size;
     if (env_->GetFileSize(fname, &lfile_size).ok() &&
         env_->NewAppendableFile(fname, &logfile_).ok()) {
       Log(options_.info_log, "Reusing old log %s \n", fname.c_str());
-      log_ = new log::Writer(logfile_, lfile_size);
-      logfile_number_ = log_number;
+      log_ = NewLogWriter(logfile_, lfile_size, log->number());
+      logfile_number_ = log->number();
+      log_recycle_floor_ = logfile_number_;
       if (mem != nullptr) {
         mem_ = mem;
         mem = nullptr;
       } else {
         // mem can be nullptr if lognum exists but was empty.
-        mem_ = new MemTable(internal_comparator_);
+        mem_ = NewMemTable();
         mem_->Ref();
       }
     }
@@ -510,22 +1011,36 @@ Status DBImpl::WriteLevel0Table(MemTable* mem, VersionEdit* edit,
   FileMetaData meta;
   meta.number = versions_->NewFileNumber();
   pending_outputs_.insert(meta.number);
+  BlobFileMetaData blob;
+  if (options_.min_blob_size > 0) {
+    blob.number = versions_->NewFileNumber();
+    pending_outputs_.insert(blob.number);
+  }
   Iterator* iter = mem->NewIterator();
+  Iterator* range_del_iter = mem->NewRangeTombstoneIterator();
   Log(options_.info_log, "Level-0 table #%llu: started",
       (unsigned long long)meta.number);
 
   Status s;
   {
     mutex_.Unlock();
-    s = BuildTable(dbname_, env_, options_, table_cache_, iter, &meta);
+    s = BuildTable(dbname_, env_, options_, table_cache_, iter, range_del_iter,
+                   &meta, blob.number != 0 ? &blob : nullptr);
     mutex_.Lock();
   }
 
   Log(options_.info_log, "Level-0 table #%llu: %lld bytes %s",
       (unsigned long long)meta.number, (unsigned long long)meta.file_size,
       s.ToString().c_str());
+  if (blob.total_count > 0) {
+    Log(options_.info_log, "Blob file #%llu: %lld values, %lld bytes",
+        (unsigned long long)blob.number, (long long)blob.total_count,
+        (long long)blob.total_bytes);
+  }
   delete iter;
+  delete range_del_iter;
   pending_outputs_.erase(meta.number);
+  pending_outputs_.erase(blob.number);
 
   // Note that if file_size is zero, the file has been deleted and
   // should not be added to the manifest.
@@ -536,26 +1051,31 @@ Status DBImpl::WriteLevel0Table(MemTable* mem, VersionEdit* edit,
     if (base != nullptr) {
       level = base->PickLevelForMemTableOutput(min_user_key, max_user_key);
     }
-    edit->AddFile(level, meta.number, meta.file_size, meta.smallest,
-                  meta.largest);
+    edit->AddFile(level, meta);
+    if (blob.total_count > 0) {
+      edit->AddBlobFile(blob);
+    }
   }
 
   CompactionStats stats;
   stats.micros = env_->NowMicros() - start_micros;
-  stats.bytes_written = meta.file_size;
+  stats.bytes_written = meta.file_size + blob.total_bytes;
   stats_[level].Add(stats);
+  write_controller_.RecordCompaction(stats.bytes_written, stats.micros);
   return s;
 }
 
 void DBImpl::CompactMemTable() {
   mutex_.AssertHeld();
-  assert(imm_ != nullptr);
+  assert(!imm_.empty());
 
-  // Save the contents of the memtable as a new Table
+  // Save the contents of the oldest memtable as a new Table.  Only the
+  // background thread removes memtables from imm_, so it stays in front.
+  MemTable* imm = imm_.front().mem;
   VersionEdit edit;
   Version* base = versions_->current();
   base->Ref();
-  Status s = WriteLevel0Table(imm_, &edit, base);
+  Status s = WriteLevel0Table(imm, &edit, base);
   base->Unref();
 
   if (s.ok() && shutting_down_.load(std::memory_order_acquire)) {
@@ -564,16 +1084,19 @@ void DBImpl::CompactMemTable() {
 
   // Replace immutable memtable with the generated Table
   if (s.ok()) {
+    // The oldest log still needed is the one of the next memtable.
     edit.SetPrevLogNumber(0);
-    edit.SetLogNumber(logfile_number_);  // Earlier logs no longer needed
+    edit.SetLogNumber(imm_.size() > 1 ? imm_[1].log_number
+                                      : logfile_number_);
     s = versions_->LogAndApply(&edit, &mutex_);
   }
 
   if (s.ok()) {
     // Commit to the new state
-    imm_->Unref();
-    imm_ = nullptr;
-    has_imm_.store(false, std::memory_order_release);
+    assert(imm_.front().mem == imm);
+    imm->Unref();
+    imm_.pop_front();
+    has_imm_.store(!imm_.empty(), std::memory_order_release);
     RemoveObsoleteFiles();
   } else {
     RecordBackgroundError(s);
@@ -642,10 +1165,10 @@ Status DBImpl::TEST_CompactMemTable() {
   if (s.ok()) {
     // Wait until the compaction completes
     MutexLock l(&mutex_);
-    while (imm_ != nullptr && bg_error_.ok()) {
+    while (!imm_.empty() && bg_error_.ok()) {
       background_work_finished_signal_.Wait();
     }
-    if (imm_ != nullptr) {
+    if (!imm_.empty()) {
       s = bg_error_;
     }
   }
@@ -668,8 +1191,8 @@ void DBImpl::MaybeScheduleCompaction() {
     // DB is being deleted; no more background compactions
   } else if (!bg_error_.ok()) {
     // Already got an error; no more changes
-  } else if (imm_ == nullptr && manual_compaction_ == nullptr &&
-             !versions_->NeedsCompaction()) {
+  } else if (imm_.empty() && manual_compaction_ == nullptr &&
+             pending_covered_files_.empty() && !versions_->NeedsCompaction()) {
     // No work to be done
   } else {
     background_compaction_scheduled_ = true;
@@ -703,7 +1226,15 @@ void DBImpl::BackgroundCall() {
 void DBImpl::BackgroundCompaction() {
   mutex_.AssertHeld();
 
-  if (imm_ != nullptr) {
+  if (!pending_covered_files_.empty()) {
+    // Only a manifest update, so it does not hold up the memtable flush.
+    RemoveCoveredFiles();
+    if (!bg_error_.ok()) {
+      return;
+    }
+  }
+
+  if (!imm_.empty()) {
     CompactMemTable();
     return;
   }
@@ -735,8 +1266,7 @@ void DBImpl::BackgroundCompaction() {
     assert(c->num_input_files(0) == 1);
     FileMetaData* f = c->input(0, 0);
     c->edit()->RemoveFile(c->level(), f->number);
-    c->edit()->AddFile(c->level() + 1, f->number, f->file_size, f->smallest,
-                       f->largest);
+    c->edit()->AddFile(c->level() + 1, *f);
     status = versions_->LogAndApply(c->edit(), &mutex_);
     if (!status.ok()) {
       RecordBackgroundError(status);
@@ -781,6 +1311,99 @@ void DBImpl::BackgroundCompaction() {
   }
 }
 
+void DBImpl::RemoveCoveredFiles() {
+  mutex_.AssertHeld();
+  VersionEdit edit;
+  int removed = 0;
+  std::vector<std::pair<int, uint64_t>> files;
+  std::vector<FileMetaData*> removed_files;
+  for (const CoveredFiles& covered : pending_covered_files_) {
+    if (!snapshots_.empty() &&
+        snapshots_.oldest()->sequence_number() < covered.sequence) {
+      // A snapshot may still read these files.  The tombstone hides their
+      // contents from newer reads and compaction will reclaim them.
+      continue;
+    }
+    // Files may have been compacted or moved since DeleteRange() ran.
+    // Only those that still exist and are still covered are removed.
+    versions_->current()->GetCoveredFiles(covered.begin, covered.end, &files);
+    for (const auto& level_and_number : files) {
+      if (std::find(covered.numbers.begin(), covered.numbers.end(),
+                    level_and_number.second) != covered.numbers.end() &&
+          std::find_if(removed_files.begin(), removed_files.end(),
+                       [&](FileMetaData* f) {
+                         return f->number == level_and_number.second;
+                       }) == removed_files.end()) {
+        edit.RemoveFile(level_and_number.first, level_and_number.second);
+        for (FileMetaData* f :
+             versions_->current()->files(level_and_number.first)) {
+          if (f->number == level_and_number.second) {
+            removed_files.push_back(f);
+          }
+        }
+        removed++;
+      }
+    }
+  }
+  pending_covered_files_.clear();
+
+  if (removed == 0) {
+    return;
+  }
+  Status s;
+  if (!versions_->current()->blob_files().empty()) {
+    s = AddBlobGarbage(removed_files, &edit);
+  }
+  if (s.ok()) {
+    s = versions_->LogAndApply(&edit, &mutex_);
+  }
+  if (s.ok()) {
+    RemoveObsoleteFiles();
+  } else {
+    RecordBackgroundError(s);
+  }
+  VersionSet::LevelSummaryStorage tmp;
+  Log(options_.info_log, "Dropped %d files covered by range deletions %s: %s\n",
+      removed, s.ToString().c_str(), versions_->LevelSummary(&tmp));
+}
+
+Status DBImpl::AddBlobGarbage(const std::vector<FileMetaData*>& files,
+                              VersionEdit* edit) {
+  mutex_.AssertHeld();
+  Version* base = versions_->current();
+  base->Ref();
+  mutex_.Unlock();
+
+  Status s;
+  ReadOptions options;
+  options.verify_checksums = options_.paranoid_checks;
+  options.fill_cache = false;
+  ParsedInternalKey ikey;
+  BlobIndex index;
+  for (size_t i = 0; i < files.size() && s.ok(); i++) {
+    Iterator* iter = table_cache_->NewIterator(options, files[i]->number,
+                                               files[i]->file_size);
+    for (iter->SeekToFirst(); iter->Valid(); iter->Next()) {
+      if (ParseInternalKey(iter->key(), &ikey) &&
+          ikey.type == kTypeBlobIndex) {
+        if (!index.DecodeFrom(iter->value())) {
+          s = Status::Corruption("corrupted blob index");
+          break;
+        }
+        edit->AddBlobGarbage(index.file_number, 1, index.RecordSize());
+      }
+    }
+    if (s.ok()) {
+      s = iter->status();
+    }
+    delete iter;
+  }
+
+  mutex_.Lock();
+  base->Unref();
+  return s;
+}
+
 void DBImpl::CleanupCompaction(CompactionState* compact) {
   mutex_.AssertHeld();
   if (compact->builder != nullptr) {
@@ -791,10 +1414,13 @@ void DBImpl::CleanupCompaction(CompactionState* compact) {
     assert(compact->outfile == nullptr);
   }
   delete compact->outfile;
+  delete compact->blob_builder;
+  delete compact->blob_outfile;
   for (size_t i = 0; i < compact->outputs.size(); i++) {
     const CompactionState::Output& out = compact->outputs[i];
     pending_outputs_.erase(out.number);
   }
+  pending_outputs_.erase(compact->blob_output.number);
   delete compact;
 }
 
@@ -810,6 +1436,9 @@ Status DBImpl::OpenCompactionOutputFile(CompactionState* compact) {
     out.number = file_number;
     out.smallest.Clear();
     out.largest.Clear();
+    out.num_entries = 0;
+    out.num_deletions = 0;
+    out.num_range_deletions = 0;
     compact->outputs.push_back(out);
     mutex_.Unlock();
   }
@@ -817,12 +1446,61 @@ Status DBImpl::OpenCompactionOutputFile(CompactionState* compact) {
   // Make the output file
   std::string fname = TableFileName(dbname_, file_number);
   Status s = env_->NewWritableFile(fname, &compact->outfile);
+  if (s.ok() && options_.rate_limiter != nullptr) {
+    compact->outfile = NewRateLimitedWritableFile(
+        compact->outfile, options_.rate_limiter, RateLimiter::kLow);
+  }
   if (s.ok()) {
-    compact->builder = new TableBuilder(options_, compact->outfile);
+    Options table_options = options_;
+    table_options.compression =
+        CompressionForLevel(options_, compact->compaction->level() + 1);
+    compact->builder = new TableBuilder(table_options, compact->outfile);
   }
   return s;
 }
 
+void DBImpl::CollectOutputRangeTombstones(
+    CompactionState* compact, Iterator* input,
+    std::vector<RangeTombstone>* result) {
+  const Comparator* ucmp = user_comparator();
+  const bool has_upper = input->Valid();
+  const Slice upper = has_upper ? ExtractUserKey(input->key()) : Slice();
+  result->clear();
+  for (const RangeTombstone& t : compact->range_del->tombstones()) {
+    if (t.seq <= compact->smallest_snapshot &&
+        compact->compaction->IsBaseLevelForRange(t.start_key, t.end_key)) {
+      // Nothing older is left for the tombstone to hide.
+      continue;
+    }
+    RangeTombstone clipped = t;
+    if (compact->has_output_lower_bound &&
+        ucmp->Compare(clipped.start_key, compact->output_lower_bound) < 0) {
+      clipped.start_key = compact->output_lower_bound;
+    }
+    if (has_upper && ucmp->Compare(clipped.end_key, upper) > 0) {
+      clipped.end_key = upper.ToString();
+    }
+    if (ucmp->Compare(clipped.start_key, clipped.end_key) < 0) {
+      result->push_back(std::move(clipped));
+    }
+  }
+  // Order by internal key, dropping pieces of the same tombstone that
+  // were split across input files and clip to the same start.
+  std::sort(result->begin(), result->end(),
+            [ucmp](const RangeTombstone& a, const RangeTombstone& b) {
+              int r = ucmp->Compare(a.start_key, b.start_key);
+              return r != 0 ? r < 0 : a.seq > b.seq;
+            });
+  result->erase(std::unique(result->begin(), result->end(),
+                            [ucmp](const RangeTombstone& a,
+                                   const RangeTombstone& b) {
+                              return a.seq == b.seq &&
+                                     ucmp->Compare(a.start_key,
+                                                   b.start_key) == 0;
+                            }),
+                result->end());
+}
+
 Status DBImpl::FinishCompactionOutputFile(CompactionState* compact,
                                           Iterator* input) {
   assert(compact != nullptr);
@@ -834,7 +1512,34 @@ Status DBImpl::FinishCompactionOutputFile(CompactionState* compact,
 
   // Check for iterator errors
   Status s = input->status();
+  if (s.ok() && compact->range_del != nullptr) {
+    // The output claims the full span of the tombstones it carries.
+    CompactionState::Output* out = compact->current_output();
+    bool has_bounds = compact->builder->NumEntries() > 0;
+    std::vector<RangeTombstone> tombstones;
+    CollectOutputRangeTombstones(compact, input, &tombstones);
+    for (const RangeTombstone& t : tombstones) {
+      InternalKey start(t.start_key, t.seq, kTypeRangeDeletion);
+      InternalKey limit(t.end_key, kMaxSequenceNumber, kTypeRangeDeletion);
+      compact->builder->AddRangeTombstone(start.Encode(), t.end_key);
+      if (!has_bounds ||
+          internal_comparator_.Compare(start, out->smallest) < 0) {
+        out->smallest = start;
+      }
+      if (!has_bounds ||
+          internal_comparator_.Compare(limit, out->largest) > 0) {
+        out->largest = limit;
+      }
+      has_bounds = true;
+    }
+    out->num_range_deletions = compact->builder->NumRangeTombstones();
+    compact->has_output_lower_bound = input->Valid();
+    if (input->Valid()) {
+      compact->output_lower_bound = ExtractUserKey(input->key()).ToString();
+    }
+  }
   const uint64_t current_entries = compact->builder->NumEntries();
+  compact->current_output()->num_entries = current_entries;
   if (s.ok()) {
     s = compact->builder->Finish();
   } else {
@@ -872,6 +1577,73 @@ Status DBImpl::FinishCompactionOutputFile(CompactionState* compact,
   return s;
 }
 
+Status DBImpl::MoveBlobValue(CompactionState* compact,
+                             const Slice& blob_index,
+                             std::string* moved_index) {
+  BlobIndex index;
+  if (!index.DecodeFrom(blob_index)) {
+    return Status::Corruption("corrupted blob index");
+  }
+  Status s;
+  if (compact->blob_builder == nullptr) {
+    mutex_.Lock();
+    compact->blob_output.number = versions_->NewFileNumber();
+    pending_outputs_.insert(compact->blob_output.number);
+    mutex_.Unlock();
+    s = env_->NewWritableFile(
+        BlobFileName(dbname_, compact->blob_output.number),
+        &compact->blob_outfile);
+    if (!s.ok()) {
+      return s;
+    }
+    if (options_.rate_limiter != nullptr) {
+      compact->blob_outfile = NewRateLimitedWritableFile(
+          compact->blob_outfile, options_.rate_limiter, RateLimiter::kLow);
+    }
+    compact->blob_builder = new BlobFileBuilder(compact->blob_outfile,
+                                                compact->blob_output.number);
+  }
+
+  ReadOptions options;
+  options.verify_checksums = options_.paranoid_checks;
+  std::string value;
+  s = blob_cache_->Get(options, index, &value);
+  BlobIndex moved;
+  if (s.ok()) {
+    s = compact->blob_builder->Add(value, &moved);
+  }
+  if (s.ok()) {
+    compact->blob_bytes_read += index.RecordSize();
+    compact->compaction->edit()->AddBlobGarbage(index.file_number, 1,
+                                                index.RecordSize());
+    moved_index->clear();
+    moved.EncodeTo(moved_index);
+  }
+  return s;
+}
+
+Status DBImpl::FinishCompactionBlobFile(CompactionState* compact) {
+  compact->blob_output.total_count = compact->blob_builder->NumEntries();
+  compact->blob_output.total_bytes = compact->blob_builder->FileSize();
+  delete compact->blob_builder;
+  compact->blob_builder = nullptr;
+
+  Status s = compact->blob_outfile->Sync();
+  if (s.ok()) {
+    s = compact->blob_outfile->Close();
+  }
+  delete compact->blob_outfile;
+  compact->blob_outfile = nullptr;
+  if (s.ok()) {
+    compact->compaction->edit()->AddBlobFile(compact->blob_output);
+    Log(options_.info_log, "Generated blob file #%llu: %lld values, %lld bytes",
+        (unsigned long long)compact->blob_output.number,
+        (long long)compact->blob_output.total_count,
+        (long long)compact->blob_output.total_bytes);
+  }
+  return s;
+}
+
 Status DBImpl::InstallCompactionResults(CompactionState* compact) {
   mutex_.AssertHeld();
   Log(options_.info_log, "Compacted %d@%d + %d@%d files => %lld bytes",
@@ -884,8 +1656,15 @@ Status DBImpl::InstallCompactionResults(CompactionState* compact) {
   const int level = compact->compaction->level();
   for (size_t i = 0; i < compact->outputs.size(); i++) {
     const CompactionState::Output& out = compact->outputs[i];
-    compact->compaction->edit()->AddFile(level + 1, out.number, out.file_size,
-                                         out.smallest, out.largest);
+    FileMetaData f;
+    f.number = out.number;
+    f.file_size = out.file_size;
+    f.smallest = out.smallest;
+    f.largest = out.largest;
+    f.num_entries = out.num_entries;
+    f.num_deletions = out.num_deletions;
+    f.num_range_deletions = out.num_range_deletions;
+    compact->compaction->edit()->AddFile(level + 1, f);
   }
   return versions_->LogAndApply(compact->compaction->edit(), &mutex_);
 }
@@ -907,24 +1686,57 @@ Status DBImpl::DoCompactionWork(CompactionState* compact) {
   } else {
     compact->smallest_snapshot = snapshots_.oldest()->sequence_number();
   }
+  for (const auto& blob_kvp : versions_->current()->blob_files()) {
+    const BlobFileMetaData& f = blob_kvp.second;
+    if (f.garbage_bytes >= options_.blob_gc_ratio * f.total_bytes) {
+      compact->blob_gc_files.insert(f.number);
+    }
+  }
 
   Iterator* input = versions_->MakeInputIterator(compact->compaction);
 
   // Release mutex while we're actually doing the compaction work
   mutex_.Unlock();
 
-  input->SeekToFirst();
   Status status;
+  RangeDelAggregator* range_del =
+      new RangeDelAggregator(user_comparator(), compact->smallest_snapshot);
+  for (int which = 0; which < 2; which++) {
+    for (int i = 0; i < compact->compaction->num_input_files(which); i++) {
+      const FileMetaData* f = compact->compaction->input(which, i);
+      if (f->num_range_deletions > 0 && status.ok()) {
+        status = table_cache_->AddRangeTombstones(f->number, f->file_size,
+                                                  range_del);
+      }
+    }
+  }
+  if (status.ok()) {
+    status = range_del->status();
+  }
+  if (range_del->empty()) {
+    delete range_del;
+  } else {
+    compact->range_del = range_del;
+  }
+
+  // Input is charged to the rate limiter in pieces of about a block.
+  RateLimiter* const read_limiter =
+      options_.rate_limit_compaction_reads ? options_.rate_limiter : nullptr;
+  size_t uncharged_read_bytes = 0;
+
+  input->SeekToFirst();
   ParsedInternalKey ikey;
   std::string current_user_key;
   bool has_current_user_key = false;
   SequenceNumber last_sequence_for_key = kMaxSequenceNumber;
-  while (input->Valid() && !shutting_down_.load(std::memory_order_acquire)) {
+  bool pending_cut = false;  // Output is full; cut at the next user key
+  while (status.ok() && input->Valid() &&
+         !shutting_down_.load(std::memory_order_acquire)) {
     // Prioritize immutable compaction work
     if (has_imm_.load(std::memory_order_relaxed)) {
       const uint64_t imm_start = env_->NowMicros();
       mutex_.Lock();
-      if (imm_ != nullptr) {
+      if (!imm_.empty()) {
         CompactMemTable();
         // Wake up MakeRoomForWrite() if necessary.
         background_work_finished_signal_.SignalAll();
@@ -934,8 +1746,20 @@ Status DBImpl::DoCompactionWork(CompactionState* compact) {
     }
 
     Slice key = input->key();
-    if (compact->compaction->ShouldStopBefore(key) &&
-        compact->builder != nullptr) {
+    bool stop_before = compact->compaction->ShouldStopBefore(key);
+    if (compact->range_del != nullptr) {
+      // Never split the entries of one user key across outputs, so that
+      // tombstones can be clipped at the boundary between two outputs.
+      stop_before = stop_before || pending_cut;
+      pending_cut = false;
+      if (stop_before && has_current_user_key && key.size() >= 8 &&
+          user_comparator()->Compare(ExtractUserKey(key), current_user_key) ==
+              0) {
+        pending_cut = true;
+        stop_before = false;
+      }
+    }
+    if (stop_before && compact->builder != nullptr) {
       status = FinishCompactionOutputFile(compact, input);
       if (!status.ok()) {
         break;
@@ -973,10 +1797,40 @@ Status DBImpl::DoCompactionWork(CompactionState* compact) {
         //     few iterations of this loop (by rule (A) above).
         // Therefore this deletion marker is obsolete and can be dropped.
         drop = true;
+      } else if (compact->range_del != nullptr &&
+                 compact->range_del->ShouldDelete(ikey)) {
+        // Covered by a range tombstone that every snapshot can see.
+        drop = true;
       }
 
       last_sequence_for_key = ikey.sequence;
     }
+
+    // The value that a dropped entry points to becomes garbage.  That of a
+    // live one is moved if its blob file is being collected.
+    Slice value = input->value();
+    std::string moved_index;
+    if (has_current_user_key && ikey.type == kTypeBlobIndex) {
+      if (drop) {
+        BlobIndex index;
+        if (!index.DecodeFrom(value)) {
+          status = Status::Corruption("corrupted blob index");
+          break;
+        }
+        compact->compaction->edit()->AddBlobGarbage(index.file_number, 1,
+                                                    index.RecordSize());
+      } else {
+        BlobIndex index;
+        if (index.DecodeFrom(value) &&
+            compact->blob_gc_files.count(index.file_number) > 0) {
+          status = MoveBlobValue(compact, value, &moved_index);
+          if (!status.ok()) {
+            break;
+          }
+          value = moved_index;
+        }
+      }
+    }
 #if 0
     Log(options_.info_log,
         "  Compact: %s, seq %d, type: %d %d, drop: %d, is_base: %d, "
@@ -999,18 +1853,33 @@ Status DBImpl::DoCompactionWork(CompactionState* compact) {
         compact->current_output()->smallest.DecodeFrom(key);
       }
       compact->current_output()->largest.DecodeFrom(key);
-      compact->builder->Add(key, input->value());
+      compact->builder->Add(key, value);
+      if (has_current_user_key && ikey.type == kTypeDeletion) {
+        compact->current_output()->num_deletions++;
+      }
 
       // Close output file if it is big enough
       if (compact->builder->FileSize() >=
           compact->compaction->MaxOutputFileSize()) {
-        status = FinishCompactionOutputFile(compact, input);
-        if (!status.ok()) {
-          break;
+        if (compact->range_del != nullptr) {
+          pending_cut = true;
+        } else {
+          status = FinishCompactionOutputFile(compact, input);
+          if (!status.ok()) {
+            break;
+          }
         }
       }
     }
 
+    if (read_limiter != nullptr) {
+      uncharged_read_bytes += key.size() + input->value().size();
+      if (uncharged_read_bytes >= options_.block_size) {
+        read_limiter->Request(uncharged_read_bytes, RateLimiter::kLow);
+        uncharged_read_bytes = 0;
+      }
+    }
+
     input->Next();
   }
   #if LOG_METRICS
@@ -1020,9 +1889,21 @@ Status DBImpl::DoCompactionWork(CompactionState* compact) {
   if (status.ok() && shutting_down_.load(std::memory_order_acquire)) {
     status = Status::IOError("Deleting DB during compaction");
   }
+  if (status.ok() && compact->builder == nullptr &&
+      compact->range_del != nullptr) {
+    // Tombstones past the last surviving entry still need a home.
+    std::vector<RangeTombstone> tombstones;
+    CollectOutputRangeTombstones(compact, input, &tombstones);
+    if (!tombstones.empty()) {
+      status = OpenCompactionOutputFile(compact);
+    }
+  }
   if (status.ok() && compact->builder != nullptr) {
     status = FinishCompactionOutputFile(compact, input);
   }
+  if (status.ok() && compact->blob_builder != nullptr) {
+    status = FinishCompactionBlobFile(compact);
+  }
   if (status.ok()) {
     status = input->status();
   }
@@ -1039,9 +1920,12 @@ Status DBImpl::DoCompactionWork(CompactionState* compact) {
   for (size_t i = 0; i < compact->outputs.size(); i++) {
     stats.bytes_written += compact->outputs[i].file_size;
   }
+  stats.bytes_read += compact->blob_bytes_read;
+  stats.bytes_written += compact->blob_output.total_bytes;
 
   mutex_.Lock();
   stats_[compact->compaction->level() + 1].Add(stats);
+  write_controller_.RecordCompaction(stats.bytes_written, stats.micros);
 
   if (status.ok()) {
     status = InstallCompactionResults(compact);
@@ -1060,17 +1944,19 @@ struct IterState {
   port::Mutex* const mu;
   Version* const version GUARDED_BY(mu);
   MemTable* const mem GUARDED_BY(mu);
-  MemTable* const imm GUARDED_BY(mu);
+  std::vector<MemTable*> imms GUARDED_BY(mu);
 
-  IterState(port::Mutex* mutex, MemTable* mem, MemTable* imm, Version* version)
-      : mu(mutex), version(version), mem(mem), imm(imm) {}
+  IterState(port::Mutex* mutex, MemTable* mem, Version* version)
+      : mu(mutex), version(version), mem(mem) {}
 };
 
 static void CleanupIteratorState(void* arg1, void* arg2) {
   IterState* state = reinterpret_cast<IterState*>(arg1);
   state->mu->Lock();
   state->mem->Unref();
-  if (state->imm != nullptr) state->imm->Unref();
+  for (MemTable* imm : state->imms) {
+    imm->Unref();
+  }
   state->version->Unref();
   state->mu->Unlock();
   delete state;
@@ -1080,35 +1966,76 @@ static void CleanupIteratorState(void* arg1, void* arg2) {
 
 Iterator* DBImpl::NewInternalIterator(const ReadOptions& options,
                                       SequenceNumber* latest_snapshot,
-                                      uint32_t* seed) {
+                                      uint32_t* seed,
+                                      RangeDelAggregator** range_del) {
   mutex_.Lock();
   *latest_snapshot = versions_->LastSequence();
 
   // Collect together all needed child iterators
+  IterState* cleanup = new IterState(&mutex_, mem_, versions_->current());
   std::vector<Iterator*> list;
   list.push_back(mem_->NewIterator());
   mem_->Ref();
-  if (imm_ != nullptr) {
-    list.push_back(imm_->NewIterator());
-    imm_->Ref();
+  for (const ImmutableMemTable& imm : imm_) {
+    list.push_back(imm.mem->NewIterator());
+    imm.mem->Ref();
+    cleanup->imms.push_back(imm.mem);
   }
-  versions_->current()->AddIterators(options, &list);
+  Version* current = versions_->current();
+  current->AddIterators(options, &list);
   Iterator* internal_iter =
       NewMergingIterator(&internal_comparator_, &list[0], list.size());
-  versions_->current()->Ref();
-
-  IterState* cleanup = new IterState(&mutex_, mem_, imm_, versions_->current());
+  current->Ref();
   internal_iter->RegisterCleanup(CleanupIteratorState, cleanup, nullptr);
 
+  RangeDelAggregator* tombstones = nullptr;
+  if (range_del != nullptr) {
+    const SequenceNumber snapshot =
+        (options.snapshot != nullptr
+             ? static_cast<const SnapshotImpl*>(options.snapshot)
+                   ->sequence_number()
+             : *latest_snapshot);
+    tombstones = new RangeDelAggregator(user_comparator(), snapshot);
+    tombstones->AddTombstones(mem_->NewRangeTombstoneIterator());
+    for (const ImmutableMemTable& imm : imm_) {
+      tombstones->AddTombstones(imm.mem->NewRangeTombstoneIterator());
+    }
+  }
+
   *seed = ++seed_;
   mutex_.Unlock();
+
+  if (tombstones != nullptr) {
+    *range_del = nullptr;
+    // The iterator holds a reference to "current".  Reading the
+    // tombstones of its tables may open them, so it is done unlocked.
+    Status s = current->AddRangeTombstones(tombstones);
+    if (s.ok()) {
+      s = tombstones->status();
+    }
+    if (!s.ok()) {
+      delete tombstones;
+      delete internal_iter;
+      return NewErrorIterator(s);
+    }
+    if (tombstones->empty()) {
+      delete tombstones;
+    } else {
+      *range_del = tombstones;
+    }
+  }
   return internal_iter;
 }
 
 Iterator* DBImpl::TEST_NewInternalIterator() {
   SequenceNumber ignored;
   uint32_t ignored_seed;
-  return NewInternalIterator(ReadOptions(), &ignored, &ignored_seed);
+  return NewInternalIterator(ReadOptions(), &ignored, &ignored_seed, nullptr);
+}
+
+void DBImpl::TEST_SetCompactionPressure(double pressure) {
+  MutexLock l(&mutex_);
+  forced_compaction_pressure_ = pressure;
 }
 
 int64_t DBImpl::TEST_MaxNextLevelOverlappingBytes() {
@@ -1118,6 +2045,28 @@ int64_t DBImpl::TEST_MaxNextLevelOverlappingBytes() {
 
 Status DBImpl::Get(const ReadOptions& options, const Slice& key,
                    std::string* value) {
+  PinnableSlice pinned(value);
+  Status s = GetImpl(options, key, &pinned, /*pin_memtables=*/false);
+  if (s.ok() && pinned.IsPinned()) {
+    value->assign(pinned.data(), pinned.size());
+  }
+  return s;
+}
+
+Status DBImpl::Get(const ReadOptions& options, const Slice& key,
+                   PinnableSlice* value) {
+  // Releasing a pinned memtable takes mutex_.
+  value->Reset();
+  return GetImpl(options, key, value, /*pin_memtables=*/true);
+}
+
+void DBImpl::UnpinMemTable(void* db, void* mem) {
+  MutexLock l(&reinterpret_cast<DBImpl*>(db)->mutex_);
+  reinterpret_cast<MemTable*>(mem)->Unref();
+}
+
+Status DBImpl::GetImpl(const ReadOptions& options, const Slice& key,
+                       PinnableSlice* value, bool pin_memtables) {
   Status s;
   MutexLock l(&mutex_);
   SequenceNumber snapshot;
@@ -1129,27 +2078,52 @@ Status DBImpl::Get(const ReadOptions& options, const Slice& key,
   }
 
   MemTable* mem = mem_;
-  MemTable* imm = imm_;
+  std::vector<MemTable*> imms;  // Newest first
   Version* current = versions_->current();
   mem->Ref();
-  if (imm != nullptr) imm->Ref();
+  for (auto iter = imm_.rbegin(); iter != imm_.rend(); ++iter) {
+    iter->mem->Ref();
+    imms.push_back(iter->mem);
+  }
   current->Ref();
 
   bool have_stat_update = false;
   Version::GetStats stats;
+  MemTable* pinned_mem = nullptr;
+  Slice mem_value;
 
   // Unlock while reading from files and memtables
   {
     mutex_.Unlock();
-    // First look in the memtable, then in the immutable memtable (if any).
+    // First look in the memtable, then in the immutable memtables from
+    // newest to oldest.
     LookupKey lkey(key, snapshot);
-    if (mem->Get(lkey, value, &s)) {
-      // Done
-    } else if (imm != nullptr && imm->Get(lkey, value, &s)) {
-      // Done
+    MemTable* found_in = mem->Get(lkey, &mem_value, &s) ? mem : nullptr;
+    for (size_t i = 0; found_in == nullptr && i < imms.size(); i++) {
+      if (imms[i]->Get(lkey, &mem_value, &s)) {
+        found_in = imms[i];
+      }
+    }
+    if (found_in != nullptr) {
+      if (!s.ok()) {
+        // Deleted
+      } else if (pin_memtables) {
+        pinned_mem = found_in;
+      } else {
+        value->PinSelf(mem_value);
+      }
     } else {
-      s = current->Get(options, lkey, value, &stats);
+      bool is_blob_index;
+      s = current->Get(options, lkey, value, &is_blob_index, &stats);
       have_stat_update = true;
+      if (s.ok() && is_blob_index) {
+        const std::string blob_index = value->ToString();
+        value->Reset();
+        s = ReadBlob(options, blob_index, value->GetSelf());
+        if (s.ok()) {
+          value->PinSelf();
+        }
+      }
     }
     mutex_.Lock();
   }
@@ -1157,8 +2131,15 @@ Status DBImpl::Get(const ReadOptions& options, const Slice& key,
   if (have_stat_update && current->UpdateStats(stats)) {
     MaybeScheduleCompaction();
   }
+  if (pinned_mem != nullptr) {
+    // Keep the memtable until the value is released.
+    pinned_mem->Ref();
+    value->PinSlice(mem_value, &UnpinMemTable, this, pinned_mem);
+  }
   mem->Unref();
-  if (imm != nullptr) imm->Unref();
+  for (MemTable* imm : imms) {
+    imm->Unref();
+  }
   current->Unref();
   return s;
 }
@@ -1166,13 +2147,17 @@ Status DBImpl::Get(const ReadOptions& options, const Slice& key,
 Iterator* DBImpl::NewIterator(const ReadOptions& options) {
   SequenceNumber latest_snapshot;
   uint32_t seed;
-  Iterator* iter = NewInternalIterator(options, &latest_snapshot, &seed);
-  return NewDBIterator(this, user_comparator(), iter,
+  RangeDelAggregator* range_del;
+  Iterator* iter =
+      NewInternalIterator(options, &latest_snapshot, &seed, &range_del);
+  return NewDBIterator(this, options, user_comparator(), iter,
                        (options.snapshot != nullptr
                             ? static_cast<const SnapshotImpl*>(options.snapshot)
                                   ->sequence_number()
                             : latest_snapshot),
-                       seed);
+                       seed, range_del,
+                       options.prefix_same_as_start ? options_.prefix_extractor
+                                                    : nullptr);
 }
 
 void DBImpl::RecordReadSample(Slice key) {
@@ -1182,6 +2167,15 @@ void DBImpl::RecordReadSample(Slice key) {
   }
 }
 
+Status DBImpl::ReadBlob(const ReadOptions& options, const Slice& blob_index,
+                        std::string* value) {
+  BlobIndex index;
+  if (!index.DecodeFrom(blob_index)) {
+    return Status::Corruption("corrupted blob index");
+  }
+  return blob_cache_->Get(options, index, value);
+}
+
 const Snapshot* DBImpl::GetSnapshot() {
   MutexLock l(&mutex_);
   return snapshots_.New(versions_->LastSequence());
@@ -1201,6 +2195,37 @@ Status DBImpl::Delete(const WriteOptions& options, const Slice& key) {
   return DB::Delete(options, key);
 }
 
+Status DBImpl::DeleteRange(const WriteOptions& options, const Slice& begin_key,
+                           const Slice& end_key) {
+  if (user_comparator()->Compare(begin_key, end_key) >= 0) {
+    return Status::OK();
+  }
+
+  // Every file that lies inside the range now holds only entries older
+  // than the tombstone written below, so once no snapshot can see them
+  // they can be dropped instead of being compacted away.
+  CoveredFiles covered;
+  {
+    MutexLock l(&mutex_);
+    std::vector<std::pair<int, uint64_t>> files;
+    versions_->current()->GetCoveredFiles(begin_key, end_key, &files);
+    for (const auto& level_and_number : files) {
+      covered.numbers.push_back(level_and_number.second);
+    }
+  }
+
+  Status s = DB::DeleteRange(options, begin_key, end_key);
+  if (s.ok() && !covered.numbers.empty()) {
+    MutexLock l(&mutex_);
+    covered.begin = begin_key.ToString();
+    covered.end = end_key.ToString();
+    covered.sequence = versions_->LastSequence();
+    pending_covered_files_.push_back(std::move(covered));
+    MaybeScheduleCompaction();
+  }
+  return s;
+}
+
 Status DBImpl::Write(const WriteOptions& options, WriteBatch* updates) {
   Writer w(&mutex_);
   w.batch = updates;
@@ -1216,15 +2241,42 @@ Status DBImpl::Write(const WriteOptions& options, WriteBatch* updates) {
     return w.status;
   }
 
-  // May temporarily unlock and wait.
-  Status status = MakeRoomForWrite(updates == nullptr);
-  uint64_t last_sequence = versions_->LastSequence();
+  // The whole group is paced, not just this writer's batch.  Writers that
+  // queue up while this one waits are left to the next group.
   Writer* last_writer = &w;
+  const size_t group_bytes =
+      updates == nullptr ? 0 : ChooseBatchGroup(&last_writer);
+
+  // May temporarily unlock and wait.
+  Status status = MakeRoomForWrite(updates == nullptr, group_bytes);
+  if (!status.ok()) {
+    last_writer = &w;
+  }
+  // Groups whose log syncs are in flight have claimed the sequence numbers
+  // following LastSequence().
+  uint64_t last_sequence = pending_log_syncs_.empty()
+                               ? versions_->LastSequence()
+                               : pending_log_syncs_.back()->last_sequence;
+  LogSync log_sync(this);
+  bool sync_started = false;
   if (status.ok() && updates != nullptr) {  // nullptr batch is for compactions
-    WriteBatch* write_batch = BuildBatchGroup(&last_writer);
+    WriteBatch* write_batch = BuildBatchGroup(last_writer);
     WriteBatchInternal::SetSequence(write_batch, last_sequence + 1);
     last_sequence += WriteBatchInternal::Count(write_batch);
 
+    // While a group's log sync is in flight the next group may be logged.
+    // Such groups are only applied to the memtable once their own sync and
+    // those before them finish.  A sync group that no writer is queued
+    // behind has nothing to overlap with, so it syncs inline.
+    const bool pipelined =
+        !pending_log_syncs_.empty() ||
+        (options.sync && last_writer != writers_.back());
+    if (pipelined && write_batch == tmp_batch_) {
+      // The next group will build its batch in tmp_batch_.
+      log_sync.owned_batch.reset(tmp_batch_);
+      tmp_batch_ = new WriteBatch;
+    }
+
     // Add to log and apply to memtable.  We can release the lock
     // during this phase since &w is currently responsible for logging
     // and protects against concurrent loggers and concurrent writes
@@ -1232,19 +2284,30 @@ Status DBImpl::Write(const WriteOptions& options, WriteBatch* updates) {
     {
       mutex_.Unlock();
       status = log_->AddRecord(WriteBatchInternal::Contents(write_batch));
-      bool sync_error = false;
+      // A grouped log fails in the middle of writing out buffered records,
+      // some of which were already acknowledged.
+      bool log_error = !status.ok() && LogBuffersRecords();
       if (status.ok() && options.sync) {
-        status = logfile_->Sync();
+        // Records still buffered by the log must reach the file first.
+        status = log_->Flush();
         if (!status.ok()) {
-          sync_error = true;
+          log_error = true;
+        } else if (pipelined) {
+          logfile_->SyncAsync(&DBImpl::LogSyncDone, &log_sync);
+          sync_started = true;
+        } else {
+          status = logfile_->Sync();
+          if (!status.ok()) {
+            log_error = true;
+          }
         }
       }
-      if (status.ok()) {
+      if (status.ok() && !pipelined) {
         status = WriteBatchInternal::InsertInto(write_batch, mem_);
       }
       mutex_.Lock();
-      if (sync_error) {
-        // The state of the log file is indeterminate: the log record we
+      if (log_error) {
+        // The state of the log file is indeterminate: the log records we
         // just added may or may not show up when the DB is re-opened.
         // So we force the DB into a mode where all future writes fail.
         RecordBackgroundError(status);
@@ -1252,6 +2315,14 @@ Status DBImpl::Write(const WriteOptions& options, WriteBatch* updates) {
     }
     if (write_batch == tmp_batch_) tmp_batch_->Clear();
 
+    if (pipelined) {
+      log_sync.batch = write_batch;
+      log_sync.last_sequence = last_sequence;
+      if (!sync_started) {
+        log_sync.synced = true;
+      }
+      return FinishLogSync(&log_sync, &w, last_writer, status);
+    }
     versions_->SetLastSequence(last_sequence);
   }
 
@@ -1274,14 +2345,87 @@ Status DBImpl::Write(const WriteOptions& options, WriteBatch* updates) {
   return status;
 }
 
+Status DBImpl::FinishLogSync(LogSync* log_sync, Writer* self,
+                             Writer* last_writer, Status status) {
+  mutex_.AssertHeld();
+  pending_log_syncs_.push_back(log_sync);
+
+  // Let the next group be logged while this one's sync is in flight.
+  std::vector<Writer*> group;
+  while (true) {
+    Writer* ready = writers_.front();
+    writers_.pop_front();
+    group.push_back(ready);
+    if (ready == last_writer) break;
+  }
+  if (!writers_.empty()) {
+    writers_.front()->cv.Signal();
+  }
+
+  while (!log_sync->synced || pending_log_syncs_.front() != log_sync) {
+    log_sync->cv.Wait();
+  }
+  if (!log_sync->status.ok()) {
+    // The state of the log file is indeterminate: the log record we
+    // just added may or may not show up when the DB is re-opened, and
+    // neither may any record logged after it.  So we fail the groups
+    // still waiting and force the DB into a mode where all future
+    // writes fail.
+    for (LogSync* later : pending_log_syncs_) {
+      if (later->status.ok()) {
+        later->status = log_sync->status;
+      }
+    }
+    RecordBackgroundError(log_sync->status);
+    if (status.ok()) {
+      status = log_sync->status;
+    }
+  }
+  if (status.ok()) {
+    // Groups are applied one at a time, in log order, by the group at the
+    // front of pending_log_syncs_.  The memtable cannot be switched until
+    // the queue drains.
+    mutex_.Unlock();
+    status = WriteBatchInternal::InsertInto(log_sync->batch, mem_);
+    mutex_.Lock();
+  }
+  pending_log_syncs_.pop_front();
+  // Later groups already use the sequence numbers that follow this one,
+  // so the last sequence advances even if the group was not applied.
+  versions_->SetLastSequence(log_sync->last_sequence);
+  if (!pending_log_syncs_.empty()) {
+    pending_log_syncs_.front()->cv.Signal();
+  } else {
+    log_syncs_drained_signal_.SignalAll();
+  }
+
+  for (Writer* ready : group) {
+    if (ready != self) {
+      ready->status = status;
+      ready->done = true;
+      ready->cv.Signal();
+    }
+  }
+  return status;
+}
+
+void DBImpl::LogSyncDone(void* arg, const Status& status) {
+  LogSync* log_sync = reinterpret_cast<LogSync*>(arg);
+  MutexLock l(&log_sync->db->mutex_);
+  if (log_sync->status.ok()) {
+    log_sync->status = status;
+  }
+  log_sync->synced = true;
+  log_sync->cv.Signal();
+}
+
 // REQUIRES: Writer list must be non-empty
 // REQUIRES: First writer must have a non-null batch
-WriteBatch* DBImpl::BuildBatchGroup(Writer** last_writer) {
+size_t DBImpl::ChooseBatchGroup(Writer** last_writer) {
   mutex_.AssertHeld();
   assert(!writers_.empty());
   Writer* first = writers_.front();
-  WriteBatch* result = first->batch;
-  assert(result != nullptr);
+  assert(first->batch != nullptr);
 
   size_t size = WriteBatchInternal::ByteSize(first->batch);
 
@@ -1304,69 +2448,134 @@ WriteBatch* DBImpl::BuildBatchGroup(Writer** last_writer) {
     }
 
     if (w->batch != nullptr) {
-      size += WriteBatchInternal::ByteSize(w->batch);
-      if (size > max_size) {
+      const size_t batch_size = WriteBatchInternal::ByteSize(w->batch);
+      if (size + batch_size > max_size) {
         // Do not make batch too big
         break;
       }
+      size += batch_size;
+    }
+    *last_writer = w;
+  }
+  return size;
+}
 
-      // Append to *result
-      if (result == first->batch) {
-        // Switch to temporary batch instead of disturbing caller's batch
-        result = tmp_batch_;
-        assert(WriteBatchInternal::Count(result) == 0);
-        WriteBatchInternal::Append(result, first->batch);
-      }
+// REQUIRES: last_writer was chosen by ChooseBatchGroup()
+WriteBatch* DBImpl::BuildBatchGroup(Writer* last_writer) {
+  mutex_.AssertHeld();
+  Writer* first = writers_.front();
+  WriteBatch* result = first->batch;
+  if (first == last_writer) {
+    return result;
+  }
+
+  // Switch to temporary batch instead of disturbing caller's batch
+  result = tmp_batch_;
+  assert(WriteBatchInternal::Count(result) == 0);
+  for (Writer* w : writers_) {
+    if (w->batch != nullptr) {
       WriteBatchInternal::Append(result, w->batch);
     }
-    *last_writer = w;
+    if (w == last_writer) break;
   }
   return result;
 }
 
 // REQUIRES: mutex_ is held
 // REQUIRES: this thread is currently at the front of the writer queue
-Status DBImpl::MakeRoomForWrite(bool force) {
+double DBImpl::CompactionPressure() {
+  mutex_.AssertHeld();
+  if (forced_compaction_pressure_ >= 0) {
+    return forced_compaction_pressure_;
+  }
+  double pressure = 0;
+  const int l0_files = versions_->NumLevelFiles(0);
+  if (l0_files >= config::kL0_SlowdownWritesTrigger) {
+    // Grows linearly until the file that stops writes.
+    pressure =
+        static_cast<double>(l0_files - config::kL0_SlowdownWritesTrigger + 1) /
+        (config::kL0_StopWritesTrigger - config::kL0_SlowdownWritesTrigger +
+         1);
+  }
+  const int64_t pending = versions_->EstimatedPendingCompactionBytes();
+  if (pending > config::kPendingCompactionBytesSlowdown) {
+    // Halves the write rate each time the backlog doubles.
+    pressure = std::max(
+        pressure,
+        1.0 - static_cast<double>(config::kPendingCompactionBytesSlowdown) /
+                  pending);
+  }
+  return pressure;
+}
+
+void DBImpl::WaitForCompaction(bool* stopped) {
+  mutex_.AssertHeld();
+  if (!*stopped) {
+    *stopped = true;
+    num_stopped_writes_++;
+  }
+  const uint64_t start_micros = env_->NowMicros();
+  background_work_finished_signal_.Wait();
+  write_stall_micros_ += env_->NowMicros() - start_micros;
+}
+
+Status DBImpl::MakeRoomForWrite(bool force, size_t write_bytes) {
   mutex_.AssertHeld();
   assert(!writers_.empty());
   bool allow_delay = !force;
+  bool stopped = false;
   Status s;
   while (true) {
     if (!bg_error_.ok()) {
       // Yield previous error
       s = bg_error_;
       break;
-    } else if (allow_delay && versions_->NumLevelFiles(0) >=
-                                  config::kL0_SlowdownWritesTrigger) {
-      // We are getting close to hitting a hard limit on the number of
-      // L0 files.  Rather than delaying a single write by several
-      // seconds when we hit the hard limit, start delaying each
-      // individual write by 1ms to reduce latency variance.  Also,
-      // this delay hands over some CPU to the compaction thread in
-      // case it is sharing the same core as the writer.
-      mutex_.Unlock();
-      env_->SleepForMicroseconds(1000);
+    } else if (allow_delay) {
+      // Rather than letting writes run at full speed until they hit a
+      // hard limit and stall for several seconds, slow them down to a
+      // rate compactions can keep up with as soon as they fall behind.
+      // This also hands over some CPU to the compaction thread in case
+      // it is sharing the same core as the writer.
       allow_delay = false;  // Do not delay a single write more than once
-      mutex_.Lock();
+      const uint64_t delay = write_controller_.GetDelay(
+          env_->NowMicros(), write_bytes, CompactionPressure());
+      if (delay > 0) {
+        num_delayed_writes_++;
+        write_stall_micros_ += delay;
+        mutex_.Unlock();
+        env_->SleepForMicroseconds(delay);
+        mutex_.Lock();
+      }
     } else if (!force &&
                (mem_->ApproximateMemoryUsage() <= options_.write_buffer_size)) {
       // There is room in current memtable
       break;
-    } else if (imm_ != nullptr) {
+    } else if (imm_.size() + 1 >=
+               static_cast<size_t>(options_.max_write_buffer_number)) {
       // We have filled up the current memtable, but the previous
-      // one is still being compacted, so we wait.
+      // ones are still being compacted, so we wait.
       Log(options_.info_log, "Current memtable full; waiting...\n");
-      background_work_finished_signal_.Wait();
+      WaitForCompaction(&stopped);
     } else if (versions_->NumLevelFiles(0) >= config::kL0_StopWritesTrigger) {
       // There are too many level-0 files.
       Log(options_.info_log, "Too many L0 files; waiting...\n");
-      background_work_finished_signal_.Wait();
+      WaitForCompaction(&stopped);
+    } else if (!pending_log_syncs_.empty()) {
+      // The log file must stay open until the syncs in flight finish, and
+      // the groups waiting for them must be applied to this memtable.
+      log_syncs_drained_signal_.Wait();
     } else {
       // Attempt to switch to a new memtable and trigger compaction of old
       assert(versions_->PrevLogNumber() == 0);
+      s = log_->Flush();
+      if (!s.ok()) {
+        // Buffered records that were already acknowledged may be lost.
+        RecordBackgroundError(s);
+        break;
+      }
       uint64_t new_log_number = versions_->NewFileNumber();
       WritableFile* lfile = nullptr;
-      s = env_->NewWritableFile(LogFileName(dbname_, new_log_number), &lfile);
+      s = NewLogFile(new_log_number, &lfile);
       if (!s.ok()) {
         // Avoid chewing through file number space in a tight loop.
         versions_->ReuseFileNumber(new_log_number);
@@ -1374,12 +2583,12 @@ Status DBImpl::MakeRoomForWrite(bool force) {
       }
       delete log_;
       delete logfile_;
+      imm_.push_back(ImmutableMemTable{mem_, logfile_number_});
+      has_imm_.store(true, std::memory_order_release);
       logfile_ = lfile;
       logfile_number_ = new_log_number;
-      log_ = new log::Writer(lfile);
-      imm_ = mem_;
-      has_imm_.store(true, std::memory_order_release);
-      mem_ = new MemTable(internal_comparator_);
+      log_ = NewLogWriter(lfile, 0, new_log_number);
+      mem_ = NewMemTable();
       mem_->Ref();
       force = false;  // Do not force another compaction if have room
       MaybeScheduleCompaction();
@@ -1432,13 +2641,35 @@ bool DBImpl::GetProperty(const Slice& property, std::string* value) {
   } else if (in == "sstables") {
     *value = versions_->current()->DebugString();
     return true;
+  } else if (in == "num-immutable-mem-table") {
+    *value = std::to_string(imm_.size());
+    return true;
+  } else if (in == "num-delayed-writes") {
+    *value = std::to_string(num_delayed_writes_);
+    return true;
+  } else if (in == "num-stopped-writes") {
+    *value = std::to_string(num_stopped_writes_);
+    return true;
+  } else if (in == "write-stall-micros") {
+    *value = std::to_string(write_stall_micros_);
+    return true;
+  } else if (in == "recovery-micros") {
+    *value = std::to_string(recovery_micros_);
+    return true;
+  } else if (in == "delayed-write-rate") {
+    *value = std::to_string(
+        static_cast<uint64_t>(write_controller_.delayed_write_rate()));
+    return true;
+  } else if (in == "estimate-pending-compaction-bytes") {
+    *value = std::to_string(versions_->EstimatedPendingCompactionBytes());
+    return true;
   } else if (in == "approximate-memory-usage") {
     size_t total_usage = options_.block_cache->TotalCharge();
     if (mem_) {
       total_usage += mem_->ApproximateMemoryUsage();
     }
-    if (imm_) {
-      total_usage += imm_->ApproximateMemoryUsage();
+    for (const ImmutableMemTable& imm : imm_) {
+      total_usage += imm.mem->ApproximateMemoryUsage();
     }
     char buf[50];
     std::snprintf(buf, sizeof(buf), "%llu",
@@ -1482,12 +2713,30 @@ Status DB::Delete(const WriteOptions& opt, const Slice& key) {
   return Write(opt, &batch);
 }
 
+Status DB::DeleteRange(const WriteOptions& opt, const Slice& begin_key,
+                       const Slice& end_key) {
+  WriteBatch batch;
+  batch.DeleteRange(begin_key, end_key);
+  return Write(opt, &batch);
+}
+
+Status DB::Get(const ReadOptions& options, const Slice& key,
+               PinnableSlice* value) {
+  value->Reset();
+  Status s = Get(options, key, value->GetSelf());
+  if (s.ok()) {
+    value->PinSelf();
+  }
+  return s;
+}
+
 DB::~DB() = default;
 
 Status DB::Open(const Options& options, const std::string& dbname, DB** dbptr) {
   *dbptr = nullptr;
 
   DBImpl* impl = new DBImpl(options, dbname);
+  const uint64_t start_micros = impl->env_->NowMicros();
   impl->mutex_.Lock();
   VersionEdit edit;
   // Recover handles create_if_missing, error_if_exists
@@ -1497,14 +2746,15 @@ Status DB::Open(const Options& options, const std::string& dbname, DB** dbptr) {
     // Create new log and a corresponding memtable.
     uint64_t new_log_number = impl->versions_->NewFileNumber();
     WritableFile* lfile;
-    s = options.env->NewWritableFile(LogFileName(dbname, new_log_number),
-                                     &lfile);
+    s = impl->NewLogFile(new_log_number, &lfile);
     if (s.ok()) {
       edit.SetLogNumber(new_log_number);
       impl->logfile_ = lfile;
       impl->logfile_number_ = new_log_number;
-      impl->log_ = new log::Writer(lfile);
-      impl->mem_ = new MemTable(impl->internal_comparator_);
+      impl->log_ = impl->NewLogWriter(lfile, 0, new_log_number);
+      // Logs written from now on can be recycled.
+      impl->log_recycle_floor_ = new_log_number - 1;
+      impl->mem_ = impl->NewMemTable();
       impl->mem_->Ref();
     }
   }
@@ -1515,6 +2765,14 @@ Status DB::Open(const Options& options, const std::string& dbname, DB** dbptr) {
   }
   if (s.ok()) {
     impl->RemoveObsoleteFiles();
+    impl->recovery_micros_ = impl->env_->NowMicros() - start_micros;
+    Log(impl->options_.info_log, "Recovered in %llu micros",
+        static_cast<unsigned long long>(impl->recovery_micros_));
+    if (impl->options_.open_files_on_startup) {
+      s = impl->OpenTableFiles();
+    }
+  }
+  if (s.ok()) {
     impl->MaybeScheduleCompaction();
   }
   impl->mutex_.Unlock();
@@ -9,10 +9,13 @@
 #include <deque>
 #include <set>
 #include <string>
+#include <vector>
 
 #include "db/dbformat.h"
 #include "db/log_writer.h"
+#include "db/range_del_aggregator.h"
 #include "db/snapshot.h"
+#include "db/write_controller.h"
 #include "leveldb/db.h"
 #include "leveldb/env.h"
 #include "port/port.h"
@@ -20,7 +23,10 @@
 
 namespace leveldb {
 
+class ArenaRegionPool;
+class BlobFileCache;
 class MemTable;
+struct FileMetaData;
 class TableCache;
 class Version;
 class VersionEdit;
@@ -39,9 +45,13 @@ class DBImpl : public DB {
   Status Put(const WriteOptions&, const Slice& key,
              const Slice& value) override;
   Status Delete(const WriteOptions&, const Slice& key) override;
+  Status DeleteRange(const WriteOptions&, const Slice& begin_key,
+                     const Slice& end_key) override;
   Status Write(const WriteOptions& options, WriteBatch* updates) override;
   Status Get(const ReadOptions& options, const Slice& key,
              std::string* value) override;
+  Status Get(const ReadOptions& options, const Slice& key,
+             PinnableSlice* value) override;
   Iterator* NewIterator(const ReadOptions&) override;
   const Snapshot* GetSnapshot() override;
   void ReleaseSnapshot(const Snapshot* snapshot) override;
@@ -66,15 +76,28 @@ class DBImpl : public DB {
   // file at a level >= 1.
   int64_t TEST_MaxNextLevelOverlappingBytes();
 
+  // Pace writes as if compactions were behind by "pressure" (see
+  // CompactionPressure()).  A negative value restores the actual pressure.
+  void TEST_SetCompactionPressure(double pressure);
+
   // Record a sample of bytes read at the specified internal key.
   // Samples are taken approximately once every config::kReadBytesPeriod
   // bytes.
   void RecordReadSample(Slice key);
 
+  // Store in *value the value that was moved to a blob file, given the
+  // encoded BlobIndex "blob_index" of a kTypeBlobIndex entry.
+  Status ReadBlob(const ReadOptions& options, const Slice& blob_index,
+                  std::string* value);
+
  private:
   friend class DB;
   struct CompactionState;
   struct Writer;
+  struct LogSync;
+  class LogPrefetcher;
+  struct RecoveryFlush;
+  struct TableFileOpener;
 
   // Information for a manual compaction
   struct ManualCompaction {
@@ -101,12 +124,61 @@ class DBImpl : public DB {
     int64_t bytes_written;
   };
 
+  // A full memtable waiting to be compacted.
+  struct ImmutableMemTable {
+    MemTable* mem;
+    uint64_t log_number;  // Log file holding the memtable's updates
+  };
+
+  // Files that lie entirely inside the span of a DeleteRange() call.
+  struct CoveredFiles {
+    std::string begin;
+    std::string end;
+    std::vector<uint64_t> numbers;
+    SequenceNumber sequence;  // At or after the covering tombstone
+  };
+
+  // If "range_del" is non-null, also collects the range tombstones visible
+  // to "options" into a new *range_del, or sets it to nullptr if there
+  // are none.
   Iterator* NewInternalIterator(const ReadOptions&,
                                 SequenceNumber* latest_snapshot,
-                                uint32_t* seed);
+                                uint32_t* seed, RangeDelAggregator** range_del);
+
+  // Implements Get().  A value found in a memtable is pinned there if
+  // "pin_memtables" is set, and copied into the buffer of *value
+  // otherwise.
+  Status GetImpl(const ReadOptions& options, const Slice& key,
+                 PinnableSlice* value, bool pin_memtables);
+  // Releases a memtable value pinned by GetImpl().
+  static void UnpinMemTable(void* db, void* mem);
 
   Status NewDB();
 
+  // Returns a memtable configured by options_, with no references.
+  MemTable* NewMemTable() const;
+
+  // Create the file for log "number", overwriting a recycled log file if
+  // one is available.
+  Status NewLogFile(uint64_t number, WritableFile** result)
+      EXCLUSIVE_LOCKS_REQUIRED(mutex_);
+
+  // Returns a log writer configured by options_ that appends to "file",
+  // the file of log "log_number", which currently holds "file_length"
+  // bytes.  Logs that start out empty are written in the recyclable format
+  // if options_.recycle_log_file_num is set.
+  log::Writer* NewLogWriter(WritableFile* file, uint64_t file_length,
+                            uint64_t log_number) const;
+
+  // Returns true if the log writers made by NewLogWriter() buffer records
+  // until they are flushed, so that a failed write may lose records added
+  // earlier.
+  bool LogBuffersRecords() const;
+
+  // Called for an obsolete log file.  Returns true if the file is, or now
+  // is, held for reuse by a later log.
+  bool RecycleLogFile(uint64_t number) EXCLUSIVE_LOCKS_REQUIRED(mutex_);
+
   // Recover the descriptor from persistent storage.  May do a significant
   // amount of work to recover recently logged updates.  Any changes to
   // be made to the descriptor are added to *edit.
@@ -123,17 +195,53 @@ class DBImpl : public DB {
   // Errors are recorded in bg_error_.
   void CompactMemTable() EXCLUSIVE_LOCKS_REQUIRED(mutex_);
 
-  Status RecoverLogFile(uint64_t log_number, bool last_log, bool* save_manifest,
+  Status RecoverLogFile(LogPrefetcher* log, bool last_log, bool* save_manifest,
                         VersionEdit* edit, SequenceNumber* max_sequence)
       EXCLUSIVE_LOCKS_REQUIRED(mutex_);
+  // Write the memtable of "flush" to level-0 on a separate thread.
+  void StartRecoveryFlush(RecoveryFlush* flush)
+      EXCLUSIVE_LOCKS_REQUIRED(mutex_);
+  static void RecoveryFlushWork(void* arg);
+  // Wait for the flush started by StartRecoveryFlush(), if any.
+  Status WaitForRecoveryFlush(RecoveryFlush* flush)
+      EXCLUSIVE_LOCKS_REQUIRED(mutex_);
+
+  // Open the table files of the current version ahead of the first reads,
+  // on options_.max_file_opening_threads threads.  Errors are only
+  // returned if options_.paranoid_checks is set.
+  Status OpenTableFiles() EXCLUSIVE_LOCKS_REQUIRED(mutex_);
+  static void OpenTableFilesWork(void* arg);
 
   Status WriteLevel0Table(MemTable* mem, VersionEdit* edit, Version* base)
       EXCLUSIVE_LOCKS_REQUIRED(mutex_);
 
-  Status MakeRoomForWrite(bool force /* compact even if there is room? */)
+  // "write_bytes" is the size of the write being made room for, which is
+  // delayed while compactions are behind.
+  Status MakeRoomForWrite(bool force /* compact even if there is room? */,
+                          size_t write_bytes) EXCLUSIVE_LOCKS_REQUIRED(mutex_);
+  // Returns how far compactions have fallen behind, from 0 (writes need
+  // not be slowed down) towards 1 (writes are about to be stopped).
+  double CompactionPressure() EXCLUSIVE_LOCKS_REQUIRED(mutex_);
+  // Wait for background work to make room for a stopped write.  The
+  // write is counted as stopped unless *stopped was already set, which
+  // it is on return.
+  void WaitForCompaction(bool* stopped) EXCLUSIVE_LOCKS_REQUIRED(mutex_);
+  // Choose the writers whose batches the writer at the front of the queue
+  // logs along with its own: *last_writer is set to the last of them.
+  // Returns the size of their batches.
+  size_t ChooseBatchGroup(Writer** last_writer)
       EXCLUSIVE_LOCKS_REQUIRED(mutex_);
-  WriteBatch* BuildBatchGroup(Writer** last_writer)
+  // Returns the batches of the writers from the front of the queue
+  // through "last_writer", combined.
+  WriteBatch* BuildBatchGroup(Writer* last_writer)
       EXCLUSIVE_LOCKS_REQUIRED(mutex_);
+  // Hand the writer queue over to the next batch group, then wait for the
+  // log sync of the group ending at last_writer and for every group logged
+  // before it, and apply the group to the memtable.  Returns the status of
+  // the group.
+  Status FinishLogSync(LogSync* log_sync, Writer* self, Writer* last_writer,
+                       Status status) EXCLUSIVE_LOCKS_REQUIRED(mutex_);
+  static void LogSyncDone(void* arg, const Status& status);
 
   void RecordBackgroundError(const Status& s);
 
@@ -146,8 +254,26 @@ class DBImpl : public DB {
   Status DoCompactionWork(CompactionState* compact)
       EXCLUSIVE_LOCKS_REQUIRED(mutex_);
 
+  // Remove the files queued by DeleteRange() that no snapshot can still
+  // observe.
+  void RemoveCoveredFiles() EXCLUSIVE_LOCKS_REQUIRED(mutex_);
+
   Status OpenCompactionOutputFile(CompactionState* compact);
+  // Store in *result the range tombstones that the current compaction
+  // output must carry: the surviving tombstones clipped to the output's
+  // user key range, which ends before the key "input" is positioned at.
+  void CollectOutputRangeTombstones(CompactionState* compact, Iterator* input,
+                                    std::vector<RangeTombstone>* result);
   Status FinishCompactionOutputFile(CompactionState* compact, Iterator* input);
+  // Copy the value that "blob_index" points to into the blob file of the
+  // compaction, and store the BlobIndex of the copy in *moved_index.
+  Status MoveBlobValue(CompactionState* compact, const Slice& blob_index,
+                       std::string* moved_index);
+  Status FinishCompactionBlobFile(CompactionState* compact);
+  // Record in *edit that the values the tables in "files" point to are
+  // garbage.
+  Status AddBlobGarbage(const std::vector<FileMetaData*>& files,
+                        VersionEdit* edit) EXCLUSIVE_LOCKS_REQUIRED(mutex_);
   Status InstallCompactionResults(CompactionState* compact)
       EXCLUSIVE_LOCKS_REQUIRED(mutex_);
 
@@ -167,6 +293,12 @@ class DBImpl : public DB {
   // table_cache_ provides its own synchronization
   TableCache* const table_cache_;
 
+  // blob_cache_ provides its own synchronization
+  BlobFileCache* const blob_cache_;
+
+  // Source of memtable memory if options_.memtable_huge_pages, else nullptr
+  ArenaRegionPool* const memtable_region_pool_;
+
   // Lock over the persistent DB state.  Non-null iff successfully acquired.
   FileLock* db_lock_;
 
@@ -175,17 +307,32 @@ class DBImpl : public DB {
   std::atomic<bool> shutting_down_;
   port::CondVar background_work_finished_signal_ GUARDED_BY(mutex_);
   MemTable* mem_;
-  MemTable* imm_ GUARDED_BY(mutex_);  // Memtable being compacted
-  std::atomic<bool> has_imm_;         // So bg thread can detect non-null imm_
+  // Memtables waiting to be compacted, oldest first.  Holds fewer than
+  // options_.max_write_buffer_number entries.
+  std::deque<ImmutableMemTable> imm_ GUARDED_BY(mutex_);
+  std::atomic<bool> has_imm_;  // So bg thread can detect non-empty imm_
   WritableFile* logfile_;
   uint64_t logfile_number_ GUARDED_BY(mutex_);
   log::Writer* log_;
+
+  // Obsolete log files kept to be overwritten by new logs, oldest first.
+  std::deque<uint64_t> recycled_logs_ GUARDED_BY(mutex_);
+  // Only log files numbered above this may be recycled.  Older ones were
+  // not written by this DB in the recyclable format, or have been
+  // recycled or deleted already.
+  uint64_t log_recycle_floor_ GUARDED_BY(mutex_);
   uint32_t seed_ GUARDED_BY(mutex_);  // For sampling.
 
   // Queue of writers.
   std::deque<Writer*> writers_ GUARDED_BY(mutex_);
   WriteBatch* tmp_batch_ GUARDED_BY(mutex_);
 
+  // Batch groups that have been logged but not yet applied because their
+  // log sync, or that of an earlier group, is in flight.  Oldest first.
+  std::deque<LogSync*> pending_log_syncs_ GUARDED_BY(mutex_);
+  // Signalled when pending_log_syncs_ becomes empty.
+  port::CondVar log_syncs_drained_signal_ GUARDED_BY(mutex_);
+
   SnapshotList snapshots_ GUARDED_BY(mutex_);
 
   // Set of table files to protect from deletion because they are
@@ -197,12 +344,26 @@ class DBImpl : public DB {
 
   ManualCompaction* manual_compaction_ GUARDED_BY(mutex_);
 
+  std::vector<CoveredFiles> pending_covered_files_ GUARDED_BY(mutex_);
+
   VersionSet* const versions_ GUARDED_BY(mutex_);
 
   // Have we encountered a background error in paranoid mode?
   Status bg_error_ GUARDED_BY(mutex_);
 
   CompactionStats stats_[config::kNumLevels] GUARDED_BY(mutex_);
+
+  // Paces writes while compactions are behind.
+  WriteController write_controller_ GUARDED_BY(mutex_);
+  double forced_compaction_pressure_ GUARDED_BY(mutex_);  // For testing
+
+  // Writes that were slowed down or stopped, and the total time spent
+  // waiting by them.
+  uint64_t num_delayed_writes_ GUARDED_BY(mutex_);
+  uint64_t num_stopped_writes_ GUARDED_BY(mutex_);
+  uint64_t write_stall_micros_ GUARDED_BY(mutex_);
+  // Time DB::Open() spent recovering the MANIFEST and logs.
+  uint64_t recovery_micros_ GUARDED_BY(mutex_);
 };
 
 // Sanitize db options.  The caller should delete result.info_log if
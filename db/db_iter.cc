@@ -7,8 +7,10 @@
 #include "db/db_impl.h"
 #include "db/dbformat.h"
 #include "db/filename.h"
+#include "db/range_del_aggregator.h"
 #include "leveldb/env.h"
 #include "leveldb/iterator.h"
+#include "leveldb/slice_transform.h"
 #include "port/port.h"
 #include "util/logging.h"
 #include "util/mutexlock.h"
@@ -45,21 +47,30 @@ class DBIter : public Iterator {
   //     just before all entries whose user key == this->key().
   enum Direction { kForward, kReverse };
 
-  DBIter(DBImpl* db, const Comparator* cmp, Iterator* iter, SequenceNumber s,
-         uint32_t seed)
+  DBIter(DBImpl* db, const ReadOptions& options, const Comparator* cmp,
+         Iterator* iter, SequenceNumber s, uint32_t seed,
+         RangeDelAggregator* range_del, const SliceTransform* prefix_extractor)
       : db_(db),
+        options_(options),
         user_comparator_(cmp),
         iter_(iter),
+        range_del_(range_del),
+        prefix_extractor_(prefix_extractor),
         sequence_(s),
         direction_(kForward),
         valid_(false),
+        has_blob_value_(false),
+        has_prefix_(false),
         rnd_(seed),
         bytes_until_read_sampling_(RandomCompactionPeriod()) {}
 
   DBIter(const DBIter&) = delete;
   DBIter& operator=(const DBIter&) = delete;
 
-  ~DBIter() override { delete iter_; }
+  ~DBIter() override {
+    delete iter_;
+    delete range_del_;
+  }
   bool Valid() const override { return valid_; }
   Slice key() const override {
     assert(valid_);
@@ -67,7 +78,8 @@ class DBIter : public Iterator {
   }
   Slice value() const override {
     assert(valid_);
-    return (direction_ == kForward) ? iter_->value() : saved_value_;
+    return (direction_ == kForward && !has_blob_value_) ? iter_->value()
+                                                        : saved_value_;
   }
   Status status() const override {
     if (status_.ok()) {
@@ -88,6 +100,48 @@ class DBIter : public Iterator {
   void FindPrevUserEntry();
   bool ParseKey(ParsedInternalKey* key);
 
+  // Returns the type of "ikey" as seen by this iterator: values covered by
+  // a newer range tombstone are reported as deletions.
+  ValueType EntryType(const ParsedInternalKey& ikey) {
+    if ((ikey.type == kTypeValue || ikey.type == kTypeBlobIndex) &&
+        range_del_ != nullptr && range_del_->ShouldDelete(ikey)) {
+      return kTypeDeletion;
+    }
+    return ikey.type;
+  }
+
+  // Returns true if the last Seek() restricted the iteration to a prefix
+  // that "user_key" lies outside of.
+  bool OutsidePrefix(const Slice& user_key) const {
+    return has_prefix_ && (!prefix_extractor_->InDomain(user_key) ||
+                           prefix_extractor_->Transform(user_key) != prefix_);
+  }
+
+  // Replace the BlobIndex in saved_value_ with the value it points to.
+  // Returns false, and makes the iterator invalid, on errors.
+  bool ReadSavedBlob() {
+    std::string blob_index;
+    blob_index.swap(saved_value_);
+    Status s = db_->ReadBlob(options_, blob_index, &saved_value_);
+    if (!s.ok()) {
+      status_ = s;
+      valid_ = false;
+      saved_key_.clear();
+      ClearSavedValue();
+      return false;
+    }
+    return true;
+  }
+
+  // Positioning backwards is not supported with a prefix extractor.
+  void RejectReverse() {
+    status_ = Status::NotSupported(
+        "reverse iteration with ReadOptions::prefix_same_as_start");
+    valid_ = false;
+    saved_key_.clear();
+    ClearSavedValue();
+  }
+
   inline void SaveKey(const Slice& k, std::string* dst) {
     dst->assign(k.data(), k.size());
   }
@@ -107,14 +161,24 @@ class DBIter : public Iterator {
   }
 
   DBImpl* db_;
+  const ReadOptions options_;  // For reading values held in blob files
   const Comparator* const user_comparator_;
   Iterator* const iter_;
+  RangeDelAggregator* const range_del_;  // nullptr if no range tombstones
+  // Non-null for ReadOptions::prefix_same_as_start.  If has_prefix_, the
+  // last Seek() restricted the iteration to keys with prefix prefix_.
+  const SliceTransform* const prefix_extractor_;
   SequenceNumber const sequence_;
   Status status_;
   std::string saved_key_;    // == current key when direction_==kReverse
   std::string saved_value_;  // == current raw value when direction_==kReverse
   Direction direction_;
   bool valid_;
+  // When moving forward, the current value was read from a blob file and
+  // is held in saved_value_.
+  bool has_blob_value_;
+  bool has_prefix_;
+  std::string prefix_;
   Random rnd_;
   size_t bytes_until_read_sampling_;
 };
@@ -180,8 +244,12 @@ void DBIter::FindNextUserEntry(bool skipping, std::string* skip) {
   assert(direction_ == kForward);
   do {
     ParsedInternalKey ikey;
-    if (ParseKey(&ikey) && ikey.sequence <= sequence_) {
-      switch (ikey.type) {
+    if (!ParseKey(&ikey)) {
+      // Skip corrupted entries
+    } else if (OutsidePrefix(ikey.user_key)) {
+      break;
+    } else if (ikey.sequence <= sequence_) {
+      switch (EntryType(ikey)) {
         case kTypeDeletion:
           // Arrange to skip all upcoming entries for this key since
           // they are hidden by this deletion.
@@ -189,15 +257,25 @@ void DBIter::FindNextUserEntry(bool skipping, std::string* skip) {
           skipping = true;
           break;
         case kTypeValue:
+        case kTypeBlobIndex:
           if (skipping &&
               user_comparator_->Compare(ikey.user_key, *skip) <= 0) {
             // Entry hidden
           } else {
             valid_ = true;
             saved_key_.clear();
+            has_blob_value_ = (ikey.type == kTypeBlobIndex);
+            if (has_blob_value_) {
+              Slice blob_index = iter_->value();
+              saved_value_.assign(blob_index.data(), blob_index.size());
+              ReadSavedBlob();
+            }
             return;
           }
           break;
+        case kTypeRangeDeletion:
+          // Range tombstones are not part of the point entry stream.
+          break;
       }
     }
     iter_->Next();
@@ -208,6 +286,10 @@ void DBIter::FindNextUserEntry(bool skipping, std::string* skip) {
 
 void DBIter::Prev() {
   assert(valid_);
+  if (prefix_extractor_ != nullptr) {
+    RejectReverse();
+    return;
+  }
 
   if (direction_ == kForward) {  // Switch directions?
     // iter_ is pointing at the current entry.  Scan backwards until
@@ -246,7 +328,7 @@ void DBIter::FindPrevUserEntry() {
           // We encountered a non-deleted value in entries for previous keys,
           break;
         }
-        value_type = ikey.type;
+        value_type = EntryType(ikey);
         if (value_type == kTypeDeletion) {
           saved_key_.clear();
           ClearSavedValue();
@@ -272,12 +354,21 @@ void DBIter::FindPrevUserEntry() {
     direction_ = kForward;
   } else {
     valid_ = true;
+    if (value_type == kTypeBlobIndex) {
+      ReadSavedBlob();
+    }
   }
 }
 
 void DBIter::Seek(const Slice& target) {
   direction_ = kForward;
   ClearSavedValue();
+  has_prefix_ =
+      prefix_extractor_ != nullptr && prefix_extractor_->InDomain(target);
+  if (has_prefix_) {
+    const Slice prefix = prefix_extractor_->Transform(target);
+    prefix_.assign(prefix.data(), prefix.size());
+  }
   saved_key_.clear();
   AppendInternalKey(&saved_key_,
                     ParsedInternalKey(target, sequence_, kValueTypeForSeek));
@@ -292,6 +383,7 @@ void DBIter::Seek(const Slice& target) {
 void DBIter::SeekToFirst() {
   direction_ = kForward;
   ClearSavedValue();
+  has_prefix_ = false;
   iter_->SeekToFirst();
   if (iter_->Valid()) {
     FindNextUserEntry(false, &saved_key_ /* temporary storage */);
@@ -301,6 +393,10 @@ void DBIter::SeekToFirst() {
 }
 
 void DBIter::SeekToLast() {
+  if (prefix_extractor_ != nullptr) {
+    RejectReverse();
+    return;
+  }
   direction_ = kReverse;
   ClearSavedValue();
   iter_->SeekToLast();
@@ -309,10 +405,13 @@ void DBIter::SeekToLast() {
 
 }  // anonymous namespace
 
-Iterator* NewDBIterator(DBImpl* db, const Comparator* user_key_comparator,
+Iterator* NewDBIterator(DBImpl* db, const ReadOptions& options,
+                        const Comparator* user_key_comparator,
                         Iterator* internal_iter, SequenceNumber sequence,
-                        uint32_t seed) {
-  return new DBIter(db, user_key_comparator, internal_iter, sequence, seed);
+                        uint32_t seed, RangeDelAggregator* range_del,
+                        const SliceTransform* prefix_extractor) {
+  return new DBIter(db, options, user_key_comparator, internal_iter, sequence,
+                    seed, range_del, prefix_extractor);
 }
 
 }  // namespace leveldb
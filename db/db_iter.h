@@ -13,13 +13,21 @@
 namespace leveldb {
 
 class DBImpl;
+class RangeDelAggregator;
+class SliceTransform;
 
 // Return a new iterator that converts internal keys (yielded by
 // "*internal_iter") that were live at the specified "sequence" number
-// into appropriate user keys.
-Iterator* NewDBIterator(DBImpl* db, const Comparator* user_key_comparator,
+// into appropriate user keys.  Values held in blob files are read with
+// "options".  Entries covered by the tombstones in
+// "*range_del" are hidden.  Takes ownership of "range_del", which may be
+// nullptr if there are no range tombstones.  If "prefix_extractor" is
+// non-null, the iterator follows ReadOptions::prefix_same_as_start.
+Iterator* NewDBIterator(DBImpl* db, const ReadOptions& options,
+                        const Comparator* user_key_comparator,
                         Iterator* internal_iter, SequenceNumber sequence,
-                        uint32_t seed);
+                        uint32_t seed, RangeDelAggregator* range_del = nullptr,
+                        const SliceTransform* prefix_extractor = nullptr);
 
 }  // namespace leveldb
 
@@ -6,9 +6,11 @@
 
 #include <atomic>
 #include <cinttypes>
+#include <cstring>
 #include <string>
 
 #include "gtest/gtest.h"
+#include "db/builder.h"
 #include "db/db_impl.h"
 #include "db/filename.h"
 #include "db/version_set.h"
@@ -16,6 +18,8 @@
 #include "leveldb/cache.h"
 #include "leveldb/env.h"
 #include "leveldb/filter_policy.h"
+#include "leveldb/rate_limiter.h"
+#include "leveldb/slice_transform.h"
 #include "leveldb/table.h"
 #include "port/port.h"
 #include "port/thread_annotations.h"
@@ -109,6 +113,9 @@ class SpecialEnv : public EnvWrapper {
   // Simulate no-space errors while this pointer is non-null.
   std::atomic<bool> no_space_;
 
+  // Force writes to log files to fail while this pointer is non-null.
+  std::atomic<bool> log_write_error_;
+
   // Simulate non-writable file system while this pointer is non-null.
   std::atomic<bool> non_writable_;
 
@@ -121,27 +128,39 @@ class SpecialEnv : public EnvWrapper {
   bool count_random_reads_;
   AtomicCounter random_read_counter_;
 
+  // Return random reads in the caller's buffer, as files that are not
+  // mmapped do, so that the blocks read from tables are cachable.
+  bool copy_random_reads_;
+
+  AtomicCounter reused_file_counter_;
+
   explicit SpecialEnv(Env* base)
       : EnvWrapper(base),
         delay_data_sync_(false),
         data_sync_error_(false),
         no_space_(false),
+        log_write_error_(false),
         non_writable_(false),
         manifest_sync_error_(false),
         manifest_write_error_(false),
-        count_random_reads_(false) {}
+        count_random_reads_(false),
+        copy_random_reads_(false) {}
 
   Status NewWritableFile(const std::string& f, WritableFile** r) {
     class DataFile : public WritableFile {
      private:
       SpecialEnv* const env_;
       WritableFile* const base_;
+      const bool is_log_;
 
      public:
-      DataFile(SpecialEnv* env, WritableFile* base) : env_(env), base_(base) {}
+      DataFile(SpecialEnv* env, WritableFile* base, bool is_log)
+          : env_(env), base_(base), is_log_(is_log) {}
       ~DataFile() { delete base_; }
       Status Append(const Slice& data) {
-        if (env_->no_space_.load(std::memory_order_acquire)) {
+        if (is_log_ && env_->log_write_error_.load(std::memory_order_acquire)) {
+          return Status::IOError("simulated log write error");
+        } else if (env_->no_space_.load(std::memory_order_acquire)) {
           // Drop writes on the floor
           return Status::OK();
         } else {
@@ -194,7 +213,7 @@ class SpecialEnv : public EnvWrapper {
     if (s.ok()) {
       if (strstr(f.c_str(), ".ldb") != nullptr ||
           strstr(f.c_str(), ".log") != nullptr) {
-        *r = new DataFile(this, *r);
+        *r = new DataFile(this, *r, strstr(f.c_str(), ".log") != nullptr);
       } else if (strstr(f.c_str(), "MANIFEST") != nullptr) {
         *r = new ManifestFile(this, *r);
       }
@@ -202,6 +221,12 @@ class SpecialEnv : public EnvWrapper {
     return s;
   }
 
+  Status ReuseWritableFile(const std::string& f, const std::string& old_f,
+                           WritableFile** r) {
+    reused_file_counter_.Increment();
+    return target()->ReuseWritableFile(f, old_f, r);
+  }
+
   Status NewRandomAccessFile(const std::string& f, RandomAccessFile** r) {
     class CountingFile : public RandomAccessFile {
      private:
@@ -219,10 +244,31 @@ class SpecialEnv : public EnvWrapper {
       }
     };
 
+    class CopyingFile : public RandomAccessFile {
+     private:
+      RandomAccessFile* target_;
+
+     public:
+      explicit CopyingFile(RandomAccessFile* target) : target_(target) {}
+      ~CopyingFile() override { delete target_; }
+      Status Read(uint64_t offset, size_t n, Slice* result,
+                  char* scratch) const override {
+        Status s = target_->Read(offset, n, result, scratch);
+        if (s.ok() && result->data() != scratch) {
+          std::memcpy(scratch, result->data(), result->size());
+          *result = Slice(scratch, result->size());
+        }
+        return s;
+      }
+    };
+
     Status s = target()->NewRandomAccessFile(f, r);
     if (s.ok() && count_random_reads_) {
       *r = new CountingFile(*r, &random_read_counter_);
     }
+    if (s.ok() && copy_random_reads_) {
+      *r = new CopyingFile(*r);
+    }
     return s;
   }
 };
@@ -276,6 +322,26 @@ class DBTest : public testing::Test {
       case kUncompressed:
         options.compression = kNoCompression;
         break;
+      case kHashMemTable:
+        options.memtable_rep = leveldb::kHashMemTable;
+        break;
+      case kCompressedWal:
+        options.reuse_logs = true;
+        options.wal_compression = kSnappyCompression;
+        options.wal_bytes_per_flush = 4096;
+        break;
+      case kDataBlockHashIndex:
+        options.data_block_hash_index = true;
+        break;
+      case kPartitionedIndexAndFilters:
+        options.filter_policy = filter_policy_;
+        options.partition_index_and_filters = true;
+        options.block_size = 256;
+        break;
+      case kWholeTableFilter:
+        options.filter_policy = filter_policy_;
+        options.whole_table_filter = true;
+        break;
       default:
         break;
     }
@@ -321,6 +387,10 @@ class DBTest : public testing::Test {
 
   Status Delete(const std::string& k) { return db_->Delete(WriteOptions(), k); }
 
+  Status DeleteRange(const std::string& begin, const std::string& end) {
+    return db_->DeleteRange(WriteOptions(), begin, end);
+  }
+
   std::string Get(const std::string& k, const Snapshot* snapshot = nullptr) {
     ReadOptions options;
     options.snapshot = snapshot;
@@ -390,6 +460,12 @@ class DBTest : public testing::Test {
             case kTypeDeletion:
               result += "DEL";
               break;
+            case kTypeRangeDeletion:
+              result += "RANGEDEL";
+              break;
+            case kTypeBlobIndex:
+              result += "BLOB";
+              break;
           }
         }
         iter->Next();
@@ -403,6 +479,12 @@ class DBTest : public testing::Test {
     return result;
   }
 
+  uint64_t IntProperty(const std::string& name) {
+    std::string property;
+    EXPECT_TRUE(db_->GetProperty("leveldb." + name, &property));
+    return std::stoull(property);
+  }
+
   int NumTableFilesAtLevel(int level) {
     std::string property;
     EXPECT_TRUE(db_->GetProperty(
@@ -530,9 +612,40 @@ class DBTest : public testing::Test {
     return files_renamed;
   }
 
+  // Returns the total size of the files of "type", and stores their number
+  // in *count.
+  uint64_t SizeOfFiles(FileType type, int* count) {
+    std::vector<std::string> filenames;
+    EXPECT_LEVELDB_OK(env_->GetChildren(dbname_, &filenames));
+    uint64_t number;
+    FileType file_type;
+    uint64_t total = 0;
+    *count = 0;
+    for (const std::string& filename : filenames) {
+      uint64_t size;
+      if (ParseFileName(filename, &number, &file_type) && file_type == type &&
+          env_->GetFileSize(dbname_ + "/" + filename, &size).ok()) {
+        total += size;
+        (*count)++;
+      }
+    }
+    return total;
+  }
+
  private:
   // Sequence of option configurations to try
-  enum OptionConfig { kDefault, kReuse, kFilter, kUncompressed, kEnd };
+  enum OptionConfig {
+    kDefault,
+    kReuse,
+    kFilter,
+    kUncompressed,
+    kHashMemTable,
+    kCompressedWal,
+    kDataBlockHashIndex,
+    kPartitionedIndexAndFilters,
+    kWholeTableFilter,
+    kEnd
+  };
 
   const FilterPolicy* filter_policy_;
   int option_config_;
@@ -607,6 +720,146 @@ TEST_F(DBTest, GetFromImmutableLayer) {
   } while (ChangeOptions());
 }
 
+TEST_F(DBTest, MultipleImmutableMemTables) {
+  do {
+    Options options = CurrentOptions();
+    options.env = env_;
+    options.write_buffer_size = 100000;  // Small write buffer
+    options.max_write_buffer_number = 4;
+    Reopen(&options);
+
+    std::string num;
+    ASSERT_LEVELDB_OK(Put("foo", "v1"));
+    ASSERT_TRUE(db_->GetProperty("leveldb.num-immutable-mem-table", &num));
+    ASSERT_EQ("0", num);
+
+    // Block sync calls so that no memtable finishes flushing.
+    env_->delay_data_sync_.store(true, std::memory_order_release);
+    Put("k1", std::string(100000, 'x'));  // Fill memtable.
+    Put("k2", std::string(100000, 'y'));  // Switch to a second memtable.
+    ASSERT_LEVELDB_OK(Put("foo", "v2"));  // Switch to a third memtable.
+    Put("k3", std::string(100000, 'z'));
+    Put("k4", std::string(10, 'w'));  // Switch to a fourth memtable.
+    ASSERT_TRUE(db_->GetProperty("leveldb.num-immutable-mem-table", &num));
+    ASSERT_EQ("3", num);
+    ASSERT_EQ("v2", Get("foo"));
+    ASSERT_EQ(std::string(100000, 'x'), Get("k1"));
+    ASSERT_EQ(std::string(100000, 'z'), Get("k3"));
+    Iterator* iter = db_->NewIterator(ReadOptions());
+    iter->SeekToFirst();
+    ASSERT_EQ("foo->v2", IterStatus(iter));
+    int count = 0;
+    for (; iter->Valid(); iter->Next()) count++;
+    ASSERT_EQ(5, count);
+    delete iter;
+    // Release sync calls.
+    env_->delay_data_sync_.store(false, std::memory_order_release);
+
+    dbfull()->TEST_CompactMemTable();
+    ASSERT_TRUE(db_->GetProperty("leveldb.num-immutable-mem-table", &num));
+    ASSERT_EQ("0", num);
+    ASSERT_EQ("v2", Get("foo"));
+    ASSERT_EQ(std::string(100000, 'y'), Get("k2"));
+  } while (ChangeOptions());
+}
+
+namespace {
+
+struct StalledWrite {
+  DB* db;
+  std::atomic<bool> done;
+};
+
+static void StalledWriteBody(void* arg) {
+  StalledWrite* w = reinterpret_cast<StalledWrite*>(arg);
+  w->db->Put(WriteOptions(), "k3", std::string(100000, 'z'));
+  w->done.store(true, std::memory_order_release);
+}
+
+struct PacedWriter {
+  DB* db;
+  int id;
+  std::atomic<int>* done;
+};
+
+static void PacedWriterBody(void* arg) {
+  PacedWriter* w = reinterpret_cast<PacedWriter*>(arg);
+  for (int i = 0; i < 25; i++) {
+    char key[100];
+    std::snprintf(key, sizeof(key), "%d/%d", w->id, i);
+    w->db->Put(WriteOptions(), key, std::string(4000, 'v'));
+  }
+  w->done->fetch_add(1, std::memory_order_release);
+}
+
+}  // namespace
+
+TEST_F(DBTest, WriteStallProperties) {
+  Options options = CurrentOptions();
+  options.env = env_;
+  options.write_buffer_size = 100000;  // Small write buffer
+  Reopen(&options);
+  ASSERT_EQ(0, IntProperty("num-delayed-writes"));
+  ASSERT_EQ(0, IntProperty("num-stopped-writes"));
+  ASSERT_EQ(0, IntProperty("write-stall-micros"));
+  ASSERT_EQ(0, IntProperty("delayed-write-rate"));
+  ASSERT_EQ(0, IntProperty("estimate-pending-compaction-bytes"));
+
+  // Block sync calls so that the first memtable cannot be flushed.
+  env_->delay_data_sync_.store(true, std::memory_order_release);
+  Put("k1", std::string(100000, 'x'));  // Fill memtable.
+  Put("k2", std::string(100000, 'y'));  // Switch to a second memtable.
+
+  // Filling the second memtable must wait for the first to be flushed.
+  StalledWrite w;
+  w.db = db_;
+  w.done.store(false, std::memory_order_release);
+  env_->StartThread(StalledWriteBody, &w);
+  DelayMilliseconds(100);
+  ASSERT_FALSE(w.done.load(std::memory_order_acquire));
+
+  // Release sync calls.
+  env_->delay_data_sync_.store(false, std::memory_order_release);
+  while (!w.done.load(std::memory_order_acquire)) {
+    DelayMilliseconds(10);
+  }
+  ASSERT_EQ(1, IntProperty("num-stopped-writes"));
+  ASSERT_GE(IntProperty("write-stall-micros"), 100000);
+  ASSERT_EQ(0, IntProperty("num-delayed-writes"));
+}
+
+TEST_F(DBTest, WriteDelayPacesBatchGroups) {
+  Options options = CurrentOptions();
+  options.env = env_;
+  Reopen(&options);
+
+  // Writes are paced at the minimum rate of 1MB/s under full pressure.
+  // Concurrent writers are logged in groups, and the followers in each
+  // group must be paced along with the writer that leads it.
+  dbfull()->TEST_SetCompactionPressure(1.0);
+  constexpr int kNumWriters = 8;
+  PacedWriter writers[kNumWriters];
+  std::atomic<int> done(0);
+  const uint64_t start = env_->NowMicros();
+  for (int i = 0; i < kNumWriters; i++) {
+    writers[i].db = db_;
+    writers[i].id = i;
+    writers[i].done = &done;
+    env_->StartThread(PacedWriterBody, &writers[i]);
+  }
+  while (done.load(std::memory_order_acquire) < kNumWriters) {
+    DelayMilliseconds(10);
+  }
+  const uint64_t elapsed = env_->NowMicros() - start;
+  dbfull()->TEST_SetCompactionPressure(-1);
+
+  // 800KB of values take at least 0.8s at 1MB/s; allow some slack.
+  const double total_bytes = kNumWriters * 25 * 4000.0;
+  ASSERT_GE(elapsed, 0.8 * total_bytes / 1048576 * 1e6);
+  ASSERT_GT(IntProperty("num-delayed-writes"), 0);
+  ASSERT_EQ(std::string(4000, 'v'), Get("7/24"));
+}
+
 TEST_F(DBTest, GetFromVersions) {
   do {
     ASSERT_LEVELDB_OK(Put("foo", "v1"));
@@ -615,6 +868,32 @@ TEST_F(DBTest, GetFromVersions) {
   } while (ChangeOptions());
 }
 
+TEST_F(DBTest, GetPinned) {
+  do {
+    PinnableSlice mem_value;
+    ASSERT_LEVELDB_OK(Put("foo", "v1"));
+    ASSERT_LEVELDB_OK(db_->Get(ReadOptions(), "foo", &mem_value));
+    ASSERT_TRUE(mem_value.IsPinned());
+    ASSERT_EQ("v1", mem_value.ToString());
+
+    // Pinned values outlive the memtables and tables they come from.
+    PinnableSlice table_value;
+    ASSERT_LEVELDB_OK(Put("foo", "v2"));
+    dbfull()->TEST_CompactMemTable();
+    ASSERT_LEVELDB_OK(db_->Get(ReadOptions(), "foo", &table_value));
+    ASSERT_TRUE(table_value.IsPinned());
+    ASSERT_EQ("v2", table_value.ToString());
+    ASSERT_LEVELDB_OK(Delete("foo"));
+    db_->CompactRange(nullptr, nullptr);
+    ASSERT_EQ("v1", mem_value.ToString());
+    ASSERT_EQ("v2", table_value.ToString());
+
+    ASSERT_TRUE(db_->Get(ReadOptions(), "foo", &mem_value).IsNotFound());
+    ASSERT_TRUE(mem_value.empty());
+    ASSERT_TRUE(!mem_value.IsPinned());
+  } while (ChangeOptions());
+}
+
 TEST_F(DBTest, GetMemUsage) {
   do {
     ASSERT_LEVELDB_OK(Put("foo", "v1"));
@@ -1074,6 +1353,140 @@ TEST_F(DBTest, MinorCompactionsHappen) {
   }
 }
 
+TEST_F(DBTest, MemTableHugePages) {
+  Options options = CurrentOptions();
+  options.write_buffer_size = 10000;
+  options.memtable_huge_pages = true;
+  Reopen(&options);
+
+  // Memtables are switched many times, reusing the same regions, and
+  // large values spill over from the region to the heap.
+  const int N = 500;
+  for (int i = 0; i < N; i++) {
+    ASSERT_LEVELDB_OK(Put(Key(i), Key(i) + std::string(1000, 'v')));
+  }
+  ASSERT_LEVELDB_OK(Put("big", std::string(3 << 20, 'x')));
+  ASSERT_GT(TotalTableFiles(), 0);
+
+  for (int i = 0; i < N; i++) {
+    ASSERT_EQ(Key(i) + std::string(1000, 'v'), Get(Key(i)));
+  }
+  ASSERT_EQ(std::string(3 << 20, 'x'), Get("big"));
+
+  Reopen(&options);
+  for (int i = 0; i < N; i++) {
+    ASSERT_EQ(Key(i) + std::string(1000, 'v'), Get(Key(i)));
+  }
+  ASSERT_EQ(std::string(3 << 20, 'x'), Get("big"));
+}
+
+TEST_F(DBTest, RateLimitedBackgroundIO) {
+  std::unique_ptr<RateLimiter> limiter(NewGenericRateLimiter(100 << 20));
+  Options options = CurrentOptions();
+  options.write_buffer_size = 100000;
+  options.rate_limiter = limiter.get();
+  options.rate_limit_compaction_reads = true;
+  Reopen(&options);
+
+  // Write every key twice so that the flushed files overlap.
+  const int N = 500;
+  for (int pass = 0; pass < 2; pass++) {
+    for (int i = 0; i < N; i++) {
+      ASSERT_LEVELDB_OK(Put(Key(i), Key(i) + std::string(1000, 'v')));
+    }
+    dbfull()->TEST_CompactMemTable();
+  }
+  // Flushes write at high priority.
+  const int64_t flushed = limiter->GetTotalBytesThrough(RateLimiter::kHigh);
+  ASSERT_GT(flushed, 0);
+
+  // Compactions read and write at low priority.
+  const int64_t compacted = limiter->GetTotalBytesThrough(RateLimiter::kLow);
+  db_->CompactRange(nullptr, nullptr);
+  ASSERT_GT(limiter->GetTotalBytesThrough(RateLimiter::kLow),
+            compacted + 2 * N * 1000);
+  ASSERT_EQ(flushed, limiter->GetTotalBytesThrough(RateLimiter::kHigh));
+
+  for (int i = 0; i < N; i++) {
+    ASSERT_EQ(Key(i) + std::string(1000, 'v'), Get(Key(i)));
+  }
+  Close();
+}
+
+TEST_F(DBTest, RecycleLogFiles) {
+  Options options = CurrentOptions();
+  options.env = env_;
+  options.write_buffer_size = 100000;  // Small write buffer
+  options.recycle_log_file_num = 2;
+  Reopen(&options);
+
+  // Memtable switches overwrite the logs of flushed memtables.
+  const std::string value(1000, 'v');
+  for (int i = 0; i < 1000; i++) {
+    ASSERT_LEVELDB_OK(Put(Key(i), value));
+  }
+  ASSERT_LEVELDB_OK(dbfull()->TEST_CompactMemTable());
+  ASSERT_GT(env_->reused_file_counter_.Read(), 0);
+
+  std::vector<std::string> filenames;
+  ASSERT_LEVELDB_OK(env_->GetChildren(dbname_, &filenames));
+  int logs = 0;
+  uint64_t number;
+  FileType type;
+  for (const std::string& filename : filenames) {
+    if (ParseFileName(filename, &number, &type) && type == kLogFile) {
+      logs++;
+    }
+  }
+  ASSERT_LE(logs, 3);  // The current log and the recycled ones
+
+  // Recovery stops where the records of an overwritten log end.
+  ASSERT_LEVELDB_OK(Put("foo", "v1"));
+  Reopen(&options);
+  ASSERT_EQ("v1", Get("foo"));
+  for (int i = 0; i < 1000; i++) {
+    ASSERT_EQ(value, Get(Key(i)));
+  }
+}
+
+TEST_F(DBTest, ManifestRollover) {
+  Options options = CurrentOptions();
+  options.max_manifest_file_size = 200;
+  Reopen(&options);
+  ASSERT_GT(IntProperty("recovery-micros"), 0);
+
+  // Returns the numbers of the MANIFEST files in the DB directory.
+  auto manifests = [&]() {
+    std::vector<std::string> filenames;
+    EXPECT_LEVELDB_OK(env_->GetChildren(dbname_, &filenames));
+    std::vector<uint64_t> result;
+    uint64_t number;
+    FileType type;
+    for (const std::string& filename : filenames) {
+      if (ParseFileName(filename, &number, &type) && type == kDescriptorFile) {
+        result.push_back(number);
+      }
+    }
+    return result;
+  };
+
+  std::set<uint64_t> seen;
+  for (int i = 0; i < 20; i++) {
+    ASSERT_LEVELDB_OK(Put(Key(i), Key(i)));
+    dbfull()->TEST_CompactMemTable();
+    // Rolled over MANIFESTs are deleted along with other obsolete files.
+    std::vector<uint64_t> numbers = manifests();
+    ASSERT_EQ(1, numbers.size());
+    seen.insert(numbers[0]);
+  }
+  ASSERT_GT(seen.size(), 2);
+
+  Reopen(&options);
+  for (int i = 0; i < 20; i++) {
+    ASSERT_EQ(Key(i), Get(Key(i)));
+  }
+}
+
 TEST_F(DBTest, RecoverWithLargeLog) {
   {
     Options options = CurrentOptions();
@@ -1433,6 +1846,141 @@ TEST_F(DBTest, DeletionMarkers2) {
   ASSERT_EQ(AllEntriesFor("foo"), "[ ]");
 }
 
+TEST_F(DBTest, DeleteRange) {
+  do {
+    ASSERT_LEVELDB_OK(Put("a", "va"));
+    ASSERT_LEVELDB_OK(Put("b", "vb"));
+    ASSERT_LEVELDB_OK(Put("c", "vc"));
+    ASSERT_LEVELDB_OK(Put("d", "vd"));
+    const Snapshot* snapshot = db_->GetSnapshot();
+    ASSERT_LEVELDB_OK(DeleteRange("b", "d"));
+    ASSERT_LEVELDB_OK(Put("c", "vc2"));
+    ASSERT_LEVELDB_OK(DeleteRange("x", "b"));  // Empty range
+
+    ASSERT_EQ("va", Get("a"));
+    ASSERT_EQ("NOT_FOUND", Get("b"));
+    ASSERT_EQ("vc2", Get("c"));
+    ASSERT_EQ("vd", Get("d"));
+    ASSERT_EQ("vb", Get("b", snapshot));
+    ASSERT_EQ("(a->va)(c->vc2)(d->vd)", Contents());
+    db_->ReleaseSnapshot(snapshot);
+
+    Reopen();
+    ASSERT_EQ("NOT_FOUND", Get("b"));
+    ASSERT_EQ("vc2", Get("c"));
+    ASSERT_EQ("(a->va)(c->vc2)(d->vd)", Contents());
+
+    ASSERT_LEVELDB_OK(dbfull()->TEST_CompactMemTable());
+    ASSERT_EQ("NOT_FOUND", Get("b"));
+    ASSERT_EQ("vc2", Get("c"));
+    ASSERT_EQ("(a->va)(c->vc2)(d->vd)", Contents());
+  } while (ChangeOptions());
+}
+
+TEST_F(DBTest, DeleteRangeAcrossLevels) {
+  for (int i = 0; i < 100; i++) {
+    ASSERT_LEVELDB_OK(Put(Key(i), "old"));
+  }
+  ASSERT_LEVELDB_OK(dbfull()->TEST_CompactMemTable());
+  dbfull()->TEST_CompactRange(0, nullptr, nullptr);
+  dbfull()->TEST_CompactRange(1, nullptr, nullptr);
+  ASSERT_EQ("0,0,1", FilesPerLevel());
+
+  // The tombstone lands in a newer level than the data it covers.
+  ASSERT_LEVELDB_OK(Put(Key(0), "new"));
+  ASSERT_LEVELDB_OK(DeleteRange(Key(10), Key(20)));
+  ASSERT_LEVELDB_OK(Put(Key(15), "new"));
+  ASSERT_LEVELDB_OK(dbfull()->TEST_CompactMemTable());
+  ASSERT_EQ("NOT_FOUND", Get(Key(10)));
+  ASSERT_EQ("new", Get(Key(15)));
+  ASSERT_EQ("old", Get(Key(20)));
+  ASSERT_EQ("[ old ]", AllEntriesFor(Key(12)));
+
+  // Compacting into the bottom level removes the covered entries and the
+  // tombstone itself.
+  dbfull()->TEST_CompactRange(0, nullptr, nullptr);
+  dbfull()->TEST_CompactRange(1, nullptr, nullptr);
+  ASSERT_EQ("[ ]", AllEntriesFor(Key(12)));
+  ASSERT_EQ("[ new ]", AllEntriesFor(Key(15)));
+  ASSERT_EQ("NOT_FOUND", Get(Key(10)));
+  ASSERT_EQ("old", Get(Key(9)));
+  ASSERT_EQ("old", Get(Key(20)));
+
+  Iterator* iter = db_->NewIterator(ReadOptions());
+  int count = 0;
+  for (iter->SeekToFirst(); iter->Valid(); iter->Next()) {
+    count++;
+  }
+  ASSERT_LEVELDB_OK(iter->status());
+  ASSERT_EQ(91, count);
+  delete iter;
+}
+
+TEST_F(DBTest, DeleteRangeDropsCoveredFiles) {
+  Options options = CurrentOptions();
+  options.write_buffer_size = 100000;  // Small write buffer
+  options.max_file_size = 100000;      // Many small tables
+  Reopen(&options);
+
+  Random rnd(301);
+  for (int i = 0; i < 1000; i++) {
+    ASSERT_LEVELDB_OK(Put(Key(i), RandomString(&rnd, 1000)));
+  }
+  ASSERT_LEVELDB_OK(Put("z", "keep"));
+  dbfull()->CompactRange(nullptr, nullptr);
+  const int files_before = TotalTableFiles();
+  ASSERT_GT(files_before, 2);
+
+  // Files holding only keys in the range are removed without compaction.
+  ASSERT_LEVELDB_OK(DeleteRange(Key(0), "y"));
+  dbfull()->TEST_CompactMemTable();
+  ASSERT_LT(TotalTableFiles(), files_before);
+  ASSERT_EQ("NOT_FOUND", Get(Key(0)));
+  ASSERT_EQ("NOT_FOUND", Get(Key(500)));
+  ASSERT_EQ("keep", Get("z"));
+  ASSERT_EQ("(z->keep)", Contents());
+
+  // A live snapshot keeps covered files readable.
+  for (int i = 0; i < 1000; i++) {
+    ASSERT_LEVELDB_OK(Put(Key(i), RandomString(&rnd, 1000)));
+  }
+  dbfull()->CompactRange(nullptr, nullptr);
+  const Snapshot* snapshot = db_->GetSnapshot();
+  ASSERT_LEVELDB_OK(DeleteRange(Key(0), "y"));
+  dbfull()->TEST_CompactMemTable();
+  ASSERT_EQ("NOT_FOUND", Get(Key(500)));
+  ASSERT_NE("NOT_FOUND", Get(Key(500), snapshot));
+  db_->ReleaseSnapshot(snapshot);
+
+  Reopen(&options);
+  ASSERT_EQ("NOT_FOUND", Get(Key(500)));
+  ASSERT_EQ("keep", Get("z"));
+}
+
+TEST_F(DBTest, DeletionHeavyFileIsCompacted) {
+  const int kNumKeys = 2 * config::kDeletionCompactionMinDeletions;
+  for (int i = 0; i < kNumKeys; i++) {
+    ASSERT_LEVELDB_OK(Put(Key(i), "v"));
+  }
+  ASSERT_LEVELDB_OK(Put("z", "keep"));
+  dbfull()->TEST_CompactMemTable();
+  ASSERT_EQ("0,0,1", FilesPerLevel());
+
+  // The deletions land in a file of their own in level-1, far below the
+  // level's size limit.  They are still pushed down and discarded.
+  for (int i = 0; i < kNumKeys; i++) {
+    ASSERT_LEVELDB_OK(Delete(Key(i)));
+  }
+  dbfull()->TEST_CompactMemTable();
+  for (int i = 0; i < 1000 && FilesPerLevel() != "0,0,1"; i++) {
+    DelayMilliseconds(10);
+  }
+  ASSERT_EQ("0,0,1", FilesPerLevel());
+  ASSERT_EQ("(z->keep)", Contents());
+  ASSERT_EQ("[ keep ]", AllEntriesFor("z"));
+  ASSERT_EQ("[ ]", AllEntriesFor(Key(0)));
+}
+
 TEST_F(DBTest, OverlapInLevel0) {
   do {
     ASSERT_EQ(config::kMaxMemCompactLevel, 2) << "Fix test to match config";
@@ -1810,6 +2358,105 @@ TEST_F(DBTest, WriteSyncError) {
   ASSERT_EQ("NOT_FOUND", Get("k3"));
 }
 
+TEST_F(DBTest, GroupedLogWriteError) {
+  // Check that a failure to write out buffered log records causes the DB
+  // to disallow future writes, since records of acknowledged writes may
+  // have been lost.
+  Options options = CurrentOptions();
+  options.env = env_;
+  options.wal_compression = kSnappyCompression;
+  options.wal_bytes_per_flush = 1000;
+
+  // (a) A write that fills the group fails to write it out
+  Reopen(&options);
+  ASSERT_LEVELDB_OK(Put("k1", "v1"));  // Buffered
+  env_->log_write_error_.store(true, std::memory_order_release);
+  ASSERT_TRUE(!Put("k2", std::string(2000, 'x')).ok());
+  env_->log_write_error_.store(false, std::memory_order_release);
+  ASSERT_TRUE(!Put("k3", "v3").ok());
+  ASSERT_EQ("NOT_FOUND", Get("k3"));
+
+  // (b) A sync write fails to write out the buffered records
+  Reopen(&options);
+  ASSERT_LEVELDB_OK(Put("k4", "v4"));
+  env_->log_write_error_.store(true, std::memory_order_release);
+  WriteOptions w;
+  w.sync = true;
+  ASSERT_TRUE(!db_->Put(w, "k5", "v5").ok());
+  env_->log_write_error_.store(false, std::memory_order_release);
+  ASSERT_TRUE(!Put("k6", "v6").ok());
+
+  // (c) Switching to a new log file fails to write out the buffered
+  // records
+  Reopen(&options);
+  ASSERT_LEVELDB_OK(Put("k7", "v7"));
+  env_->log_write_error_.store(true, std::memory_order_release);
+  ASSERT_TRUE(!dbfull()->TEST_CompactMemTable().ok());
+  env_->log_write_error_.store(false, std::memory_order_release);
+  ASSERT_TRUE(!Put("k8", "v8").ok());
+}
+
+namespace {
+
+struct SyncWriter {
+  DB* db;
+  int id;
+  std::atomic<bool> failed;
+  std::atomic<bool> done;
+};
+
+static const int kSyncWriterWrites = 50;
+
+static void SyncWriterBody(void* arg) {
+  SyncWriter* w = reinterpret_cast<SyncWriter*>(arg);
+  for (int i = 0; i < kSyncWriterWrites; i++) {
+    // Mix in unsynced writes, which are logged while syncs are in flight.
+    WriteOptions options;
+    options.sync = (i % 3 != 0);
+    char key[100];
+    std::snprintf(key, sizeof(key), "%d.%d", w->id, i);
+    if (!w->db->Put(options, key, key).ok()) {
+      w->failed.store(true, std::memory_order_release);
+    }
+  }
+  w->done.store(true, std::memory_order_release);
+}
+
+}  // namespace
+
+TEST_F(DBTest, ConcurrentSyncWrites) {
+  // Uses the default Env so that log syncs complete asynchronously.
+  Options options = CurrentOptions();
+  Reopen(&options);
+
+  const int kWriters = 4;
+  SyncWriter writers[kWriters];
+  for (int id = 0; id < kWriters; id++) {
+    writers[id].db = db_;
+    writers[id].id = id;
+    writers[id].failed.store(false, std::memory_order_release);
+    writers[id].done.store(false, std::memory_order_release);
+    env_->StartThread(SyncWriterBody, &writers[id]);
+  }
+  for (int id = 0; id < kWriters; id++) {
+    while (!writers[id].done.load(std::memory_order_acquire)) {
+      DelayMilliseconds(10);
+    }
+    ASSERT_FALSE(writers[id].failed.load(std::memory_order_acquire));
+  }
+
+  for (int pass = 0; pass < 2; pass++) {
+    for (int id = 0; id < kWriters; id++) {
+      for (int i = 0; i < kSyncWriterWrites; i++) {
+        char key[100];
+        std::snprintf(key, sizeof(key), "%d.%d", id, i);
+        ASSERT_EQ(key, Get(key));
+      }
+    }
+    Reopen(&options);
+  }
+}
+
 TEST_F(DBTest, ManifestWriteError) {
   // Test for the following problem:
   // (a) Compaction produces file F
@@ -1944,6 +2591,484 @@ TEST_F(DBTest, BloomFilter) {
   delete options.filter_policy;
 }
 
+TEST_F(DBTest, WholeTableFilter) {
+  env_->count_random_reads_ = true;
+  Options options = CurrentOptions();
+  options.env = env_;
+  options.block_cache = NewLRUCache(0);  // Prevent cache hits
+  options.filter_policy = NewBloomFilterPolicy(10);
+  options.whole_table_filter = true;
+  Reopen(&options);
+
+  const int N = 10000;
+  for (int i = 0; i < N; i++) {
+    ASSERT_LEVELDB_OK(Put(Key(i), Key(i)));
+  }
+  Compact("a", "z");
+  for (int i = 0; i < N; i += 100) {
+    ASSERT_LEVELDB_OK(Put(Key(i), Key(i)));
+  }
+  dbfull()->TEST_CompactMemTable();
+  env_->delay_data_sync_.store(true, std::memory_order_release);
+
+  for (int i = 0; i < N; i++) {
+    ASSERT_EQ(Key(i), Get(Key(i)));
+  }
+  env_->random_read_counter_.Reset();
+  for (int i = 0; i < N; i++) {
+    ASSERT_EQ("NOT_FOUND", Get(Key(i) + ".missing"));
+  }
+  ASSERT_LE(env_->random_read_counter_.Read(), 3 * N / 100);
+  env_->delay_data_sync_.store(false, std::memory_order_release);
+
+  // The filter format is recorded in each table, not in the options.
+  options.whole_table_filter = false;
+  Reopen(&options);
+  env_->delay_data_sync_.store(true, std::memory_order_release);
+  env_->random_read_counter_.Reset();
+  for (int i = 0; i < N; i++) {
+    ASSERT_EQ("NOT_FOUND", Get(Key(i) + ".missing"));
+  }
+  ASSERT_LE(env_->random_read_counter_.Read(), 3 * N / 100);
+
+  env_->delay_data_sync_.store(false, std::memory_order_release);
+  Close();
+  delete options.block_cache;
+  delete options.filter_policy;
+}
+
+namespace {
+
+std::string PrefixKey(int tenant, int entity, int ts) {
+  char buf[100];
+  std::snprintf(buf, sizeof(buf), "t%d/e%d/%04d", tenant, entity, ts);
+  return buf;
+}
+
+// Returns the keys that "iter" yields from Seek(target) on.
+std::string ScanFrom(Iterator* iter, const std::string& target) {
+  std::string result;
+  for (iter->Seek(target); iter->Valid(); iter->Next()) {
+    if (!result.empty()) result.push_back(',');
+    result.append(iter->key().data(), iter->key().size());
+  }
+  return result;
+}
+
+}  // namespace
+
+TEST_F(DBTest, PrefixSameAsStart) {
+  env_->count_random_reads_ = true;
+  Options options = CurrentOptions();
+  options.env = env_;
+  options.block_cache = NewLRUCache(0);  // Prevent cache hits
+  options.filter_policy = NewBloomFilterPolicy(16);
+  options.prefix_extractor = NewDelimitedPrefixTransform('/', 2);
+  Reopen(&options);
+
+  // One table per tenant, with entities 0, 2, 4, ... and a few more
+  // tables in level 0.
+  for (int t = 0; t < 5; t++) {
+    for (int e = 0; e < 20; e += 2) {
+      for (int ts = 0; ts < 20; ts++) {
+        ASSERT_LEVELDB_OK(Put(PrefixKey(t, e, ts), "v"));
+      }
+    }
+    dbfull()->TEST_CompactMemTable();
+  }
+  // Pushed below the table that spans all tenants, the last three tables
+  // stay in level 0.
+  ASSERT_LEVELDB_OK(Put(PrefixKey(0, 4, 100), "v"));
+  ASSERT_LEVELDB_OK(Put(PrefixKey(4, 4, 100), "v"));
+  dbfull()->TEST_CompactMemTable();
+  for (int t = 0; t < 5; t += 2) {
+    ASSERT_LEVELDB_OK(Put(PrefixKey(t, 4, 100), "v"));
+    dbfull()->TEST_CompactMemTable();
+  }
+  ASSERT_EQ("3,1,5", FilesPerLevel());
+
+  ReadOptions read_options;
+  read_options.prefix_same_as_start = true;
+  Iterator* iter = db_->NewIterator(read_options);
+  Iterator* all = db_->NewIterator(ReadOptions());
+
+  // Only the keys of the prefix of the target are visited.
+  ASSERT_EQ(PrefixKey(2, 4, 18) + "," + PrefixKey(2, 4, 19) + "," +
+                PrefixKey(2, 4, 100),
+            ScanFrom(iter, PrefixKey(2, 4, 18)));
+  ASSERT_EQ(PrefixKey(3, 18, 19), ScanFrom(iter, PrefixKey(3, 18, 19)));
+  ASSERT_EQ("", ScanFrom(iter, PrefixKey(4, 5, 0)));
+  ASSERT_EQ("", ScanFrom(iter, PrefixKey(9, 0, 0)));
+  ASSERT_LEVELDB_OK(iter->status());
+
+  // Keys outside the domain of the transform are not restricted.
+  ASSERT_EQ(ScanFrom(all, "t4"), ScanFrom(iter, "t4"));
+  iter->SeekToFirst();
+  int count = 0;
+  for (; iter->Valid(); iter->Next()) count++;
+  ASSERT_EQ(5 * 10 * 20 + 3, count);
+
+  // A missing prefix costs no read, while the tables that may hold the
+  // target are read without the option.
+  env_->random_read_counter_.Reset();
+  for (int t = 0; t < 5; t++) {
+    ScanFrom(iter, PrefixKey(t, 1, 0));
+    ScanFrom(iter, PrefixKey(t, 19, 0));
+  }
+  ASSERT_EQ(0, env_->random_read_counter_.Read());
+  for (int t = 0; t < 5; t++) {
+    all->Seek(PrefixKey(t, 1, 0));
+  }
+  ASSERT_GE(env_->random_read_counter_.Read(), 5);
+
+  // Positioning backwards is not supported.
+  iter->Seek(PrefixKey(1, 2, 3));
+  ASSERT_TRUE(iter->Valid());
+  iter->Prev();
+  ASSERT_TRUE(!iter->Valid());
+  ASSERT_TRUE(iter->status().IsNotSupportedError());
+  delete iter;
+  delete all;
+
+  // Prefixes recorded under another transform are ignored.
+  delete options.prefix_extractor;
+  options.prefix_extractor = NewFixedPrefixTransform(2);
+  Reopen(&options);
+  iter = db_->NewIterator(read_options);
+  count = 0;
+  for (iter->Seek("t2/e4/"); iter->Valid(); iter->Next()) count++;
+  ASSERT_EQ(3 * 20 + 1, count);  // Entities "e4", "e6" and "e8" of "t2"
+  delete iter;
+
+  Close();
+  delete options.block_cache;
+  delete options.filter_policy;
+  delete options.prefix_extractor;
+}
+
+TEST_F(DBTest, BlobValues) {
+  Options options = CurrentOptions();
+  options.min_blob_size = 1000;
+  Reopen(&options);
+
+  Random rnd(301);
+  std::vector<std::string> values;
+  for (int i = 0; i < 100; i++) {
+    values.push_back(RandomString(&rnd, (i % 2 == 0) ? 10 : 10000));
+    ASSERT_LEVELDB_OK(Put(Key(i), values[i]));
+  }
+  ASSERT_LEVELDB_OK(Delete(Key(7)));
+  dbfull()->TEST_CompactMemTable();
+
+  // Only the large values moved to the blob file.
+  int count;
+  ASSERT_EQ(50 * (10000 + 4), SizeOfFiles(kBlobFile, &count));
+  ASSERT_EQ(1, count);
+  ASSERT_LT(SizeOfFiles(kTableFile, &count), 10000);
+
+  for (int pass = 0; pass < 3; pass++) {
+    for (int i = 0; i < 100; i++) {
+      ASSERT_EQ(i == 7 ? "NOT_FOUND" : values[i], Get(Key(i)));
+    }
+    Iterator* iter = db_->NewIterator(ReadOptions());
+    int i = 0;
+    for (iter->SeekToFirst(); iter->Valid(); iter->Next(), i++) {
+      if (i == 7) i++;
+      ASSERT_EQ(Key(i), iter->key().ToString());
+      ASSERT_EQ(values[i], iter->value().ToString());
+    }
+    ASSERT_EQ(100, i);
+    for (iter->SeekToLast(); iter->Valid(); iter->Prev()) {
+      i--;
+      if (i == 7) i--;
+      ASSERT_EQ(Key(i), iter->key().ToString());
+      ASSERT_EQ(values[i], iter->value().ToString());
+    }
+    ASSERT_EQ(0, i);
+    iter->Seek(Key(7));
+    ASSERT_EQ(values[8], iter->value().ToString());
+    iter->Prev();
+    ASSERT_EQ(values[6], iter->value().ToString());
+    iter->Prev();
+    ASSERT_EQ(values[5], iter->value().ToString());
+    iter->Next();
+    ASSERT_EQ(values[6], iter->value().ToString());
+    ASSERT_LEVELDB_OK(iter->status());
+    delete iter;
+
+    if (pass == 0) {
+      Reopen(&options);
+    } else {
+      // Compactions rewrite the pointers, not the values.
+      dbfull()->CompactRange(nullptr, nullptr);
+      SizeOfFiles(kBlobFile, &count);
+      ASSERT_EQ(1, count);
+    }
+  }
+
+  // Repair keeps the blob files that the tables point into.
+  Close();
+  ASSERT_LEVELDB_OK(RepairDB(dbname_, options));
+  Reopen(&options);
+  ASSERT_EQ(values[99], Get(Key(99)));
+
+  // Values stay readable with the option turned off.
+  options.min_blob_size = 0;
+  Reopen(&options);
+  ASSERT_EQ(values[9], Get(Key(9)));
+}
+
+TEST_F(DBTest, BlobChecksums) {
+  Options options = CurrentOptions();
+  options.min_blob_size = 1000;
+  Reopen(&options);
+  ASSERT_LEVELDB_OK(Put("foo", std::string(10000, 'v')));
+  dbfull()->TEST_CompactMemTable();
+  Close();
+
+  // Corrupt the value in the blob file.
+  std::vector<std::string> filenames;
+  ASSERT_LEVELDB_OK(env_->GetChildren(dbname_, &filenames));
+  uint64_t number;
+  FileType type;
+  for (const std::string& filename : filenames) {
+    if (ParseFileName(filename, &number, &type) && type == kBlobFile) {
+      const std::string fname = dbname_ + "/" + filename;
+      std::string contents;
+      ASSERT_LEVELDB_OK(ReadFileToString(env_, fname, &contents));
+      contents[contents.size() - 1] ^= 1;
+      ASSERT_LEVELDB_OK(WriteStringToFile(env_, contents, fname));
+    }
+  }
+  Reopen(&options);
+
+  // Gets and iterators both follow ReadOptions::verify_checksums.
+  ReadOptions read_options;
+  std::string value;
+  ASSERT_LEVELDB_OK(db_->Get(read_options, "foo", &value));
+  Iterator* iter = db_->NewIterator(read_options);
+  iter->SeekToFirst();
+  ASSERT_TRUE(iter->Valid());
+  ASSERT_LEVELDB_OK(iter->status());
+  delete iter;
+
+  read_options.verify_checksums = true;
+  ASSERT_TRUE(db_->Get(read_options, "foo", &value).IsCorruption());
+  iter = db_->NewIterator(read_options);
+  iter->SeekToFirst();
+  ASSERT_FALSE(iter->Valid());
+  ASSERT_TRUE(iter->status().IsCorruption());
+  delete iter;
+}
+
+TEST_F(DBTest, BlobGarbageCollection) {
+  Options options = CurrentOptions();
+  options.min_blob_size = 1000;
+  options.blob_gc_ratio = 0.5;
+  Reopen(&options);
+
+  // Writes version "round" of keys [begin, end), compacts it down and
+  // returns the number of blob files.
+  auto write = [&](int begin, int end, int round) {
+    for (int i = begin; i < end; i++) {
+      EXPECT_LEVELDB_OK(Put(Key(i), std::string(2000, 'a' + round) + Key(i)));
+    }
+    dbfull()->TEST_CompactMemTable();
+    dbfull()->CompactRange(nullptr, nullptr);
+    int count;
+    SizeOfFiles(kBlobFile, &count);
+    return count;
+  };
+  auto check = [&](int begin, int end, int round) {
+    for (int i = begin; i < end; i++) {
+      ASSERT_EQ(std::string(2000, 'a' + round) + Key(i), Get(Key(i)));
+    }
+  };
+
+  ASSERT_EQ(1, write(0, 100, 0));
+  // Every value of the first blob file is overwritten, so that it goes.
+  ASSERT_EQ(1, write(0, 100, 1));
+  check(0, 100, 1);
+  // Half of the second one is garbage...
+  ASSERT_EQ(2, write(0, 50, 2));
+  // ...so that the next compaction through its values moves the rest.
+  ASSERT_EQ(3, write(99, 100, 3));
+  check(0, 50, 2);
+  check(50, 99, 1);
+  check(99, 100, 3);
+
+  Reopen(&options);
+  check(50, 99, 1);
+
+  // Tables dropped whole by a range deletion release their values too.
+  ASSERT_LEVELDB_OK(DeleteRange(Key(0), Key(100)));
+  dbfull()->TEST_CompactMemTable();
+  int count;
+  SizeOfFiles(kBlobFile, &count);
+  ASSERT_EQ(0, count);
+  ASSERT_EQ("NOT_FOUND", Get(Key(50)));
+}
+
+TEST_F(DBTest, OpenFilesOnStartup) {
+  env_->count_random_reads_ = true;
+  Options options = CurrentOptions();
+  options.env = env_;
+  Reopen(&options);
+  for (int i = 0; i < 3; i++) {
+    ASSERT_LEVELDB_OK(Put(Key(i), Key(i)));
+    dbfull()->TEST_CompactMemTable();
+  }
+
+  // A table opened on the read path also reads its footer and index.
+  Reopen(&options);
+  env_->random_read_counter_.Reset();
+  ASSERT_EQ(Key(0), Get(Key(0)));
+  ASSERT_GT(env_->random_read_counter_.Read(), 1);
+
+  // Opened ahead of time, only the data block is left to read.
+  options.open_files_on_startup = true;
+  options.max_file_opening_threads = 2;
+  Reopen(&options);
+  env_->random_read_counter_.Reset();
+  for (int i = 0; i < 3; i++) {
+    ASSERT_EQ(Key(i), Get(Key(i)));
+  }
+  ASSERT_EQ(3, env_->random_read_counter_.Read());
+
+  // A table file of the wrong length only fails a paranoid open.
+  Close();
+  std::vector<std::string> filenames;
+  ASSERT_LEVELDB_OK(env_->GetChildren(dbname_, &filenames));
+  uint64_t number;
+  FileType type;
+  for (const std::string& filename : filenames) {
+    if (ParseFileName(filename, &number, &type) && type == kTableFile) {
+      WritableFile* file;
+      ASSERT_LEVELDB_OK(
+          env_->NewAppendableFile(TableFileName(dbname_, number), &file));
+      ASSERT_LEVELDB_OK(file->Append("x"));
+      ASSERT_LEVELDB_OK(file->Close());
+      delete file;
+      break;
+    }
+  }
+  options.paranoid_checks = true;
+  ASSERT_TRUE(TryReopen(&options).IsCorruption());
+  options.paranoid_checks = false;
+  ASSERT_LEVELDB_OK(TryReopen(&options));
+  for (int i = 0; i < 3; i++) {
+    ASSERT_EQ(Key(i), Get(Key(i)));
+  }
+}
+
+TEST_F(DBTest, CompressionPerLevel) {
+  Options options = CurrentOptions();
+  ASSERT_EQ(options.compression, CompressionForLevel(options, 3));
+  options.compression_per_level = {kNoCompression, kZstdCompression};
+  ASSERT_EQ(kNoCompression, CompressionForLevel(options, 0));
+  ASSERT_EQ(kZstdCompression, CompressionForLevel(options, 1));
+  ASSERT_EQ(kZstdCompression, CompressionForLevel(options, 6));
+  Reopen(&options);
+
+  // Two overlapping flushes, so that compaction rewrites them.
+  Random rnd(301);
+  std::vector<std::string> values;
+  for (int i = 0; i < 100; i++) {
+    std::string value;
+    test::CompressibleString(&rnd, 0.25, 1000, &value);
+    values.push_back(value);
+    ASSERT_LEVELDB_OK(Put(Key(i), value));
+  }
+  dbfull()->TEST_CompactMemTable();
+  ASSERT_LEVELDB_OK(Put(Key(0), values[0]));
+  dbfull()->TEST_CompactMemTable();
+  ASSERT_GE(Size(Key(0), Key(100)), 100000);
+
+  db_->CompactRange(nullptr, nullptr);
+  ASSERT_EQ(0, NumTableFilesAtLevel(0));
+  std::string out;
+  if (port::Zstd_Compress(1, values[0].data(), values[0].size(), &out)) {
+    ASSERT_LT(Size(Key(0), Key(100)), 50000);
+  }
+  for (int i = 0; i < 100; i++) {
+    ASSERT_EQ(values[i], Get(Key(i)));
+  }
+}
+
+TEST_F(DBTest, PartitionedIndexAndFilters) {
+  env_->count_random_reads_ = true;
+  Options options = CurrentOptions();
+  options.env = env_;
+  options.filter_policy = NewBloomFilterPolicy(10);
+  options.partition_index_and_filters = true;
+  options.block_size = 256;
+  options.block_cache = NewLRUCache(1 << 20);
+  Reopen(&options);
+  const int kNumKeys = 2000;
+  for (int i = 0; i < kNumKeys; i++) {
+    ASSERT_LEVELDB_OK(Put(Key(i), Key(i)));
+  }
+  dbfull()->TEST_CompactMemTable();
+  Reopen(&options);
+
+  for (int i = 0; i < kNumKeys; i++) {
+    ASSERT_EQ(Key(i), Get(Key(i)));
+  }
+  // The filter partitions rule out missing keys before their data blocks
+  // are read.  Partitions of mmapped files are read again for every
+  // lookup rather than cached.
+  env_->random_read_counter_.Reset();
+  for (int i = 0; i < kNumKeys; i++) {
+    ASSERT_EQ("NOT_FOUND", Get(Key(i) + ".missing"));
+  }
+  ASSERT_LE(env_->random_read_counter_.Read(), 2 * kNumKeys + kNumKeys / 50);
+
+  Close();
+  delete options.block_cache;
+  delete options.filter_policy;
+}
+
+TEST_F(DBTest, IndexAndFilterBlocksInBlockCache) {
+  env_->copy_random_reads_ = true;
+  Options options = CurrentOptions();
+  options.env = env_;
+  options.filter_policy = NewBloomFilterPolicy(10);
+  options.block_cache = NewLRUCache(1 << 20, 0.5);
+  options.cache_index_and_filter_blocks = true;
+  Reopen(&options);
+  MakeTables(3, "a", "z");
+  ASSERT_EQ("1,1,1", FilesPerLevel());
+
+  // The index and filter blocks are charged to the block cache, and read
+  // back from the file once evicted.
+  Reopen(&options);
+  ASSERT_EQ("begin", Get("a"));
+  ASSERT_GT(options.block_cache->TotalCharge(), 0);
+  options.block_cache->Prune();
+  ASSERT_EQ(0, options.block_cache->TotalCharge());
+  ASSERT_EQ("end", Get("z"));
+  ASSERT_EQ("NOT_FOUND", Get("m"));
+
+  // Those of level-0 tables can be pinned there.
+  options.pin_l0_index_and_filter_blocks_in_cache = true;
+  Reopen(&options);
+  ASSERT_EQ("begin", Get("a"));
+  options.block_cache->Prune();
+  const size_t pinned = options.block_cache->TotalCharge();
+  ASSERT_GT(pinned, 0);
+  ASSERT_EQ("end", Get("z"));
+  ASSERT_EQ("NOT_FOUND", Get("m"));
+  options.block_cache->Prune();
+  ASSERT_EQ(pinned, options.block_cache->TotalCharge());
+
+  // Closing the tables unpins them.
+  Close();
+  options.block_cache->Prune();
+  ASSERT_EQ(0, options.block_cache->TotalCharge());
+  delete options.block_cache;
+  delete options.filter_policy;
+}
+
 // Multi-threaded test:
 namespace {
 
@@ -2060,6 +3185,10 @@ class ModelDB : public DB {
   Status Delete(const WriteOptions& o, const Slice& key) override {
     return DB::Delete(o, key);
   }
+  Status DeleteRange(const WriteOptions& o, const Slice& begin_key,
+                     const Slice& end_key) override {
+    return DB::DeleteRange(o, begin_key, end_key);
+  }
   Status Get(const ReadOptions& options, const Slice& key,
              std::string* value) override {
     assert(false);  // Not implemented
@@ -2093,6 +3222,12 @@ class ModelDB : public DB {
         (*map_)[key.ToString()] = value.ToString();
       }
       void Delete(const Slice& key) override { map_->erase(key.ToString()); }
+      void DeleteRange(const Slice& begin_key, const Slice& end_key) override {
+        if (begin_key.compare(end_key) < 0) {
+          map_->erase(map_->lower_bound(begin_key.ToString()),
+                      map_->lower_bound(end_key.ToString()));
+        }
+      }
     };
     Handler handler;
     handler.map_ = &map_;
@@ -2250,11 +3385,17 @@ TEST_F(DBTest, Randomized) {
         ASSERT_LEVELDB_OK(model.Put(WriteOptions(), k, v));
         ASSERT_LEVELDB_OK(db_->Put(WriteOptions(), k, v));
 
-      } else if (p < 90) {  // Delete
+      } else if (p < 88) {  // Delete
         k = RandomKey(&rnd);
         ASSERT_LEVELDB_OK(model.Delete(WriteOptions(), k));
         ASSERT_LEVELDB_OK(db_->Delete(WriteOptions(), k));
 
+      } else if (p < 90) {  // DeleteRange
+        k = RandomKey(&rnd);
+        v = RandomKey(&rnd);
+        ASSERT_LEVELDB_OK(model.DeleteRange(WriteOptions(), k, v));
+        ASSERT_LEVELDB_OK(db_->DeleteRange(WriteOptions(), k, v));
+
       } else {  // Multi-element batch
         WriteBatch b;
         const int num = rnd.Uniform(8);
@@ -33,6 +33,11 @@ static const int kL0_SlowdownWritesTrigger = 8;
 // Maximum number of level-0 files.  We stop writes at this point.
 static const int kL0_StopWritesTrigger = 12;
 
+// Soft limit on the number of bytes that compactions are behind (see
+// VersionSet::EstimatedPendingCompactionBytes).  We slow down writes
+// beyond this point, increasingly so as the backlog grows.
+static const int kPendingCompactionBytesSlowdown = 64 << 20;
+
 // Maximum level to which a new compacted memtable is pushed if it
 // does not create overlap.  We try to push to level 2 to avoid the
 // relatively expensive level 0=>1 compactions and to avoid some
@@ -41,6 +46,13 @@ static const int kL0_StopWritesTrigger = 12;
 // space if the same key space is being repeatedly overwritten.
 static const int kMaxMemCompactLevel = 2;
 
+// A file is compacted on its own, even if its level is within its size
+// limit, once at least this percentage of its entries are deletion
+// markers or range tombstones and it holds at least
+// kDeletionCompactionMinDeletions of them.
+static const int kDeletionCompactionPercent = 50;
+static const int kDeletionCompactionMinDeletions = 128;
+
 // Approximate gap in bytes between samples of data read during iteration.
 static const int kReadBytesPeriod = 1048576;
 
@@ -51,14 +63,28 @@ class InternalKey;
 // Value types encoded as the last component of internal keys.
 // DO NOT CHANGE THESE ENUM VALUES: they are embedded in the on-disk
 // data structures.
-enum ValueType { kTypeDeletion = 0x0, kTypeValue = 0x1 };
+//
+// kTypeRangeDeletion entries never appear among the point entries of a
+// memtable or table.  They are kept in a separate skiplist/meta block
+// whose keys are (start_key, sequence, kTypeRangeDeletion) and whose
+// values are the exclusive end key of the deleted range.
+//
+// kTypeBlobIndex entries are values that were moved to a blob file when
+// the memtable was written out.  Only tables hold them, and their values
+// are the encoded BlobIndex of the record in the blob file.
+enum ValueType {
+  kTypeDeletion = 0x0,
+  kTypeValue = 0x1,
+  kTypeRangeDeletion = 0x2,
+  kTypeBlobIndex = 0x3
+};
 // kValueTypeForSeek defines the ValueType that should be passed when
 // constructing a ParsedInternalKey object for seeking to a particular
 // sequence number (since we sort sequence numbers in decreasing order
 // and the value type is embedded as the low 8 bits in the sequence
 // number in internal keys, we need to use the highest-numbered
 // ValueType, not the lowest).
-static const ValueType kValueTypeForSeek = kTypeValue;
+static const ValueType kValueTypeForSeek = kTypeBlobIndex;
 
 typedef uint64_t SequenceNumber;
 
@@ -177,7 +203,7 @@ inline bool ParseInternalKey(const Slice& internal_key,
   result->sequence = num >> 8;
   result->type = static_cast<ValueType>(c);
   result->user_key = Slice(internal_key.data(), n - 8);
-  return (c <= static_cast<uint8_t>(kTypeValue));
+  return (c <= static_cast<uint8_t>(kTypeBlobIndex));
 }
 
 // A helper class useful for DBImpl::Get()
@@ -23,7 +23,7 @@ namespace leveldb {
 
 namespace {
 
-bool GuessType(const std::string& fname, FileType* type) {
+bool GuessType(const std::string& fname, uint64_t* number, FileType* type) {
   size_t pos = fname.rfind('/');
   std::string basename;
   if (pos == std::string::npos) {
@@ -31,8 +31,7 @@ bool GuessType(const std::string& fname, FileType* type) {
   } else {
     basename = std::string(fname.data() + pos + 1, fname.size() - pos - 1);
   }
-  uint64_t ignored;
-  return ParseFileName(basename, &ignored, type);
+  return ParseFileName(basename, number, type);
 }
 
 // Notified when log reader encounters corruption.
@@ -59,9 +58,13 @@ Status PrintLogContents(Env* env, const std::string& fname,
   if (!s.ok()) {
     return s;
   }
+  // Logs in the recyclable format are tagged with the number in their name.
+  uint64_t number = 0;
+  FileType type;
+  GuessType(fname, &number, &type);
   CorruptionReporter reporter;
   reporter.dst_ = dst;
-  log::Reader reader(file, &reporter, true, 0);
+  log::Reader reader(file, &reporter, true, 0, number);
   Slice record;
   std::string scratch;
   while (reader.ReadRecord(&record, &scratch)) {
@@ -88,6 +91,14 @@ class WriteBatchItemPrinter : public WriteBatch::Handler {
     r += "'\n";
     dst_->Append(r);
   }
+  void DeleteRange(const Slice& begin_key, const Slice& end_key) override {
+    std::string r = "  delrange '";
+    AppendEscapedStringTo(&r, begin_key);
+    r += "' .. '";
+    AppendEscapedStringTo(&r, end_key);
+    r += "'\n";
+    dst_->Append(r);
+  }
 
   WritableFile* dst_;
 };
@@ -189,6 +200,8 @@ Status DumpTable(Env* env, const std::string& fname, WritableFile* dst) {
         r += "del";
       } else if (key.type == kTypeValue) {
         r += "val";
+      } else if (key.type == kTypeBlobIndex) {
+        r += "blob";
       } else {
         AppendNumberTo(&r, key.type);
       }
@@ -212,8 +225,9 @@ Status DumpTable(Env* env, const std::string& fname, WritableFile* dst) {
 }  // namespace
 
 Status DumpFile(Env* env, const std::string& fname, WritableFile* dst) {
+  uint64_t number;
   FileType ftype;
-  if (!GuessType(fname, &ftype)) {
+  if (!GuessType(fname, &number, &ftype)) {
     return Status::InvalidArgument(fname + ": unknown file type");
   }
   switch (ftype) {
@@ -20,15 +20,35 @@ enum RecordType {
   // For fragments
   kFirstType = 2,
   kMiddleType = 3,
-  kLastType = 4
+  kLastType = 4,
+
+  // Switches the records that follow to the grouped format.  The payload
+  // is one byte holding the CompressionType of each group.
+  kSetCompressionType = 5,
+
+  // Variants of the types above for logs that may overwrite an older log
+  // file.  Their header also holds the log number, which tells records of
+  // this log from the leftovers of the older one.
+  kRecyclableFullType = 6,
+  kRecyclableFirstType = 7,
+  kRecyclableMiddleType = 8,
+  kRecyclableLastType = 9,
+  kRecyclableSetCompressionType = 10
 };
-static const int kMaxRecordType = kLastType;
+static const int kMaxRecordType = kRecyclableSetCompressionType;
+
+// Distance from each type to its recyclable variant.
+static const int kRecyclableTypeOffset = kRecyclableFullType - kFullType;
 
 static const int kBlockSize = 32768;
 
 // Header is checksum (4 bytes), length (2 bytes), type (1 byte).
 static const int kHeaderSize = 4 + 2 + 1;
 
+// Header of the recyclable types, which adds the low 32 bits of the log
+// number (4 bytes).
+static const int kRecyclableHeaderSize = kHeaderSize + 4;
+
 }  // namespace log
 }  // namespace leveldb
 
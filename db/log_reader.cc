@@ -7,6 +7,7 @@
 #include <cstdio>
 
 #include "leveldb/env.h"
+#include "port/port.h"
 #include "util/coding.h"
 #include "util/crc32c.h"
 
@@ -17,6 +18,10 @@ Reader::Reporter::~Reporter() = default;
 
 Reader::Reader(SequentialFile* file, Reporter* reporter, bool checksum,
                uint64_t initial_offset)
+    : Reader(file, reporter, checksum, initial_offset, 0) {}
+
+Reader::Reader(SequentialFile* file, Reporter* reporter, bool checksum,
+               uint64_t initial_offset, uint64_t log_number)
     : file_(file),
       reporter_(reporter),
       checksum_(checksum),
@@ -26,7 +31,11 @@ Reader::Reader(SequentialFile* file, Reporter* reporter, bool checksum,
       last_record_offset_(0),
       end_of_buffer_offset_(0),
       initial_offset_(initial_offset),
-      resyncing_(initial_offset > 0) {}
+      log_number_(static_cast<uint32_t>(log_number)),
+      recyclable_(false),
+      resyncing_(initial_offset > 0),
+      grouped_(false),
+      compression_(kNoCompression) {}
 
 Reader::~Reader() { delete[] backing_store_; }
 
@@ -54,6 +63,85 @@ bool Reader::SkipToInitialBlock() {
 }
 
 bool Reader::ReadRecord(Slice* record, std::string* scratch) {
+  while (true) {
+    if (!group_.empty()) {
+      if (GetLengthPrefixedSlice(&group_, record)) {
+        return true;
+      }
+      ReportCorruption(group_.size(), "bad record in group");
+      group_.clear();
+    }
+
+    Slice logical;
+    if (!ReadLogicalRecord(&logical, scratch)) {
+      return false;
+    }
+    if (!grouped_) {
+      *record = logical;
+      return true;
+    }
+    if (!LoadGroup(logical)) {
+      ReportCorruption(logical.size(), "corrupted compressed group");
+    }
+  }
+}
+
+bool Reader::LoadGroup(const Slice& record) {
+  switch (compression_) {
+    case kNoCompression:
+      group_buffer_.assign(record.data(), record.size());
+      break;
+
+    case kSnappyCompression: {
+      size_t ulength = 0;
+      if (!port::Snappy_GetUncompressedLength(record.data(), record.size(),
+                                              &ulength)) {
+        return false;
+      }
+      group_buffer_.resize(ulength);
+      if (!port::Snappy_Uncompress(record.data(), record.size(),
+                                   &group_buffer_[0])) {
+        return false;
+      }
+      break;
+    }
+
+    case kZstdCompression: {
+      size_t ulength = 0;
+      if (!port::Zstd_GetUncompressedLength(record.data(), record.size(),
+                                            &ulength)) {
+        return false;
+      }
+      group_buffer_.resize(ulength);
+      if (!port::Zstd_Uncompress(record.data(), record.size(),
+                                 &group_buffer_[0])) {
+        return false;
+      }
+      break;
+    }
+
+    case kLZ4Compression: {
+      size_t ulength = 0;
+      if (!port::LZ4_GetUncompressedLength(record.data(), record.size(),
+                                           &ulength)) {
+        return false;
+      }
+      group_buffer_.resize(ulength);
+      if (!port::LZ4_Uncompress(record.data(), record.size(),
+                                &group_buffer_[0])) {
+        return false;
+      }
+      break;
+    }
+
+    default:
+      return false;
+  }
+  group_ = Slice(group_buffer_);
+  return true;
+}
+
+bool Reader::ReadLogicalRecord(Slice* record, std::string* scratch) {
   if (last_record_offset_ < initial_offset_) {
     if (!SkipToInitialBlock()) {
       return false;
@@ -69,13 +157,15 @@ bool Reader::ReadRecord(Slice* record, std::string* scratch) {
 
   Slice fragment;
   while (true) {
-    const unsigned int record_type = ReadPhysicalRecord(&fragment);
+    int header_size;
+    const unsigned int record_type =
+        ReadPhysicalRecord(&fragment, &header_size);
 
     // ReadPhysicalRecord may have only had an empty trailer remaining in its
     // internal buffer. Calculate the offset of the next physical record now
     // that it has returned, properly accounting for its header size.
     uint64_t physical_record_offset =
-        end_of_buffer_offset_ - buffer_.size() - kHeaderSize - fragment.size();
+        end_of_buffer_offset_ - buffer_.size() - header_size - fragment.size();
 
     if (resyncing_) {
       if (record_type == kMiddleType) {
@@ -141,6 +231,24 @@ bool Reader::ReadRecord(Slice* record, std::string* scratch) {
         }
         break;
 
+      case kSetCompressionType:
+        if (in_fragmented_record) {
+          ReportCorruption(scratch->size(), "partial record without end(3)");
+          in_fragmented_record = false;
+          scratch->clear();
+        }
+        if (fragment.size() != 1 ||
+            (fragment[0] != kNoCompression &&
+             fragment[0] != kSnappyCompression &&
+             fragment[0] != kZstdCompression &&
+             fragment[0] != kLZ4Compression)) {
+          ReportCorruption(fragment.size(), "unknown log compression type");
+        } else {
+          grouped_ = true;
+          compression_ = static_cast<CompressionType>(fragment[0]);
+        }
+        break;
+
       case kEof:
         if (in_fragmented_record) {
           // This can be caused by the writer dying immediately after
@@ -186,7 +294,8 @@ void Reader::ReportDrop(uint64_t bytes, const Status& reason) {
   }
 }
 
-unsigned int Reader::ReadPhysicalRecord(Slice* result) {
+unsigned int Reader::ReadPhysicalRecord(Slice* result, int* header_size) {
+  *header_size = kHeaderSize;
   while (true) {
     if (buffer_.size() < kHeaderSize) {
       if (!eof_) {
@@ -217,11 +326,19 @@ unsigned int Reader::ReadPhysicalRecord(Slice* result) {
     const char* header = buffer_.data();
     const uint32_t a = static_cast<uint32_t>(header[4]) & 0xff;
     const uint32_t b = static_cast<uint32_t>(header[5]) & 0xff;
-    const unsigned int type = header[6];
+    unsigned int type = header[6];
     const uint32_t length = a | (b << 8);
-    if (kHeaderSize + length > buffer_.size()) {
+    const bool recyclable =
+        type >= kRecyclableFullType && type <= kRecyclableSetCompressionType;
+    *header_size = recyclable ? kRecyclableHeaderSize : kHeaderSize;
+    if (*header_size + length > buffer_.size()) {
       size_t drop_size = buffer_.size();
       buffer_.clear();
+      if (recyclable_) {
+        // Leftover of the log file this log overwrote.
+        eof_ = true;
+        return kEof;
+      }
       if (!eof_) {
         ReportCorruption(drop_size, "bad record length");
         return kBadRecord;
@@ -243,7 +360,8 @@ unsigned int Reader::ReadPhysicalRecord(Slice* result) {
     // Check crc
     if (checksum_) {
       uint32_t expected_crc = crc32c::Unmask(DecodeFixed32(header));
-      uint32_t actual_crc = crc32c::Value(header + 6, 1 + length);
+      uint32_t actual_crc =
+          crc32c::Value(header + 6, *header_size - 6 + length);
       if (actual_crc != expected_crc) {
         // Drop the rest of the buffer since "length" itself may have
         // been corrupted and if we trust it, we could find some
@@ -251,21 +369,37 @@ unsigned int Reader::ReadPhysicalRecord(Slice* result) {
         // like a valid log record.
         size_t drop_size = buffer_.size();
         buffer_.clear();
+        if (recyclable_) {
+          // Leftover of the log file this log overwrote.
+          eof_ = true;
+          return kEof;
+        }
         ReportCorruption(drop_size, "checksum mismatch");
         return kBadRecord;
       }
     }
 
-    buffer_.remove_prefix(kHeaderSize + length);
+    if (recyclable) {
+      if (DecodeFixed32(header + kHeaderSize) != log_number_) {
+        // Record of the log file this log overwrote.
+        buffer_.clear();
+        eof_ = true;
+        return kEof;
+      }
+      recyclable_ = true;
+      type -= kRecyclableTypeOffset;
+    }
+
+    buffer_.remove_prefix(*header_size + length);
 
     // Skip physical record that started before initial_offset_
-    if (end_of_buffer_offset_ - buffer_.size() - kHeaderSize - length <
+    if (end_of_buffer_offset_ - buffer_.size() - *header_size - length <
         initial_offset_) {
       result->clear();
       return kBadRecord;
     }
 
-    *result = Slice(header + kHeaderSize, length);
+    *result = Slice(header + *header_size, length);
     return type;
   }
 }
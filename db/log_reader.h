@@ -6,8 +6,10 @@
 #define STORAGE_LEVELDB_DB_LOG_READER_H_
 
 #include <cstdint>
+#include <string>
 
 #include "db/log_format.h"
+#include "leveldb/options.h"
 #include "leveldb/slice.h"
 #include "leveldb/status.h"
 
@@ -39,10 +41,19 @@ class Reader {
   // If "checksum" is true, verify checksums if available.
   //
   // The Reader will start reading at the first record located at physical
-  // position >= initial_offset within the file.
+  // position >= initial_offset within the file.  Grouped records (see
+  // log_format.md) are only recognized once the reader has seen the record
+  // that announces them, so logs written by a grouping Writer must be read
+  // from offset zero.
   Reader(SequentialFile* file, Reporter* reporter, bool checksum,
          uint64_t initial_offset);
 
+  // Like the above, but for a log that may be in the recyclable format
+  // (see log_format.md): records tagged with a log number other than
+  // "log_number" are the leftovers of an older log and end the log.
+  Reader(SequentialFile* file, Reporter* reporter, bool checksum,
+         uint64_t initial_offset, uint64_t log_number);
+
   Reader(const Reader&) = delete;
   Reader& operator=(const Reader&) = delete;
 
@@ -60,6 +71,14 @@ class Reader {
   // Undefined before the first call to ReadRecord.
   uint64_t LastRecordOffset();
 
+  // Returns true if the log switched to grouped records in the part read
+  // so far.
+  bool grouped() const { return grouped_; }
+
+  // Returns true if the part of the log read so far is in the recyclable
+  // format.
+  bool recyclable() const { return recyclable_; }
+
  private:
   // Extend record types with the following special values
   enum {
@@ -77,8 +96,17 @@ class Reader {
   // Returns true on success. Handles reporting.
   bool SkipToInitialBlock();
 
-  // Return type, or one of the preceding special values
-  unsigned int ReadPhysicalRecord(Slice* result);
+  // Read the next logical record, i.e. the next group if grouped_.
+  bool ReadLogicalRecord(Slice* record, std::string* scratch);
+
+  // Decompress the group "record" into group_buffer_.  Returns false if
+  // it is corrupted.
+  bool LoadGroup(const Slice& record);
+
+  // Return type, or one of the preceding special values.  Recyclable
+  // types are returned as the corresponding plain type.  Stores the size
+  // of the record's header in *header_size.
+  unsigned int ReadPhysicalRecord(Slice* result, int* header_size);
 
   // Reports dropped bytes to the reporter.
   // buffer_ must be updated to remove the dropped bytes prior to invocation.
@@ -100,10 +128,26 @@ class Reader {
   // Offset at which to start looking for the first record to return
   uint64_t const initial_offset_;
 
+  // Low 32 bits of the number of the log, as stored in recyclable records
+  uint32_t const log_number_;
+
+  // Set once a recyclable record has been read.  From then on a record
+  // that does not parse is taken to be where the log overwrote an older
+  // one, and ends the log without reporting a corruption.
+  bool recyclable_;
+
   // True if we are resynchronizing after a seek (initial_offset_ > 0). In
   // particular, a run of kMiddleType and kLastType records can be silently
   // skipped in this mode
   bool resyncing_;
+
+  // Set once a kSetCompressionType record has been read.  From then on
+  // each logical record is a group of length-prefixed records compressed
+  // with compression_.
+  bool grouped_;
+  CompressionType compression_;
+  std::string group_buffer_;
+  Slice group_;  // Records of the current group not yet returned
 };
 
 }  // namespace log
@@ -6,9 +6,11 @@
 #include "db/log_reader.h"
 #include "db/log_writer.h"
 #include "leveldb/env.h"
+#include "port/port.h"
 #include "util/coding.h"
 #include "util/crc32c.h"
 #include "util/random.h"
+#include "util/testutil.h"
 
 namespace leveldb {
 namespace log {
@@ -54,6 +56,47 @@ class LogTest : public testing::Test {
     writer_ = new Writer(&dest_, dest_.contents_.size());
   }
 
+  // Append further records with a writer that groups them.
+  void ReopenGrouped(CompressionType compression, size_t group_bytes) {
+    WriterOptions options;
+    options.group = true;
+    options.compression = compression;
+    options.group_bytes = group_bytes;
+    delete writer_;
+    writer_ = new Writer(&dest_, dest_.contents_.size(), options);
+  }
+
+  // Start writing log "log_number" in the recyclable format over the
+  // current contents, as if the file were recycled.
+  void RecycleAs(uint64_t log_number, bool group = false) {
+    WriterOptions options;
+    options.group = group;
+    options.recyclable = true;
+    options.log_number = log_number;
+    delete writer_;
+    old_contents_.swap(dest_.contents_);
+    dest_.contents_.clear();
+    writer_ = new Writer(&dest_, 0, options);
+  }
+
+  // Read the log as log "log_number".
+  void StartReadingLog(uint64_t log_number) {
+    if (dest_.contents_.size() < old_contents_.size()) {
+      // The tail of the recycled file keeps its old contents.
+      dest_.contents_.append(old_contents_, dest_.contents_.size(),
+                             std::string::npos);
+    }
+    delete reader_;
+    reader_ = new Reader(&source_, &report_, true /*checksum*/,
+                         0 /*initial_offset*/, log_number);
+  }
+
+  void FlushWriter() { ASSERT_LEVELDB_OK(writer_->Flush()); }
+
+  bool ReaderGrouped() const { return reader_->grouped(); }
+
+  bool ReaderRecyclable() const { return reader_->recyclable(); }
+
   void Write(const std::string& msg) {
     ASSERT_TRUE(!reading_) << "Write() after starting to read";
     writer_->AddRecord(Slice(msg));
@@ -228,6 +271,7 @@ class LogTest : public testing::Test {
   static int num_initial_offset_records_;
 
   StringDest dest_;
+  std::string old_contents_;  // Contents before RecycleAs()
   StringSource source_;
   ReportCollector report_;
   bool reading_;
@@ -554,5 +598,196 @@ TEST_F(LogTest, ReadEnd) { CheckOffsetPastEndReturnsNoRecords(0); }
 
 TEST_F(LogTest, ReadPastEnd) { CheckOffsetPastEndReturnsNoRecords(5); }
 
+TEST_F(LogTest, GroupedReadWrite) {
+  ReopenGrouped(kNoCompression, 100);
+  Write("foo");
+  Write("");
+  Write("bar");
+  ASSERT_EQ(0, WrittenBytes());  // Still buffered
+  FlushWriter();
+  // The format marker and a single record holding all three.
+  ASSERT_EQ((kHeaderSize + 1) + kHeaderSize + 9, WrittenBytes());
+  Write(BigString("x", 200));  // Over group_bytes: written at once
+  ASSERT_EQ((kHeaderSize + 1) + 2 * kHeaderSize + 9 + 202, WrittenBytes());
+  ASSERT_EQ("foo", Read());
+  ASSERT_TRUE(ReaderGrouped());
+  ASSERT_EQ("", Read());
+  ASSERT_EQ("bar", Read());
+  ASSERT_EQ(BigString("x", 200), Read());
+  ASSERT_EQ("EOF", Read());
+  ASSERT_EQ(0, DroppedBytes());
+}
+
+TEST_F(LogTest, GroupedRandomRead) {
+  ReopenGrouped(kNoCompression, 0);
+  const int N = 500;
+  Random write_rnd(301);
+  for (int i = 0; i < N; i++) {
+    Write(RandomSkewedString(i, &write_rnd));
+  }
+  Random read_rnd(301);
+  for (int i = 0; i < N; i++) {
+    ASSERT_EQ(RandomSkewedString(i, &read_rnd), Read());
+  }
+  ASSERT_EQ("EOF", Read());
+  ASSERT_EQ(0, DroppedBytes());
+}
+
+TEST_F(LogTest, CompressedGroups) {
+  ReopenGrouped(kSnappyCompression, kBlockSize);
+  const int N = 1000;
+  for (int i = 0; i < N; i++) {
+    Write(BigString(NumberString(i), 100));
+  }
+  FlushWriter();
+  std::string compressed;
+  if (port::Snappy_Compress("x", 1, &compressed)) {
+    ASSERT_LT(WrittenBytes(), N * 100 / 2);
+  } else {
+    // Groups are written uncompressed.
+    ASSERT_GT(WrittenBytes(), N * 100);
+  }
+  for (int i = 0; i < N; i++) {
+    ASSERT_EQ(BigString(NumberString(i), 100), Read());
+  }
+  ASSERT_EQ("EOF", Read());
+  ASSERT_EQ(0, DroppedBytes());
+}
+
+TEST_F(LogTest, AppendGroupsToOldLog) {
+  Write("hello");
+  ReopenGrouped(kSnappyCompression, 0);
+  Write("world");
+  ASSERT_EQ("hello", Read());
+  ASSERT_TRUE(!ReaderGrouped());
+  ASSERT_EQ("world", Read());
+  ASSERT_TRUE(ReaderGrouped());
+  ASSERT_EQ("EOF", Read());
+}
+
+TEST_F(LogTest, MarkerDoesNotFitTrailer) {
+  // Leave exactly a header's worth of space in the first block, which
+  // is too little for the format marker.
+  Write(BigString("foo", kBlockSize - 2 * kHeaderSize));
+  ASSERT_EQ(kBlockSize - kHeaderSize, WrittenBytes());
+  ReopenGrouped(kNoCompression, 0);
+  Write("bar");
+  ASSERT_EQ(kBlockSize + (kHeaderSize + 1) + kHeaderSize + 4, WrittenBytes());
+  ASSERT_EQ(BigString("foo", kBlockSize - 2 * kHeaderSize), Read());
+  ASSERT_EQ("bar", Read());
+  ASSERT_EQ("EOF", Read());
+  ASSERT_EQ(0, DroppedBytes());
+}
+
+TEST_F(LogTest, BadCompressionType) {
+  ReopenGrouped(kNoCompression, 0);
+  Write("foo");
+  SetByte(kHeaderSize, 100);
+  FixChecksum(0, 1);
+  // The group is then returned as a record of its own.
+  ASSERT_EQ(std::string("\x03" "foo", 4), Read());
+  ASSERT_TRUE(!ReaderGrouped());
+  ASSERT_EQ(1, DroppedBytes());
+  ASSERT_EQ("OK", MatchError("unknown log compression type"));
+}
+
+TEST_F(LogTest, RecyclableReadWrite) {
+  RecycleAs(7);
+  Write("foo");
+  ASSERT_EQ(kRecyclableHeaderSize + 3, WrittenBytes());
+  Write(BigString("bar", 100000));
+  Write("");
+  StartReadingLog(7);
+  ASSERT_EQ("foo", Read());
+  ASSERT_TRUE(ReaderRecyclable());
+  ASSERT_EQ(BigString("bar", 100000), Read());
+  ASSERT_EQ("", Read());
+  ASSERT_EQ("EOF", Read());
+  ASSERT_EQ(0, DroppedBytes());
+}
+
+TEST_F(LogTest, RecyclableMarginalTrailer) {
+  // Make a trailer that is exactly the same length as a recyclable header.
+  RecycleAs(7);
+  const int n = kBlockSize - 2 * kRecyclableHeaderSize;
+  Write(BigString("foo", n));
+  ASSERT_EQ(kBlockSize - kRecyclableHeaderSize, WrittenBytes());
+  Write("");
+  Write("bar");
+  StartReadingLog(7);
+  ASSERT_EQ(BigString("foo", n), Read());
+  ASSERT_EQ("", Read());
+  ASSERT_EQ("bar", Read());
+  ASSERT_EQ("EOF", Read());
+  ASSERT_EQ(0, DroppedBytes());
+}
+
+TEST_F(LogTest, RecycledLogEndsBeforeOldRecords) {
+  RecycleAs(7);
+  Random rnd(301);
+  for (int i = 0; i < 200; i++) {
+    Write(RandomSkewedString(i, &rnd));
+  }
+  RecycleAs(8);
+  for (int i = 0; i < 20; i++) {
+    Write(NumberString(i));
+  }
+  StartReadingLog(8);
+  for (int i = 0; i < 20; i++) {
+    ASSERT_EQ(NumberString(i), Read());
+  }
+  ASSERT_EQ("EOF", Read());
+  ASSERT_EQ(0, DroppedBytes());
+}
+
+TEST_F(LogTest, EmptyRecycledLog) {
+  RecycleAs(7);
+  Write("foo");
+  Write("bar");
+  RecycleAs(8);
+  StartReadingLog(8);
+  ASSERT_EQ("EOF", Read());
+  ASSERT_EQ(0, DroppedBytes());
+}
+
+TEST_F(LogTest, RecycledLogOverPartialRecord) {
+  // The new log ends in the middle of an old record.
+  RecycleAs(7);
+  Write(BigString("x", 1000));
+  RecycleAs(8);
+  Write(BigString("y", 500));
+  StartReadingLog(8);
+  ASSERT_EQ(BigString("y", 500), Read());
+  ASSERT_EQ("EOF", Read());
+  ASSERT_EQ(0, DroppedBytes());
+}
+
+TEST_F(LogTest, RecyclableGroups) {
+  RecycleAs(7);
+  Write(BigString("x", 1000));
+  RecycleAs(8, true /*group*/);
+  Write("foo");
+  Write("bar");
+  StartReadingLog(8);
+  ASSERT_EQ("foo", Read());
+  ASSERT_TRUE(ReaderGrouped());
+  ASSERT_EQ("bar", Read());
+  ASSERT_EQ("EOF", Read());
+  ASSERT_EQ(0, DroppedBytes());
+}
+
+TEST_F(LogTest, BadRecordInGroup) {
+  ReopenGrouped(kNoCompression, 0);
+  Write("foo");
+  Write("bar");
+  // Make the length of "foo" overrun the group.
+  const int group_offset = (kHeaderSize + 1) + kHeaderSize;
+  SetByte(group_offset, 10);
+  FixChecksum(kHeaderSize + 1, 4);
+  ASSERT_EQ("bar", Read());
+  ASSERT_EQ("EOF", Read());
+  ASSERT_EQ("OK", MatchError("bad record in group"));
+}
+
 }  // namespace log
 }  // namespace leveldb
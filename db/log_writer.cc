@@ -7,12 +7,16 @@
 #include <cstdint>
 
 #include "leveldb/env.h"
+#include "port/port.h"
 #include "util/coding.h"
 #include "util/crc32c.h"
 
 namespace leveldb {
 namespace log {
 
+// Zeroes that fill the trailer of a block.
+static const char kTrailer[kRecyclableHeaderSize] = {0};
+
 static void InitTypeCrc(uint32_t* type_crc) {
   for (int i = 0; i <= kMaxRecordType; i++) {
     char t = static_cast<char>(i);
@@ -20,18 +24,106 @@ static void InitTypeCrc(uint32_t* type_crc) {
   }
 }
 
-Writer::Writer(WritableFile* dest) : dest_(dest), block_offset_(0) {
-  InitTypeCrc(type_crc_);
-}
+Writer::Writer(WritableFile* dest) : Writer(dest, 0) {}
 
 Writer::Writer(WritableFile* dest, uint64_t dest_length)
-    : dest_(dest), block_offset_(dest_length % kBlockSize) {
+    : Writer(dest, dest_length, WriterOptions()) {}
+
+Writer::Writer(WritableFile* dest, uint64_t dest_length,
+               const WriterOptions& options)
+    : dest_(dest),
+      block_offset_(dest_length % kBlockSize),
+      options_(options),
+      header_size_(options.recyclable ? kRecyclableHeaderSize : kHeaderSize),
+      announced_(false),
+      announced_type_(kNoCompression) {
   InitTypeCrc(type_crc_);
 }
 
 Writer::~Writer() = default;
 
 Status Writer::AddRecord(const Slice& slice) {
+  if (!options_.group) {
+    Status s = EmitRecord(slice);
+    if (s.ok()) {
+      s = dest_->Flush();
+    }
+    return s;
+  }
+  PutLengthPrefixedSlice(&pending_, slice);
+  if (pending_.size() >= options_.group_bytes) {
+    return Flush();
+  }
+  return Status::OK();
+}
+
+Status Writer::Flush() {
+  if (pending_.empty()) {
+    return Status::OK();
+  }
+
+  Slice group(pending_);
+  CompressionType type = options_.compression;
+  bool ok = false;
+  switch (type) {
+    case kNoCompression:
+      break;
+
+    case kSnappyCompression:
+      ok = port::Snappy_Compress(pending_.data(), pending_.size(),
+                                 &compressed_);
+      break;
+
+    case kZstdCompression:
+      ok = port::Zstd_Compress(options_.zstd_compression_level,
+                               pending_.data(), pending_.size(), &compressed_);
+      break;
+
+    case kLZ4Compression:
+      ok = port::LZ4_Compress(pending_.data(), pending_.size(), &compressed_);
+      break;
+  }
+  // Keep the group uncompressed if compression is not supported or if it
+  // saves less than 12.5%, as in table/table_builder.cc.
+  if (ok && compressed_.size() < pending_.size() - (pending_.size() / 8u)) {
+    group = compressed_;
+  } else {
+    type = kNoCompression;
+  }
+
+  Status s;
+  if (!announced_ || type != announced_type_) {
+    s = EmitCompressionType(type);
+    announced_ = true;
+    announced_type_ = type;
+  }
+  if (s.ok()) {
+    s = EmitRecord(group);
+  }
+  if (s.ok()) {
+    s = dest_->Flush();
+  }
+  pending_.clear();
+  return s;
+}
+
+Status Writer::EmitCompressionType(CompressionType type) {
+  const char payload = static_cast<char>(type);
+  const int leftover = kBlockSize - block_offset_;
+  if (leftover < header_size_ + 1) {
+    // Switch to a new block rather than splitting the marker
+    if (leftover > 0) {
+      Status s = dest_->Append(Slice(kTrailer, leftover));
+      if (!s.ok()) {
+        return s;
+      }
+    }
+    block_offset_ = 0;
+  }
+  return EmitPhysicalRecord(kSetCompressionType, &payload, 1);
+}
+
+Status Writer::EmitRecord(const Slice& slice) {
   const char* ptr = slice.data();
   size_t left = slice.size();
 
@@ -43,20 +135,19 @@ Status Writer::AddRecord(const Slice& slice) {
   do {
     const int leftover = kBlockSize - block_offset_;
     assert(leftover >= 0);
-    if (leftover < kHeaderSize) {
+    if (leftover < header_size_) {
       // Switch to a new block
       if (leftover > 0) {
-        // Fill the trailer (literal below relies on kHeaderSize being 7)
-        static_assert(kHeaderSize == 7, "");
-        dest_->Append(Slice("\x00\x00\x00\x00\x00\x00", leftover));
+        // Fill the trailer
+        dest_->Append(Slice(kTrailer, leftover));
       }
       block_offset_ = 0;
     }
 
-    // Invariant: we never leave < kHeaderSize bytes in a block.
-    assert(kBlockSize - block_offset_ - kHeaderSize >= 0);
+    // Invariant: we never leave < header_size_ bytes in a block.
+    assert(kBlockSize - block_offset_ - header_size_ >= 0);
 
-    const size_t avail = kBlockSize - block_offset_ - kHeaderSize;
+    const size_t avail = kBlockSize - block_offset_ - header_size_;
     const size_t fragment_length = (left < avail) ? left : avail;
 
     RecordType type;
@@ -82,28 +173,33 @@ Status Writer::AddRecord(const Slice& slice) {
 Status Writer::EmitPhysicalRecord(RecordType t, const char* ptr,
                                   size_t length) {
   assert(length <= 0xffff);  // Must fit in two bytes
-  assert(block_offset_ + kHeaderSize + length <= kBlockSize);
+  assert(block_offset_ + header_size_ + length <= kBlockSize);
 
   // Format the header
-  char buf[kHeaderSize];
+  char buf[kRecyclableHeaderSize];
   buf[4] = static_cast<char>(length & 0xff);
   buf[5] = static_cast<char>(length >> 8);
+  if (options_.recyclable) {
+    t = static_cast<RecordType>(t + kRecyclableTypeOffset);
+    EncodeFixed32(buf + kHeaderSize,
+                  static_cast<uint32_t>(options_.log_number));
+  }
   buf[6] = static_cast<char>(t);
 
-  // Compute the crc of the record type and the payload.
-  uint32_t crc = crc32c::Extend(type_crc_[t], ptr, length);
+  // Compute the crc of the record type, the log number if present, and
+  // the payload.
+  uint32_t crc = crc32c::Extend(type_crc_[t], buf + kHeaderSize,
+                                header_size_ - kHeaderSize);
+  crc = crc32c::Extend(crc, ptr, length);
   crc = crc32c::Mask(crc);  // Adjust for storage
   EncodeFixed32(buf, crc);
 
   // Write the header and the payload
-  Status s = dest_->Append(Slice(buf, kHeaderSize));
+  Status s = dest_->Append(Slice(buf, header_size_));
   if (s.ok()) {
     s = dest_->Append(Slice(ptr, length));
-    if (s.ok()) {
-      s = dest_->Flush();
-    }
   }
-  block_offset_ += kHeaderSize + length;
+  block_offset_ += header_size_ + length;
   return s;
 }
 
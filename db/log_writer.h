@@ -6,8 +6,10 @@
 #define STORAGE_LEVELDB_DB_LOG_WRITER_H_
 
 #include <cstdint>
+#include <string>
 
 #include "db/log_format.h"
+#include "leveldb/options.h"
 #include "leveldb/slice.h"
 #include "leveldb/status.h"
 
@@ -17,6 +19,25 @@ class WritableFile;
 
 namespace log {
 
+// Optional features of the log format (see log_format.md).
+struct WriterOptions {
+  // If true, pack records into groups and compress each group with
+  // "compression" before writing it as a single logical record.  Records
+  // are buffered until at least "group_bytes" bytes of them are pending
+  // or Flush() is called; zero writes every record out as its own group.
+  // Falls back to writing uncompressed groups if "compression" is not
+  // supported.  "zstd_compression_level" applies to kZstdCompression.
+  bool group = false;
+  CompressionType compression = kNoCompression;
+  int zstd_compression_level = 1;
+  size_t group_bytes = 0;
+
+  // If true, write records in the recyclable format, tagged with
+  // "log_number", so that the log may overwrite an older log file.
+  bool recyclable = false;
+  uint64_t log_number = 0;
+};
+
 class Writer {
  public:
   // Create a writer that will append data to "*dest".
@@ -29,19 +50,43 @@ class Writer {
   // "*dest" must remain live while this Writer is in use.
   Writer(WritableFile* dest, uint64_t dest_length);
 
+  // Create a writer that will append data to "*dest" in the format
+  // selected by "options".
+  // "*dest" must have initial length "dest_length".
+  // "*dest" must remain live while this Writer is in use.
+  Writer(WritableFile* dest, uint64_t dest_length,
+         const WriterOptions& options);
+
   Writer(const Writer&) = delete;
   Writer& operator=(const Writer&) = delete;
 
   ~Writer();
 
+  // Add a record to the log.  Records that are still buffered are lost
+  // if the process crashes; call Flush() to write them out.
   Status AddRecord(const Slice& slice);
 
+  // Write out the records buffered by AddRecord(), if any, and flush
+  // "*dest".  On error the buffered records are dropped and "*dest" may
+  // hold part of them, so the log should not be written to again.
+  Status Flush();
+
  private:
+  // Fragment "slice" into physical records of the standard types.
+  Status EmitRecord(const Slice& slice);
+  Status EmitCompressionType(CompressionType type);
   Status EmitPhysicalRecord(RecordType type, const char* ptr, size_t length);
 
   WritableFile* dest_;
   int block_offset_;  // Current offset in block
 
+  const WriterOptions options_;
+  const int header_size_;  // Size of the header of each physical record
+  bool announced_;                  // Has a group format been written?
+  CompressionType announced_type_;  // Format of the last written group
+  std::string pending_;             // Length-prefixed buffered records
+  std::string compressed_;
+
   // crc32c values for all supported record types.  These are
   // pre-computed to reduce the overhead of computing the crc of the
   // record type stored in the header.
@@ -3,11 +3,21 @@
 // found in the LICENSE file. See the AUTHORS file for names of contributors.
 
 #include "db/memtable.h"
+
+#include <algorithm>
+#include <memory>
+#include <utility>
+#include <vector>
+
 #include "db/dbformat.h"
 #include "leveldb/comparator.h"
 #include "leveldb/env.h"
 #include "leveldb/iterator.h"
+#include "port/port.h"
+#include "port/thread_annotations.h"
 #include "util/coding.h"
+#include "util/hash.h"
+#include "util/mutexlock.h"
 
 namespace leveldb {
 
@@ -18,13 +28,130 @@ static Slice GetLengthPrefixedSlice(const char* data) {
   return Slice(p, len);
 }
 
-MemTable::MemTable(const InternalKeyComparator& comparator)
-    : comparator_(comparator), refs_(0), table_(comparator_, &arena_) {}
+// A hash table over the user keys of a memtable's entries.  Each bucket
+// is a linked list sorted by internal key, so a lookup needs to compare
+// only against the few entries that share its bucket.  Like the skiplist,
+// it supports one writer concurrently with any number of readers.
+//
+// A sorted view of all entries, used by iterators, is built on demand and
+// reused until the next insertion.
+class MemTable::HashIndex {
+ public:
+  typedef std::shared_ptr<const std::vector<const char*>> SortedEntries;
+
+  HashIndex(const KeyComparator& cmp, Arena* arena, size_t num_buckets)
+      : compare_(cmp), arena_(arena), num_buckets_(num_buckets), size_(0) {
+    char* mem = arena_->AllocateAligned(sizeof(std::atomic<Node*>) *
+                                        num_buckets_);
+    buckets_ = reinterpret_cast<std::atomic<Node*>*>(mem);
+    for (size_t i = 0; i < num_buckets_; i++) {
+      new (&buckets_[i]) std::atomic<Node*>(nullptr);
+    }
+  }
+
+  HashIndex(const HashIndex&) = delete;
+  HashIndex& operator=(const HashIndex&) = delete;
+
+  // REQUIRES: External synchronization between writers.
+  void Insert(const char* entry) {
+    std::atomic<Node*>* link = Bucket(EntryUserKey(entry));
+    Node* next = link->load(std::memory_order_relaxed);
+    while (next != nullptr && compare_(next->entry, entry) < 0) {
+      link = &next->next;
+      next = link->load(std::memory_order_relaxed);
+    }
+    char* mem = arena_->AllocateAligned(sizeof(Node));
+    Node* node = new (mem) Node(entry, next);
+    // Publish the fully initialized node to concurrent readers.
+    link->store(node, std::memory_order_release);
+    size_.fetch_add(1, std::memory_order_release);
+  }
+
+  // Returns the first entry at or after "memkey" among the entries that
+  // share its bucket, or nullptr if there is none.  The caller must check
+  // that the entry has the expected user key.
+  const char* Seek(const char* memkey) const {
+    Node* node = Bucket(EntryUserKey(memkey))->load(std::memory_order_acquire);
+    while (node != nullptr && compare_(node->entry, memkey) < 0) {
+      node = node->next.load(std::memory_order_acquire);
+    }
+    return node == nullptr ? nullptr : node->entry;
+  }
+
+  // Returns all entries in sorted order.
+  SortedEntries Sorted() {
+    MutexLock l(&mu_);
+    const size_t size = size_.load(std::memory_order_acquire);
+    if (sorted_ == nullptr || sorted_->size() != size) {
+      std::vector<const char*>* entries = new std::vector<const char*>;
+      entries->reserve(size);
+      for (size_t i = 0; i < num_buckets_; i++) {
+        Node* node = buckets_[i].load(std::memory_order_acquire);
+        while (node != nullptr) {
+          entries->push_back(node->entry);
+          node = node->next.load(std::memory_order_acquire);
+        }
+      }
+      const KeyComparator& compare = compare_;
+      std::sort(entries->begin(), entries->end(),
+                [&compare](const char* a, const char* b) {
+                  return compare(a, b) < 0;
+                });
+      sorted_.reset(entries);
+    }
+    return sorted_;
+  }
+
+ private:
+  struct Node {
+    Node(const char* e, Node* n) : entry(e), next(n) {}
+
+    const char* const entry;
+    std::atomic<Node*> next;
+  };
+
+  static Slice EntryUserKey(const char* entry) {
+    return ExtractUserKey(GetLengthPrefixedSlice(entry));
+  }
+
+  std::atomic<Node*>* Bucket(const Slice& user_key) const {
+    return &buckets_[Hash(user_key.data(), user_key.size(), 0x6d656d74) %
+                     num_buckets_];
+  }
+
+  const KeyComparator compare_;
+  Arena* const arena_;
+  const size_t num_buckets_;
+  std::atomic<Node*>* buckets_;  // Allocated from *arena_
+  std::atomic<size_t> size_;     // Number of entries inserted
 
-MemTable::~MemTable() { assert(refs_ == 0); }
+  port::Mutex mu_;
+  SortedEntries sorted_ GUARDED_BY(mu_);
+};
+
+MemTable::MemTable(const InternalKeyComparator& comparator,
+                   ArenaRegionPool* region_pool, size_t hash_buckets)
+    : comparator_(comparator),
+      refs_(0),
+      arena_(region_pool),
+      table_(comparator_, &arena_),
+      hash_index_(hash_buckets == 0
+                      ? nullptr
+                      : new HashIndex(comparator_, &arena_, hash_buckets)),
+      range_del_table_(comparator_, &arena_),
+      has_range_deletions_(false) {}
+
+MemTable::~MemTable() {
+  assert(refs_ == 0);
+  delete hash_index_;
+}
 
 size_t MemTable::ApproximateMemoryUsage() { return arena_.MemoryUsage(); }
 
+MemTable::KeyComparator::KeyComparator(const InternalKeyComparator& c)
+    : comparator(c),
+      bytewise(c.user_comparator() == BytewiseComparator()) {}
+
 int MemTable::KeyComparator::operator()(const char* aptr,
                                         const char* bptr) const {
   // Internal keys are encoded as length-prefixed strings.
@@ -33,6 +160,20 @@ int MemTable::KeyComparator::operator()(const char* aptr,
   return comparator.Compare(a, b);
 }
 
+uint64_t MemTable::KeyComparator::Prefix(const char* entry) const {
+  if (!bytewise) {
+    return 0;
+  }
+  Slice user_key = ExtractUserKey(GetLengthPrefixedSlice(entry));
+  const size_t n = user_key.size() < 8 ? user_key.size() : 8;
+  uint64_t result = 0;
+  for (size_t i = 0; i < n; i++) {
+    result |= static_cast<uint64_t>(static_cast<uint8_t>(user_key[i]))
+              << (56 - 8 * i);
+  }
+  return result;
+}
+
 // Encode a suitable internal key target for "target" and return it.
 // Uses *scratch as scratch space, and the returned pointer will point
 // into this scratch space.
@@ -71,7 +212,73 @@ class MemTableIterator : public Iterator {
   std::string tmp_;  // For passing to EncodeKey
 };
 
-Iterator* MemTable::NewIterator() { return new MemTableIterator(&table_); }
+// Iterates over a sorted snapshot of the entries of a hash-indexed
+// memtable.
+class MemTableVectorIterator : public Iterator {
+ public:
+  MemTableVectorIterator(const MemTable::KeyComparator& compare,
+                         MemTable::HashIndex::SortedEntries entries)
+      : compare_(compare),
+        entries_(std::move(entries)),
+        index_(entries_->size()) {}
+
+  MemTableVectorIterator(const MemTableVectorIterator&) = delete;
+  MemTableVectorIterator& operator=(const MemTableVectorIterator&) = delete;
+
+  ~MemTableVectorIterator() override = default;
+
+  bool Valid() const override { return index_ < entries_->size(); }
+  void Seek(const Slice& k) override {
+    const char* target = EncodeKey(&tmp_, k);
+    const MemTable::KeyComparator& compare = compare_;
+    index_ = std::lower_bound(entries_->begin(), entries_->end(), target,
+                              [&compare](const char* a, const char* b) {
+                                return compare(a, b) < 0;
+                              }) -
+             entries_->begin();
+  }
+  void SeekToFirst() override { index_ = 0; }
+  void SeekToLast() override {
+    index_ = entries_->empty() ? 0 : entries_->size() - 1;
+  }
+  void Next() override {
+    assert(Valid());
+    index_++;
+  }
+  void Prev() override {
+    assert(Valid());
+    index_ = (index_ == 0) ? entries_->size() : index_ - 1;
+  }
+  Slice key() const override {
+    return GetLengthPrefixedSlice((*entries_)[index_]);
+  }
+  Slice value() const override {
+    Slice key_slice = GetLengthPrefixedSlice((*entries_)[index_]);
+    return GetLengthPrefixedSlice(key_slice.data() + key_slice.size());
+  }
+
+  Status status() const override { return Status::OK(); }
+
+ private:
+  const MemTable::KeyComparator& compare_;
+  const MemTable::HashIndex::SortedEntries entries_;
+  size_t index_;  // entries_->size() if not valid
+  std::string tmp_;  // For passing to EncodeKey
+};
+
+Iterator* MemTable::NewIterator() {
+  if (hash_index_ != nullptr) {
+    return new MemTableVectorIterator(comparator_, hash_index_->Sorted());
+  }
+  return new MemTableIterator(&table_);
+}
+
+Iterator* MemTable::NewRangeTombstoneIterator() {
+  if (!has_range_deletions_.load(std::memory_order_acquire)) {
+    return nullptr;
+  }
+  return new MemTableIterator(&range_del_table_);
+}
 
 void MemTable::Add(SequenceNumber s, ValueType type, const Slice& key,
                    const Slice& value) {
@@ -96,14 +303,74 @@ void MemTable::Add(SequenceNumber s, ValueType type, const Slice& key,
   p = EncodeVarint32(p, val_size);
   std::memcpy(p, value.data(), val_size);
   assert(p + val_size == buf + encoded_len);
-  table_.Insert(buf);
+  if (type == kTypeRangeDeletion) {
+    range_del_table_.Insert(buf);
+    has_range_deletions_.store(true, std::memory_order_release);
+  } else if (hash_index_ != nullptr) {
+    hash_index_->Insert(buf);
+  } else {
+    table_.Insert(buf);
+  }
+}
+
+SequenceNumber MemTable::MaxCoveringTombstone(const Slice& user_key,
+                                              SequenceNumber snapshot) {
+  // Range tombstones are rare and ordered by start key, so a scan up to
+  // the first tombstone starting after "user_key" is cheap.
+  const Comparator* ucmp = comparator_.comparator.user_comparator();
+  SequenceNumber result = 0;
+  Table::Iterator iter(&range_del_table_);
+  for (iter.SeekToFirst(); iter.Valid(); iter.Next()) {
+    Slice ikey = GetLengthPrefixedSlice(iter.key());
+    Slice start = ExtractUserKey(ikey);
+    if (ucmp->Compare(start, user_key) > 0) {
+      break;
+    }
+    const SequenceNumber seq =
+        DecodeFixed64(ikey.data() + ikey.size() - 8) >> 8;
+    if (seq > snapshot || seq <= result) {
+      continue;
+    }
+    Slice end = GetLengthPrefixedSlice(ikey.data() + ikey.size());
+    if (ucmp->Compare(user_key, end) < 0) {
+      result = seq;
+    }
+  }
+  return result;
 }
 
 bool MemTable::Get(const LookupKey& key, std::string* value, Status* s) {
+  Slice v;
+  Status status;
+  if (!Get(key, &v, &status)) {
+    return false;
+  }
+  if (status.ok()) {
+    value->assign(v.data(), v.size());
+  } else {
+    *s = status;
+  }
+  return true;
+}
+
+bool MemTable::Get(const LookupKey& key, Slice* value, Status* s) {
+  SequenceNumber covering = 0;
+  if (has_range_deletions_.load(std::memory_order_acquire)) {
+    const Slice internal_key = key.internal_key();
+    covering = MaxCoveringTombstone(
+        key.user_key(),
+        DecodeFixed64(internal_key.data() + internal_key.size() - 8) >> 8);
+  }
   Slice memkey = key.memtable_key();
-  Table::Iterator iter(&table_);
-  iter.Seek(memkey.data());
-  if (iter.Valid()) {
+  const char* entry;
+  if (hash_index_ != nullptr) {
+    entry = hash_index_->Seek(memkey.data());
+  } else {
+    Table::Iterator iter(&table_);
+    iter.Seek(memkey.data());
+    entry = iter.Valid() ? iter.key() : nullptr;
+  }
+  if (entry != nullptr) {
     // entry format is:
     //    klength  varint32
     //    userkey  char[klength]
@@ -113,25 +380,37 @@ bool MemTable::Get(const LookupKey& key, std::string* value, Status* s) {
     // Check that it belongs to same user key.  We do not check the
     // sequence number since the Seek() call above should have skipped
     // all entries with overly large sequence numbers.
-    const char* entry = iter.key();
     uint32_t key_length;
     const char* key_ptr = GetVarint32Ptr(entry, entry + 5, &key_length);
     if (comparator_.comparator.user_comparator()->Compare(
             Slice(key_ptr, key_length - 8), key.user_key()) == 0) {
       // Correct user key
       const uint64_t tag = DecodeFixed64(key_ptr + key_length - 8);
+      if ((tag >> 8) < covering) {
+        *s = Status::NotFound(Slice());
+        return true;
+      }
       switch (static_cast<ValueType>(tag & 0xff)) {
-        case kTypeValue: {
-          Slice v = GetLengthPrefixedSlice(key_ptr + key_length);
-          value->assign(v.data(), v.size());
+        case kTypeValue:
+          *value = GetLengthPrefixedSlice(key_ptr + key_length);
           return true;
-        }
         case kTypeDeletion:
           *s = Status::NotFound(Slice());
           return true;
+        case kTypeRangeDeletion:
+          // Stored in range_del_table_, never with the other entries.
+          break;
+        case kTypeBlobIndex:
+          // Only tables refer to blob files; memtables hold the values.
+          break;
       }
     }
   }
+  if (covering > 0) {
+    // Everything older than this memtable is older than the tombstone.
+    *s = Status::NotFound(Slice());
+    return true;
+  }
   return false;
 }
 
@@ -5,6 +5,7 @@
 #ifndef STORAGE_LEVELDB_DB_MEMTABLE_H_
 #define STORAGE_LEVELDB_DB_MEMTABLE_H_
 
+#include <atomic>
 #include <string>
 
 #include "db/dbformat.h"
@@ -21,7 +22,16 @@ class MemTable {
  public:
   // MemTables are reference counted.  The initial reference count
   // is zero and the caller must call Ref() at least once.
-  explicit MemTable(const InternalKeyComparator& comparator);
+  //
+  // If "region_pool" is non-null, memory is carved out of one of its
+  // regions first.  "*region_pool" must outlive the memtable.
+  //
+  // If "hash_buckets" is non-zero, entries are indexed by a hash table
+  // over user keys with that many buckets instead of a skiplist (see
+  // kHashMemTable).  Iterators then sort the entries when created.
+  explicit MemTable(const InternalKeyComparator& comparator,
+                    ArenaRegionPool* region_pool = nullptr,
+                    size_t hash_buckets = 0);
 
   MemTable(const MemTable&) = delete;
   MemTable& operator=(const MemTable&) = delete;
@@ -50,36 +60,65 @@ class MemTable {
   // db/format.{h,cc} module.
   Iterator* NewIterator();
 
+  // Return an iterator over the range tombstones added to this memtable,
+  // or nullptr if there are none.  Keys are internal keys whose user key
+  // is the start of the deleted range; values are the (exclusive) end keys.
+  // The same lifetime rules as NewIterator() apply.
+  Iterator* NewRangeTombstoneIterator();
+
   // Add an entry into memtable that maps key to value at the
   // specified sequence number and with the specified type.
-  // Typically value will be empty if type==kTypeDeletion.
+  // Typically value will be empty if type==kTypeDeletion.  For
+  // type==kTypeRangeDeletion, "key" is the start of the deleted range and
+  // "value" its exclusive end.
   void Add(SequenceNumber seq, ValueType type, const Slice& key,
            const Slice& value);
 
   // If memtable contains a value for key, store it in *value and return true.
-  // If memtable contains a deletion for key, store a NotFound() error
+  // If memtable contains a deletion for key, or a range tombstone that
+  // covers key and is newer than any value for it, store a NotFound() error
   // in *status and return true.
   // Else, return false.
   bool Get(const LookupKey& key, std::string* value, Status* s);
 
+  // Like Get() above, but *value refers to the value in the memtable,
+  // which stays live until the memtable is deleted.
+  bool Get(const LookupKey& key, Slice* value, Status* s);
+
  private:
   friend class MemTableIterator;
   friend class MemTableBackwardIterator;
+  friend class MemTableVectorIterator;
+
+  class HashIndex;
 
   struct KeyComparator {
     const InternalKeyComparator comparator;
-    explicit KeyComparator(const InternalKeyComparator& c) : comparator(c) {}
+    const bool bytewise;  // Whether user keys are ordered by BytewiseComparator
+    explicit KeyComparator(const InternalKeyComparator& c);
     int operator()(const char* a, const char* b) const;
+
+    // The first 8 bytes of the user key, big-endian and zero-padded, if
+    // user keys are ordered byte-wise.  Otherwise 0.
+    uint64_t Prefix(const char* entry) const;
   };
 
   typedef SkipList<const char*, KeyComparator> Table;
 
   ~MemTable();  // Private since only Unref() should be used to delete it
 
+  // Returns the largest sequence number <= "snapshot" of a range tombstone
+  // covering "user_key", or 0 if there is none.
+  SequenceNumber MaxCoveringTombstone(const Slice& user_key,
+                                      SequenceNumber snapshot);
+
   KeyComparator comparator_;
   int refs_;
   Arena arena_;
-  Table table_;
+  Table table_;            // Unused if hash_index_ != nullptr
+  HashIndex* hash_index_;  // Indexes entries instead of table_, if non-null
+  Table range_del_table_;  // Range tombstones, shares arena_ with table_
+  std::atomic<bool> has_range_deletions_;
 };
 
 }  // namespace leveldb
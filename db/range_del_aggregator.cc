@@ -0,0 +1,231 @@
+// Copyright (c) 2011 The LevelDB Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file. See the AUTHORS file for names of contributors.
+
+#include "db/range_del_aggregator.h"
+
+#include <algorithm>
+#include <functional>
+#include <queue>
+#include <set>
+#include <utility>
+
+#include "leveldb/comparator.h"
+#include "leveldb/iterator.h"
+
+namespace leveldb {
+
+// Appends the tombstones yielded by "iter" to *tombstones, skipping empty
+// ranges.  Takes ownership of "iter", which may be nullptr.  Returns the
+// first error encountered.
+static Status ReadTombstones(const Comparator* ucmp, Iterator* iter,
+                             std::vector<RangeTombstone>* tombstones) {
+  if (iter == nullptr) {
+    return Status::OK();
+  }
+  Status s;
+  for (iter->SeekToFirst(); iter->Valid(); iter->Next()) {
+    ParsedInternalKey parsed;
+    if (!ParseInternalKey(iter->key(), &parsed) ||
+        parsed.type != kTypeRangeDeletion) {
+      if (s.ok()) {
+        s = Status::Corruption("bad range tombstone");
+      }
+      continue;
+    }
+    if (ucmp->Compare(parsed.user_key, iter->value()) >= 0) {
+      continue;  // Empty range
+    }
+    RangeTombstone t;
+    t.start_key = parsed.user_key.ToString();
+    t.end_key = iter->value().ToString();
+    t.seq = parsed.sequence;
+    tombstones->push_back(std::move(t));
+  }
+  if (s.ok()) {
+    s = iter->status();
+  }
+  delete iter;
+  return s;
+}
+
+// Splits the ranges of "tombstones" at every start and end key.  Calls
+// emit(start, end, active) in key order for each run of user keys
+// [start, end) that is covered by some of them, where "active" holds the
+// sequence numbers of the tombstones covering the run.
+template <typename Emit>
+static void SplitTombstones(const Comparator* ucmp,
+                            std::vector<const RangeTombstone*> tombstones,
+                            Emit emit) {
+  if (tombstones.empty()) {
+    return;
+  }
+  std::vector<std::string> bounds;
+  for (const RangeTombstone* t : tombstones) {
+    bounds.push_back(t->start_key);
+    bounds.push_back(t->end_key);
+  }
+
+  auto less = [ucmp](const std::string& a, const std::string& b) {
+    return ucmp->Compare(a, b) < 0;
+  };
+  std::sort(bounds.begin(), bounds.end(), less);
+  bounds.erase(std::unique(bounds.begin(), bounds.end(),
+                           [ucmp](const std::string& a, const std::string& b) {
+                             return ucmp->Compare(a, b) == 0;
+                           }),
+               bounds.end());
+  std::sort(tombstones.begin(), tombstones.end(),
+            [ucmp](const RangeTombstone* a, const RangeTombstone* b) {
+              return ucmp->Compare(a->start_key, b->start_key) < 0;
+            });
+
+  // Sweep the boundaries left to right, tracking the sequence numbers of
+  // the tombstones active in [bounds[i], bounds[i+1]).
+  typedef std::pair<size_t, SequenceNumber> EndAndSeq;
+  std::priority_queue<EndAndSeq, std::vector<EndAndSeq>,
+                      std::greater<EndAndSeq>>
+      ends;
+  std::multiset<SequenceNumber> active;
+  size_t next = 0;
+  for (size_t i = 0; i + 1 < bounds.size(); i++) {
+    while (next < tombstones.size() &&
+           ucmp->Compare(tombstones[next]->start_key, bounds[i]) <= 0) {
+      const size_t end_index =
+          std::lower_bound(bounds.begin(), bounds.end(),
+                           tombstones[next]->end_key, less) -
+          bounds.begin();
+      ends.push(std::make_pair(end_index, tombstones[next]->seq));
+      active.insert(tombstones[next]->seq);
+      next++;
+    }
+    while (!ends.empty() && ends.top().first <= i) {
+      active.erase(active.find(ends.top().second));
+      ends.pop();
+    }
+    if (!active.empty()) {
+      emit(bounds[i], bounds[i + 1], active);
+    }
+  }
+}
+
+RangeTombstoneList::RangeTombstoneList(const Comparator* user_comparator,
+                                       Iterator* iter)
+    : ucmp_(user_comparator) {
+  status_ = ReadTombstones(ucmp_, iter, &tombstones_);
+  std::vector<const RangeTombstone*> all;
+  for (const RangeTombstone& t : tombstones_) {
+    all.push_back(&t);
+  }
+  SplitTombstones(ucmp_, all,
+                  [this](const std::string& start, const std::string& end,
+                         const std::multiset<SequenceNumber>& active) {
+                    Fragment f;
+                    f.start = start;
+                    f.end = end;
+                    f.seqs.assign(active.rbegin(), active.rend());
+                    fragments_.push_back(std::move(f));
+                  });
+}
+
+RangeTombstoneList::~RangeTombstoneList() = default;
+
+SequenceNumber RangeTombstoneList::MaxCoveringSeq(
+    const Slice& user_key, SequenceNumber upper_bound) const {
+  // Find the last fragment whose start is <= user_key.
+  auto iter = std::upper_bound(
+      fragments_.begin(), fragments_.end(), user_key,
+      [this](const Slice& key, const Fragment& f) {
+        return ucmp_->Compare(key, f.start) < 0;
+      });
+  if (iter == fragments_.begin()) {
+    return 0;
+  }
+  --iter;
+  if (ucmp_->Compare(user_key, iter->end) >= 0) {
+    return 0;
+  }
+  for (SequenceNumber seq : iter->seqs) {
+    if (seq <= upper_bound) {
+      return seq;
+    }
+  }
+  return 0;
+}
+
+RangeDelAggregator::RangeDelAggregator(const Comparator* user_comparator,
+                                       SequenceNumber upper_bound)
+    : ucmp_(user_comparator),
+      upper_bound_(upper_bound),
+      fragments_valid_(true) {}
+
+RangeDelAggregator::~RangeDelAggregator() = default;
+
+void RangeDelAggregator::AddTombstones(Iterator* iter) {
+  const size_t old_size = tombstones_.size();
+  Status s = ReadTombstones(ucmp_, iter, &tombstones_);
+  if (status_.ok()) {
+    status_ = s;
+  }
+  if (tombstones_.size() != old_size) {
+    fragments_valid_ = false;
+  }
+}
+
+void RangeDelAggregator::AddTombstones(const RangeTombstoneList& list) {
+  if (status_.ok()) {
+    status_ = list.status();
+  }
+  if (!list.tombstones().empty()) {
+    tombstones_.insert(tombstones_.end(), list.tombstones().begin(),
+                       list.tombstones().end());
+    fragments_valid_ = false;
+  }
+}
+
+void RangeDelAggregator::BuildFragments() {
+  fragments_.clear();
+  fragments_valid_ = true;
+
+  std::vector<const RangeTombstone*> visible;
+  for (const RangeTombstone& t : tombstones_) {
+    if (t.seq <= upper_bound_) {
+      visible.push_back(&t);
+    }
+  }
+  SplitTombstones(
+      ucmp_, visible,
+      [this](const std::string& start, const std::string& end,
+             const std::multiset<SequenceNumber>& active) {
+        const SequenceNumber seq = *active.rbegin();
+        if (!fragments_.empty() && fragments_.back().seq == seq &&
+            ucmp_->Compare(fragments_.back().end, start) == 0) {
+          fragments_.back().end = end;
+        } else {
+          Fragment f;
+          f.start = start;
+          f.end = end;
+          f.seq = seq;
+          fragments_.push_back(std::move(f));
+        }
+      });
+}
+
+SequenceNumber RangeDelAggregator::MaxCoveringSeq(const Slice& user_key) {
+  if (!fragments_valid_) {
+    BuildFragments();
+  }
+  // Find the last fragment whose start is <= user_key.
+  auto iter = std::upper_bound(
+      fragments_.begin(), fragments_.end(), user_key,
+      [this](const Slice& key, const Fragment& f) {
+        return ucmp_->Compare(key, f.start) < 0;
+      });
+  if (iter == fragments_.begin()) {
+    return 0;
+  }
+  --iter;
+  return ucmp_->Compare(user_key, iter->end) < 0 ? iter->seq : 0;
+}
+
+}  // namespace leveldb
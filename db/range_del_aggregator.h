@@ -0,0 +1,131 @@
+// Copyright (c) 2011 The LevelDB Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file. See the AUTHORS file for names of contributors.
+
+#ifndef STORAGE_LEVELDB_DB_RANGE_DEL_AGGREGATOR_H_
+#define STORAGE_LEVELDB_DB_RANGE_DEL_AGGREGATOR_H_
+
+#include <string>
+#include <vector>
+
+#include "db/dbformat.h"
+#include "leveldb/status.h"
+
+namespace leveldb {
+
+class Comparator;
+class Iterator;
+
+// A deletion of every user key in [start_key, end_key) that was written
+// before sequence number "seq".
+struct RangeTombstone {
+  std::string start_key;
+  std::string end_key;
+  SequenceNumber seq;
+};
+
+// The range tombstones of a table, read once when the table is opened and
+// shared by all lookups in it.
+//
+// Thread-safe: immutable once constructed.
+class RangeTombstoneList {
+ public:
+  // Read the tombstones yielded by "iter" (see
+  // RangeDelAggregator::AddTombstones).  Takes ownership of "iter".
+  RangeTombstoneList(const Comparator* user_comparator, Iterator* iter);
+
+  RangeTombstoneList(const RangeTombstoneList&) = delete;
+  RangeTombstoneList& operator=(const RangeTombstoneList&) = delete;
+
+  ~RangeTombstoneList();
+
+  // Returns the first error encountered reading the tombstones.
+  Status status() const { return status_; }
+
+  // Returns the largest sequence number <= upper_bound of a tombstone
+  // covering "user_key", or 0 if there is none.
+  SequenceNumber MaxCoveringSeq(const Slice& user_key,
+                                SequenceNumber upper_bound) const;
+
+  const std::vector<RangeTombstone>& tombstones() const { return tombstones_; }
+
+ private:
+  // A maximal run of user keys [start, end) covered by the same set of
+  // tombstones, whose sequence numbers "seqs" holds in decreasing order.
+  struct Fragment {
+    std::string start;
+    std::string end;
+    std::vector<SequenceNumber> seqs;
+  };
+
+  const Comparator* const ucmp_;
+  Status status_;
+  std::vector<RangeTombstone> tombstones_;
+  std::vector<Fragment> fragments_;  // Sorted by start, non-overlapping
+};
+
+// Collects the range tombstones of a set of memtables and tables and
+// answers "is this entry covered by a newer tombstone" queries.
+//
+// Only tombstones with a sequence number <= "upper_bound" participate in
+// coverage queries; all tombstones are still returned by tombstones().
+//
+// Not thread-safe: the lookup structure is built lazily on first query.
+class RangeDelAggregator {
+ public:
+  RangeDelAggregator(const Comparator* user_comparator,
+                     SequenceNumber upper_bound);
+
+  RangeDelAggregator(const RangeDelAggregator&) = delete;
+  RangeDelAggregator& operator=(const RangeDelAggregator&) = delete;
+
+  ~RangeDelAggregator();
+
+  // Add the tombstones yielded by "iter", whose keys are internal keys
+  // (start_key, seq, kTypeRangeDeletion) and whose values are end keys.
+  // Takes ownership of "iter", which may be nullptr.
+  void AddTombstones(Iterator* iter);
+
+  // Add the tombstones of a table.
+  void AddTombstones(const RangeTombstoneList& list);
+
+  // Returns the first error encountered by AddTombstones().
+  Status status() const { return status_; }
+
+  // Returns true iff no tombstones have been added.
+  bool empty() const { return tombstones_.empty(); }
+
+  // Returns the largest sequence number <= upper_bound of a tombstone
+  // covering "user_key", or 0 if there is none.
+  SequenceNumber MaxCoveringSeq(const Slice& user_key);
+
+  // Returns true iff "key" is deleted by a newer tombstone.
+  bool ShouldDelete(const ParsedInternalKey& key) {
+    return key.sequence < MaxCoveringSeq(key.user_key);
+  }
+
+  // All tombstones added so far, in insertion order.
+  const std::vector<RangeTombstone>& tombstones() const { return tombstones_; }
+
+ private:
+  // A maximal run of user keys [start, end) covered by the same set of
+  // visible tombstones.  "seq" is the largest sequence among them.
+  struct Fragment {
+    std::string start;
+    std::string end;
+    SequenceNumber seq;
+  };
+
+  void BuildFragments();
+
+  const Comparator* const ucmp_;
+  const SequenceNumber upper_bound_;
+  Status status_;
+  std::vector<RangeTombstone> tombstones_;
+  bool fragments_valid_;
+  std::vector<Fragment> fragments_;  // Sorted by start, non-overlapping
+};
+
+}  // namespace leveldb
+
+#endif  // STORAGE_LEVELDB_DB_RANGE_DEL_AGGREGATOR_H_
@@ -0,0 +1,127 @@
+// Copyright (c) 2011 The LevelDB Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file. See the AUTHORS file for names of contributors.
+
+#include "db/range_del_aggregator.h"
+
+#include "db/memtable.h"
+#include "gtest/gtest.h"
+#include "leveldb/comparator.h"
+#include "leveldb/iterator.h"
+
+namespace leveldb {
+
+class RangeDelAggregatorTest : public testing::Test {
+ public:
+  RangeDelAggregatorTest()
+      : icmp_(BytewiseComparator()), mem_(new MemTable(icmp_)) {
+    mem_->Ref();
+  }
+
+  ~RangeDelAggregatorTest() { mem_->Unref(); }
+
+  void Add(const char* start, const char* end, SequenceNumber seq) {
+    mem_->Add(seq, kTypeRangeDeletion, start, end);
+  }
+
+  SequenceNumber Covering(const char* key, SequenceNumber upper_bound) {
+    RangeDelAggregator agg(BytewiseComparator(), upper_bound);
+    agg.AddTombstones(mem_->NewRangeTombstoneIterator());
+    EXPECT_TRUE(agg.status().ok());
+    return agg.MaxCoveringSeq(key);
+  }
+
+  InternalKeyComparator icmp_;
+  MemTable* mem_;
+};
+
+TEST_F(RangeDelAggregatorTest, Empty) {
+  ASSERT_TRUE(mem_->NewRangeTombstoneIterator() == nullptr);
+  RangeDelAggregator agg(BytewiseComparator(), kMaxSequenceNumber);
+  agg.AddTombstones(nullptr);
+  ASSERT_TRUE(agg.empty());
+  ASSERT_EQ(0, agg.MaxCoveringSeq("a"));
+}
+
+TEST_F(RangeDelAggregatorTest, SingleTombstone) {
+  Add("b", "d", 10);
+  ASSERT_EQ(0, Covering("a", kMaxSequenceNumber));
+  ASSERT_EQ(10, Covering("b", kMaxSequenceNumber));
+  ASSERT_EQ(10, Covering("c", kMaxSequenceNumber));
+  ASSERT_EQ(0, Covering("d", kMaxSequenceNumber));  // end is exclusive
+  ASSERT_EQ(0, Covering("c", 9));                   // invisible to snapshot
+}
+
+TEST_F(RangeDelAggregatorTest, Overlapping) {
+  Add("a", "e", 5);
+  Add("c", "g", 8);
+  Add("d", "f", 3);
+  Add("x", "x", 100);  // empty range is ignored
+  ASSERT_EQ(5, Covering("b", kMaxSequenceNumber));
+  ASSERT_EQ(8, Covering("c", kMaxSequenceNumber));
+  ASSERT_EQ(8, Covering("e", kMaxSequenceNumber));
+  ASSERT_EQ(0, Covering("g", kMaxSequenceNumber));
+  ASSERT_EQ(0, Covering("x", kMaxSequenceNumber));
+  ASSERT_EQ(5, Covering("c", 7));
+  ASSERT_EQ(3, Covering("e", 4));
+  ASSERT_EQ(0, Covering("e", 2));
+}
+
+TEST_F(RangeDelAggregatorTest, ShouldDelete) {
+  Add("k", "m", 20);
+  RangeDelAggregator agg(BytewiseComparator(), kMaxSequenceNumber);
+  agg.AddTombstones(mem_->NewRangeTombstoneIterator());
+  ASSERT_EQ(1, agg.tombstones().size());
+  ASSERT_TRUE(agg.ShouldDelete(ParsedInternalKey("k", 19, kTypeValue)));
+  ASSERT_FALSE(agg.ShouldDelete(ParsedInternalKey("k", 21, kTypeValue)));
+  ASSERT_FALSE(agg.ShouldDelete(ParsedInternalKey("m", 1, kTypeValue)));
+}
+
+TEST_F(RangeDelAggregatorTest, List) {
+  Add("a", "e", 5);
+  Add("c", "g", 8);
+  Add("d", "f", 3);
+  Add("x", "x", 100);  // empty range is ignored
+  RangeTombstoneList list(BytewiseComparator(),
+                          mem_->NewRangeTombstoneIterator());
+  ASSERT_TRUE(list.status().ok());
+  ASSERT_EQ(3, list.tombstones().size());
+  ASSERT_EQ(5, list.MaxCoveringSeq("b", kMaxSequenceNumber));
+  ASSERT_EQ(8, list.MaxCoveringSeq("e", kMaxSequenceNumber));
+  ASSERT_EQ(0, list.MaxCoveringSeq("g", kMaxSequenceNumber));
+  ASSERT_EQ(0, list.MaxCoveringSeq("x", kMaxSequenceNumber));
+  ASSERT_EQ(5, list.MaxCoveringSeq("c", 7));
+  ASSERT_EQ(3, list.MaxCoveringSeq("e", 4));
+  ASSERT_EQ(0, list.MaxCoveringSeq("e", 2));
+
+  // Aggregators take the tombstones of a list as they are.
+  RangeDelAggregator agg(BytewiseComparator(), 4);
+  agg.AddTombstones(list);
+  ASSERT_TRUE(agg.status().ok());
+  ASSERT_EQ(3, agg.tombstones().size());
+  ASSERT_EQ(3, agg.MaxCoveringSeq("e"));
+  ASSERT_EQ(0, agg.MaxCoveringSeq("f"));
+}
+
+TEST_F(RangeDelAggregatorTest, MemTableGet) {
+  mem_->Add(1, kTypeValue, "b", "v1");
+  mem_->Add(2, kTypeValue, "c", "v2");
+  Add("a", "c", 3);
+  mem_->Add(4, kTypeValue, "a", "v4");
+
+  std::string value;
+  Status s;
+  ASSERT_TRUE(mem_->Get(LookupKey("a", 10), &value, &s));
+  ASSERT_TRUE(s.ok());
+  ASSERT_EQ("v4", value);
+  ASSERT_TRUE(mem_->Get(LookupKey("b", 10), &value, &s));
+  ASSERT_TRUE(s.IsNotFound());
+  s = Status::OK();
+  ASSERT_TRUE(mem_->Get(LookupKey("b", 2), &value, &s));
+  ASSERT_TRUE(s.ok());
+  ASSERT_EQ("v1", value);
+  ASSERT_TRUE(mem_->Get(LookupKey("c", 10), &value, &s));
+  ASSERT_EQ("v2", value);
+}
+
+}  // namespace leveldb
@@ -276,6 +276,34 @@ TEST_F(RecoveryTest, MultipleMemTables) {
   }
 }
 
+TEST_F(RecoveryTest, OverwritesAcrossMemTables) {
+  // Overwrite every key several times in a large log.
+  const int kNum = 1000;
+  const int kRounds = 5;
+  for (int round = 0; round < kRounds; round++) {
+    for (int i = 0; i < kNum; i++) {
+      char key[100];
+      std::snprintf(key, sizeof(key), "%050d", i);
+      ASSERT_LEVELDB_OK(Put(key, std::string(100, 'a' + round)));
+    }
+  }
+  Close();
+  ASSERT_EQ(0, NumTables());
+  ASSERT_EQ(1, NumLogs());
+
+  // Recover into many memtables.  The newest value of each key must win
+  // even though the memtables are written out while the log is replayed.
+  Options opt;
+  opt.write_buffer_size = kNum * 150 / 2;
+  Open(&opt);
+  ASSERT_LE(2, NumTables());
+  for (int i = 0; i < kNum; i++) {
+    char key[100];
+    std::snprintf(key, sizeof(key), "%050d", i);
+    ASSERT_EQ(std::string(100, 'a' + kRounds - 1), Get(key));
+  }
+}
+
 TEST_F(RecoveryTest, MultipleLogFiles) {
   ASSERT_LEVELDB_OK(Put("foo", "bar"));
   Close();
@@ -14,6 +14,8 @@
 //        all tables (see 2c)
 //      - compaction pointers are cleared
 //      - every table file is added at level 0
+//      - every blob file that some table points into is added, holding
+//        the values the tables point to
 //
 // Possible optimization 1:
 //   (a) Compute total size and use to pick appropriate max-level M
@@ -24,6 +26,10 @@
 //   Store per-table metadata (smallest, largest, largest-seq#, ...)
 //   in the table's meta section to speed up ScanTable.
 
+#include <map>
+#include <set>
+
+#include "db/blob_file.h"
 #include "db/builder.h"
 #include "db/db_impl.h"
 #include "db/dbformat.h"
@@ -93,6 +99,8 @@ class Repairer {
   struct TableInfo {
     FileMetaData meta;
     SequenceNumber max_sequence;
+    // The values the table points to, by blob file number
+    std::map<uint64_t, BlobFileMetaData> blobs;
   };
 
   Status FindFiles() {
@@ -119,6 +127,8 @@ class Repairer {
             logs_.push_back(number);
           } else if (type == kTableFile) {
             table_numbers_.push_back(number);
+          } else if (type == kBlobFile) {
+            blob_numbers_.insert(number);
           } else {
             // Ignore other files
           }
@@ -171,7 +181,7 @@ class Repairer {
     // propagating bad information (like overly large sequence
     // numbers).
     log::Reader reader(lfile, &reporter, false /*do not checksum*/,
-                       0 /*initial_offset*/);
+                       0 /*initial_offset*/, log);
 
     // Read all the records and add to a memtable
     std::string scratch;
@@ -203,8 +213,11 @@ class Repairer {
     FileMetaData meta;
     meta.number = next_file_number_++;
     Iterator* iter = mem->NewIterator();
-    status = BuildTable(dbname_, env_, options_, table_cache_, iter, &meta);
+    Iterator* range_del_iter = mem->NewRangeTombstoneIterator();
+    status = BuildTable(dbname_, env_, options_, table_cache_, iter,
+                        range_del_iter, &meta);
     delete iter;
+    delete range_del_iter;
     mem->Unref();
     mem = nullptr;
     if (status.ok()) {
@@ -273,14 +286,56 @@ class Repairer {
         t.meta.smallest.DecodeFrom(key);
       }
       t.meta.largest.DecodeFrom(key);
+      if (parsed.type == kTypeDeletion) {
+        t.meta.num_deletions++;
+      }
+      if (parsed.type == kTypeBlobIndex) {
+        BlobIndex index;
+        if (index.DecodeFrom(iter->value())) {
+          BlobFileMetaData* blob = &t.blobs[index.file_number];
+          blob->number = index.file_number;
+          blob->total_count++;
+          blob->total_bytes += index.RecordSize();
+        }
+      }
       if (parsed.sequence > t.max_sequence) {
         t.max_sequence = parsed.sequence;
       }
     }
+    t.meta.num_entries = counter;
     if (!iter->status().ok()) {
       status = iter->status();
     }
     delete iter;
+
+    // Range tombstones extend the key range claimed by the table.
+    Iterator* range_iter = table_cache_->NewRangeTombstoneIterator(
+        t.meta.number, t.meta.file_size);
+    if (range_iter != nullptr) {
+      for (range_iter->SeekToFirst(); range_iter->Valid(); range_iter->Next()) {
+        Slice key = range_iter->key();
+        if (!ParseInternalKey(key, &parsed)) {
+          continue;
+        }
+        InternalKey sentinel(range_iter->value(), kMaxSequenceNumber,
+                             kTypeRangeDeletion);
+        if (empty || icmp_.Compare(key, t.meta.smallest.Encode()) < 0) {
+          t.meta.smallest.DecodeFrom(key);
+        }
+        if (empty || icmp_.Compare(sentinel, t.meta.largest) > 0) {
+          t.meta.largest = sentinel;
+        }
+        empty = false;
+        t.meta.num_range_deletions++;
+        if (parsed.sequence > t.max_sequence) {
+          t.max_sequence = parsed.sequence;
+        }
+      }
+      if (status.ok() && !range_iter->status().ok()) {
+        status = range_iter->status();
+      }
+      delete range_iter;
+    }
     Log(options_.info_log, "Table #%llu: %d entries %s",
         (unsigned long long)t.meta.number, counter, status.ToString().c_str());
 
@@ -302,7 +357,10 @@ class Repairer {
     if (!s.ok()) {
       return;
     }
-    TableBuilder* builder = new TableBuilder(options_, file);
+    // Every repaired table is placed in level-0.
+    Options table_options = options_;
+    table_options.compression = CompressionForLevel(options_, 0);
+    TableBuilder* builder = new TableBuilder(table_options, file);
 
     // Copy data.
     Iterator* iter = NewTableIterator(t.meta);
@@ -312,6 +370,15 @@ class Repairer {
       counter++;
     }
     delete iter;
+    iter = table_cache_->NewRangeTombstoneIterator(t.meta.number,
+                                                   t.meta.file_size);
+    if (iter != nullptr) {
+      for (iter->SeekToFirst(); iter->Valid(); iter->Next()) {
+        builder->AddRangeTombstone(iter->key(), iter->value());
+        counter++;
+      }
+      delete iter;
+    }
 
     ArchiveFile(src);
     if (counter == 0) {
@@ -365,11 +432,25 @@ class Repairer {
     edit_.SetNextFile(next_file_number_);
     edit_.SetLastSequence(max_sequence);
 
+    std::map<uint64_t, BlobFileMetaData> blobs;
     for (size_t i = 0; i < tables_.size(); i++) {
       // TODO(opt): separate out into multiple levels
       const TableInfo& t = tables_[i];
-      edit_.AddFile(0, t.meta.number, t.meta.file_size, t.meta.smallest,
-                    t.meta.largest);
+      edit_.AddFile(0, t.meta);
+      for (const auto& blob_kvp : t.blobs) {
+        BlobFileMetaData* blob = &blobs[blob_kvp.first];
+        blob->number = blob_kvp.first;
+        blob->total_count += blob_kvp.second.total_count;
+        blob->total_bytes += blob_kvp.second.total_bytes;
+      }
+    }
+    for (const auto& blob_kvp : blobs) {
+      if (blob_numbers_.count(blob_kvp.first) > 0) {
+        edit_.AddBlobFile(blob_kvp.second);
+      } else {
+        Log(options_.info_log, "Blob file #%llu: missing",
+            (unsigned long long)blob_kvp.first);
+      }
     }
 
     // std::fprintf(stderr,
@@ -437,6 +518,7 @@ class Repairer {
 
   std::vector<std::string> manifests_;
   std::vector<uint64_t> table_numbers_;
+  std::set<uint64_t> blob_numbers_;
   std::vector<uint64_t> logs_;
   std::vector<TableInfo> tables_;
   uint64_t next_file_number_;
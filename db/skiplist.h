@@ -29,13 +29,25 @@
 
 #include <atomic>
 #include <cassert>
+#include <cstdint>
 #include <cstdlib>
 
+#include "port/port.h"
 #include "util/arena.h"
 #include "util/random.h"
 
 namespace leveldb {
 
+// "Comparator" must provide two const methods:
+//
+//   int operator()(const Key& a, const Key& b);  // <0, 0, >0 like memcmp
+//   uint64_t Prefix(const Key& k);
+//
+// Prefix() summarizes a key in a way that preserves its order: whenever
+// Prefix(a) < Prefix(b), "a" must sort before "b".  The summary is cached
+// in every node, so most comparisons made while searching the list do not
+// touch the key itself.  A comparator with no cheap summary may return a
+// constant.
 template <typename Key, class Comparator>
 class SkipList {
  private:
@@ -103,12 +115,13 @@ class SkipList {
     return max_height_.load(std::memory_order_relaxed);
   }
 
-  Node* NewNode(const Key& key, int height);
+  Node* NewNode(const Key& key, uint64_t prefix, int height);
   int RandomHeight();
   bool Equal(const Key& a, const Key& b) const { return (compare_(a, b) == 0); }
 
-  // Return true if key is greater than the data stored in "n"
-  bool KeyIsAfterNode(const Key& key, Node* n) const;
+  // Return true if key, whose prefix is "prefix", is greater than the data
+  // stored in "n"
+  bool KeyIsAfterNode(const Key& key, uint64_t prefix, Node* n) const;
 
   // Return the earliest node that comes at or after key.
   // Return nullptr if there is no such node.
@@ -142,8 +155,11 @@ class SkipList {
 // Implementation details follow
 template <typename Key, class Comparator>
 struct SkipList<Key, Comparator>::Node {
-  explicit Node(const Key& k) : key(k) {}
+  Node(const Key& k, uint64_t p) : prefix(p), key(k) {}
 
+  // Searches read the prefix, the key and the links in that order, so
+  // keep them adjacent.
+  uint64_t const prefix;
   Key const key;
 
   // Accessors/mutators for links.  Wrapped in methods so we can
@@ -178,10 +194,10 @@ struct SkipList<Key, Comparator>::Node {
 
 template <typename Key, class Comparator>
 typename SkipList<Key, Comparator>::Node* SkipList<Key, Comparator>::NewNode(
-    const Key& key, int height) {
+    const Key& key, uint64_t prefix, int height) {
   char* const node_memory = arena_->AllocateAligned(
       sizeof(Node) + sizeof(std::atomic<Node*>) * (height - 1));
-  return new (node_memory) Node(key);
+  return new (node_memory) Node(key, prefix);
 }
 
 template <typename Key, class Comparator>
@@ -250,20 +266,33 @@ int SkipList<Key, Comparator>::RandomHeight() {
 }
 
 template <typename Key, class Comparator>
-bool SkipList<Key, Comparator>::KeyIsAfterNode(const Key& key, Node* n) const {
+bool SkipList<Key, Comparator>::KeyIsAfterNode(const Key& key, uint64_t prefix,
+                                               Node* n) const {
   // null n is considered infinite
-  return (n != nullptr) && (compare_(n->key, key) < 0);
+  if (n == nullptr) {
+    return false;
+  }
+  if (n->prefix != prefix) {
+    return n->prefix < prefix;
+  }
+  return compare_(n->key, key) < 0;
 }
 
 template <typename Key, class Comparator>
 typename SkipList<Key, Comparator>::Node*
 SkipList<Key, Comparator>::FindGreaterOrEqual(const Key& key,
                                               Node** prev) const {
+  const uint64_t prefix = compare_.Prefix(key);
   Node* x = head_;
   int level = GetMaxHeight() - 1;
   while (true) {
     Node* next = x->Next(level);
-    if (KeyIsAfterNode(key, next)) {
+    if (next != nullptr) {
+      // Overlap fetching the node we move to next with comparing "key"
+      // against the node after "x".
+      port::Prefetch(next->NoBarrier_Next(level));
+    }
+    if (KeyIsAfterNode(key, prefix, next)) {
       // Keep searching in this list
       x = next;
     } else {
@@ -281,12 +310,13 @@ SkipList<Key, Comparator>::FindGreaterOrEqual(const Key& key,
 template <typename Key, class Comparator>
 typename SkipList<Key, Comparator>::Node*
 SkipList<Key, Comparator>::FindLessThan(const Key& key) const {
+  const uint64_t prefix = compare_.Prefix(key);
   Node* x = head_;
   int level = GetMaxHeight() - 1;
   while (true) {
     assert(x == head_ || compare_(x->key, key) < 0);
     Node* next = x->Next(level);
-    if (next == nullptr || compare_(next->key, key) >= 0) {
+    if (!KeyIsAfterNode(key, prefix, next)) {
       if (level == 0) {
         return x;
       } else {
@@ -323,7 +353,7 @@ template <typename Key, class Comparator>
 SkipList<Key, Comparator>::SkipList(Comparator cmp, Arena* arena)
     : compare_(cmp),
       arena_(arena),
-      head_(NewNode(0 /* any key will do */, kMaxHeight)),
+      head_(NewNode(0 /* any key will do */, 0, kMaxHeight)),
       max_height_(1),
       rnd_(0xdeadbeef) {
   for (int i = 0; i < kMaxHeight; i++) {
@@ -337,6 +367,7 @@ void SkipList<Key, Comparator>::Insert(const Key& key) {
   // here since Insert() is externally synchronized.
   Node* prev[kMaxHeight];
   Node* x = FindGreaterOrEqual(key, prev);
+  const uint64_t prefix = compare_.Prefix(key);
 
   // Our data structure does not allow duplicate insertion
   assert(x == nullptr || !Equal(key, x->key));
@@ -356,7 +387,7 @@ void SkipList<Key, Comparator>::Insert(const Key& key) {
     max_height_.store(height, std::memory_order_relaxed);
   }
 
-  x = NewNode(key, height);
+  x = NewNode(key, prefix, height);
   for (int i = 0; i < height; i++) {
     // NoBarrier_SetNext() suffices since we will add a barrier when
     // we publish a pointer to "x" in prev[i].
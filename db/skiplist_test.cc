@@ -30,6 +30,9 @@ struct Comparator {
       return 0;
     }
   }
+
+  // Coarse enough that many keys share a prefix.
+  uint64_t Prefix(const Key& k) const { return k >> 8; }
 };
 
 TEST(SkipTest, Empty) {
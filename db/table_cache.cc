@@ -5,6 +5,7 @@
 #include "db/table_cache.h"
 
 #include "db/filename.h"
+#include "db/range_del_aggregator.h"
 #include "leveldb/env.h"
 #include "leveldb/table.h"
 #include "util/coding.h"
@@ -14,10 +15,12 @@ namespace leveldb {
 struct TableAndFile {
   RandomAccessFile* file;
   Table* table;
+  RangeTombstoneList* range_tombstones;  // nullptr if the table has none
 };
 
 static void DeleteEntry(const Slice& key, void* value) {
   TableAndFile* tf = reinterpret_cast<TableAndFile*>(value);
+  delete tf->range_tombstones;
   delete tf->table;
   delete tf->file;
   delete tf;
@@ -34,6 +37,10 @@ TableCache::TableCache(const std::string& dbname, const Options& options,
     : env_(options.env),
       dbname_(dbname),
       options_(options),
+      // Tables hold internal keys.
+      user_comparator_(
+          static_cast<const InternalKeyComparator*>(options.comparator)
+              ->user_comparator()),
       cache_(NewLRUCache(entries)) {}
 
 TableCache::~TableCache() { delete cache_; }
@@ -69,6 +76,11 @@ Status TableCache::FindTable(uint64_t file_number, uint64_t file_size,
       TableAndFile* tf = new TableAndFile;
       tf->file = file;
       tf->table = table;
+      Iterator* range_iter = table->NewRangeTombstoneIterator();
+      tf->range_tombstones =
+          range_iter == nullptr
+              ? nullptr
+              : new RangeTombstoneList(user_comparator_, range_iter);
       *handle = cache_->Insert(key, tf, 1, &DeleteEntry);
     }
   }
@@ -97,15 +109,124 @@ Iterator* TableCache::NewIterator(const ReadOptions& options,
   return result;
 }
 
+Iterator* TableCache::NewRangeTombstoneIterator(uint64_t file_number,
+                                                uint64_t file_size) {
+  Cache::Handle* handle = nullptr;
+  Status s = FindTable(file_number, file_size, &handle);
+  if (!s.ok()) {
+    return NewErrorIterator(s);
+  }
+
+  Table* table = reinterpret_cast<TableAndFile*>(cache_->Value(handle))->table;
+  Iterator* result = table->NewRangeTombstoneIterator();
+  if (result == nullptr) {
+    cache_->Release(handle);
+  } else {
+    result->RegisterCleanup(&UnrefEntry, cache_, handle);
+  }
+  return result;
+}
+
+Status TableCache::AddRangeTombstones(uint64_t file_number,
+                                      uint64_t file_size,
+                                      RangeDelAggregator* range_del) {
+  Cache::Handle* handle = nullptr;
+  Status s = FindTable(file_number, file_size, &handle);
+  if (s.ok()) {
+    const RangeTombstoneList* list =
+        reinterpret_cast<TableAndFile*>(cache_->Value(handle))
+            ->range_tombstones;
+    if (list != nullptr) {
+      range_del->AddTombstones(*list);
+    }
+    cache_->Release(handle);
+  }
+  return s;
+}
+
+Status TableCache::MaxCoveringSeq(uint64_t file_number, uint64_t file_size,
+                                  const Slice& user_key,
+                                  SequenceNumber upper_bound,
+                                  SequenceNumber* seq) {
+  *seq = 0;
+  Cache::Handle* handle = nullptr;
+  Status s = FindTable(file_number, file_size, &handle);
+  if (s.ok()) {
+    const RangeTombstoneList* list =
+        reinterpret_cast<TableAndFile*>(cache_->Value(handle))
+            ->range_tombstones;
+    if (list != nullptr) {
+      s = list->status();
+      *seq = list->MaxCoveringSeq(user_key, upper_bound);
+    }
+    cache_->Release(handle);
+  }
+  return s;
+}
+
 Status TableCache::Get(const ReadOptions& options, uint64_t file_number,
-                       uint64_t file_size, const Slice& k, void* arg,
+                       uint64_t file_size, int level, const Slice& k,
+                       void* arg,
                        void (*handle_result)(void*, const Slice&,
-                                             const Slice&)) {
+                                             const Slice&),
+                       Iterator** pinned) {
+  if (pinned != nullptr) {
+    *pinned = nullptr;
+  }
   Cache::Handle* handle = nullptr;
   Status s = FindTable(file_number, file_size, &handle);
   if (s.ok()) {
     Table* t = reinterpret_cast<TableAndFile*>(cache_->Value(handle))->table;
-    s = t->InternalGet(options, k, arg, handle_result);
+    if (level == 0 && options_.pin_l0_index_and_filter_blocks_in_cache) {
+      t->PinIndexAndFilter();
+    }
+    s = t->InternalGet(options, k, arg, handle_result, pinned);
+    if (pinned != nullptr && *pinned != nullptr) {
+      // Blocks of memory-mapped files live as long as the table.
+      (*pinned)->RegisterCleanup(&UnrefEntry, cache_, handle);
+    } else {
+      cache_->Release(handle);
+    }
+  }
+  return s;
+}
+
+bool TableCache::PrefixMayMatch(const ReadOptions& options,
+                                uint64_t file_number, uint64_t file_size,
+                                const Slice& k) {
+  Cache::Handle* handle = nullptr;
+  if (!FindTable(file_number, file_size, &handle).ok()) {
+    return true;  // Let the read report the error
+  }
+  Table* t = reinterpret_cast<TableAndFile*>(cache_->Value(handle))->table;
+  const bool may_match = t->PrefixMayMatch(options, k);
+  cache_->Release(handle);
+  return may_match;
+}
+
+Status TableCache::Prewarm(uint64_t file_number, uint64_t file_size,
+                           bool verify_size) {
+  if (verify_size) {
+    std::string fname = TableFileName(dbname_, file_number);
+    uint64_t actual_size;
+    Status s = env_->GetFileSize(fname, &actual_size);
+    if (!s.ok()) {
+      fname = SSTTableFileName(dbname_, file_number);
+      if (env_->GetFileSize(fname, &actual_size).ok()) {
+        s = Status::OK();
+      }
+    }
+    if (!s.ok()) {
+      return s;
+    }
+    if (actual_size != file_size) {
+      return Status::Corruption("table file has unexpected size", fname);
+    }
+  }
+
+  Cache::Handle* handle = nullptr;
+  Status s = FindTable(file_number, file_size, &handle);
+  if (s.ok()) {
     cache_->Release(handle);
   }
   return s;
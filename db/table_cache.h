@@ -18,6 +18,7 @@
 namespace leveldb {
 
 class Env;
+class RangeDelAggregator;
 
 class TableCache {
  public:
@@ -38,11 +39,46 @@ class TableCache {
   Iterator* NewIterator(const ReadOptions& options, uint64_t file_number,
                         uint64_t file_size, Table** tableptr = nullptr);
 
+  // Return an iterator over the range tombstones of the specified file, or
+  // nullptr if the file has none.  Errors are reported through an error
+  // iterator.
+  Iterator* NewRangeTombstoneIterator(uint64_t file_number, uint64_t file_size);
+
+  // Add the range tombstones of the specified file to *range_del.  The
+  // tombstones of a file are read once, when it is opened.
+  Status AddRangeTombstones(uint64_t file_number, uint64_t file_size,
+                            RangeDelAggregator* range_del);
+
+  // Set *seq to the largest sequence number <= upper_bound of a range
+  // tombstone in the specified file covering "user_key", or to 0 if there
+  // is none.
+  Status MaxCoveringSeq(uint64_t file_number, uint64_t file_size,
+                        const Slice& user_key, SequenceNumber upper_bound,
+                        SequenceNumber* seq);
+
   // If a seek to internal key "k" in specified file finds an entry,
-  // call (*handle_result)(arg, found_key, found_value).
+  // call (*handle_result)(arg, found_key, found_value).  "level" is the
+  // level of the file, which decides whether its index and filter blocks
+  // get pinned in the block cache.
+  //
+  // If "pinned" is non-null, *pinned is set to an iterator that keeps
+  // found_value live until it is deleted, or to nullptr if no entry was
+  // found.  The iterator must be deleted before this cache is.
   Status Get(const ReadOptions& options, uint64_t file_number,
-             uint64_t file_size, const Slice& k, void* arg,
-             void (*handle_result)(void*, const Slice&, const Slice&));
+             uint64_t file_size, int level, const Slice& k, void* arg,
+             void (*handle_result)(void*, const Slice&, const Slice&),
+             Iterator** pinned = nullptr);
+
+  // Return false if the specified file holds no key with the prefix of
+  // internal key "k" according to its filter (see
+  // ReadOptions::prefix_same_as_start).
+  bool PrefixMayMatch(const ReadOptions& options, uint64_t file_number,
+                      uint64_t file_size, const Slice& k);
+
+  // Open the specified file, unless it is already cached, so that later
+  // lookups need not.  If "verify_size" is true, first check that the
+  // file length is exactly "file_size" bytes.
+  Status Prewarm(uint64_t file_number, uint64_t file_size, bool verify_size);
 
   // Evict any entry for the specified file number
   void Evict(uint64_t file_number);
@@ -53,6 +89,7 @@ class TableCache {
   Env* const env_;
   const std::string dbname_;
   const Options& options_;
+  const Comparator* const user_comparator_;
   Cache* cache_;
 };
 
@@ -20,9 +20,24 @@ enum Tag {
   kDeletedFile = 6,
   kNewFile = 7,
   // 8 was used for large value refs
-  kPrevLogNumber = 9
+  kPrevLogNumber = 9,
+  kNewFileWithStats = 10,
+  kBlobFile = 11,
+  kBlobGarbage = 12
 };
 
+// Field numbers for the statistics attached to a kNewFileWithStats entry.
+// Readers skip fields they do not recognize.
+enum FileStatField {
+  kNumRangeDeletions = 1,
+  kNumEntries = 2,
+  kNumDeletions = 3
+};
+
+static bool HasFileStats(const FileMetaData& f) {
+  return f.num_range_deletions > 0 || f.num_entries > 0;
+}
+
 void VersionEdit::Clear() {
   comparator_.clear();
   log_number_ = 0;
@@ -37,6 +52,8 @@ void VersionEdit::Clear() {
   compact_pointers_.clear();
   deleted_files_.clear();
   new_files_.clear();
+  new_blob_files_.clear();
+  blob_garbage_.clear();
 }
 
 void VersionEdit::EncodeTo(std::string* dst) const {
@@ -75,12 +92,39 @@ void VersionEdit::EncodeTo(std::string* dst) const {
 
   for (size_t i = 0; i < new_files_.size(); i++) {
     const FileMetaData& f = new_files_[i].second;
-    PutVarint32(dst, kNewFile);
+    const bool with_stats = HasFileStats(f);
+    PutVarint32(dst, with_stats ? kNewFileWithStats : kNewFile);
     PutVarint32(dst, new_files_[i].first);  // level
     PutVarint64(dst, f.number);
     PutVarint64(dst, f.file_size);
     PutLengthPrefixedSlice(dst, f.smallest.Encode());
     PutLengthPrefixedSlice(dst, f.largest.Encode());
+    if (with_stats) {
+      PutVarint32(dst, 3);  // number of stat fields
+      PutVarint32(dst, kNumRangeDeletions);
+      PutVarint64(dst, f.num_range_deletions);
+      PutVarint32(dst, kNumEntries);
+      PutVarint64(dst, f.num_entries);
+      PutVarint32(dst, kNumDeletions);
+      PutVarint64(dst, f.num_deletions);
+    }
+  }
+
+  for (const BlobFileMetaData& f : new_blob_files_) {
+    PutVarint32(dst, kBlobFile);
+    PutVarint64(dst, f.number);
+    PutVarint64(dst, f.total_count);
+    PutVarint64(dst, f.total_bytes);
+    PutVarint64(dst, f.garbage_count);
+    PutVarint64(dst, f.garbage_bytes);
+  }
+
+  for (const auto& garbage_kvp : blob_garbage_) {
+    const BlobFileMetaData& g = garbage_kvp.second;
+    PutVarint32(dst, kBlobGarbage);
+    PutVarint64(dst, g.number);
+    PutVarint64(dst, g.garbage_count);
+    PutVarint64(dst, g.garbage_bytes);
   }
 }
 
@@ -93,6 +137,35 @@ static bool GetInternalKey(Slice* input, InternalKey* dst) {
   }
 }
 
+static bool GetFileStats(Slice* input, FileMetaData* f) {
+  uint32_t count;
+  if (!GetVarint32(input, &count)) {
+    return false;
+  }
+  for (uint32_t i = 0; i < count; i++) {
+    uint32_t field;
+    uint64_t value;
+    if (!GetVarint32(input, &field) || !GetVarint64(input, &value)) {
+      return false;
+    }
+    switch (field) {
+      case kNumRangeDeletions:
+        f->num_range_deletions = value;
+        break;
+      case kNumEntries:
+        f->num_entries = value;
+        break;
+      case kNumDeletions:
+        f->num_deletions = value;
+        break;
+      default:
+        // Written by a newer version; ignore.
+        break;
+    }
+  }
+  return true;
+}
+
 static bool GetLevel(Slice* input, int* level) {
   uint32_t v;
   if (GetVarint32(input, &v) && v < config::kNumLevels) {
@@ -113,6 +186,7 @@ Status VersionEdit::DecodeFrom(const Slice& src) {
   int level;
   uint64_t number;
   FileMetaData f;
+  BlobFileMetaData blob;
   Slice str;
   InternalKey key;
 
@@ -176,16 +250,43 @@ Status VersionEdit::DecodeFrom(const Slice& src) {
         break;
 
       case kNewFile:
+      case kNewFileWithStats:
+        f = FileMetaData();
         if (GetLevel(&input, &level) && GetVarint64(&input, &f.number) &&
             GetVarint64(&input, &f.file_size) &&
             GetInternalKey(&input, &f.smallest) &&
-            GetInternalKey(&input, &f.largest)) {
+            GetInternalKey(&input, &f.largest) &&
+            (tag == kNewFile || GetFileStats(&input, &f))) {
           new_files_.push_back(std::make_pair(level, f));
         } else {
           msg = "new-file entry";
         }
         break;
 
+      case kBlobFile:
+        blob = BlobFileMetaData();
+        if (GetVarint64(&input, &blob.number) &&
+            GetVarint64(&input, &blob.total_count) &&
+            GetVarint64(&input, &blob.total_bytes) &&
+            GetVarint64(&input, &blob.garbage_count) &&
+            GetVarint64(&input, &blob.garbage_bytes)) {
+          new_blob_files_.push_back(blob);
+        } else {
+          msg = "blob-file entry";
+        }
+        break;
+
+      case kBlobGarbage:
+        blob = BlobFileMetaData();
+        if (GetVarint64(&input, &blob.number) &&
+            GetVarint64(&input, &blob.garbage_count) &&
+            GetVarint64(&input, &blob.garbage_bytes)) {
+          AddBlobGarbage(blob.number, blob.garbage_count, blob.garbage_bytes);
+        } else {
+          msg = "blob-garbage entry";
+        }
+        break;
+
       default:
         msg = "unknown tag";
         break;
@@ -250,6 +351,38 @@ std::string VersionEdit::DebugString() const {
     r.append(f.smallest.DebugString());
     r.append(" .. ");
     r.append(f.largest.DebugString());
+    if (f.num_entries > 0) {
+      r.append(" entries=");
+      AppendNumberTo(&r, f.num_entries);
+      r.append(" deletions=");
+      AppendNumberTo(&r, f.num_deletions);
+    }
+    if (f.num_range_deletions > 0) {
+      r.append(" range_deletions=");
+      AppendNumberTo(&r, f.num_range_deletions);
+    }
+  }
+  for (const BlobFileMetaData& f : new_blob_files_) {
+    r.append("\n  AddBlobFile: ");
+    AppendNumberTo(&r, f.number);
+    r.append(" records=");
+    AppendNumberTo(&r, f.total_count);
+    r.append(" bytes=");
+    AppendNumberTo(&r, f.total_bytes);
+    if (f.garbage_count > 0) {
+      r.append(" garbage=");
+      AppendNumberTo(&r, f.garbage_count);
+      r.append("/");
+      AppendNumberTo(&r, f.garbage_bytes);
+    }
+  }
+  for (const auto& garbage_kvp : blob_garbage_) {
+    r.append("\n  BlobGarbage: ");
+    AppendNumberTo(&r, garbage_kvp.first);
+    r.append(" ");
+    AppendNumberTo(&r, garbage_kvp.second.garbage_count);
+    r.append("/");
+    AppendNumberTo(&r, garbage_kvp.second.garbage_bytes);
   }
   r.append("\n}\n");
   return r;
@@ -5,6 +5,7 @@
 #ifndef STORAGE_LEVELDB_DB_VERSION_EDIT_H_
 #define STORAGE_LEVELDB_DB_VERSION_EDIT_H_
 
+#include <map>
 #include <set>
 #include <utility>
 #include <vector>
@@ -16,7 +17,13 @@ namespace leveldb {
 class VersionSet;
 
 struct FileMetaData {
-  FileMetaData() : refs(0), allowed_seeks(1 << 30), file_size(0) {}
+  FileMetaData()
+      : refs(0),
+        allowed_seeks(1 << 30),
+        file_size(0),
+        num_entries(0),
+        num_deletions(0),
+        num_range_deletions(0) {}
 
   int refs;
   int allowed_seeks;  // Seeks allowed until compaction
@@ -24,6 +31,27 @@ struct FileMetaData {
   uint64_t file_size;    // File size in bytes
   InternalKey smallest;  // Smallest internal key served by table
   InternalKey largest;   // Largest internal key served by table
+  uint64_t num_entries;          // Point entries, or 0 if unknown
+  uint64_t num_deletions;        // Point deletion markers among them
+  uint64_t num_range_deletions;  // Range tombstones stored in the table
+};
+
+// Counts of the records of a blob file, and of the records among them that
+// no table entry points to anymore.  Records are counted in
+// BlobIndex::RecordSize() bytes.
+struct BlobFileMetaData {
+  BlobFileMetaData()
+      : number(0),
+        total_count(0),
+        total_bytes(0),
+        garbage_count(0),
+        garbage_bytes(0) {}
+
+  uint64_t number;
+  uint64_t total_count;
+  uint64_t total_bytes;
+  uint64_t garbage_count;
+  uint64_t garbage_bytes;
 };
 
 class VersionEdit {
@@ -70,11 +98,33 @@ class VersionEdit {
     new_files_.push_back(std::make_pair(level, f));
   }
 
+  // Add the specified file, including the statistics recorded in "f".
+  // REQUIRES: This version has not been saved (see VersionSet::SaveTo)
+  void AddFile(int level, const FileMetaData& f) {
+    FileMetaData copy = f;
+    copy.refs = 0;
+    copy.allowed_seeks = 1 << 30;
+    new_files_.push_back(std::make_pair(level, copy));
+  }
+
   // Delete the specified "file" from the specified "level".
   void RemoveFile(int level, uint64_t file) {
     deleted_files_.insert(std::make_pair(level, file));
   }
 
+  // Add the blob file described by "f", including the garbage it holds.
+  void AddBlobFile(const BlobFileMetaData& f) { new_blob_files_.push_back(f); }
+
+  // Record that "count" records of blob file "file", holding "bytes"
+  // bytes, became garbage.  A blob file is deleted once all of its records
+  // are garbage.
+  void AddBlobGarbage(uint64_t file, uint64_t count, uint64_t bytes) {
+    BlobFileMetaData* g = &blob_garbage_[file];
+    g->number = file;
+    g->garbage_count += count;
+    g->garbage_bytes += bytes;
+  }
+
   void EncodeTo(std::string* dst) const;
   Status DecodeFrom(const Slice& src);
 
@@ -99,6 +149,8 @@ class VersionEdit {
   std::vector<std::pair<int, InternalKey>> compact_pointers_;
   DeletedFileSet deleted_files_;
   std::vector<std::pair<int, FileMetaData>> new_files_;
+  std::vector<BlobFileMetaData> new_blob_files_;
+  std::map<uint64_t, BlobFileMetaData> blob_garbage_;
 };
 
 }  // namespace leveldb
@@ -38,4 +38,52 @@ TEST(VersionEditTest, EncodeDecode) {
   TestEncodeDecode(edit);
 }
 
+TEST(VersionEditTest, EncodeDecodeFileStats) {
+  VersionEdit edit;
+  FileMetaData f;
+  f.number = 7;
+  f.file_size = 1000;
+  f.smallest = InternalKey("a", 10, kTypeRangeDeletion);
+  f.largest = InternalKey("m", kMaxSequenceNumber, kTypeRangeDeletion);
+  f.num_range_deletions = 3;
+  f.num_entries = 40;
+  f.num_deletions = 25;
+  edit.AddFile(2, f);
+  edit.AddFile(2, 8, 100, InternalKey("n", 5, kTypeValue),
+               InternalKey("p", 6, kTypeValue));
+  TestEncodeDecode(edit);
+
+  std::string encoded;
+  edit.EncodeTo(&encoded);
+  VersionEdit parsed;
+  ASSERT_TRUE(parsed.DecodeFrom(encoded).ok());
+  std::string debug = parsed.DebugString();
+  ASSERT_NE(std::string::npos, debug.find("range_deletions=3"));
+  ASSERT_NE(std::string::npos, debug.find("entries=40 deletions=25"));
+}
+
+TEST(VersionEditTest, EncodeDecodeBlobFiles) {
+  VersionEdit edit;
+  BlobFileMetaData f;
+  f.number = 9;
+  f.total_count = 100;
+  f.total_bytes = 409600;
+  f.garbage_count = 10;
+  f.garbage_bytes = 40960;
+  edit.AddBlobFile(f);
+  edit.AddBlobGarbage(5, 3, 300);
+  edit.AddBlobGarbage(5, 2, 200);
+  TestEncodeDecode(edit);
+
+  std::string encoded;
+  edit.EncodeTo(&encoded);
+  VersionEdit parsed;
+  ASSERT_TRUE(parsed.DecodeFrom(encoded).ok());
+  std::string debug = parsed.DebugString();
+  ASSERT_NE(std::string::npos,
+            debug.find("AddBlobFile: 9 records=100 bytes=409600 "
+                       "garbage=10/40960"));
+  ASSERT_NE(std::string::npos, debug.find("BlobGarbage: 5 5/500"));
+}
+
 }  // namespace leveldb
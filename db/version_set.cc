@@ -169,11 +169,34 @@ class Version::LevelFileNumIterator : public Iterator {
  public:
   LevelFileNumIterator(const InternalKeyComparator& icmp,
                        const std::vector<FileMetaData*>* flist)
-      : icmp_(icmp), flist_(flist), index_(flist->size()) {  // Marks as invalid
-  }
+      : icmp_(icmp),
+        flist_(flist),
+        index_(flist->size()),  // Marks as invalid
+        table_cache_(nullptr) {}
+
+  // Like the above, but a Seek() that lands on a file whose filter rules
+  // out the prefix of the target leaves the iterator invalid (see
+  // ReadOptions::prefix_same_as_start).  The file holds a key after the
+  // target, outside the prefix, so that no later file holds the prefix.
+  LevelFileNumIterator(const InternalKeyComparator& icmp,
+                       const std::vector<FileMetaData*>* flist,
+                       TableCache* table_cache, const ReadOptions& options)
+      : icmp_(icmp),
+        flist_(flist),
+        index_(flist->size()),  // Marks as invalid
+        table_cache_(table_cache),
+        options_(options) {}
+
   bool Valid() const override { return index_ < flist_->size(); }
   void Seek(const Slice& target) override {
     index_ = FindFile(icmp_, *flist_, target);
+    if (table_cache_ != nullptr && Valid()) {
+      const FileMetaData* f = (*flist_)[index_];
+      if (!table_cache_->PrefixMayMatch(options_, f->number, f->file_size,
+                                        target)) {
+        index_ = flist_->size();
+      }
+    }
   }
   void SeekToFirst() override { index_ = 0; }
   void SeekToLast() override {
@@ -207,6 +230,8 @@ class Version::LevelFileNumIterator : public Iterator {
   const InternalKeyComparator icmp_;
   const std::vector<FileMetaData*>* const flist_;
   uint32_t index_;
+  TableCache* const table_cache_;  // Non-null if seeks check the prefix
+  const ReadOptions options_;
 
   // Backing store for value().  Holds the file number and size.
   mutable char value_buf_[16];
@@ -224,19 +249,92 @@ static Iterator* GetFileIterator(void* arg, const ReadOptions& options,
   }
 }
 
+namespace {
+
+// Iterator over a level-0 file that leaves a Seek() invalid, without
+// reading the file, if its filter rules out the prefix of the target (see
+// ReadOptions::prefix_same_as_start).
+class PrefixSeekFileIterator : public Iterator {
+ public:
+  PrefixSeekFileIterator(TableCache* table_cache, const ReadOptions& options,
+                         const FileMetaData* f)
+      : table_cache_(table_cache),
+        options_(options),
+        file_number_(f->number),
+        file_size_(f->file_size),
+        iter_(table_cache->NewIterator(options, f->number, f->file_size)),
+        skipped_(false) {}
+
+  ~PrefixSeekFileIterator() override { delete iter_; }
+
+  bool Valid() const override { return !skipped_ && iter_->Valid(); }
+  void Seek(const Slice& target) override {
+    skipped_ = !table_cache_->PrefixMayMatch(options_, file_number_,
+                                             file_size_, target);
+    if (!skipped_) iter_->Seek(target);
+  }
+  void SeekToFirst() override {
+    skipped_ = false;
+    iter_->SeekToFirst();
+  }
+  void SeekToLast() override {
+    skipped_ = false;
+    iter_->SeekToLast();
+  }
+  void Next() override {
+    assert(Valid());
+    iter_->Next();
+  }
+  void Prev() override {
+    assert(Valid());
+    iter_->Prev();
+  }
+  Slice key() const override { return iter_->key(); }
+  Slice value() const override { return iter_->value(); }
+  Status status() const override { return iter_->status(); }
+
+ private:
+  TableCache* const table_cache_;
+  const ReadOptions options_;
+  const uint64_t file_number_;
+  const uint64_t file_size_;
+  Iterator* const iter_;
+  bool skipped_;
+};
+
+// Returns true if seeks through "options" may skip the files whose filter
+// rules out the prefix of the target.
+bool PrefixSeek(const Options* db_options, const ReadOptions& options) {
+  return options.prefix_same_as_start &&
+         db_options->prefix_extractor != nullptr &&
+         db_options->filter_policy != nullptr;
+}
+
+}  // namespace
+
 Iterator* Version::NewConcatenatingIterator(const ReadOptions& options,
                                             int level) const {
-  return NewTwoLevelIterator(
-      new LevelFileNumIterator(vset_->icmp_, &files_[level]), &GetFileIterator,
-      vset_->table_cache_, options);
+  LevelFileNumIterator* files =
+      PrefixSeek(vset_->options_, options)
+          ? new LevelFileNumIterator(vset_->icmp_, &files_[level],
+                                     vset_->table_cache_, options)
+          : new LevelFileNumIterator(vset_->icmp_, &files_[level]);
+  return NewTwoLevelIterator(files, &GetFileIterator, vset_->table_cache_,
+                             options);
 }
 
 void Version::AddIterators(const ReadOptions& options,
                            std::vector<Iterator*>* iters) {
   // Merge all level zero files together since they may overlap
+  const bool prefix_seek = PrefixSeek(vset_->options_, options);
   for (size_t i = 0; i < files_[0].size(); i++) {
-    iters->push_back(vset_->table_cache_->NewIterator(
-        options, files_[0][i]->number, files_[0][i]->file_size));
+    if (prefix_seek) {
+      iters->push_back(new PrefixSeekFileIterator(vset_->table_cache_,
+                                                  options, files_[0][i]));
+    } else {
+      iters->push_back(vset_->table_cache_->NewIterator(
+          options, files_[0][i]->number, files_[0][i]->file_size));
+    }
   }
 
   // For levels > 0, we can use a concatenating iterator that sequentially
@@ -249,6 +347,38 @@ void Version::AddIterators(const ReadOptions& options,
   }
 }
 
+Status Version::AddRangeTombstones(RangeDelAggregator* range_del) {
+  for (int level = 0; level < config::kNumLevels; level++) {
+    for (FileMetaData* f : files_[level]) {
+      if (f->num_range_deletions > 0) {
+        Status s = vset_->table_cache_->AddRangeTombstones(
+            f->number, f->file_size, range_del);
+        if (!s.ok()) {
+          return s;
+        }
+      }
+    }
+  }
+  return Status::OK();
+}
+
+void Version::GetCoveredFiles(const Slice& begin, const Slice& end,
+                              std::vector<std::pair<int, uint64_t>>* files) {
+  const Comparator* ucmp = vset_->icmp_.user_comparator();
+  // A file may end with the exclusive bound of one of its own tombstones,
+  // which is encoded as the earliest internal key for that user key.
+  const InternalKey limit(end, kMaxSequenceNumber, kTypeRangeDeletion);
+  files->clear();
+  for (int level = 0; level < config::kNumLevels; level++) {
+    for (FileMetaData* f : files_[level]) {
+      if (ucmp->Compare(f->smallest.user_key(), begin) >= 0 &&
+          vset_->icmp_.Compare(f->largest, limit) <= 0) {
+        files->push_back(std::make_pair(level, f->number));
+      }
+    }
+  }
+}
+
 // Callback from TableCache::Get()
 namespace {
 enum SaverState {
@@ -261,7 +391,9 @@ struct Saver {
   SaverState state;
   const Comparator* ucmp;
   Slice user_key;
-  std::string* value;
+  Slice value;              // Of the entry found, if any
+  bool* is_blob_index;      // Set if value is the BlobIndex of the value
+  SequenceNumber sequence;  // Of the entry found, if any
 };
 }  // namespace
 static void SaveValue(void* arg, const Slice& ikey, const Slice& v) {
@@ -271,14 +403,23 @@ static void SaveValue(void* arg, const Slice& ikey, const Slice& v) {
     s->state = kCorrupt;
   } else {
     if (s->ucmp->Compare(parsed_key.user_key, s->user_key) == 0) {
-      s->state = (parsed_key.type == kTypeValue) ? kFound : kDeleted;
+      s->state = (parsed_key.type == kTypeValue ||
+                  parsed_key.type == kTypeBlobIndex)
+                     ? kFound
+                     : kDeleted;
+      s->sequence = parsed_key.sequence;
       if (s->state == kFound) {
-        s->value->assign(v.data(), v.size());
+        s->value = v;
+        *s->is_blob_index = (parsed_key.type == kTypeBlobIndex);
       }
     }
   }
 }
 
+static void DeletePinnedIterator(void* arg1, void* arg2) {
+  delete reinterpret_cast<Iterator*>(arg1);
+}
+
 static bool NewestFirst(FileMetaData* a, FileMetaData* b) {
   return a->number > b->number;
 }
@@ -327,15 +468,19 @@ void Version::ForEachOverlapping(Slice user_key, Slice internal_key, void* arg,
 }
 
 Status Version::Get(const ReadOptions& options, const LookupKey& k,
-                    std::string* value, GetStats* stats) {
+                    PinnableSlice* value, bool* is_blob_index,
+                    GetStats* stats) {
   stats->seek_file = nullptr;
   stats->seek_file_level = -1;
+  *is_blob_index = false;
 
   struct State {
     Saver saver;
+    PinnableSlice* value;
     GetStats* stats;
     const ReadOptions* options;
     Slice ikey;
+    SequenceNumber snapshot;
     FileMetaData* last_file_read;
     int last_file_read_level;
 
@@ -356,13 +501,40 @@ Status Version::Get(const ReadOptions& options, const LookupKey& k,
       state->last_file_read = f;
       state->last_file_read_level = level;
 
-      state->s = state->vset->table_cache_->Get(*state->options, f->number,
-                                                f->file_size, state->ikey,
-                                                &state->saver, SaveValue);
+      // Files are visited newest first, so a tombstone in this file that
+      // covers the key hides everything in the files that follow.
+      SequenceNumber covering = 0;
+      if (f->num_range_deletions > 0) {
+        state->s = state->vset->table_cache_->MaxCoveringSeq(
+            f->number, f->file_size, state->saver.user_key, state->snapshot,
+            &covering);
+        if (!state->s.ok()) {
+          state->found = true;
+          return false;
+        }
+      }
+
+      Iterator* pinned;
+      state->s = state->vset->table_cache_->Get(
+          *state->options, f->number, f->file_size, level, state->ikey,
+          &state->saver, SaveValue, &pinned);
       if (!state->s.ok()) {
+        delete pinned;
         state->found = true;
         return false;
       }
+      if (covering > 0 && (state->saver.state == kNotFound ||
+                           (state->saver.state != kCorrupt &&
+                            state->saver.sequence < covering))) {
+        state->saver.state = kDeleted;
+      }
+      if (state->saver.state == kFound) {
+        // The value lives in the block that "pinned" holds.
+        state->value->PinSlice(state->saver.value, &DeletePinnedIterator,
+                               pinned, nullptr);
+      } else {
+        delete pinned;
+      }
       switch (state->saver.state) {
         case kNotFound:
           return true;  // Keep searching in other files
@@ -392,12 +564,16 @@ Status Version::Get(const ReadOptions& options, const LookupKey& k,
 
   state.options = &options;
   state.ikey = k.internal_key();
+  state.snapshot =
+      DecodeFixed64(state.ikey.data() + state.ikey.size() - 8) >> 8;
   state.vset = vset_;
 
   state.saver.state = kNotFound;
   state.saver.ucmp = vset_->icmp_.user_comparator();
   state.saver.user_key = k.user_key();
-  state.saver.value = value;
+  state.value = value;
+  state.saver.is_blob_index = is_blob_index;
+  state.saver.sequence = 0;
 
   ForEachOverlapping(state.saver.user_key, state.ikey, &state, &State::Match);
 
@@ -565,6 +741,26 @@ std::string Version::DebugString() const {
       r.append("]\n");
     }
   }
+  if (!blob_files_.empty()) {
+    // E.g.,
+    //   --- blob files ---
+    //   21:100/409600 garbage 10/40960
+    r.append("--- blob files ---\n");
+    for (const auto& blob_kvp : blob_files_) {
+      const BlobFileMetaData& f = blob_kvp.second;
+      r.push_back(' ');
+      AppendNumberTo(&r, f.number);
+      r.push_back(':');
+      AppendNumberTo(&r, f.total_count);
+      r.push_back('/');
+      AppendNumberTo(&r, f.total_bytes);
+      r.append(" garbage ");
+      AppendNumberTo(&r, f.garbage_count);
+      r.push_back('/');
+      AppendNumberTo(&r, f.garbage_bytes);
+      r.push_back('\n');
+    }
+  }
   return r;
 }
 
@@ -597,10 +793,12 @@ class VersionSet::Builder {
   VersionSet* vset_;
   Version* base_;
   LevelState levels_[config::kNumLevels];
+  std::map<uint64_t, BlobFileMetaData> blob_files_;
 
  public:
   // Initialize a builder with the files from *base and other info from *vset
-  Builder(VersionSet* vset, Version* base) : vset_(vset), base_(base) {
+  Builder(VersionSet* vset, Version* base)
+      : vset_(vset), base_(base), blob_files_(base->blob_files_) {
     base_->Ref();
     BySmallestKey cmp;
     cmp.internal_comparator = &vset_->icmp_;
@@ -671,6 +869,18 @@ class VersionSet::Builder {
       levels_[level].deleted_files.erase(f->number);
       levels_[level].added_files->insert(f);
     }
+
+    // Add new blob files and count their garbage
+    for (const BlobFileMetaData& f : edit->new_blob_files_) {
+      blob_files_[f.number] = f;
+    }
+    for (const auto& garbage_kvp : edit->blob_garbage_) {
+      auto it = blob_files_.find(garbage_kvp.first);
+      if (it != blob_files_.end()) {
+        it->second.garbage_count += garbage_kvp.second.garbage_count;
+        it->second.garbage_bytes += garbage_kvp.second.garbage_bytes;
+      }
+    }
   }
 
   // Save the current state in *v.
@@ -717,6 +927,13 @@ class VersionSet::Builder {
       }
 #endif
     }
+
+    // Drop the blob files that no table entry points to anymore.
+    for (const auto& blob_kvp : blob_files_) {
+      if (blob_kvp.second.garbage_count < blob_kvp.second.total_count) {
+        v->blob_files_.insert(blob_kvp);
+      }
+    }
   }
 
   void MaybeAddFile(Version* v, int level, FileMetaData* f) {
@@ -748,6 +965,8 @@ VersionSet::VersionSet(const std::string& dbname, const Options* options,
       last_sequence_(0),
       log_number_(0),
       prev_log_number_(0),
+      manifest_file_size_(0),
+      manifest_snapshot_size_(0),
       descriptor_file_(nullptr),
       descriptor_log_(nullptr),
       dummy_versions_(this),
@@ -791,6 +1010,25 @@ Status VersionSet::LogAndApply(VersionEdit* edit, port::Mutex* mu) {
     edit->SetPrevLogNumber(prev_log_number_);
   }
 
+  // Roll over to a new MANIFEST once the current one is too large, unless
+  // it is mostly made of its snapshot and a new one would be no smaller.
+  // The old one stays open in case writing the new one fails.
+  const uint64_t old_manifest_file_number = manifest_file_number_;
+  const uint64_t old_manifest_file_size = manifest_file_size_;
+  const uint64_t old_manifest_snapshot_size = manifest_snapshot_size_;
+  WritableFile* old_descriptor_file = nullptr;
+  log::Writer* old_descriptor_log = nullptr;
+  if (descriptor_log_ != nullptr &&
+      manifest_file_size_ >=
+          std::max<uint64_t>(options_->max_manifest_file_size,
+                             2 * manifest_snapshot_size_)) {
+    old_descriptor_file = descriptor_file_;
+    old_descriptor_log = descriptor_log_;
+    descriptor_file_ = nullptr;
+    descriptor_log_ = nullptr;
+    manifest_file_number_ = NewFileNumber();
+  }
+
   edit->SetNextFile(next_file_number_);
   edit->SetLastSequence(last_sequence_);
 
@@ -808,12 +1046,14 @@ Status VersionSet::LogAndApply(VersionEdit* edit, port::Mutex* mu) {
   Status s;
   if (descriptor_log_ == nullptr) {
     // No reason to unlock *mu here since we only hit this path in the
-    // first call to LogAndApply (when opening the database).
+    // first call to LogAndApply (when opening the database) and on the
+    // rare MANIFEST rollovers.
     assert(descriptor_file_ == nullptr);
     new_manifest_file = DescriptorFileName(dbname_, manifest_file_number_);
     s = env_->NewWritableFile(new_manifest_file, &descriptor_file_);
     if (s.ok()) {
       descriptor_log_ = new log::Writer(descriptor_file_);
+      manifest_file_size_ = 0;
       s = WriteSnapshot(descriptor_log_);
     }
   }
@@ -827,6 +1067,7 @@ Status VersionSet::LogAndApply(VersionEdit* edit, port::Mutex* mu) {
       std::string record;
       edit->EncodeTo(&record);
       s = descriptor_log_->AddRecord(record);
+      manifest_file_size_ += log::kHeaderSize + record.size();
       if (s.ok()) {
         s = descriptor_file_->Sync();
       }
@@ -849,6 +1090,13 @@ Status VersionSet::LogAndApply(VersionEdit* edit, port::Mutex* mu) {
     AppendVersion(v);
     log_number_ = edit->log_number_;
     prev_log_number_ = edit->prev_log_number_;
+    if (old_descriptor_log != nullptr) {
+      Log(options_->info_log, "Rolled MANIFEST #%llu over to #%llu\n",
+          static_cast<unsigned long long>(old_manifest_file_number),
+          static_cast<unsigned long long>(manifest_file_number_));
+      delete old_descriptor_log;
+      delete old_descriptor_file;
+    }
   } else {
     delete v;
     if (!new_manifest_file.empty()) {
@@ -858,6 +1106,14 @@ Status VersionSet::LogAndApply(VersionEdit* edit, port::Mutex* mu) {
       descriptor_file_ = nullptr;
       env_->RemoveFile(new_manifest_file);
     }
+    if (old_descriptor_log != nullptr) {
+      // Keep appending to the old MANIFEST, which CURRENT still names.
+      descriptor_file_ = old_descriptor_file;
+      descriptor_log_ = old_descriptor_log;
+      manifest_file_number_ = old_manifest_file_number;
+      manifest_file_size_ = old_manifest_file_size;
+      manifest_snapshot_size_ = old_manifest_snapshot_size;
+    }
   }
 
   return s;
@@ -980,6 +1236,8 @@ Status VersionSet::Recover(bool* save_manifest) {
     last_sequence_ = last_sequence;
     log_number_ = log_number;
     prev_log_number_ = prev_log_number;
+    Log(options_->info_log, "Recovered version set from %d records in %s",
+        read_records, current.c_str());
 
     // See if we can reuse the existing MANIFEST file.
     if (ReuseManifest(dscname, current)) {
@@ -1008,7 +1266,8 @@ bool VersionSet::ReuseManifest(const std::string& dscname,
       manifest_type != kDescriptorFile ||
       !env_->GetFileSize(dscname, &manifest_size).ok() ||
       // Make new compacted MANIFEST if old one is too big
-      manifest_size >= TargetFileSize(options_)) {
+      manifest_size >= std::min<uint64_t>(TargetFileSize(options_),
+                                          options_->max_manifest_file_size)) {
     return false;
   }
 
@@ -1024,6 +1283,8 @@ bool VersionSet::ReuseManifest(const std::string& dscname,
   Log(options_->info_log, "Reusing MANIFEST %s\n", dscname.c_str());
   descriptor_log_ = new log::Writer(descriptor_file_, manifest_size);
   manifest_file_number_ = manifest_number;
+  manifest_file_size_ = manifest_size;
+  manifest_snapshot_size_ = 0;  // Unknown
   return true;
 }
 
@@ -1037,6 +1298,7 @@ void VersionSet::Finalize(Version* v) {
   // Precomputed best level for next compaction
   int best_level = -1;
   double best_score = -1;
+  int64_t pending_bytes = 0;
 
   for (int level = 0; level < config::kNumLevels - 1; level++) {
     double score;
@@ -1054,11 +1316,17 @@ void VersionSet::Finalize(Version* v) {
       // overwrites/deletions).
       score = v->files_[level].size() /
               static_cast<double>(config::kL0_CompactionTrigger);
+      if (score >= 1) {
+        pending_bytes += TotalFileSize(v->files_[level]);
+      }
     } else {
       // Compute the ratio of current size to size limit.
       const uint64_t level_bytes = TotalFileSize(v->files_[level]);
-      score =
-          static_cast<double>(level_bytes) / MaxBytesForLevel(options_, level);
+      const double max_bytes = MaxBytesForLevel(options_, level);
+      score = static_cast<double>(level_bytes) / max_bytes;
+      if (level_bytes > max_bytes) {
+        pending_bytes += static_cast<int64_t>(level_bytes - max_bytes);
+      }
     }
 
     if (score > best_score) {
@@ -1069,6 +1337,29 @@ void VersionSet::Finalize(Version* v) {
 
   v->compaction_level_ = best_level;
   v->compaction_score_ = best_score;
+  v->pending_compaction_bytes_ = pending_bytes;
+
+  // Find the file with the largest fraction of deletions.  Files in the
+  // last level are skipped: their deletions are dropped as they arrive.
+  double best_ratio = config::kDeletionCompactionPercent / 100.0;
+  v->deletion_file_to_compact_ = nullptr;
+  v->deletion_file_to_compact_level_ = -1;
+  for (int level = 0; level < config::kNumLevels - 1; level++) {
+    for (FileMetaData* f : v->files_[level]) {
+      const uint64_t deletions = f->num_deletions + f->num_range_deletions;
+      if (deletions < config::kDeletionCompactionMinDeletions) {
+        continue;
+      }
+      const double ratio = static_cast<double>(deletions) /
+                           (f->num_entries + f->num_range_deletions);
+      if (ratio >= best_ratio && (v->deletion_file_to_compact_ == nullptr ||
+                                  ratio > best_ratio)) {
+        v->deletion_file_to_compact_ = f;
+        v->deletion_file_to_compact_level_ = level;
+        best_ratio = ratio;
+      }
+    }
+  }
 }
 
 Status VersionSet::WriteSnapshot(log::Writer* log) {
@@ -1092,12 +1383,19 @@ Status VersionSet::WriteSnapshot(log::Writer* log) {
     const std::vector<FileMetaData*>& files = current_->files_[level];
     for (size_t i = 0; i < files.size(); i++) {
       const FileMetaData* f = files[i];
-      edit.AddFile(level, f->number, f->file_size, f->smallest, f->largest);
+      edit.AddFile(level, *f);
     }
   }
 
+  // Save blob files
+  for (const auto& blob_kvp : current_->blob_files_) {
+    edit.AddBlobFile(blob_kvp.second);
+  }
+
   std::string record;
   edit.EncodeTo(&record);
+  manifest_snapshot_size_ = log::kHeaderSize + record.size();
+  manifest_file_size_ += manifest_snapshot_size_;
   return log->AddRecord(record);
 }
 
@@ -1160,6 +1458,9 @@ void VersionSet::AddLiveFiles(std::set<uint64_t>* live) {
         live->insert(files[i]->number);
       }
     }
+    for (const auto& blob_kvp : v->blob_files_) {
+      live->insert(blob_kvp.first);
+    }
   }
 }
 
@@ -1282,8 +1583,11 @@ Compaction* VersionSet::PickCompaction() {
   int level;
 
   // We prefer compactions triggered by too much data in a level over
-  // the compactions triggered by seeks.
+  // the compactions triggered by deletions, and those over the
+  // compactions triggered by seeks.
   const bool size_compaction = (current_->compaction_score_ >= 1);
+  const bool deletion_compaction =
+      (current_->deletion_file_to_compact_ != nullptr);
   const bool seek_compaction = (current_->file_to_compact_ != nullptr);
   if (size_compaction) {
     level = current_->compaction_level_;
@@ -1304,6 +1608,11 @@ Compaction* VersionSet::PickCompaction() {
       // Wrap-around to the beginning of the key space
       c->inputs_[0].push_back(current_->files_[level][0]);
     }
+  } else if (deletion_compaction) {
+    level = current_->deletion_file_to_compact_level_;
+    c = new Compaction(options_, level);
+    c->inputs_[0].push_back(current_->deletion_file_to_compact_);
+    c->for_deletions_ = true;
   } else if (seek_compaction) {
     level = current_->file_to_compact_level_;
     c = new Compaction(options_, level);
@@ -1355,6 +1664,14 @@ FileMetaData* FindSmallestBoundaryFile(
     const InternalKeyComparator& icmp,
     const std::vector<FileMetaData*>& level_files,
     const InternalKey& largest_key) {
+  ParsedInternalKey parsed;
+  if (ParseInternalKey(largest_key.Encode(), &parsed) &&
+      parsed.type == kTypeRangeDeletion &&
+      parsed.sequence == kMaxSequenceNumber) {
+    // The exclusive end of a range tombstone: the compaction holds no
+    // entries for this user key, so there is nothing to keep together.
+    return nullptr;
+  }
   const Comparator* user_cmp = icmp.user_comparator();
   FileMetaData* smallest_boundary_file = nullptr;
   for (size_t i = 0; i < level_files.size(); ++i) {
@@ -1510,6 +1827,7 @@ Compaction::Compaction(const Options* options, int level)
     : level_(level),
       max_output_file_size_(MaxFileSizeForLevel(options, level)),
       input_version_(nullptr),
+      for_deletions_(false),
       grandparent_index_(0),
       seen_key_(false),
       overlapped_bytes_(0) {
@@ -1528,8 +1846,10 @@ bool Compaction::IsTrivialMove() const {
   const VersionSet* vset = input_version_->vset_;
   // Avoid a move if there is lots of overlapping grandparent data.
   // Otherwise, the move could create a parent file that will require
-  // a very expensive merge later on.
-  return (num_input_files(0) == 1 && num_input_files(1) == 0 &&
+  // a very expensive merge later on.  A compaction picked for its
+  // deletions must rewrite the file to discard them.
+  return (!for_deletions_ && num_input_files(0) == 1 &&
+          num_input_files(1) == 0 &&
           TotalFileSize(grandparents_) <=
               MaxGrandParentOverlapBytes(vset->options_));
 }
@@ -1563,6 +1883,16 @@ bool Compaction::IsBaseLevelForKey(const Slice& user_key) {
   return true;
 }
 
+bool Compaction::IsBaseLevelForRange(const Slice& begin, const Slice& end) {
+  // "end" is exclusive, but treating it as inclusive is merely conservative.
+  for (int lvl = level_ + 2; lvl < config::kNumLevels; lvl++) {
+    if (input_version_->OverlapInLevel(lvl, &begin, &end)) {
+      return false;
+    }
+  }
+  return true;
+}
+
 bool Compaction::ShouldStopBefore(const Slice& internal_key) {
   const VersionSet* vset = input_version_->vset_;
   // Scan to find earliest grandparent file that contains key.
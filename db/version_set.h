@@ -33,6 +33,7 @@ class Writer;
 class Compaction;
 class Iterator;
 class MemTable;
+class RangeDelAggregator;
 class TableBuilder;
 class TableCache;
 class Version;
@@ -69,11 +70,23 @@ class Version {
   // REQUIRES: This version has been saved (see VersionSet::SaveTo)
   void AddIterators(const ReadOptions&, std::vector<Iterator*>* iters);
 
-  // Lookup the value for key.  If found, store it in *val and
-  // return OK.  Else return a non-OK status.  Fills *stats.
+  // Add the range tombstones of every file in this Version to *range_del.
+  // May open files, so callers should not hold the lock.
+  // REQUIRES: This version has been saved (see VersionSet::SaveTo)
+  Status AddRangeTombstones(RangeDelAggregator* range_del);
+
+  // Store in *files the (level, number) of every file whose entries all
+  // have user keys in [begin, end).
+  void GetCoveredFiles(const Slice& begin, const Slice& end,
+                       std::vector<std::pair<int, uint64_t>>* files);
+
+  // Lookup the value for key.  If found, pin it in *val (see
+  // PinnableSlice) and return OK.  Else return a non-OK status.  Fills
+  // *stats.  If the value was moved to a blob file, *val is set to its
+  // encoded BlobIndex and *is_blob_index to true.
   // REQUIRES: lock is not held
-  Status Get(const ReadOptions&, const LookupKey& key, std::string* val,
-             GetStats* stats);
+  Status Get(const ReadOptions&, const LookupKey& key, PinnableSlice* val,
+             bool* is_blob_index, GetStats* stats);
 
   // Adds "stats" into the current state.  Returns true if a new
   // compaction may need to be triggered, false otherwise.
@@ -111,6 +124,17 @@ class Version {
 
   int NumFiles(int level) const { return files_[level].size(); }
 
+  // Return the files at the specified level.
+  const std::vector<FileMetaData*>& files(int level) const {
+    return files_[level];
+  }
+
+  // Return the blob files that some table of this version points into,
+  // by file number.
+  const std::map<uint64_t, BlobFileMetaData>& blob_files() const {
+    return blob_files_;
+  }
+
   // Return a human readable string that describes this version's contents.
   std::string DebugString() const;
 
@@ -127,8 +151,11 @@ class Version {
         refs_(0),
         file_to_compact_(nullptr),
         file_to_compact_level_(-1),
+        deletion_file_to_compact_(nullptr),
+        deletion_file_to_compact_level_(-1),
         compaction_score_(-1),
-        compaction_level_(-1) {}
+        compaction_level_(-1),
+        pending_compaction_bytes_(0) {}
 
   Version(const Version&) = delete;
   Version& operator=(const Version&) = delete;
@@ -153,15 +180,28 @@ class Version {
   // List of files per level
   std::vector<FileMetaData*> files_[config::kNumLevels];
 
+  // Blob files by file number
+  std::map<uint64_t, BlobFileMetaData> blob_files_;
+
   // Next file to compact based on seek stats.
   FileMetaData* file_to_compact_;
   int file_to_compact_level_;
 
+  // File whose entries are mostly deletions, so that compacting it frees
+  // space even if nothing new is written to its range.  Initialized by
+  // Finalize().
+  FileMetaData* deletion_file_to_compact_;
+  int deletion_file_to_compact_level_;
+
   // Level that should be compacted next and its compaction score.
   // Score < 1 means compaction is not strictly needed.  These fields
   // are initialized by Finalize().
   double compaction_score_;
   int compaction_level_;
+
+  // Estimate of the bytes to compact to bring every level back within
+  // its limit.  Initialized by Finalize().
+  int64_t pending_compaction_bytes_;
 };
 
 class VersionSet {
@@ -244,6 +284,12 @@ class VersionSet {
   // file at a level >= 1.
   int64_t MaxNextLevelOverlappingBytes();
 
+  // Return an estimate of the number of bytes that must be compacted to
+  // bring every level back within its size limit.
+  int64_t EstimatedPendingCompactionBytes() const {
+    return current_->pending_compaction_bytes_;
+  }
+
   // Create an iterator that reads over the compaction inputs for "*c".
   // The caller should delete the iterator when no longer needed.
   Iterator* MakeInputIterator(Compaction* c);
@@ -251,7 +297,8 @@ class VersionSet {
   // Returns true iff some level needs a compaction.
   bool NeedsCompaction() const {
     Version* v = current_;
-    return (v->compaction_score_ >= 1) || (v->file_to_compact_ != nullptr);
+    return (v->compaction_score_ >= 1) || (v->file_to_compact_ != nullptr) ||
+           (v->deletion_file_to_compact_ != nullptr);
   }
 
   // Add all files listed in any live version to *live.
@@ -303,6 +350,8 @@ class VersionSet {
   uint64_t last_sequence_;
   uint64_t log_number_;
   uint64_t prev_log_number_;  // 0 or backing store for memtable being compacted
+  uint64_t manifest_file_size_;  // Approximate size of the current MANIFEST
+  uint64_t manifest_snapshot_size_;  // Size of its leading snapshot record
 
   // Opened lazily
   WritableFile* descriptor_file_;
@@ -349,6 +398,9 @@ class Compaction {
   // in levels greater than "level+1".
   bool IsBaseLevelForKey(const Slice& user_key);
 
+  // Like IsBaseLevelForKey(), for every user key in [begin, end).
+  bool IsBaseLevelForRange(const Slice& begin, const Slice& end);
+
   // Returns true iff we should stop building the current output
   // before processing "internal_key".
   bool ShouldStopBefore(const Slice& internal_key);
@@ -366,6 +418,7 @@ class Compaction {
   int level_;
   uint64_t max_output_file_size_;
   Version* input_version_;
+  bool for_deletions_;  // Picked to discard deletions; never a trivial move
   VersionEdit edit_;
 
   // Each compaction reads inputs from "level_" and "level_+1"
@@ -0,0 +1,78 @@
+// Copyright (c) 2011 The LevelDB Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file. See the AUTHORS file for names of contributors.
+
+#include "db/write_controller.h"
+
+#include <algorithm>
+
+namespace leveldb {
+
+namespace {
+
+// Compaction throughput assumed before any compaction has been measured.
+constexpr double kInitialCompactionRate = 16.0 * 1048576;
+
+// Writes are never paced below this rate, however far behind
+// compactions are.  Level-0 stops still apply.
+constexpr double kMinWriteRate = 1048576;
+
+// Weight of the newest sample in the compaction throughput average.
+constexpr double kRateSampleWeight = 0.3;
+
+// Credits accumulate for at most this long, which bounds the burst a
+// writer may issue after a pause.
+constexpr double kMaxBurstMicros = 1000;
+
+}  // namespace
+
+WriteController::WriteController()
+    : compaction_rate_(kInitialCompactionRate),
+      delayed_(false),
+      write_rate_(0),
+      credits_(0),
+      last_refill_micros_(0) {}
+
+void WriteController::RecordCompaction(uint64_t bytes, uint64_t micros) {
+  if (bytes == 0 || micros == 0) {
+    return;
+  }
+  const double sample = static_cast<double>(bytes) * 1e6 / micros;
+  compaction_rate_ += kRateSampleWeight * (sample - compaction_rate_);
+}
+
+uint64_t WriteController::GetDelay(uint64_t now_micros, uint64_t bytes,
+                                   double pressure) {
+  if (pressure <= 0) {
+    delayed_ = false;
+    return 0;
+  }
+  pressure = std::min(pressure, 1.0);
+  const double rate =
+      std::max(kMinWriteRate, compaction_rate_ * (1.0 - pressure));
+  if (!delayed_) {
+    // Start pacing with an empty bucket.
+    delayed_ = true;
+    credits_ = 0;
+    last_refill_micros_ = now_micros;
+  } else if (now_micros > last_refill_micros_) {
+    credits_ += write_rate_ * (now_micros - last_refill_micros_) / 1e6;
+    credits_ = std::min(credits_, rate * kMaxBurstMicros / 1e6);
+    last_refill_micros_ = now_micros;
+  }
+  write_rate_ = rate;
+
+  if (credits_ >= bytes) {
+    credits_ -= bytes;
+    return 0;
+  }
+  // The credits accrued while the writer sleeps pay for the rest of the
+  // write, so the bucket is empty when it wakes up.
+  const uint64_t delay =
+      static_cast<uint64_t>((bytes - credits_) * 1e6 / rate) + 1;
+  credits_ = 0;
+  last_refill_micros_ = now_micros + delay;
+  return delay;
+}
+
+}  // namespace leveldb
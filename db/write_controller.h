@@ -0,0 +1,54 @@
+// Copyright (c) 2011 The LevelDB Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file. See the AUTHORS file for names of contributors.
+
+#ifndef STORAGE_LEVELDB_DB_WRITE_CONTROLLER_H_
+#define STORAGE_LEVELDB_DB_WRITE_CONTROLLER_H_
+
+#include <cstdint>
+
+namespace leveldb {
+
+// Paces writes while compactions are falling behind.
+//
+// Writes draw credits (in bytes) from a token bucket that refills at a
+// rate derived from the measured throughput of recent compactions,
+// scaled down as the compaction backlog grows.  A write that finds too
+// few credits is delayed until enough have accrued, so writers slow down
+// gradually instead of alternating between full speed and fixed sleeps.
+//
+// Not thread-safe: callers must provide external synchronization.
+class WriteController {
+ public:
+  WriteController();
+
+  WriteController(const WriteController&) = delete;
+  WriteController& operator=(const WriteController&) = delete;
+
+  // Record that a compaction or memtable flush wrote "bytes" in "micros".
+  void RecordCompaction(uint64_t bytes, uint64_t micros);
+
+  // Returns the number of microseconds a write of "bytes" issued at
+  // "now_micros" should be delayed.  "pressure" describes how far
+  // compactions have fallen behind, from 0 (not at all: writes are never
+  // delayed) towards 1 (writes are about to be stopped).
+  uint64_t GetDelay(uint64_t now_micros, uint64_t bytes, double pressure);
+
+  // Returns the estimated compaction throughput in bytes per second.
+  double compaction_rate() const { return compaction_rate_; }
+
+  // Returns the rate in bytes per second at which writes are currently
+  // admitted, or 0 if writes are not being delayed.
+  double delayed_write_rate() const { return delayed_ ? write_rate_ : 0; }
+
+ private:
+  double compaction_rate_;  // Moving average of compaction throughput
+  bool delayed_;            // Was the last write subject to pacing?
+  double write_rate_;       // Bucket refill rate in bytes per second
+  double credits_;          // Bytes that may be written without delay
+  uint64_t last_refill_micros_;
+};
+
+}  // namespace leveldb
+
+#endif  // STORAGE_LEVELDB_DB_WRITE_CONTROLLER_H_
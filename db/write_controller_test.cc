@@ -0,0 +1,70 @@
+// Copyright (c) 2011 The LevelDB Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file. See the AUTHORS file for names of contributors.
+
+#include "db/write_controller.h"
+
+#include "gtest/gtest.h"
+
+namespace leveldb {
+
+static const uint64_t kMB = 1048576;
+
+TEST(WriteControllerTest, NoPressure) {
+  WriteController controller;
+  ASSERT_EQ(0, controller.GetDelay(0, 10 * kMB, 0));
+  ASSERT_EQ(0, controller.delayed_write_rate());
+}
+
+TEST(WriteControllerTest, RateFollowsCompactions) {
+  WriteController controller;
+  for (int i = 0; i < 100; i++) {
+    controller.RecordCompaction(10 * kMB, 1000000);  // 10MB/s
+  }
+  ASSERT_NEAR(10.0 * kMB, controller.compaction_rate(), 1.0);
+
+  // At half pressure writes are admitted at half the compaction rate, so
+  // 1MB takes 200ms.
+  uint64_t delay = controller.GetDelay(0, kMB, 0.5);
+  ASSERT_NEAR(200000, delay, 10);
+  ASSERT_NEAR(5.0 * kMB, controller.delayed_write_rate(), 1.0);
+
+  // Writes issued back to back pay for each other.
+  ASSERT_NEAR(200000, controller.GetDelay(delay, kMB, 0.5), 10);
+
+  // Higher pressure means longer delays.
+  ASSERT_NEAR(1000000, controller.GetDelay(2 * delay, kMB, 0.9), 10);
+}
+
+TEST(WriteControllerTest, SmallWritesUseCredits) {
+  WriteController controller;
+  controller.RecordCompaction(0, 0);  // Ignored
+  const double rate = controller.compaction_rate() / 2;
+
+  // The first write starts with an empty bucket.
+  ASSERT_GT(controller.GetDelay(1000, 100, 0.5), 0);
+
+  // A pause accrues at most a millisecond worth of credits.
+  const uint64_t now = 10000000;
+  const uint64_t burst = static_cast<uint64_t>(rate / 1000);
+  ASSERT_EQ(0, controller.GetDelay(now, burst / 2, 0.5));
+  ASSERT_EQ(0, controller.GetDelay(now, burst / 4, 0.5));
+  ASSERT_GT(controller.GetDelay(now, burst / 2, 0.5), 0);
+}
+
+TEST(WriteControllerTest, ResetsWhenCaughtUp) {
+  WriteController controller;
+  ASSERT_GT(controller.GetDelay(0, kMB, 0.5), 0);
+  ASSERT_GT(controller.delayed_write_rate(), 0);
+  ASSERT_EQ(0, controller.GetDelay(1, kMB, 0));
+  ASSERT_EQ(0, controller.delayed_write_rate());
+}
+
+TEST(WriteControllerTest, MinimumRate) {
+  WriteController controller;
+  // Even with compactions hopelessly behind, writes keep trickling in at
+  // 1MB/s.
+  ASSERT_NEAR(1000000, controller.GetDelay(0, kMB, 1.0), 10);
+}
+
+}  // namespace leveldb
@@ -61,6 +61,7 @@ typedef struct leveldb_filterpolicy_t leveldb_filterpolicy_t;
 typedef struct leveldb_iterator_t leveldb_iterator_t;
 typedef struct leveldb_logger_t leveldb_logger_t;
 typedef struct leveldb_options_t leveldb_options_t;
+typedef struct leveldb_pinnableslice_t leveldb_pinnableslice_t;
 typedef struct leveldb_randomfile_t leveldb_randomfile_t;
 typedef struct leveldb_readoptions_t leveldb_readoptions_t;
 typedef struct leveldb_seqfile_t leveldb_seqfile_t;
@@ -86,6 +87,12 @@ LEVELDB_EXPORT void leveldb_delete(leveldb_t* db,
                                    const char* key, size_t keylen,
                                    char** errptr);
 
+/* Removes every entry with a key in [start_key, limit_key). */
+LEVELDB_EXPORT void leveldb_delete_range(
+    leveldb_t* db, const leveldb_writeoptions_t* options,
+    const char* start_key, size_t start_key_len, const char* limit_key,
+    size_t limit_key_len, char** errptr);
+
 LEVELDB_EXPORT void leveldb_write(leveldb_t* db,
                                   const leveldb_writeoptions_t* options,
                                   leveldb_writebatch_t* batch, char** errptr);
@@ -97,6 +104,14 @@ LEVELDB_EXPORT char* leveldb_get(leveldb_t* db,
                                  const char* key, size_t keylen, size_t* vallen,
                                  char** errptr);
 
+/* Like leveldb_get(), but without copying the value when possible.
+   Returns NULL if not found.  Otherwise the value stays pinned until the
+   result is passed to leveldb_pinnableslice_destroy(), which must happen
+   before the db is closed. */
+LEVELDB_EXPORT leveldb_pinnableslice_t* leveldb_get_pinned(
+    leveldb_t* db, const leveldb_readoptions_t* options, const char* key,
+    size_t keylen, char** errptr);
+
 LEVELDB_EXPORT leveldb_iterator_t* leveldb_create_iterator(
     leveldb_t* db, const leveldb_readoptions_t* options);
 
@@ -145,6 +160,12 @@ LEVELDB_EXPORT const char* leveldb_iter_value(const leveldb_iterator_t*,
 LEVELDB_EXPORT void leveldb_iter_get_error(const leveldb_iterator_t*,
                                            char** errptr);
 
+/* Pinnable slice */
+
+LEVELDB_EXPORT void leveldb_pinnableslice_destroy(leveldb_pinnableslice_t*);
+LEVELDB_EXPORT const char* leveldb_pinnableslice_value(
+    const leveldb_pinnableslice_t*, size_t* vlen);
+
 /* Write batch */
 
 LEVELDB_EXPORT leveldb_writebatch_t* leveldb_writebatch_create(void);
@@ -155,6 +176,9 @@ LEVELDB_EXPORT void leveldb_writebatch_put(leveldb_writebatch_t*,
                                            const char* val, size_t vlen);
 LEVELDB_EXPORT void leveldb_writebatch_delete(leveldb_writebatch_t*,
                                               const char* key, size_t klen);
+LEVELDB_EXPORT void leveldb_writebatch_delete_range(
+    leveldb_writebatch_t*, const char* start_key, size_t start_key_len,
+    const char* limit_key, size_t limit_key_len);
 LEVELDB_EXPORT void leveldb_writebatch_iterate(
     const leveldb_writebatch_t*, void* state,
     void (*put)(void*, const char* k, size_t klen, const char* v, size_t vlen),
@@ -190,7 +214,12 @@ LEVELDB_EXPORT void leveldb_options_set_block_restart_interval(
 LEVELDB_EXPORT void leveldb_options_set_max_file_size(leveldb_options_t*,
                                                       size_t);
 
-enum { leveldb_no_compression = 0, leveldb_snappy_compression = 1 };
+enum {
+  leveldb_no_compression = 0,
+  leveldb_snappy_compression = 1,
+  leveldb_zstd_compression = 2,
+  leveldb_lz4_compression = 3
+};
 LEVELDB_EXPORT void leveldb_options_set_compression(leveldb_options_t*, int);
 
 /* Comparator */
@@ -31,6 +31,13 @@ class LEVELDB_EXPORT Cache;
 // of Cache uses a least-recently-used eviction policy.
 LEVELDB_EXPORT Cache* NewLRUCache(size_t capacity);
 
+// Like NewLRUCache(capacity), but entries inserted with Cache::kHigh
+// priority are kept in a pool of up to "high_pri_pool_ratio" of the
+// capacity, from which they are evicted only after every unreferenced
+// kLow entry.  High priority entries that do not fit in the pool age out
+// with the kLow entries.  REQUIRES: 0 <= high_pri_pool_ratio <= 1
+LEVELDB_EXPORT Cache* NewLRUCache(size_t capacity, double high_pri_pool_ratio);
+
 class LEVELDB_EXPORT Cache {
  public:
   Cache() = default;
@@ -45,6 +52,11 @@ class LEVELDB_EXPORT Cache {
   // Opaque handle to an entry stored in the cache.
   struct Handle {};
 
+  // Hint for how hard the cache should try to keep an entry.  Blocks that
+  // every read of a table goes through, such as index and filter blocks,
+  // are inserted at kHigh; data blocks at kLow.
+  enum Priority { kLow = 0, kHigh = 1 };
+
   // Insert a mapping from key->value into the cache and assign it
   // the specified charge against the total cache capacity.
   //
@@ -57,6 +69,12 @@ class LEVELDB_EXPORT Cache {
   virtual Handle* Insert(const Slice& key, void* value, size_t charge,
                          void (*deleter)(const Slice& key, void* value)) = 0;
 
+  // Like Insert() above, but with a priority hint for eviction.  The
+  // default implementation ignores the hint.
+  virtual Handle* Insert(const Slice& key, void* value, size_t charge,
+                         void (*deleter)(const Slice& key, void* value),
+                         Priority priority);
+
   // If the cache has no mapping for "key", returns nullptr.
   //
   // Else return a handle that corresponds to the mapping.  The caller
@@ -11,6 +11,7 @@
 #include "leveldb/export.h"
 #include "leveldb/iterator.h"
 #include "leveldb/options.h"
+#include "leveldb/pinnable_slice.h"
 
 namespace leveldb {
 
@@ -72,6 +73,16 @@ class LEVELDB_EXPORT DB {
   // Note: consider setting options.sync = true.
   virtual Status Delete(const WriteOptions& options, const Slice& key) = 0;
 
+  // Remove every database entry whose key lies in [begin_key, end_key).
+  // Returns OK on success, and a non-OK status on error.  It is not an
+  // error if the range is empty or holds no entries.  Unlike a sequence
+  // of Delete() calls, the cost does not depend on the number of keys
+  // removed, and table files lying entirely inside the range are dropped
+  // without being rewritten.
+  // Note: consider setting options.sync = true.
+  virtual Status DeleteRange(const WriteOptions& options,
+                             const Slice& begin_key, const Slice& end_key) = 0;
+
   // Apply the specified updates to the database.
   // Returns OK on success, non-OK on failure.
   // Note: consider setting options.sync = true.
@@ -87,6 +98,15 @@ class LEVELDB_EXPORT DB {
   virtual Status Get(const ReadOptions& options, const Slice& key,
                      std::string* value) = 0;
 
+  // Like Get() above, but when possible *value refers to the value where
+  // the database holds it instead of a copy, and keeps that memory pinned
+  // until *value is reset or destroyed.  *value should be reset before
+  // this db is deleted.
+  //
+  // The default implementation copies the value into the buffer of *value.
+  virtual Status Get(const ReadOptions& options, const Slice& key,
+                     PinnableSlice* value);
+
   // Return a heap-allocated iterator over the contents of the database.
   // The result of NewIterator() is initially invalid (caller must
   // call one of the Seek methods on the iterator before using it).
@@ -119,6 +139,21 @@ class LEVELDB_EXPORT DB {
   //     about the internal operation of the DB.
   //  "leveldb.sstables" - returns a multi-line string that describes all
   //     of the sstables that make up the db contents.
+  //  "leveldb.num-immutable-mem-table" - returns the number of full
+  //     memtables waiting to be flushed to level-0.
+  //  "leveldb.num-delayed-writes" - returns the number of writes that were
+  //     slowed down because compactions were falling behind.
+  //  "leveldb.num-stopped-writes" - returns the number of writes that had
+  //     to wait for a memtable flush or level-0 compaction to finish.
+  //  "leveldb.write-stall-micros" - returns the total time in microseconds
+  //     that writes spent slowed down or stopped.
+  //  "leveldb.recovery-micros" - returns the time in microseconds that
+  //     opening the DB spent recovering its MANIFEST and log files.
+  //  "leveldb.delayed-write-rate" - returns the rate in bytes per second
+  //     that writes are currently limited to, or 0 if they are not.
+  //  "leveldb.estimate-pending-compaction-bytes" - returns an estimate of
+  //     the number of bytes compactions must rewrite to bring every level
+  //     back within its size limit.
   //  "leveldb.approximate-memory-usage" - returns the approximate number of
   //     bytes of memory in use by the DB.
   virtual bool GetProperty(const Slice& property, std::string* value) = 0;
@@ -110,6 +110,23 @@ class LEVELDB_EXPORT Env {
   virtual Status NewAppendableFile(const std::string& fname,
                                    WritableFile** result);
 
+  // Create an object that writes to a new file with the specified name by
+  // renaming the existing file "old_fname" and overwriting it from the
+  // beginning.  The file is not truncated, so bytes beyond those written
+  // keep their old contents.  On success, stores a pointer to the new file
+  // in *result and returns OK.  On failure stores nullptr in *result and
+  // returns non-OK.
+  //
+  // The returned file will only be accessed by one thread at a time.
+  //
+  // May return an IsNotSupportedError error if this Env does not allow
+  // overwriting an existing file.  Users of Env (including the leveldb
+  // implementation) must be prepared to deal with an Env that does not
+  // support it.
+  virtual Status ReuseWritableFile(const std::string& fname,
+                                   const std::string& old_fname,
+                                   WritableFile** result);
+
   // Returns true iff the named file exists.
   virtual bool FileExists(const std::string& fname) = 0;
 
@@ -269,6 +286,13 @@ class LEVELDB_EXPORT RandomAccessFile {
   // Safe for concurrent use by multiple threads.
   virtual Status Read(uint64_t offset, size_t n, Slice* result,
                       char* scratch) const = 0;
+
+  // Returns true if Read() never uses "scratch" and instead points
+  // "*result" at data that stays live until the file is deleted (e.g. a
+  // memory-mapped file).  Callers may then pass a null "scratch".
+  //
+  // The default implementation returns false.
+  virtual bool ReadsInPlace() const;
 };
 
 // A file abstraction for sequential writing.  The implementation
@@ -287,6 +311,23 @@ class LEVELDB_EXPORT WritableFile {
   virtual Status Close() = 0;
   virtual Status Flush() = 0;
   virtual Status Sync() = 0;
+
+  // Reserve storage for the file to grow to "size" bytes, without
+  // changing its length, so that later appends need not allocate it.
+  // The default implementation does nothing.
+  virtual Status Preallocate(uint64_t size);
+
+  // Invoked by SyncAsync() once the sync has finished.
+  using SyncCallback = void (*)(void* arg, const Status& status);
+
+  // Start a Sync() and arrange for "done(arg, status)" to be called when
+  // it finishes, possibly from another thread and possibly before
+  // SyncAsync() returns.  Appends issued after SyncAsync() returns may
+  // run while the sync is in flight and are not covered by it.  The file
+  // must not be closed or deleted until "done" has been called.
+  //
+  // The default implementation calls Sync() and then "done".
+  virtual void SyncAsync(SyncCallback done, void* arg);
 };
 
 // An interface for writing log messages.
@@ -355,6 +396,10 @@ class LEVELDB_EXPORT EnvWrapper : public Env {
   Status NewAppendableFile(const std::string& f, WritableFile** r) override {
     return target_->NewAppendableFile(f, r);
   }
+  Status ReuseWritableFile(const std::string& f, const std::string& old_f,
+                           WritableFile** r) override {
+    return target_->ReuseWritableFile(f, old_f, r);
+  }
   bool FileExists(const std::string& f) override {
     return target_->FileExists(f);
   }
@@ -67,6 +67,37 @@ class LEVELDB_EXPORT FilterPolicy {
 // trailing spaces in keys.
 LEVELDB_EXPORT const FilterPolicy* NewBloomFilterPolicy(int bits_per_key);
 
+// Return a new filter policy that, like NewBloomFilterPolicy(), uses a
+// bloom filter with approximately the specified number of bits per key,
+// but confines the bits of each key to one 64-byte block of the filter.
+// Probing for a key then touches a single cache line when the filter is
+// 64-byte aligned (and at most two otherwise) instead of one per bit,
+// which makes lookups of missing keys cheaper at the cost of a slightly
+// higher false positive rate (still ~1% for 10 bits per key).  Each key
+// sets eight bits, so bits_per_key should be at least 8.
+//
+// The filters are not compatible with those of NewBloomFilterPolicy(), and
+// tables written with one policy are read without filters by the other.
+// The same note about custom comparators applies.
+LEVELDB_EXPORT const FilterPolicy* NewBlockedBloomFilterPolicy(
+    int bits_per_key);
+
+// Return a new filter policy that uses a ribbon filter with the false
+// positive rate of a bloom filter of the specified number of bits per
+// key, in about 25% less space (7.5 to 8 bits per key for 10, depending
+// on the number of keys in the filter).  Building a filter takes about
+// twice as long as with NewBloomFilterPolicy(), and probing it reads r
+// 64-bit words, where r is about 0.69 * bits_per_key.  Filters of fewer
+// than a few hundred keys gain little; the policy is best combined with
+// Options::whole_table_filter or partitioned filters.
+//
+// The policy reads the filters of NewBloomFilterPolicy(), so that it can
+// replace that policy on an existing database, and it falls back to
+// writing bloom filters for sets of keys too small to benefit.
+// Conversely, NewBloomFilterPolicy() treats ribbon filters as matching
+// every key.  The same note about custom comparators applies.
+LEVELDB_EXPORT const FilterPolicy* NewRibbonFilterPolicy(int bits_per_key);
+
 }  // namespace leveldb
 
 #endif  // STORAGE_LEVELDB_INCLUDE_FILTER_POLICY_H_
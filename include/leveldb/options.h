@@ -6,6 +6,7 @@
 #define STORAGE_LEVELDB_INCLUDE_OPTIONS_H_
 
 #include <cstddef>
+#include <vector>
 
 #include "leveldb/export.h"
 
@@ -16,6 +17,8 @@ class Comparator;
 class Env;
 class FilterPolicy;
 class Logger;
+class RateLimiter;
+class SliceTransform;
 class Snapshot;
 
 // DB contents are stored in a set of blocks, each of which holds a
@@ -26,7 +29,25 @@ enum CompressionType {
   // NOTE: do not change the values of existing entries, as these are
   // part of the persistent format on disk.
   kNoCompression = 0x0,
-  kSnappyCompression = 0x1
+  kSnappyCompression = 0x1,
+  kZstdCompression = 0x2,
+  kLZ4Compression = 0x3
+};
+
+// The data structure used to index the entries of a memtable.
+enum MemTableRep {
+  // Entries are kept sorted as they are inserted.  Lookups, insertions
+  // and iteration all cost O(log n) per entry.
+  kSkipListMemTable = 0x0,
+  // Entries are indexed by a hash of their user key, so lookups of
+  // recently written keys cost O(1).  The entries are sorted only when an
+  // iterator is created, which costs O(n log n) if the memtable changed
+  // since the last sort.  Suited to point-lookup-heavy workloads that
+  // rarely iterate.
+  //
+  // REQUIRES: the comparator considers two keys equal only if they are
+  // byte-wise identical.
+  kHashMemTable = 0x1
 };
 
 // Options to control the behavior of a database (passed to DB::Open)
@@ -75,17 +96,46 @@ struct LEVELDB_EXPORT Options {
   // on disk) before converting to a sorted on-disk file.
   //
   // Larger values increase performance, especially during bulk loads.
-  // Up to two write buffers may be held in memory at the same time,
-  // so you may wish to adjust this parameter to control memory usage.
+  // Up to max_write_buffer_number write buffers may be held in memory at
+  // the same time, so you may wish to adjust this parameter to control
+  // memory usage.
   // Also, a larger write buffer will result in a longer recovery time
   // the next time the database is opened.
   size_t write_buffer_size = 4 * 1024 * 1024;
 
+  // Maximum number of write buffers held in memory: the active one plus
+  // the full ones waiting to be flushed.  When a write buffer fills up
+  // while the others are still being flushed, writes stall until the
+  // oldest flush completes.  Raising this absorbs write bursts that
+  // outpace flushing, at the cost of memory and recovery time.
+  //
+  // Values outside [2, 64] are clipped.
+  int max_write_buffer_number = 2;
+
+  // If true, each memtable allocates its memory from one contiguous
+  // region backed by huge pages where the platform supports them, which
+  // reduces TLB misses when searching and inserting into the memtable.
+  // The region of a flushed memtable is reused by its successor.
+  bool memtable_huge_pages = false;
+
+  // Data structure used to index memtable entries.
+  MemTableRep memtable_rep = kSkipListMemTable;
+
   // Number of open files that can be used by the DB.  You may need to
   // increase this if your database has a large working set (budget
   // one open file per 2MB of working set).
   int max_open_files = 1000;
 
+  // If true, DB::Open() opens the table files of the database, as many as
+  // max_open_files allows, and loads their index and filter blocks before
+  // returning, so that the first reads after a restart do not pay for it.
+  // If paranoid_checks is also set, the length of every table file is
+  // checked against the MANIFEST and a mismatch fails the open.
+  bool open_files_on_startup = false;
+
+  // Number of threads open_files_on_startup uses to open table files.
+  int max_file_opening_threads = 4;
+
   // Control over blocks (user data is stored in a set of blocks, and
   // a block is the unit of reading from disk).
 
@@ -93,6 +143,23 @@ struct LEVELDB_EXPORT Options {
   // If null, leveldb will automatically create and use an 8MB internal cache.
   Cache* block_cache = nullptr;
 
+  // If true, the index and filter blocks of open tables are kept in
+  // block_cache at Cache::kHigh priority and charged against its capacity,
+  // instead of being held outside of it for as long as a table is open.
+  // They are read back from the file once evicted.  block_cache should
+  // then have a high priority pool (see NewLRUCache()) so that data blocks
+  // do not push them out; if block_cache is null, half of the internal
+  // cache is set aside for them.  Blocks of tables read through mmap use no
+  // heap memory and stay outside of the cache.
+  bool cache_index_and_filter_blocks = false;
+
+  // If true and cache_index_and_filter_blocks is set, level-0 tables pin
+  // their index and filter blocks in block_cache once a lookup reaches
+  // them, so that these are never evicted.  Every read that misses the
+  // memtable searches all level-0 tables.  The blocks stay pinned until
+  // the table is closed, even if a compaction moves it to another level.
+  bool pin_l0_index_and_filter_blocks_in_cache = false;
+
   // Approximate size of user data packed per block.  Note that the
   // block size specified here corresponds to uncompressed data.  The
   // actual size of the unit read from disk may be smaller if
@@ -104,6 +171,35 @@ struct LEVELDB_EXPORT Options {
   // leave this parameter alone.
   int block_restart_interval = 16;
 
+  // If true, split the index and filter blocks of each table into
+  // partitions of about block_size bytes, located through a small
+  // top-level index.  Only the top-level index stays in memory while a
+  // table is open.  The partitions are read on demand through the block
+  // cache and may be evicted from it, so that the memory used by the
+  // index and filters of large tables is bounded by the cache size.
+  // Lookups cost one more block read (or block cache lookup).
+  //
+  // Tables written with this option cannot be read by older versions of
+  // leveldb.  This parameter can be changed dynamically.
+  //
+  // Default: false
+  bool partition_index_and_filters = false;
+
+  // If true, end each data block with a hash index from user keys to the
+  // restart points holding them.  Point lookups in a block then jump to
+  // the right restart point instead of binary searching the restart
+  // array, and skip blocks that do not hold the key at all, which saves
+  // CPU when the data is cached.  The index takes about one byte per key.
+  // Blocks with more than 253 restart points are written without it.
+  // Requires a comparator under which user keys are equal only if their
+  // bytes are, as is the case for the default comparator.
+  //
+  // Tables written with this option cannot be read by older versions of
+  // leveldb.  This parameter can be changed dynamically.
+  //
+  // Default: false
+  bool data_block_hash_index = false;
+
   // Leveldb will write up to this amount of bytes to a file before
   // switching to a new one.
   // Most clients should leave this parameter alone.  However if your
@@ -130,16 +226,122 @@ struct LEVELDB_EXPORT Options {
   // efficiently detect that and will switch to uncompressed mode.
   CompressionType compression = kSnappyCompression;
 
+  // If non-empty, entry i is the compression used for tables written to
+  // level i in place of "compression", and the last entry also applies to
+  // every deeper level.  This lets the small, frequently rewritten upper
+  // levels use a fast algorithm (or none) while the large bottom levels,
+  // which hold most of the data and are rarely rewritten, use a stronger
+  // one such as kZstdCompression.  Memtable flushes use entry 0.
+  //
+  // Default: empty
+  std::vector<CompressionType> compression_per_level;
+
+  // Compression level passed to zstd for blocks compressed with
+  // kZstdCompression.  Higher levels compress better but more slowly;
+  // negative levels trade compression ratio for speed.  Blocks are
+  // decompressed at the same speed whatever level they were written at.
+  //
+  // Default: 1
+  int zstd_compression_level = 1;
+
   // EXPERIMENTAL: If true, append to existing MANIFEST and log files
   // when a database is opened.  This can significantly speed up open.
   //
   // Default: currently false, but may become true later.
   bool reuse_logs = false;
 
+  // Compress the write-ahead log using the specified compression
+  // algorithm.  When set, log records are packed into groups that are
+  // compressed and written out together (see wal_bytes_per_flush).  Logs
+  // written this way cannot be read by older versions of leveldb.
+  //
+  // Default: kNoCompression, which writes every record on its own in the
+  // original log format.
+  CompressionType wal_compression = kNoCompression;
+
+  // If wal_compression is set, buffer up to this many bytes of log
+  // records before compressing them and writing them out.  Larger values
+  // compress better and issue fewer writes to the log file, but records
+  // still buffered are lost if the process crashes, not only if the
+  // machine does.  Writes with WriteOptions::sync set, switching to a new
+  // log file and closing the database write out all buffered records.
+  //
+  // Default: 0, which writes out every record immediately.
+  size_t wal_bytes_per_flush = 0;
+
+  // If non-zero, keep up to this many write-ahead log files that are no
+  // longer needed and overwrite them with new logs instead of creating
+  // new files.  Overwriting a file in place spares the file system from
+  // updating its metadata on every sync, which makes synced writes
+  // cheaper.  Logs are then written in a format that older versions of
+  // leveldb cannot read.
+  //
+  // Default: 0
+  size_t recycle_log_file_num = 0;
+
+  // Once the MANIFEST grows past this many bytes, the next change to the
+  // set of files starts a new MANIFEST that holds a snapshot of the
+  // current state, so that opening the database does not replay a long
+  // history of edits.
+  //
+  // Default: 4MB
+  size_t max_manifest_file_size = 4 * 1024 * 1024;
+
+  // If non-zero, values of at least this many bytes are moved out of the
+  // tables into append-only blob files when the memtable is written out,
+  // and the tables keep a small pointer to them instead.  Compactions then
+  // rewrite only the pointers, which saves most of the bytes they write
+  // when values are large.  Reading such a value takes one more read, from
+  // its blob file.  Databases that hold blob files cannot be opened by
+  // older versions of leveldb.
+  //
+  // Default: 0, which keeps every value in the tables.
+  size_t min_blob_size = 0;
+
+  // Values dropped by compactions are left behind in their blob files as
+  // garbage, and a blob file is deleted once all of it is.  Compactions
+  // move the live values out of the blob files in which at least this
+  // fraction of the bytes is garbage, so that these can be deleted sooner.
+  // Higher fractions write less but leave more garbage on disk.
+  //
+  // Default: 0.5
+  double blob_gc_ratio = 0.5;
+
   // If non-null, use the specified filter policy to reduce disk reads.
   // Many applications will benefit from passing the result of
   // NewBloomFilterPolicy() here.
   const FilterPolicy* filter_policy = nullptr;
+
+  // If true, build one filter over all the keys of each table instead of
+  // one for every 2KB of data blocks.  Point lookups check it before
+  // searching the index, so a key missing from a table costs a single
+  // filter probe.  The filter of a table is held in memory in full while
+  // the table is open.  Ignored if partition_index_and_filters is set.
+  //
+  // Tables written with this option are read without their filter by
+  // older versions of leveldb.  This parameter can be changed dynamically.
+  bool whole_table_filter = false;
+
+  // If non-null, the prefixes that this transform extracts from the keys
+  // of a table are added to its filter, and iterators reading with
+  // ReadOptions::prefix_same_as_start skip the tables whose filter rules
+  // out the prefix of the key they seek to.  Requires filter_policy.  The
+  // prefixes go in a whole-table filter, which is built as if
+  // whole_table_filter were set; they are not recorded if
+  // partition_index_and_filters is set.
+  //
+  // Tables keep the name of the transform, and their prefixes are ignored
+  // if it changes.
+  const SliceTransform* prefix_extractor = nullptr;
+
+  // If non-null, memtable flushes and compactions pass the data they
+  // write through this rate limiter, flushes at a higher priority than
+  // compactions.  The limiter may be shared by several DBs.
+  RateLimiter* rate_limiter = nullptr;
+
+  // If true and rate_limiter is non-null, compactions also pass the data
+  // they read through the rate limiter, measured in uncompressed bytes.
+  bool rate_limit_compaction_reads = false;
 };
 
 // Options that control read operations
@@ -157,6 +359,15 @@ struct LEVELDB_EXPORT ReadOptions {
   // not have been released).  If "snapshot" is null, use an implicit
   // snapshot of the state at the beginning of this read operation.
   const Snapshot* snapshot = nullptr;
+
+  // If true and the DB has an Options::prefix_extractor, an iterator
+  // positioned by Seek(target) only yields keys with the prefix of
+  // "target", and becomes invalid after the last of them.  Tables whose
+  // filter rules out the prefix are not read.  Seeks to keys outside the
+  // domain of the transform are not restricted.  SeekToFirst() followed by
+  // Next() still visits the whole DB, but Prev() and SeekToLast() are not
+  // supported: they make the iterator invalid with a NotSupported status.
+  bool prefix_same_as_start = false;
 };
 
 // Options that control write operations
@@ -0,0 +1,97 @@
+// Copyright (c) 2011 The LevelDB Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file. See the AUTHORS file for names of contributors.
+//
+// A PinnableSlice is a Slice that can keep the data it refers to alive.
+// DB::Get() uses one to return a value without copying it: the slice
+// then refers to the value where the database holds it (a block in the
+// block cache, a memory-mapped table or a memtable) and keeps that memory
+// pinned until the slice is reset or destroyed.
+//
+// Multiple threads can invoke const methods on a PinnableSlice without
+// external synchronization, but if any of the threads may call a
+// non-const method, all threads accessing the same PinnableSlice must use
+// external synchronization.
+
+#ifndef STORAGE_LEVELDB_INCLUDE_PINNABLE_SLICE_H_
+#define STORAGE_LEVELDB_INCLUDE_PINNABLE_SLICE_H_
+
+#include <string>
+
+#include "leveldb/export.h"
+#include "leveldb/slice.h"
+
+namespace leveldb {
+
+class LEVELDB_EXPORT PinnableSlice : public Slice {
+ public:
+  using CleanupFunction = void (*)(void* arg1, void* arg2);
+
+  // Create an empty slice that copies data into a buffer of its own.
+  PinnableSlice() : buf_(&self_space_), cleanup_(nullptr) {}
+
+  // Create an empty slice that copies data into "*buf", which must outlive
+  // the slice.
+  explicit PinnableSlice(std::string* buf) : buf_(buf), cleanup_(nullptr) {}
+
+  PinnableSlice(const PinnableSlice&) = delete;
+  PinnableSlice& operator=(const PinnableSlice&) = delete;
+
+  ~PinnableSlice() { Reset(); }
+
+  // Refer to "s", whose data stays live until (*cleanup)(arg1, arg2) is
+  // called when this slice is reset or destroyed.
+  void PinSlice(const Slice& s, CleanupFunction cleanup, void* arg1,
+                void* arg2) {
+    Unpin();
+    Slice::operator=(s);
+    cleanup_ = cleanup;
+    arg1_ = arg1;
+    arg2_ = arg2;
+  }
+
+  // Refer to a copy of "s" held in the buffer of the slice.
+  void PinSelf(const Slice& s) {
+    Unpin();
+    buf_->assign(s.data(), s.size());
+    Slice::operator=(*buf_);
+  }
+
+  // Refer to the current contents of the buffer of the slice (see
+  // GetSelf()).
+  void PinSelf() {
+    Unpin();
+    Slice::operator=(*buf_);
+  }
+
+  // Return the buffer of the slice, for callers that fill it in place
+  // before calling PinSelf().
+  std::string* GetSelf() { return buf_; }
+
+  // Return true iff the slice refers to data it does not hold itself.
+  bool IsPinned() const { return cleanup_ != nullptr; }
+
+  // Release any pinned data and make the slice empty.
+  void Reset() {
+    Unpin();
+    clear();
+  }
+
+ private:
+  void Unpin() {
+    if (cleanup_ != nullptr) {
+      (*cleanup_)(arg1_, arg2_);
+      cleanup_ = nullptr;
+    }
+  }
+
+  std::string self_space_;
+  std::string* const buf_;
+  CleanupFunction cleanup_;
+  void* arg1_;
+  void* arg2_;
+};
+
+}  // namespace leveldb
+
+#endif  // STORAGE_LEVELDB_INCLUDE_PINNABLE_SLICE_H_
@@ -0,0 +1,57 @@
+// Copyright (c) 2011 The LevelDB Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file. See the AUTHORS file for names of contributors.
+//
+// A RateLimiter bounds the rate at which background work (memtable
+// flushes and compactions) performs I/O, so that it does not starve
+// foreground reads and writes of disk bandwidth.  It has internal
+// synchronization and may be shared by several DBs.
+//
+// A builtin token-bucket implementation is provided.
+
+#ifndef STORAGE_LEVELDB_INCLUDE_RATE_LIMITER_H_
+#define STORAGE_LEVELDB_INCLUDE_RATE_LIMITER_H_
+
+#include <cstddef>
+#include <cstdint>
+
+#include "leveldb/export.h"
+
+namespace leveldb {
+
+class LEVELDB_EXPORT RateLimiter {
+ public:
+  // Requests of higher priority are granted before any waiting request
+  // of lower priority.  Memtable flushes run at kHigh so that they are
+  // not held up behind compactions, which run at kLow.
+  enum Priority { kLow = 0, kHigh = 1, kNumPriorities = 2 };
+
+  RateLimiter() = default;
+
+  RateLimiter(const RateLimiter&) = delete;
+  RateLimiter& operator=(const RateLimiter&) = delete;
+
+  // REQUIRES: no calls to Request() are in progress.
+  virtual ~RateLimiter();
+
+  // Block until "bytes" of I/O at priority "pri" may proceed.
+  virtual void Request(size_t bytes, Priority pri) = 0;
+
+  // Change the rate limit.  Takes effect within a fraction of a second,
+  // including for requests that are already waiting.
+  virtual void SetBytesPerSecond(int64_t bytes_per_second) = 0;
+
+  // Return the current rate limit.
+  virtual int64_t GetBytesPerSecond() const = 0;
+
+  // Return the total number of bytes requested at priority "pri".
+  virtual int64_t GetTotalBytesThrough(Priority pri) const = 0;
+};
+
+// Create a rate limiter that admits "bytes_per_second" bytes of I/O per
+// second, distributed in refills a tenth of a second apart.
+LEVELDB_EXPORT RateLimiter* NewGenericRateLimiter(int64_t bytes_per_second);
+
+}  // namespace leveldb
+
+#endif  // STORAGE_LEVELDB_INCLUDE_RATE_LIMITER_H_
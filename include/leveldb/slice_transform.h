@@ -0,0 +1,63 @@
+// Copyright (c) 2011 The LevelDB Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file. See the AUTHORS file for names of contributors.
+//
+// A SliceTransform maps keys to their prefixes.  A database configured
+// with one (see Options::prefix_extractor) records the prefixes of the keys
+// of each table in the table's filter, so that iterators reading with
+// ReadOptions::prefix_same_as_start can skip the tables that hold no key
+// of the prefix they seek to.
+
+#ifndef STORAGE_LEVELDB_INCLUDE_SLICE_TRANSFORM_H_
+#define STORAGE_LEVELDB_INCLUDE_SLICE_TRANSFORM_H_
+
+#include <cstddef>
+
+#include "leveldb/export.h"
+#include "leveldb/slice.h"
+
+namespace leveldb {
+
+class LEVELDB_EXPORT SliceTransform {
+ public:
+  virtual ~SliceTransform();
+
+  // The name of the transform.  Tables record the name of the transform
+  // that computed their prefixes and do not use them with a transform of
+  // another name, so the name must change whenever the prefix of some key
+  // would.
+  virtual const char* Name() const = 0;
+
+  // Return true if "key" has a prefix.  Keys without one are not recorded
+  // and seeks to them never skip a table.
+  virtual bool InDomain(const Slice& key) const = 0;
+
+  // Return the prefix of "key", which must be in the domain.  The result
+  // must be a leading part of "key" (or refer to data that outlives the
+  // transform), and the keys that share a prefix must be adjacent in the
+  // order of the comparator of the database.  Any transform that returns
+  // a leading part of "key" satisfies this with the default comparator.
+  virtual Slice Transform(const Slice& key) const = 0;
+};
+
+// Return a new transform whose prefixes are the first "prefix_len" bytes
+// of the keys.  Keys shorter than that have no prefix.
+//
+// Callers must delete the result after any database that is using the
+// result has been closed.
+LEVELDB_EXPORT const SliceTransform* NewFixedPrefixTransform(
+    size_t prefix_len);
+
+// Return a new transform whose prefixes run through the "count"-th
+// occurrence of "delimiter" in the keys.  For example, with '/' and 2 the
+// prefix of "tenant/entity/timestamp" is "tenant/entity/".  Keys with
+// fewer delimiters have no prefix.
+//
+// Callers must delete the result after any database that is using the
+// result has been closed.
+LEVELDB_EXPORT const SliceTransform* NewDelimitedPrefixTransform(
+    char delimiter, int count);
+
+}  // namespace leveldb
+
+#endif  // STORAGE_LEVELDB_INCLUDE_SLICE_TRANSFORM_H_
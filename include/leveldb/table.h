@@ -7,6 +7,7 @@
 
 #include <cstdint>
 
+#include "leveldb/cache.h"
 #include "leveldb/export.h"
 #include "leveldb/iterator.h"
 
@@ -64,17 +65,62 @@ class LEVELDB_EXPORT Table {
 
   static Iterator* BlockReader(void*, const ReadOptions&, const Slice&);
 
+  // Like BlockReader(), but for the partitions of a partitioned index.
+  static Iterator* IndexPartitionReader(void*, const ReadOptions&,
+                                        const Slice&);
+
+  // Like BlockReader(), but if "get_key" is non-null the iterator comes
+  // positioned for a point lookup of *get_key.  A block read from the file
+  // is inserted in the block cache at "priority".
+  static Iterator* DataBlockReader(Table* table, const ReadOptions& options,
+                                   const Slice& index_value,
+                                   const Slice* get_key,
+                                   Cache::Priority priority);
+
   explicit Table(Rep* rep) : rep_(rep) {}
 
+  // Return an iterator over the index entries, which map a key >= the
+  // last key of each data block to the block's handle.
+  Iterator* NewIndexIterator(const ReadOptions& options) const;
+
+  // Return an iterator over the index block itself, which is the
+  // top-level index if the index is partitioned.
+  Iterator* NewIndexBlockIterator(const ReadOptions& options) const;
+
+  // If the index and filter blocks are kept in the block cache, hold on
+  // to them there until the table is closed.
+  void PinIndexAndFilter();
+
+  // Return false if the filter of a table that is not partitioned rules
+  // out key "k" in the data block at "block_offset" (0 if the filter is a
+  // whole-table filter).
+  bool FilterMayMatch(const ReadOptions& options, uint64_t block_offset,
+                      const Slice& k);
+
+  // Return false if the table holds no key with the prefix of key "k"
+  // according to its filter (see Options::prefix_extractor).
+  bool PrefixMayMatch(const ReadOptions& options, const Slice& k);
+
   // Calls (*handle_result)(arg, ...) with the entry found after a call
-  // to Seek(key).  May not make such a call if filter policy says
-  // that key is not present.
+  // to Seek(key).  May not make such a call if filter policy or the
+  // data block hash index says that key is not present, and may pass an
+  // entry for another user key instead of the one Seek(key) would find.
+  //
+  // If "pinned" is non-null, *pinned is set to an iterator that keeps the
+  // entry passed to handle_result live until the iterator is deleted, or
+  // to nullptr if there was no such call.
   Status InternalGet(const ReadOptions&, const Slice& key, void* arg,
                      void (*handle_result)(void* arg, const Slice& k,
-                                           const Slice& v));
+                                           const Slice& v),
+                     Iterator** pinned = nullptr);
+
+  // Returns an iterator over the range tombstones stored in the table,
+  // or nullptr if the table has none.
+  Iterator* NewRangeTombstoneIterator() const;
 
-  void ReadMeta(const Footer& footer);
+  Status ReadMeta(const Footer& footer);
   void ReadFilter(const Slice& filter_handle_value);
+  Status ReadRangeDelBlock(const Slice& handle_value);
 
   Rep* const rep_;
 };
@@ -51,6 +51,14 @@ class LEVELDB_EXPORT TableBuilder {
   // REQUIRES: Finish(), Abandon() have not been called
   void Add(const Slice& key, const Slice& value);
 
+  // Add a range tombstone to the table being constructed.  Tombstones are
+  // kept in a separate meta block, so they may be interleaved freely with
+  // calls to Add().
+  // REQUIRES: key is after any previously added tombstone key according
+  // to comparator.
+  // REQUIRES: Finish(), Abandon() have not been called
+  void AddRangeTombstone(const Slice& key, const Slice& value);
+
   // Advanced operation: flush any buffered key/value pairs to file.
   // Can be used to ensure that two adjacent entries never live in
   // the same data block.  Most clients should not need to use this method.
@@ -75,6 +83,9 @@ class LEVELDB_EXPORT TableBuilder {
   // Number of calls to Add() so far.
   uint64_t NumEntries() const;
 
+  // Number of calls to AddRangeTombstone() so far.
+  uint64_t NumRangeTombstones() const;
+
   // Size of the file generated so far.  If invoked after a successful
   // Finish() call, returns the size of the final generated file.
   uint64_t FileSize() const;
@@ -83,6 +94,8 @@ class LEVELDB_EXPORT TableBuilder {
   bool ok() const { return status().ok(); }
   void WriteBlock(BlockBuilder* block, BlockHandle* handle);
   void WriteRawBlock(const Slice& data, CompressionType, BlockHandle* handle);
+  void AddIndexEntry(bool last);
+  void WriteIndexPartition();
 
   struct Rep;
   Rep* rep_;
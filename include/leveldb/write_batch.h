@@ -37,6 +37,9 @@ class LEVELDB_EXPORT WriteBatch {
     virtual ~Handler();
     virtual void Put(const Slice& key, const Slice& value) = 0;
     virtual void Delete(const Slice& key) = 0;
+    // Called for every DeleteRange() record.  The default implementation
+    // ignores range deletions so that existing handlers keep working.
+    virtual void DeleteRange(const Slice& begin_key, const Slice& end_key);
   };
 
   WriteBatch();
@@ -53,6 +56,10 @@ class LEVELDB_EXPORT WriteBatch {
   // If the database contains a mapping for "key", erase it.  Else do nothing.
   void Delete(const Slice& key);
 
+  // Erase every mapping whose key lies in the range [begin_key, end_key).
+  // Does nothing if begin_key >= end_key under the database comparator.
+  void DeleteRange(const Slice& begin_key, const Slice& end_key);
+
   // Clear all updates buffered in this batch.
   void Clear();
 
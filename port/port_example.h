@@ -81,6 +81,37 @@ bool Snappy_GetUncompressedLength(const char* input, size_t length,
 bool Snappy_Uncompress(const char* input_data, size_t input_length,
                        char* output);
 
+// Store the zstd compression of "input[0,input_length-1]" at compression
+// level "level" in *output.  Returns false if zstd is not supported by
+// this port.
+bool Zstd_Compress(int level, const char* input, size_t input_length,
+                   std::string* output);
+
+// If input[0,input_length-1] looks like a valid zstd compressed buffer,
+// store the size of the uncompressed data in *result and return true.
+// Else return false.
+bool Zstd_GetUncompressedLength(const char* input, size_t length,
+                                size_t* result);
+
+// Attempt to zstd uncompress input[0,input_length-1] into *output.
+// Returns true if successful, false if the input is invalid zstd
+// compressed data.
+//
+// REQUIRES: at least the first "n" bytes of output[] must be writable
+// where "n" is the result of a successful call to
+// Zstd_GetUncompressedLength.
+bool Zstd_Uncompress(const char* input_data, size_t input_length,
+                     char* output);
+
+// LZ4 counterparts of the Snappy_* functions above.  Returns false if LZ4
+// is not supported by this port.
+bool LZ4_Compress(const char* input, size_t input_length,
+                  std::string* output);
+bool LZ4_GetUncompressedLength(const char* input, size_t length,
+                               size_t* result);
+bool LZ4_Uncompress(const char* input_data, size_t input_length,
+                    char* output);
+
 // ------------------ Miscellaneous -------------------
 
 // If heap profiling is not supported, returns false.
@@ -94,6 +125,10 @@ bool GetHeapProfile(void (*func)(void*, const char*, int), void* arg);
 // the newly extended CRC value (which may also be zero).
 uint32_t AcceleratedCRC32C(uint32_t crc, const char* buf, size_t size);
 
+// Hints the processor to load the cache line holding "addr" for reading.
+// May do nothing.
+void Prefetch(const void* addr);
+
 }  // namespace port
 }  // namespace leveldb
 
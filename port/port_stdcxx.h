@@ -28,6 +28,12 @@
 #if HAVE_SNAPPY
 #include <snappy.h>
 #endif  // HAVE_SNAPPY
+#if HAVE_ZSTD
+#include <zstd.h>
+#endif  // HAVE_ZSTD
+#if HAVE_LZ4
+#include <lz4.h>
+#endif  // HAVE_LZ4
 
 #include <cassert>
 #include <condition_variable>  // NOLINT
@@ -126,6 +132,137 @@ inline bool Snappy_Uncompress(const char* input, size_t length, char* output) {
 #endif  // HAVE_SNAPPY
 }
 
+inline bool Zstd_Compress(int level, const char* input, size_t length,
+                          std::string* output) {
+#if HAVE_ZSTD
+  output->resize(ZSTD_compressBound(length));
+  size_t outlen =
+      ZSTD_compress(&(*output)[0], output->size(), input, length, level);
+  if (ZSTD_isError(outlen)) {
+    return false;
+  }
+  output->resize(outlen);
+  return true;
+#else
+  // Silence compiler warnings about unused arguments.
+  (void)level;
+  (void)input;
+  (void)length;
+  (void)output;
+  return false;
+#endif  // HAVE_ZSTD
+}
+
+inline bool Zstd_GetUncompressedLength(const char* input, size_t length,
+                                       size_t* result) {
+#if HAVE_ZSTD
+  unsigned long long size = ZSTD_getFrameContentSize(input, length);
+  if (size == ZSTD_CONTENTSIZE_UNKNOWN || size == ZSTD_CONTENTSIZE_ERROR) {
+    return false;
+  }
+  *result = static_cast<size_t>(size);
+  return true;
+#else
+  // Silence compiler warnings about unused arguments.
+  (void)input;
+  (void)length;
+  (void)result;
+  return false;
+#endif  // HAVE_ZSTD
+}
+
+inline bool Zstd_Uncompress(const char* input, size_t length, char* output) {
+#if HAVE_ZSTD
+  size_t outlen;
+  if (!Zstd_GetUncompressedLength(input, length, &outlen)) {
+    return false;
+  }
+  size_t result = ZSTD_decompress(output, outlen, input, length);
+  return !ZSTD_isError(result) && result == outlen;
+#else
+  // Silence compiler warnings about unused arguments.
+  (void)input;
+  (void)length;
+  (void)output;
+  return false;
+#endif  // HAVE_ZSTD
+}
+
+// The LZ4 block format does not record the uncompressed length, so the
+// output of LZ4_Compress starts with it as a little-endian fixed32.
+inline bool LZ4_Compress(const char* input, size_t length,
+                         std::string* output) {
+#if HAVE_LZ4
+  if (length > static_cast<size_t>(LZ4_MAX_INPUT_SIZE)) {
+    return false;
+  }
+  const int bound = LZ4_compressBound(static_cast<int>(length));
+  output->resize(4 + bound);
+  for (int i = 0; i < 4; i++) {
+    (*output)[i] = static_cast<char>((length >> (8 * i)) & 0xff);
+  }
+  const int outlen = LZ4_compress_default(input, &(*output)[4],
+                                          static_cast<int>(length), bound);
+  if (outlen <= 0) {
+    return false;
+  }
+  output->resize(4 + outlen);
+  return true;
+#else
+  // Silence compiler warnings about unused arguments.
+  (void)input;
+  (void)length;
+  (void)output;
+  return false;
+#endif  // HAVE_LZ4
+}
+
+inline bool LZ4_GetUncompressedLength(const char* input, size_t length,
+                                      size_t* result) {
+#if HAVE_LZ4
+  if (length < 4) {
+    return false;
+  }
+  size_t size = 0;
+  for (int i = 0; i < 4; i++) {
+    size |= static_cast<size_t>(static_cast<uint8_t>(input[i])) << (8 * i);
+  }
+  // Each byte of LZ4 input expands to at most 255 bytes of output.  Reject
+  // corrupt lengths before the caller allocates a buffer for them.
+  if (size > (length - 4) * 255) {
+    return false;
+  }
+  *result = size;
+  return true;
+#else
+  // Silence compiler warnings about unused arguments.
+  (void)input;
+  (void)length;
+  (void)result;
+  return false;
+#endif  // HAVE_LZ4
+}
+
+inline bool LZ4_Uncompress(const char* input, size_t length, char* output) {
+#if HAVE_LZ4
+  size_t outlen;
+  if (!LZ4_GetUncompressedLength(input, length, &outlen) ||
+      outlen > static_cast<size_t>(LZ4_MAX_INPUT_SIZE)) {
+    return false;
+  }
+  const int result =
+      LZ4_decompress_safe(input + 4, output, static_cast<int>(length - 4),
+                          static_cast<int>(outlen));
+  return result >= 0 && static_cast<size_t>(result) == outlen;
+#else
+  // Silence compiler warnings about unused arguments.
+  (void)input;
+  (void)length;
+  (void)output;
+  return false;
+#endif  // HAVE_LZ4
+}
+
 inline bool GetHeapProfile(void (*func)(void*, const char*, int), void* arg) {
   // Silence compiler warnings about unused arguments.
   (void)func;
@@ -145,6 +282,16 @@ inline uint32_t AcceleratedCRC32C(uint32_t crc, const char* buf, size_t size) {
 #endif  // HAVE_CRC32C
 }
 
+// Hints the processor to load the cache line holding "addr" for reading.
+inline void Prefetch(const void* addr) {
+#if defined(__GNUC__) || defined(__clang__)
+  __builtin_prefetch(addr, 0 /* read */, 3 /* high locality */);
+#else
+  // Silence compiler warnings about unused arguments.
+  (void)addr;
+#endif  // defined(__GNUC__) || defined(__clang__)
+}
+
 }  // namespace port
 }  // namespace leveldb
 
@@ -17,25 +17,42 @@
 
 namespace leveldb {
 
-inline uint32_t Block::NumRestarts() const {
-  assert(size_ >= sizeof(uint32_t));
-  return DecodeFixed32(data_ + size_ - sizeof(uint32_t));
-}
-
 Block::Block(const BlockContents& contents)
     : data_(contents.data.data()),
       size_(contents.data.size()),
+      restart_offset_(0),
+      num_restarts_(0),
+      hash_buckets_(nullptr),
+      num_hash_buckets_(0),
       owned_(contents.heap_allocated) {
   if (size_ < sizeof(uint32_t)) {
     size_ = 0;  // Error marker
-  } else {
-    size_t max_restarts_allowed = (size_ - sizeof(uint32_t)) / sizeof(uint32_t);
-    if (NumRestarts() > max_restarts_allowed) {
-      // The size is too small for NumRestarts()
+    return;
+  }
+  const uint32_t footer = DecodeFixed32(data_ + size_ - sizeof(uint32_t));
+  size_t restarts_end = size_ - sizeof(uint32_t);
+  num_restarts_ = footer & ~kBlockHashIndexFlag;
+  if ((footer & kBlockHashIndexFlag) != 0) {
+    if (restarts_end < sizeof(uint32_t)) {
       size_ = 0;
-    } else {
-      restart_offset_ = size_ - (1 + NumRestarts()) * sizeof(uint32_t);
+      return;
     }
+    restarts_end -= sizeof(uint32_t);
+    num_hash_buckets_ = DecodeFixed32(data_ + restarts_end);
+    if (num_hash_buckets_ == 0 || num_hash_buckets_ > restarts_end ||
+        num_restarts_ > kBlockHashMaxRestarts) {
+      size_ = 0;
+      return;
+    }
+    restarts_end -= num_hash_buckets_;
+    hash_buckets_ = reinterpret_cast<const uint8_t*>(data_ + restarts_end);
+  }
+  size_t max_restarts_allowed = restarts_end / sizeof(uint32_t);
+  if (num_restarts_ > max_restarts_allowed) {
+    // The size is too small for num_restarts_
+    size_ = 0;
+  } else {
+    restart_offset_ = restarts_end - num_restarts_ * sizeof(uint32_t);
   }
 }
 
@@ -80,6 +97,8 @@ class Block::Iter : public Iterator {
   const char* const data_;       // underlying block contents
   uint32_t const restarts_;      // Offset of restart array (list of fixed32)
   uint32_t const num_restarts_;  // Number of uint32_t entries in restart array
+  const uint8_t* const hash_buckets_;  // Hash index, or nullptr if none
+  uint32_t const num_hash_buckets_;
 
   // current_ is offset in data_ of current entry.  >= restarts_ if !Valid
   uint32_t current_;
@@ -114,11 +133,14 @@ class Block::Iter : public Iterator {
 
  public:
   Iter(const Comparator* comparator, const char* data, uint32_t restarts,
-       uint32_t num_restarts)
+       uint32_t num_restarts, const uint8_t* hash_buckets,
+       uint32_t num_hash_buckets)
       : comparator_(comparator),
         data_(data),
         restarts_(restarts),
         num_restarts_(num_restarts),
+        hash_buckets_(hash_buckets),
+        num_hash_buckets_(num_hash_buckets),
         current_(restarts_),
         restart_index_(num_restarts_) {
     assert(num_restarts_ > 0);
@@ -226,6 +248,31 @@ class Block::Iter : public Iterator {
     }
   }
 
+  // See Block::NewIteratorForGet().
+  void SeekForGet(const Slice& target) {
+    if (hash_buckets_ == nullptr || target.size() < 8) {
+      Seek(target);
+      return;
+    }
+    const uint8_t entry =
+        hash_buckets_[BlockHashIndexHash(target) % num_hash_buckets_];
+    if (entry == kBlockHashNoEntry) {
+      // No entry for the user key in this block
+      current_ = restarts_;
+      restart_index_ = num_restarts_;
+      return;
+    }
+    if (entry == kBlockHashCollision || entry >= num_restarts_) {
+      Seek(target);
+      return;
+    }
+    // Every entry for the user key is in this restart interval, so the
+    // first entry >= target is too, or follows right after it.
+    SeekToRestartPoint(entry);
+    while (ParseNextKey() && Compare(key_, target) < 0) {
+    }
+  }
+
   void SeekToFirst() override {
     SeekToRestartPoint(0);
     ParseNextKey();
@@ -281,12 +328,25 @@ Iterator* Block::NewIterator(const Comparator* comparator) {
   if (size_ < sizeof(uint32_t)) {
     return NewErrorIterator(Status::Corruption("bad block contents"));
   }
-  const uint32_t num_restarts = NumRestarts();
-  if (num_restarts == 0) {
+  if (num_restarts_ == 0) {
     return NewEmptyIterator();
   } else {
-    return new Iter(comparator, data_, restart_offset_, num_restarts);
+    return new Iter(comparator, data_, restart_offset_, num_restarts_,
+                    hash_buckets_, num_hash_buckets_);
+  }
+}
+
+Iterator* Block::NewIteratorForGet(const Comparator* comparator,
+                                   const Slice& target) {
+  if (size_ < sizeof(uint32_t) || num_restarts_ == 0) {
+    Iterator* iter = NewIterator(comparator);
+    iter->Seek(target);
+    return iter;
   }
+  Iter* iter = new Iter(comparator, data_, restart_offset_, num_restarts_,
+                        hash_buckets_, num_hash_buckets_);
+  iter->SeekForGet(target);
+  return iter;
 }
 
 }  // namespace leveldb
@@ -28,15 +28,24 @@ class Block {
   size_t size() const { return size_; }
   Iterator* NewIterator(const Comparator* comparator);
 
+  // Return an iterator positioned for a point lookup of the internal key
+  // "target": at the first entry >= target if the block holds an entry for
+  // target's user key.  Otherwise the iterator is either invalid or at an
+  // entry for some other user key.  Uses the block's hash index, if it has
+  // one, to avoid the binary search of Seek().
+  Iterator* NewIteratorForGet(const Comparator* comparator,
+                              const Slice& target);
+
  private:
   class Iter;
 
-  uint32_t NumRestarts() const;
-
   const char* data_;
   size_t size_;
   uint32_t restart_offset_;  // Offset in data_ of restart array
-  bool owned_;               // Block owns data_[]
+  uint32_t num_restarts_;
+  const uint8_t* hash_buckets_;  // Hash index, or nullptr if none
+  uint32_t num_hash_buckets_;
+  bool owned_;  // Block owns data_[]
 };
 
 }  // namespace leveldb
@@ -25,6 +25,17 @@
 //     restarts: uint32[num_restarts]
 //     num_restarts: uint32
 // restarts[i] contains the offset within the block of the ith restart point.
+//
+// If options->data_block_hash_index is set, data blocks instead end with
+//     restarts: uint32[num_restarts]
+//     buckets: uint8[num_buckets]
+//     num_buckets: uint32
+//     num_restarts | kBlockHashIndexFlag: uint32
+// Each user key in the block is hashed to buckets[hash % num_buckets],
+// which holds the index of the restart point whose interval contains the
+// key, kBlockHashNoEntry if no key hashes to it, or kBlockHashCollision
+// if keys of several intervals do (including a user key whose entries
+// span two intervals).
 
 #include "table/block_builder.h"
 
@@ -33,12 +44,17 @@
 
 #include "leveldb/comparator.h"
 #include "leveldb/options.h"
+#include "table/format.h"
 #include "util/coding.h"
 
 namespace leveldb {
 
 BlockBuilder::BlockBuilder(const Options* options)
-    : options_(options), restarts_(), counter_(0), finished_(false) {
+    : options_(options),
+      restarts_(),
+      counter_(0),
+      finished_(false),
+      hashable_(true) {
   assert(options->block_restart_interval >= 1);
   restarts_.push_back(0);  // First restart point is at offset 0
 }
@@ -50,11 +66,30 @@ void BlockBuilder::Reset() {
   counter_ = 0;
   finished_ = false;
   last_key_.clear();
+  key_hashes_.clear();
+  key_restarts_.clear();
+  hashable_ = true;
+}
+
+// Number of hash index buckets for "num_keys" user keys: the buckets are
+// kept at most 75% full.
+static uint32_t NumHashBuckets(size_t num_keys) {
+  return static_cast<uint32_t>(num_keys * 4 / 3 + 1);
+}
+
+bool BlockBuilder::UseHashIndex() const {
+  return options_->data_block_hash_index && hashable_ &&
+         restarts_.size() <= kBlockHashMaxRestarts;
 }
 
 size_t BlockBuilder::CurrentSizeEstimate() const {
+  size_t hash_index_size = 0;
+  if (UseHashIndex()) {
+    hash_index_size = NumHashBuckets(key_hashes_.size()) + sizeof(uint32_t);
+  }
   return (buffer_.size() +                       // Raw data buffer
           restarts_.size() * sizeof(uint32_t) +  // Restart array
+          hash_index_size +                      // Hash index
           sizeof(uint32_t));                     // Restart array length
 }
 
@@ -63,7 +98,25 @@ Slice BlockBuilder::Finish() {
   for (size_t i = 0; i < restarts_.size(); i++) {
     PutFixed32(&buffer_, restarts_[i]);
   }
-  PutFixed32(&buffer_, restarts_.size());
+  uint32_t footer = restarts_.size();
+  if (UseHashIndex()) {
+    const uint32_t num_buckets = NumHashBuckets(key_hashes_.size());
+    const size_t buckets_offset = buffer_.size();
+    buffer_.append(num_buckets, static_cast<char>(kBlockHashNoEntry));
+    uint8_t* buckets =
+        reinterpret_cast<uint8_t*>(&buffer_[0] + buckets_offset);
+    for (size_t i = 0; i < key_hashes_.size(); i++) {
+      uint8_t* bucket = &buckets[key_hashes_[i] % num_buckets];
+      if (*bucket == kBlockHashNoEntry) {
+        *bucket = key_restarts_[i];
+      } else if (*bucket != key_restarts_[i]) {
+        *bucket = kBlockHashCollision;
+      }
+    }
+    PutFixed32(&buffer_, num_buckets);
+    footer |= kBlockHashIndexFlag;
+  }
+  PutFixed32(&buffer_, footer);
   finished_ = true;
   return Slice(buffer_);
 }
@@ -88,6 +141,22 @@ void BlockBuilder::Add(const Slice& key, const Slice& value) {
   }
   const size_t non_shared = key.size() - shared;
 
+  if (!options_->data_block_hash_index || key.size() < 8) {
+    // The option changed within the block, or this is not an internal key.
+    hashable_ = false;
+  } else if (hashable_) {
+    // Index each user key once per restart interval it appears in.
+    const uint8_t restart = static_cast<uint8_t>(restarts_.size() - 1);
+    const bool same_user_key =
+        !key_restarts_.empty() &&
+        Slice(key.data(), key.size() - 8) ==
+            Slice(last_key_piece.data(), last_key_piece.size() - 8);
+    if (!same_user_key || key_restarts_.back() != restart) {
+      key_hashes_.push_back(BlockHashIndexHash(key));
+      key_restarts_.push_back(restart);
+    }
+  }
+
   // Add "<shared><non_shared><value_size>" to buffer_
   PutVarint32(&buffer_, shared);
   PutVarint32(&buffer_, non_shared);
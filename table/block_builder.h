@@ -6,6 +6,7 @@
 #define STORAGE_LEVELDB_TABLE_BLOCK_BUILDER_H_
 
 #include <cstdint>
+#include <string>
 #include <vector>
 
 #include "leveldb/slice.h"
@@ -41,12 +42,21 @@ class BlockBuilder {
   bool empty() const { return buffer_.empty(); }
 
  private:
+  // Whether Finish() would add a hash index to the block.
+  bool UseHashIndex() const;
+
   const Options* options_;
   std::string buffer_;              // Destination buffer
   std::vector<uint32_t> restarts_;  // Restart points
   int counter_;                     // Number of entries emitted since restart
   bool finished_;                   // Has Finish() been called?
   std::string last_key_;
+
+  // Hash index input: the hash of each user key and the restart interval
+  // it appears in.
+  std::vector<uint32_t> key_hashes_;
+  std::vector<uint8_t> key_restarts_;
+  bool hashable_;  // False if a key was added without being indexed
 };
 
 }  // namespace leveldb
@@ -5,10 +5,12 @@
 #include "table/format.h"
 
 #include "leveldb/env.h"
+#include "leveldb/slice_transform.h"
 #include "port/port.h"
 #include "table/block.h"
 #include "util/coding.h"
 #include "util/crc32c.h"
+#include "util/hash.h"
 
 namespace leveldb {
 
@@ -61,6 +63,52 @@ Status Footer::DecodeFrom(Slice* input) {
   return result;
 }
 
+uint32_t BlockHashIndexHash(const Slice& key) {
+  assert(key.size() >= 8);
+  return Hash(key.data(), key.size() - 8, 0x8d5a4c3bu);
+}
+
+bool PrefixFilterEntry(const SliceTransform* prefix_extractor,
+                       const Slice& key, std::string* result) {
+  assert(key.size() >= 8);
+  const Slice user_key(key.data(), key.size() - 8);
+  if (!prefix_extractor->InDomain(user_key)) {
+    return false;
+  }
+  const Slice prefix = prefix_extractor->Transform(user_key);
+  result->assign(prefix.data(), prefix.size());
+  result->append(key.data() + user_key.size(), 8);
+  return true;
+}
+
+static bool GetUncompressedLength(CompressionType type, const char* input,
+                                  size_t length, size_t* result) {
+  switch (type) {
+    case kSnappyCompression:
+      return port::Snappy_GetUncompressedLength(input, length, result);
+    case kZstdCompression:
+      return port::Zstd_GetUncompressedLength(input, length, result);
+    case kLZ4Compression:
+      return port::LZ4_GetUncompressedLength(input, length, result);
+    default:
+      return false;
+  }
+}
+
+static bool Uncompress(CompressionType type, const char* input,
+                       size_t length, char* output) {
+  switch (type) {
+    case kSnappyCompression:
+      return port::Snappy_Uncompress(input, length, output);
+    case kZstdCompression:
+      return port::Zstd_Uncompress(input, length, output);
+    case kLZ4Compression:
+      return port::LZ4_Uncompress(input, length, output);
+    default:
+      return false;
+  }
+}
+
 Status ReadBlock(RandomAccessFile* file, const ReadOptions& options,
                  const BlockHandle& handle, BlockContents* result) {
   result->data = Slice();
@@ -70,7 +118,10 @@ Status ReadBlock(RandomAccessFile* file, const ReadOptions& options,
   // Read the block contents as well as the type/crc footer.
   // See table_builder.cc for the code that built this structure.
   size_t n = static_cast<size_t>(handle.size());
-  char* buf = new char[n + kBlockTrailerSize];
+  // A file that reads in place hands out its own copy of the block, which
+  // is used directly unless it has to be uncompressed.
+  char* buf =
+      file->ReadsInPlace() ? nullptr : new char[n + kBlockTrailerSize];
   Slice contents;
   Status s = file->Read(handle.offset(), n + kBlockTrailerSize, &contents, buf);
   if (!s.ok()) {
@@ -112,14 +163,17 @@ Status ReadBlock(RandomAccessFile* file, const ReadOptions& options,
 
       // Ok
       break;
-    case kSnappyCompression: {
+    case kSnappyCompression:
+    case kZstdCompression:
+    case kLZ4Compression: {
+      const CompressionType type = static_cast<CompressionType>(data[n]);
       size_t ulength = 0;
-      if (!port::Snappy_GetUncompressedLength(data, n, &ulength)) {
+      if (!GetUncompressedLength(type, data, n, &ulength)) {
         delete[] buf;
         return Status::Corruption("corrupted compressed block contents");
       }
       char* ubuf = new char[ulength];
-      if (!port::Snappy_Uncompress(data, n, ubuf)) {
+      if (!Uncompress(type, data, n, ubuf)) {
         delete[] buf;
         delete[] ubuf;
         return Status::Corruption("corrupted compressed block contents");
@@ -16,6 +16,7 @@ namespace leveldb {
 
 class Block;
 class RandomAccessFile;
+class SliceTransform;
 struct ReadOptions;
 
 // BlockHandle is a pointer to the extent of a file that stores a data
@@ -78,6 +79,26 @@ static const uint64_t kTableMagicNumber = 0xdb4775248b80fb57ull;
 // 1-byte type + 32-bit crc
 static const size_t kBlockTrailerSize = 5;
 
+// Layout of the optional data block hash index (see block_builder.cc).
+// The flag is set in the last fixed32 of a block that has one.
+static const uint32_t kBlockHashIndexFlag = 1u << 31;
+static const uint8_t kBlockHashNoEntry = 255;
+static const uint8_t kBlockHashCollision = 254;
+static const size_t kBlockHashMaxRestarts = 253;
+
+// Return the hash of the user key of the internal key "key" that the
+// data block hash index is built on.
+// REQUIRES: key.size() >= 8
+uint32_t BlockHashIndexHash(const Slice& key);
+
+// If the user key of the internal key "key" is in the domain of
+// "prefix_extractor", set *result to the entry that stands for its prefix
+// in a table filter and return true.  The entry is the prefix followed by
+// the 8-byte tag of "key", so that it reads as an internal key.
+// REQUIRES: key.size() >= 8
+bool PrefixFilterEntry(const SliceTransform* prefix_extractor,
+                       const Slice& key, std::string* result);
+
 struct BlockContents {
   Slice data;           // Actual contents of data
   bool cachable;        // True iff data can be cached
@@ -4,11 +4,14 @@
 
 #include "leveldb/table.h"
 
+#include <atomic>
+
 #include "leveldb/cache.h"
 #include "leveldb/comparator.h"
 #include "leveldb/env.h"
 #include "leveldb/filter_policy.h"
 #include "leveldb/options.h"
+#include "leveldb/slice_transform.h"
 #include "table/block.h"
 #include "table/filter_block.h"
 #include "table/format.h"
@@ -22,6 +25,12 @@ struct Table::Rep {
     delete filter;
     delete[] filter_data;
     delete index_block;
+    delete range_del_block;
+    for (Cache::Handle* pinned : {pinned_index.load(), pinned_filter.load()}) {
+      if (pinned != nullptr) {
+        options.block_cache->Release(pinned);
+      }
+    }
   }
 
   Options options;
@@ -32,9 +41,154 @@ struct Table::Rep {
   const char* filter_data;
 
   BlockHandle metaindex_handle;  // Handle to metaindex_block: saved from footer
-  Block* index_block;
+  Block* index_block;  // The top-level index if partitioned_index
+  BlockHandle index_handle;
+
+  // With options.cache_index_and_filter_blocks, index_block is nullptr and
+  // the index block is read through the block cache.  So is the filter if
+  // cached_filter is set.  Once the table is pinned, pinned_index and
+  // pinned_filter hold the blocks in the cache until the table is closed.
+  bool cached_filter;
+  BlockHandle filter_handle;
+  std::atomic<Cache::Handle*> pinned_index;
+  std::atomic<Cache::Handle*> pinned_filter;
+
+  // If partitioned_index, the index is split into partitions located
+  // through index_block.  If partitioned_filter as well, every top-level
+  // index entry also locates the filter partition for the data blocks of
+  // its index partition, and "filter" is unused.
+  bool partitioned_index;
+  bool partitioned_filter;
+
+  // If whole_table_filter, the filter holds a single filter for all the
+  // keys of the table, which is checked before the index.  If
+  // prefix_filter as well, it also holds the prefixes of the keys computed
+  // by options.prefix_extractor.
+  bool whole_table_filter;
+  bool prefix_filter;
+  Block* range_del_block;  // nullptr if the table has no range tombstones
 };
 
+static void DeleteBlock(void* arg, void* ignored) {
+  delete reinterpret_cast<Block*>(arg);
+}
+
+static void DeleteCachedBlock(const Slice& key, void* value) {
+  Block* block = reinterpret_cast<Block*>(value);
+  delete block;
+}
+
+static void ReleaseBlock(void* arg, void* h) {
+  Cache* cache = reinterpret_cast<Cache*>(arg);
+  Cache::Handle* handle = reinterpret_cast<Cache::Handle*>(h);
+  cache->Release(handle);
+}
+
+namespace {
+
+// Fill "buf" with the block cache key of the block at "handle".
+void EncodeBlockCacheKey(uint64_t cache_id, const BlockHandle& handle,
+                         char (&buf)[16]) {
+  EncodeFixed64(buf, cache_id);
+  EncodeFixed64(buf + 8, handle.offset());
+}
+
+// Set *block to the block at "handle", looked up in "cache" (if non-null)
+// and read from "file" on a miss.  If *cache_handle is then non-null, it
+// must be released once the block is no longer used; otherwise the caller
+// owns *block.
+Status ReadBlockThroughCache(RandomAccessFile* file, Cache* cache,
+                             uint64_t cache_id, const ReadOptions& options,
+                             const BlockHandle& handle,
+                             Cache::Priority priority, Block** block,
+                             Cache::Handle** cache_handle) {
+  *block = nullptr;
+  *cache_handle = nullptr;
+  char cache_key_buffer[16];
+  EncodeBlockCacheKey(cache_id, handle, cache_key_buffer);
+  Slice key(cache_key_buffer, sizeof(cache_key_buffer));
+  if (cache != nullptr) {
+    *cache_handle = cache->Lookup(key);
+    if (*cache_handle != nullptr) {
+      *block = reinterpret_cast<Block*>(cache->Value(*cache_handle));
+      return Status::OK();
+    }
+  }
+  BlockContents contents;
+  Status s = ReadBlock(file, options, handle, &contents);
+  if (s.ok()) {
+    *block = new Block(contents);
+    if (cache != nullptr && contents.cachable && options.fill_cache) {
+      *cache_handle = cache->Insert(key, *block, (*block)->size(),
+                                    &DeleteCachedBlock, priority);
+    }
+  }
+  return s;
+}
+
+// Arrange for "iter" to free "block" and "cache_handle", as returned by
+// ReadBlockThroughCache(), once it is deleted.
+void RegisterBlockCleanup(Iterator* iter, Block* block, Cache* cache,
+                          Cache::Handle* cache_handle) {
+  if (cache_handle == nullptr) {
+    iter->RegisterCleanup(&DeleteBlock, block, nullptr);
+  } else {
+    iter->RegisterCleanup(&ReleaseBlock, cache, cache_handle);
+  }
+}
+
+// A filter block or partition, as kept in the block cache.
+struct CachedFilter {
+  CachedFilter(const FilterPolicy* policy, const BlockContents& contents)
+      : contents(contents), reader(policy, contents.data) {}
+  ~CachedFilter() {
+    if (contents.heap_allocated) {
+      delete[] contents.data.data();
+    }
+  }
+
+  const BlockContents contents;
+  FilterBlockReader reader;
+};
+
+void DeleteCachedFilter(const Slice& key, void* value) {
+  delete reinterpret_cast<CachedFilter*>(value);
+}
+
+// Return the filter block or partition at "handle", or nullptr if it
+// cannot be read.  If it comes from "cache", *cache_handle must be
+// released once the filter is no longer used; otherwise the caller owns
+// the result.
+CachedFilter* ReadCachedFilter(RandomAccessFile* file, Cache* cache,
+                               uint64_t cache_id, const FilterPolicy* policy,
+                               const ReadOptions& options,
+                               const BlockHandle& handle,
+                               Cache::Priority priority,
+                               Cache::Handle** cache_handle) {
+  *cache_handle = nullptr;
+  char cache_key_buffer[16];
+  EncodeBlockCacheKey(cache_id, handle, cache_key_buffer);
+  Slice key(cache_key_buffer, sizeof(cache_key_buffer));
+  if (cache != nullptr) {
+    *cache_handle = cache->Lookup(key);
+    if (*cache_handle != nullptr) {
+      return reinterpret_cast<CachedFilter*>(cache->Value(*cache_handle));
+    }
+  }
+  BlockContents contents;
+  if (!ReadBlock(file, options, handle, &contents).ok()) {
+    return nullptr;
+  }
+  CachedFilter* filter = new CachedFilter(policy, contents);
+  if (cache != nullptr && contents.cachable && options.fill_cache) {
+    *cache_handle = cache->Insert(key, filter, contents.data.size(),
+                                  &DeleteCachedFilter, priority);
+  }
+  return filter;
+}
+
+}  // namespace
+
 Status Table::Open(const Options& options, RandomAccessFile* file,
                    uint64_t size, Table** table) {
   *table = nullptr;
@@ -69,43 +223,125 @@ Status Table::Open(const Options& options, RandomAccessFile* file,
     rep->file = file;
     rep->metaindex_handle = footer.metaindex_handle();
     rep->index_block = index_block;
+    rep->index_handle = footer.index_handle();
     rep->cache_id = (options.block_cache ? options.block_cache->NewId() : 0);
     rep->filter_data = nullptr;
     rep->filter = nullptr;
+    rep->cached_filter = false;
+    rep->pinned_index = nullptr;
+    rep->pinned_filter = nullptr;
+    if (options.cache_index_and_filter_blocks &&
+        options.block_cache != nullptr && index_block_contents.cachable) {
+      // Hand the index block over to the block cache.
+      char cache_key_buffer[16];
+      EncodeBlockCacheKey(rep->cache_id, rep->index_handle, cache_key_buffer);
+      Slice key(cache_key_buffer, sizeof(cache_key_buffer));
+      options.block_cache->Release(
+          options.block_cache->Insert(key, index_block, index_block->size(),
+                                      &DeleteCachedBlock, Cache::kHigh));
+      rep->index_block = nullptr;
+    }
+    rep->range_del_block = nullptr;
+    rep->partitioned_index = false;
+    rep->partitioned_filter = false;
+    rep->whole_table_filter = false;
+    rep->prefix_filter = false;
     *table = new Table(rep);
-    (*table)->ReadMeta(footer);
+    s = (*table)->ReadMeta(footer);
+    if (!s.ok()) {
+      // Unlike the filter, range tombstones are required for correct reads.
+      delete *table;
+      *table = nullptr;
+    }
   }
 
   return s;
 }
 
-void Table::ReadMeta(const Footer& footer) {
-  if (rep_->options.filter_policy == nullptr) {
-    return;  // Do not need any metadata
+Status Table::ReadMeta(const Footer& footer) {
+  // An empty metaindex block holds just the restart array (two fixed32s).
+  if (footer.metaindex_handle().size() <= 2 * sizeof(uint32_t)) {
+    return Status::OK();
   }
 
-  // TODO(sanjay): Skip this if footer.metaindex_handle() size indicates
-  // it is an empty block.
   ReadOptions opt;
   if (rep_->options.paranoid_checks) {
     opt.verify_checksums = true;
   }
   BlockContents contents;
-  if (!ReadBlock(rep_->file, opt, footer.metaindex_handle(), &contents).ok()) {
-    // Do not propagate errors since meta info is not needed for operation
-    return;
+  Status s = ReadBlock(rep_->file, opt, footer.metaindex_handle(), &contents);
+  if (!s.ok()) {
+    return s;
   }
   Block* meta = new Block(contents);
 
   Iterator* iter = meta->NewIterator(BytewiseComparator());
-  std::string key = "filter.";
-  key.append(rep_->options.filter_policy->Name());
-  iter->Seek(key);
-  if (iter->Valid() && iter->key() == Slice(key)) {
-    ReadFilter(iter->value());
+  iter->Seek("leveldb.partitioned_index");
+  rep_->partitioned_index =
+      iter->Valid() && iter->key() == Slice("leveldb.partitioned_index");
+  if (rep_->options.filter_policy != nullptr) {
+    const std::string name = rep_->options.filter_policy->Name();
+    if (rep_->partitioned_index) {
+      std::string key = "partitioned_filter." + name;
+      iter->Seek(key);
+      rep_->partitioned_filter = iter->Valid() && iter->key() == Slice(key);
+    } else {
+      std::string key = "filter." + name;
+      iter->Seek(key);
+      if (iter->Valid() && iter->key() == Slice(key)) {
+        ReadFilter(iter->value());
+      } else {
+        key = "fullfilter." + name;
+        iter->Seek(key);
+        if (iter->Valid() && iter->key() == Slice(key)) {
+          rep_->whole_table_filter = true;
+          ReadFilter(iter->value());
+        }
+        if (rep_->whole_table_filter &&
+            rep_->options.prefix_extractor != nullptr) {
+          // Only prefixes of the same transform are of use
+          iter->Seek("leveldb.prefix_extractor");
+          rep_->prefix_filter =
+              iter->Valid() &&
+              iter->key() == Slice("leveldb.prefix_extractor") &&
+              iter->value() == Slice(rep_->options.prefix_extractor->Name());
+        }
+      }
+    }
+  }
+  iter->Seek("leveldb.range_del");
+  if (iter->Valid() && iter->key() == Slice("leveldb.range_del")) {
+    s = ReadRangeDelBlock(iter->value());
   }
   delete iter;
   delete meta;
+  return s;
+}
+
+Status Table::ReadRangeDelBlock(const Slice& handle_value) {
+  Slice v = handle_value;
+  BlockHandle handle;
+  Status s = handle.DecodeFrom(&v);
+  if (!s.ok()) {
+    return s;
+  }
+  ReadOptions opt;
+  if (rep_->options.paranoid_checks) {
+    opt.verify_checksums = true;
+  }
+  BlockContents contents;
+  s = ReadBlock(rep_->file, opt, handle, &contents);
+  if (s.ok()) {
+    rep_->range_del_block = new Block(contents);
+  }
+  return s;
+}
+
+Iterator* Table::NewRangeTombstoneIterator() const {
+  if (rep_->range_del_block == nullptr) {
+    return nullptr;
+  }
+  return rep_->range_del_block->NewIterator(rep_->options.comparator);
 }
 
 void Table::ReadFilter(const Slice& filter_handle_value) {
@@ -125,6 +361,21 @@ void Table::ReadFilter(const Slice& filter_handle_value) {
   if (!ReadBlock(rep_->file, opt, filter_handle, &block).ok()) {
     return;
   }
+  Cache* block_cache = rep_->options.block_cache;
+  if (rep_->options.cache_index_and_filter_blocks && block_cache != nullptr &&
+      block.cachable) {
+    char cache_key_buffer[16];
+    EncodeBlockCacheKey(rep_->cache_id, filter_handle, cache_key_buffer);
+    Slice key(cache_key_buffer, sizeof(cache_key_buffer));
+    CachedFilter* filter =
+        new CachedFilter(rep_->options.filter_policy, block);
+    block_cache->Release(block_cache->Insert(key, filter, block.data.size(),
+                                             &DeleteCachedFilter,
+                                             Cache::kHigh));
+    rep_->cached_filter = true;
+    rep_->filter_handle = filter_handle;
+    return;
+  }
   if (block.heap_allocated) {
     rep_->filter_data = block.data.data();  // Will need to delete later
   }
@@ -133,26 +384,27 @@ void Table::ReadFilter(const Slice& filter_handle_value) {
 
 Table::~Table() { delete rep_; }
 
-static void DeleteBlock(void* arg, void* ignored) {
-  delete reinterpret_cast<Block*>(arg);
-}
-
-static void DeleteCachedBlock(const Slice& key, void* value) {
-  Block* block = reinterpret_cast<Block*>(value);
-  delete block;
-}
-
-static void ReleaseBlock(void* arg, void* h) {
-  Cache* cache = reinterpret_cast<Cache*>(arg);
-  Cache::Handle* handle = reinterpret_cast<Cache::Handle*>(h);
-  cache->Release(handle);
-}
-
 // Convert an index iterator value (i.e., an encoded BlockHandle)
 // into an iterator over the contents of the corresponding block.
 Iterator* Table::BlockReader(void* arg, const ReadOptions& options,
                              const Slice& index_value) {
+  return DataBlockReader(reinterpret_cast<Table*>(arg), options, index_value,
+                         nullptr, Cache::kLow);
+}
+
+Iterator* Table::IndexPartitionReader(void* arg, const ReadOptions& options,
+                                      const Slice& index_value) {
   Table* table = reinterpret_cast<Table*>(arg);
+  return DataBlockReader(table, options, index_value, nullptr,
+                         table->rep_->options.cache_index_and_filter_blocks
+                             ? Cache::kHigh
+                             : Cache::kLow);
+}
+
+Iterator* Table::DataBlockReader(Table* table, const ReadOptions& options,
+                                 const Slice& index_value,
+                                 const Slice* get_key,
+                                 Cache::Priority priority) {
   Cache* block_cache = table->rep_->options.block_cache;
   Block* block = nullptr;
   Cache::Handle* cache_handle = nullptr;
@@ -164,86 +416,236 @@ Iterator* Table::BlockReader(void* arg, const ReadOptions& options,
   // can add more features in the future.
 
   if (s.ok()) {
-    BlockContents contents;
-    if (block_cache != nullptr) {
-      char cache_key_buffer[16];
-      EncodeFixed64(cache_key_buffer, table->rep_->cache_id);
-      EncodeFixed64(cache_key_buffer + 8, handle.offset());
-      Slice key(cache_key_buffer, sizeof(cache_key_buffer));
-      cache_handle = block_cache->Lookup(key);
-      if (cache_handle != nullptr) {
-        block = reinterpret_cast<Block*>(block_cache->Value(cache_handle));
-      } else {
-        s = ReadBlock(table->rep_->file, options, handle, &contents);
-        if (s.ok()) {
-          block = new Block(contents);
-          if (contents.cachable && options.fill_cache) {
-            cache_handle = block_cache->Insert(key, block, block->size(),
-                                               &DeleteCachedBlock);
-          }
-        }
-      }
-    } else {
-      s = ReadBlock(table->rep_->file, options, handle, &contents);
-      if (s.ok()) {
-        block = new Block(contents);
-      }
-    }
+    s = ReadBlockThroughCache(table->rep_->file, block_cache,
+                              table->rep_->cache_id, options, handle,
+                              priority, &block, &cache_handle);
   }
 
   Iterator* iter;
   if (block != nullptr) {
-    iter = block->NewIterator(table->rep_->options.comparator);
-    if (cache_handle == nullptr) {
-      iter->RegisterCleanup(&DeleteBlock, block, nullptr);
+    const Comparator* comparator = table->rep_->options.comparator;
+    if (get_key != nullptr) {
+      iter = block->NewIteratorForGet(comparator, *get_key);
     } else {
-      iter->RegisterCleanup(&ReleaseBlock, block_cache, cache_handle);
+      iter = block->NewIterator(comparator);
     }
+    RegisterBlockCleanup(iter, block, block_cache, cache_handle);
   } else {
     iter = NewErrorIterator(s);
   }
   return iter;
 }
 
+Iterator* Table::NewIndexBlockIterator(const ReadOptions& options) const {
+  const Comparator* comparator = rep_->options.comparator;
+  if (rep_->index_block != nullptr) {
+    return rep_->index_block->NewIterator(comparator);
+  }
+  Cache* block_cache = rep_->options.block_cache;
+  Cache::Handle* pinned = rep_->pinned_index.load(std::memory_order_acquire);
+  if (pinned != nullptr) {
+    Block* block = reinterpret_cast<Block*>(block_cache->Value(pinned));
+    return block->NewIterator(comparator);
+  }
+  Block* block;
+  Cache::Handle* cache_handle;
+  Status s =
+      ReadBlockThroughCache(rep_->file, block_cache, rep_->cache_id, options,
+                            rep_->index_handle, Cache::kHigh, &block,
+                            &cache_handle);
+  if (!s.ok()) {
+    return NewErrorIterator(s);
+  }
+  Iterator* iter = block->NewIterator(comparator);
+  RegisterBlockCleanup(iter, block, block_cache, cache_handle);
+  return iter;
+}
+
+Iterator* Table::NewIndexIterator(const ReadOptions& options) const {
+  Iterator* iter = NewIndexBlockIterator(options);
+  if (rep_->partitioned_index) {
+    // Every top-level index entry starts with the handle of a partition.
+    iter = NewTwoLevelIterator(iter, &Table::IndexPartitionReader,
+                               const_cast<Table*>(this), options);
+  }
+  return iter;
+}
+
+void Table::PinIndexAndFilter() {
+  Cache* block_cache = rep_->options.block_cache;
+  ReadOptions options;
+  if (rep_->options.paranoid_checks) {
+    options.verify_checksums = true;
+  }
+  if (rep_->index_block == nullptr &&
+      rep_->pinned_index.load(std::memory_order_acquire) == nullptr) {
+    Block* block;
+    Cache::Handle* cache_handle;
+    Status s = ReadBlockThroughCache(rep_->file, block_cache, rep_->cache_id,
+                                     options, rep_->index_handle,
+                                     Cache::kHigh, &block, &cache_handle);
+    if (s.ok() && cache_handle == nullptr) {
+      delete block;  // The cache declined it; there is nothing to pin
+    } else if (s.ok()) {
+      Cache::Handle* expected = nullptr;
+      if (!rep_->pinned_index.compare_exchange_strong(expected,
+                                                      cache_handle)) {
+        block_cache->Release(cache_handle);  // Pinned by another thread
+      }
+    }
+  }
+  if (rep_->cached_filter &&
+      rep_->pinned_filter.load(std::memory_order_acquire) == nullptr) {
+    Cache::Handle* cache_handle;
+    CachedFilter* filter = ReadCachedFilter(
+        rep_->file, block_cache, rep_->cache_id, rep_->options.filter_policy,
+        options, rep_->filter_handle, Cache::kHigh, &cache_handle);
+    if (cache_handle == nullptr) {
+      delete filter;
+    } else {
+      Cache::Handle* expected = nullptr;
+      if (!rep_->pinned_filter.compare_exchange_strong(expected,
+                                                       cache_handle)) {
+        block_cache->Release(cache_handle);
+      }
+    }
+  }
+}
+
 Iterator* Table::NewIterator(const ReadOptions& options) const {
-  return NewTwoLevelIterator(
-      rep_->index_block->NewIterator(rep_->options.comparator),
-      &Table::BlockReader, const_cast<Table*>(this), options);
+  return NewTwoLevelIterator(NewIndexIterator(options), &Table::BlockReader,
+                             const_cast<Table*>(this), options);
+}
+
+bool Table::FilterMayMatch(const ReadOptions& options, uint64_t block_offset,
+                           const Slice& k) {
+  if (!rep_->cached_filter) {
+    return rep_->filter == nullptr ||
+           rep_->filter->KeyMayMatch(block_offset, k);
+  }
+  Cache* block_cache = rep_->options.block_cache;
+  Cache::Handle* pinned = rep_->pinned_filter.load(std::memory_order_acquire);
+  if (pinned != nullptr) {
+    return reinterpret_cast<CachedFilter*>(block_cache->Value(pinned))
+        ->reader.KeyMayMatch(block_offset, k);
+  }
+  Cache::Handle* cache_handle;
+  CachedFilter* cached_filter = ReadCachedFilter(
+      rep_->file, block_cache, rep_->cache_id, rep_->options.filter_policy,
+      options, rep_->filter_handle, Cache::kHigh, &cache_handle);
+  if (cached_filter == nullptr) {
+    return true;
+  }
+  const bool may_match = cached_filter->reader.KeyMayMatch(block_offset, k);
+  if (cache_handle != nullptr) {
+    block_cache->Release(cache_handle);
+  } else {
+    delete cached_filter;
+  }
+  return may_match;
+}
+
+bool Table::PrefixMayMatch(const ReadOptions& options, const Slice& k) {
+  std::string entry;
+  if (!rep_->prefix_filter ||
+      !PrefixFilterEntry(rep_->options.prefix_extractor, k, &entry)) {
+    return true;
+  }
+  return FilterMayMatch(options, 0, entry);
 }
 
 Status Table::InternalGet(const ReadOptions& options, const Slice& k, void* arg,
                           void (*handle_result)(void*, const Slice&,
-                                                const Slice&)) {
+                                                const Slice&),
+                          Iterator** pinned) {
+  if (pinned != nullptr) {
+    *pinned = nullptr;
+  }
   Status s;
-  Iterator* iiter = rep_->index_block->NewIterator(rep_->options.comparator);
+  if (rep_->whole_table_filter && !FilterMayMatch(options, 0, k)) {
+    // A key the filter rules out costs no index lookup.
+    return s;
+  }
+  Cache* block_cache = rep_->options.block_cache;
+  FilterBlockReader* filter = nullptr;  // Set for partitioned filters
+  uint64_t filter_base = 0;
+  CachedFilter* cached_filter = nullptr;
+  Cache::Handle* filter_cache_handle = nullptr;
+  Iterator* iiter;
+  if (rep_->partitioned_index) {
+    Iterator* top_iter = NewIndexBlockIterator(options);
+    top_iter->Seek(k);
+    if (!top_iter->Valid()) {
+      s = top_iter->status();
+      delete top_iter;
+      return s;
+    }
+    Slice top_value = top_iter->value();
+    BlockHandle index_handle, filter_handle;
+    if (rep_->partitioned_filter && index_handle.DecodeFrom(&top_value).ok() &&
+        filter_handle.DecodeFrom(&top_value).ok() &&
+        GetVarint64(&top_value, &filter_base)) {
+      cached_filter = ReadCachedFilter(
+          rep_->file, block_cache, rep_->cache_id, rep_->options.filter_policy,
+          options, filter_handle,
+          rep_->options.cache_index_and_filter_blocks ? Cache::kHigh
+                                                      : Cache::kLow,
+          &filter_cache_handle);
+      if (cached_filter != nullptr) {
+        filter = &cached_filter->reader;
+      }
+    }
+    iiter = IndexPartitionReader(this, options, top_iter->value());
+    delete top_iter;
+  } else {
+    iiter = NewIndexBlockIterator(options);
+  }
+
   iiter->Seek(k);
   if (iiter->Valid()) {
     Slice handle_value = iiter->value();
-    FilterBlockReader* filter = rep_->filter;
     BlockHandle handle;
-    if (filter != nullptr && handle.DecodeFrom(&handle_value).ok() &&
-        !filter->KeyMayMatch(handle.offset(), k)) {
+    bool may_match = true;
+    if (handle.DecodeFrom(&handle_value).ok()) {
+      if (filter != nullptr) {
+        may_match = filter->KeyMayMatch(handle.offset() - filter_base, k);
+      } else if (!rep_->partitioned_index && !rep_->whole_table_filter) {
+        may_match = FilterMayMatch(options, handle.offset(), k);
+      }
+    }
+    if (!may_match) {
       // Not found
     } else {
-      Iterator* block_iter = BlockReader(this, options, iiter->value());
-      block_iter->Seek(k);
+      Iterator* block_iter =
+          DataBlockReader(this, options, iiter->value(), &k, Cache::kLow);
       if (block_iter->Valid()) {
         (*handle_result)(arg, block_iter->key(), block_iter->value());
+        if (pinned != nullptr) {
+          // The entry lives in the block, which the iterator holds.
+          *pinned = block_iter;
+          block_iter = nullptr;
+        }
+      }
+      if (block_iter != nullptr) {
+        s = block_iter->status();
+        delete block_iter;
       }
-      s = block_iter->status();
-      delete block_iter;
     }
   }
   if (s.ok()) {
     s = iiter->status();
   }
   delete iiter;
+  if (filter_cache_handle != nullptr) {
+    block_cache->Release(filter_cache_handle);
+  } else {
+    delete cached_filter;
+  }
   return s;
 }
 
 uint64_t Table::ApproximateOffsetOf(const Slice& key) const {
-  Iterator* index_iter =
-      rep_->index_block->NewIterator(rep_->options.comparator);
+  Iterator* index_iter = NewIndexIterator(ReadOptions());
   index_iter->Seek(key);
   uint64_t result;
   if (index_iter->Valid()) {
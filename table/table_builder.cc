@@ -10,6 +10,7 @@
 #include "leveldb/env.h"
 #include "leveldb/filter_policy.h"
 #include "leveldb/options.h"
+#include "leveldb/slice_transform.h"
 #include "table/block_builder.h"
 #include "table/filter_block.h"
 #include "table/format.h"
@@ -22,28 +23,66 @@ struct TableBuilder::Rep {
   Rep(const Options& opt, WritableFile* f)
       : options(opt),
         index_block_options(opt),
+        meta_block_options(opt),
         file(f),
         offset(0),
         data_block(&options),
         index_block(&index_block_options),
+        top_level_index(&index_block_options),
+        partitioned(opt.partition_index_and_filters),
+        filter_base(0),
+        whole_table_filter(
+            (opt.whole_table_filter || opt.prefix_extractor != nullptr) &&
+            !partitioned),
+        prefix_extractor(opt.filter_policy != nullptr && whole_table_filter
+                             ? opt.prefix_extractor
+                             : nullptr),
+        has_last_prefix(false),
+        range_del_block(&meta_block_options),
         num_entries(0),
+        num_range_tombstones(0),
         closed(false),
         filter_block(opt.filter_policy == nullptr
                          ? nullptr
                          : new FilterBlockBuilder(opt.filter_policy)),
         pending_index_entry(false) {
     index_block_options.block_restart_interval = 1;
+    index_block_options.data_block_hash_index = false;
+    meta_block_options.data_block_hash_index = false;
   }
 
   Options options;
   Options index_block_options;
+  Options meta_block_options;  // Range tombstone and metaindex blocks
   WritableFile* file;
   uint64_t offset;
   Status status;
   BlockBuilder data_block;
   BlockBuilder index_block;
+
+  // If partitioned, index_block and filter_block hold the current index
+  // and filter partitions, which cover the data blocks starting at offset
+  // filter_base.  top_level_index maps the last index key of each written
+  // partition to the handles of its index and filter partitions.
+  BlockBuilder top_level_index;
+  const bool partitioned;
+  uint64_t filter_base;
+
+  // If whole_table_filter, filter_block builds a single filter for all
+  // the keys of the table.  If prefix_extractor is non-null as well, the
+  // filter also holds an entry for every prefix of the keys, of which
+  // last_prefix is the latest once has_last_prefix is set.
+  const bool whole_table_filter;
+  const SliceTransform* const prefix_extractor;
+  bool has_last_prefix;
+  std::string last_prefix;
+  std::string prefix_entry;
+
+  BlockBuilder range_del_block;
   std::string last_key;
+  std::string last_range_del_key;
   int64_t num_entries;
+  int64_t num_range_tombstones;
   bool closed;  // Either Finish() or Abandon() has been called.
   FilterBlockBuilder* filter_block;
 
@@ -88,6 +127,9 @@ Status TableBuilder::ChangeOptions(const Options& options) {
   rep_->options = options;
   rep_->index_block_options = options;
   rep_->index_block_options.block_restart_interval = 1;
+  rep_->index_block_options.data_block_hash_index = false;
+  rep_->meta_block_options = options;
+  rep_->meta_block_options.data_block_hash_index = false;
   return Status::OK();
 }
 
@@ -102,14 +144,21 @@ void TableBuilder::Add(const Slice& key, const Slice& value) {
   if (r->pending_index_entry) {
     assert(r->data_block.empty());
     r->options.comparator->FindShortestSeparator(&r->last_key, key);
-    std::string handle_encoding;
-    r->pending_handle.EncodeTo(&handle_encoding);
-    r->index_block.Add(r->last_key, Slice(handle_encoding));
-    r->pending_index_entry = false;
+    AddIndexEntry(false);
   }
 
   if (r->filter_block != nullptr) {
     r->filter_block->AddKey(key);
+    if (r->prefix_extractor != nullptr &&
+        PrefixFilterEntry(r->prefix_extractor, key, &r->prefix_entry)) {
+      // Keys with the same prefix are adjacent; add each prefix once.
+      const Slice prefix(r->prefix_entry.data(), r->prefix_entry.size() - 8);
+      if (!r->has_last_prefix || prefix != Slice(r->last_prefix)) {
+        r->filter_block->AddKey(r->prefix_entry);
+        r->has_last_prefix = true;
+        r->last_prefix.assign(prefix.data(), prefix.size());
+      }
+    }
   }
 
   r->last_key.assign(key.data(), key.size());
@@ -122,6 +171,51 @@ void TableBuilder::Add(const Slice& key, const Slice& value) {
   }
 }
 
+void TableBuilder::AddIndexEntry(bool last) {
+  Rep* r = rep_;
+  std::string handle_encoding;
+  r->pending_handle.EncodeTo(&handle_encoding);
+  r->index_block.Add(r->last_key, Slice(handle_encoding));
+  r->pending_index_entry = false;
+  if (r->partitioned &&
+      (last || r->index_block.CurrentSizeEstimate() >= r->options.block_size)) {
+    WriteIndexPartition();
+  }
+}
+
+void TableBuilder::WriteIndexPartition() {
+  Rep* r = rep_;
+  BlockHandle index_handle, filter_handle;
+  WriteBlock(&r->index_block, &index_handle);
+  std::string value;
+  index_handle.EncodeTo(&value);
+  if (ok() && r->filter_block != nullptr) {
+    WriteRawBlock(r->filter_block->Finish(), kNoCompression, &filter_handle);
+    filter_handle.EncodeTo(&value);
+    PutVarint64(&value, r->filter_base);
+    delete r->filter_block;
+    r->filter_block = new FilterBlockBuilder(r->options.filter_policy);
+    r->filter_base = r->offset;
+    r->filter_block->StartBlock(0);
+  }
+  // r->last_key is >= every key of the partition and < every key of the
+  // next one.
+  r->top_level_index.Add(r->last_key, value);
+}
+
+void TableBuilder::AddRangeTombstone(const Slice& key, const Slice& value) {
+  Rep* r = rep_;
+  assert(!r->closed);
+  if (!ok()) return;
+  if (r->num_range_tombstones > 0) {
+    assert(r->options.comparator->Compare(key, Slice(r->last_range_del_key)) >
+           0);
+  }
+  r->last_range_del_key.assign(key.data(), key.size());
+  r->num_range_tombstones++;
+  r->range_del_block.Add(key, value);
+}
+
 void TableBuilder::Flush() {
   Rep* r = rep_;
   assert(!r->closed);
@@ -133,8 +227,8 @@ void TableBuilder::Flush() {
     r->pending_index_entry = true;
     r->status = r->file->Flush();
   }
-  if (r->filter_block != nullptr) {
-    r->filter_block->StartBlock(r->offset);
+  if (r->filter_block != nullptr && !r->whole_table_filter) {
+    r->filter_block->StartBlock(r->offset - r->filter_base);
   }
 }
 
@@ -149,25 +243,32 @@ void TableBuilder::WriteBlock(BlockBuilder* block, BlockHandle* handle) {
 
   Slice block_contents;
   CompressionType type = r->options.compression;
-  // TODO(postrelease): Support more compression options: zlib?
+  std::string* compressed = &r->compressed_output;
+  bool ok = false;
   switch (type) {
     case kNoCompression:
-      block_contents = raw;
       break;
 
-    case kSnappyCompression: {
-      std::string* compressed = &r->compressed_output;
-      if (port::Snappy_Compress(raw.data(), raw.size(), compressed) &&
-          compressed->size() < raw.size() - (raw.size() / 8u)) {
-        block_contents = *compressed;
-      } else {
-        // Snappy not supported, or compressed less than 12.5%, so just
-        // store uncompressed form
-        block_contents = raw;
-        type = kNoCompression;
-      }
+    case kSnappyCompression:
+      ok = port::Snappy_Compress(raw.data(), raw.size(), compressed);
+      break;
+
+    case kZstdCompression:
+      ok = port::Zstd_Compress(r->options.zstd_compression_level, raw.data(),
+                               raw.size(), compressed);
+      break;
+
+    case kLZ4Compression:
+      ok = port::LZ4_Compress(raw.data(), raw.size(), compressed);
       break;
-    }
+  }
+  if (ok && compressed->size() < raw.size() - (raw.size() / 8u)) {
+    block_contents = *compressed;
+  } else {
+    // Compression not requested or not supported, or compressed less
+    // than 12.5%, so just store uncompressed form
+    block_contents = raw;
+    type = kNoCompression;
   }
   WriteRawBlock(block_contents, type, handle);
   r->compressed_output.clear();
@@ -201,25 +302,54 @@ Status TableBuilder::Finish() {
   assert(!r->closed);
   r->closed = true;
 
-  BlockHandle filter_block_handle, metaindex_block_handle, index_block_handle;
+  BlockHandle filter_block_handle, range_del_block_handle,
+      metaindex_block_handle, index_block_handle;
 
   // Write filter block
-  if (ok() && r->filter_block != nullptr) {
+  if (ok() && r->filter_block != nullptr && !r->partitioned) {
     WriteRawBlock(r->filter_block->Finish(), kNoCompression,
                   &filter_block_handle);
   }
 
+  // Write range tombstone block
+  if (ok() && r->num_range_tombstones > 0) {
+    WriteBlock(&r->range_del_block, &range_del_block_handle);
+  }
+
   // Write metaindex block
   if (ok()) {
-    BlockBuilder meta_index_block(&r->options);
-    if (r->filter_block != nullptr) {
-      // Add mapping from "filter.Name" to location of filter data
-      std::string key = "filter.";
+    BlockBuilder meta_index_block(&r->meta_block_options);
+    if (r->filter_block != nullptr && !r->partitioned) {
+      // Add mapping from "filter.Name" (or "fullfilter.Name") to location
+      // of filter data
+      std::string key = r->whole_table_filter ? "fullfilter." : "filter.";
       key.append(r->options.filter_policy->Name());
       std::string handle_encoding;
       filter_block_handle.EncodeTo(&handle_encoding);
       meta_index_block.Add(key, handle_encoding);
     }
+    // Keys must stay sorted: "filter." < "fullfilter." <
+    // "leveldb.partitioned_index" < "leveldb.prefix_extractor" <
+    // "leveldb.range_del" < "partitioned_filter."
+    if (r->partitioned) {
+      meta_index_block.Add("leveldb.partitioned_index", Slice());
+    }
+    if (r->prefix_extractor != nullptr) {
+      // The filter holds prefixes computed by this transform
+      meta_index_block.Add("leveldb.prefix_extractor",
+                           r->prefix_extractor->Name());
+    }
+    if (r->num_range_tombstones > 0) {
+      std::string handle_encoding;
+      range_del_block_handle.EncodeTo(&handle_encoding);
+      meta_index_block.Add("leveldb.range_del", handle_encoding);
+    }
+    if (r->filter_block != nullptr && r->partitioned) {
+      // The filter partitions are located through the top-level index
+      std::string key = "partitioned_filter.";
+      key.append(r->options.filter_policy->Name());
+      meta_index_block.Add(key, Slice());
+    }
 
     // TODO(postrelease): Add stats and other meta blocks
     WriteBlock(&meta_index_block, &metaindex_block_handle);
@@ -229,12 +359,13 @@ Status TableBuilder::Finish() {
   if (ok()) {
     if (r->pending_index_entry) {
       r->options.comparator->FindShortSuccessor(&r->last_key);
-      std::string handle_encoding;
-      r->pending_handle.EncodeTo(&handle_encoding);
-      r->index_block.Add(r->last_key, Slice(handle_encoding));
-      r->pending_index_entry = false;
+      AddIndexEntry(true);
+    }
+    if (r->partitioned) {
+      WriteBlock(&r->top_level_index, &index_block_handle);
+    } else {
+      WriteBlock(&r->index_block, &index_block_handle);
     }
-    WriteBlock(&r->index_block, &index_block_handle);
   }
 
   // Write footer
@@ -260,6 +391,10 @@ void TableBuilder::Abandon() {
 
 uint64_t TableBuilder::NumEntries() const { return rep_->num_entries; }
 
+uint64_t TableBuilder::NumRangeTombstones() const {
+  return rep_->num_range_tombstones;
+}
+
 uint64_t TableBuilder::FileSize() const { return rep_->offset; }
 
 }  // namespace leveldb
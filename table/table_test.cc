@@ -5,12 +5,14 @@
 #include "leveldb/table.h"
 
 #include <map>
+#include <memory>
 #include <string>
 
 #include "gtest/gtest.h"
 #include "db/dbformat.h"
 #include "db/memtable.h"
 #include "db/write_batch_internal.h"
+#include "leveldb/cache.h"
 #include "leveldb/db.h"
 #include "leveldb/env.h"
 #include "leveldb/iterator.h"
@@ -18,6 +20,8 @@
 #include "table/block.h"
 #include "table/block_builder.h"
 #include "table/format.h"
+#include "util/coding.h"
+#include "util/crc32c.h"
 #include "util/random.h"
 #include "util/testutil.h"
 
@@ -108,12 +112,15 @@ class StringSink : public WritableFile {
 
 class StringSource : public RandomAccessFile {
  public:
-  StringSource(const Slice& contents)
-      : contents_(contents.data(), contents.size()) {}
+  // If "in_place" is set, reads return pointers into the contents, as
+  // memory-mapped files do.
+  StringSource(const Slice& contents, bool in_place = false)
+      : contents_(contents.data(), contents.size()), in_place_(in_place) {}
 
   ~StringSource() override = default;
 
   uint64_t Size() const { return contents_.size(); }
+  const char* data() const { return contents_.data(); }
 
   Status Read(uint64_t offset, size_t n, Slice* result,
               char* scratch) const override {
@@ -123,13 +130,20 @@ class StringSource : public RandomAccessFile {
     if (offset + n > contents_.size()) {
       n = contents_.size() - offset;
     }
+    if (in_place_) {
+      *result = Slice(&contents_[offset], n);
+      return Status::OK();
+    }
     std::memcpy(scratch, &contents_[offset], n);
     *result = Slice(scratch, n);
     return Status::OK();
   }
 
+  bool ReadsInPlace() const override { return in_place_; }
+
  private:
   std::string contents_;
+  const bool in_place_;
 };
 
 typedef std::map<std::string, std::string, STLLessThan> KVMap;
@@ -230,6 +244,9 @@ class TableConstructor : public Constructor {
     source_ = new StringSource(sink.contents());
     Options table_options;
     table_options.comparator = options.comparator;
+    table_options.block_cache = options.block_cache;
+    table_options.cache_index_and_filter_blocks =
+        options.cache_index_and_filter_blocks;
     return Table::Open(table_options, source_, sink.contents().size(), &table_);
   }
 
@@ -299,15 +316,17 @@ class KeyConvertingIterator : public Iterator {
 
 class MemTableConstructor : public Constructor {
  public:
-  explicit MemTableConstructor(const Comparator* cmp)
-      : Constructor(cmp), internal_comparator_(cmp) {
-    memtable_ = new MemTable(internal_comparator_);
+  MemTableConstructor(const Comparator* cmp, size_t hash_buckets)
+      : Constructor(cmp),
+        internal_comparator_(cmp),
+        hash_buckets_(hash_buckets) {
+    memtable_ = new MemTable(internal_comparator_, nullptr, hash_buckets_);
     memtable_->Ref();
   }
   ~MemTableConstructor() override { memtable_->Unref(); }
   Status FinishImpl(const Options& options, const KVMap& data) override {
     memtable_->Unref();
-    memtable_ = new MemTable(internal_comparator_);
+    memtable_ = new MemTable(internal_comparator_, nullptr, hash_buckets_);
     memtable_->Ref();
     int seq = 1;
     for (const auto& kvp : data) {
@@ -322,6 +341,7 @@ class MemTableConstructor : public Constructor {
 
  private:
   const InternalKeyComparator internal_comparator_;
+  const size_t hash_buckets_;
   MemTable* memtable_;
 };
 
@@ -370,7 +390,14 @@ class DBConstructor : public Constructor {
   DB* db_;
 };
 
-enum TestType { TABLE_TEST, BLOCK_TEST, MEMTABLE_TEST, DB_TEST };
+enum TestType {
+  TABLE_TEST,
+  PARTITIONED_TABLE_TEST,
+  BLOCK_TEST,
+  MEMTABLE_TEST,
+  HASH_MEMTABLE_TEST,
+  DB_TEST
+};
 
 struct TestArgs {
   TestType type;
@@ -386,6 +413,10 @@ static const TestArgs kTestArgList[] = {
     {TABLE_TEST, true, 1},
     {TABLE_TEST, true, 1024},
 
+    {PARTITIONED_TABLE_TEST, false, 16},
+    {PARTITIONED_TABLE_TEST, false, 1},
+    {PARTITIONED_TABLE_TEST, true, 16},
+
     {BLOCK_TEST, false, 16},
     {BLOCK_TEST, false, 1},
     {BLOCK_TEST, false, 1024},
@@ -396,6 +427,8 @@ static const TestArgs kTestArgList[] = {
     // Restart interval does not matter for memtables
     {MEMTABLE_TEST, false, 16},
     {MEMTABLE_TEST, true, 16},
+    {HASH_MEMTABLE_TEST, false, 16},
+    {HASH_MEMTABLE_TEST, true, 16},
 
     // Do not bother with restart interval variations for DB
     {DB_TEST, false, 16},
@@ -423,11 +456,21 @@ class Harness : public testing::Test {
       case TABLE_TEST:
         constructor_ = new TableConstructor(options_.comparator);
         break;
+      case PARTITIONED_TABLE_TEST:
+        // Index partitions of a few entries each
+        options_.partition_index_and_filters = true;
+        options_.block_size = 64;
+        constructor_ = new TableConstructor(options_.comparator);
+        break;
       case BLOCK_TEST:
         constructor_ = new BlockConstructor(options_.comparator);
         break;
       case MEMTABLE_TEST:
-        constructor_ = new MemTableConstructor(options_.comparator);
+        constructor_ = new MemTableConstructor(options_.comparator, 0);
+        break;
+      case HASH_MEMTABLE_TEST:
+        // Few buckets, so that many keys share each one
+        constructor_ = new MemTableConstructor(options_.comparator, 7);
         break;
       case DB_TEST:
         constructor_ = new DBConstructor(options_.comparator);
@@ -638,6 +681,81 @@ TEST_F(Harness, ZeroRestartPointsInBlock) {
   delete iter;
 }
 
+TEST_F(Harness, DataBlockHashIndex) {
+  InternalKeyComparator icmp(BytewiseComparator());
+  Options options;
+  options.comparator = &icmp;
+  options.block_restart_interval = 4;
+  options.data_block_hash_index = true;
+  Options plain_options = options;
+  plain_options.data_block_hash_index = false;
+
+  // Even user keys, with up to three versions each, so that some span
+  // two restart intervals.
+  Random rnd(301);
+  BlockBuilder builder(&options);
+  BlockBuilder plain_builder(&plain_options);
+  for (int i = 0; i < 200; i += 2) {
+    char user_key[16];
+    std::snprintf(user_key, sizeof(user_key), "k%04d", i);
+    const int versions = 1 + rnd.Uniform(3);
+    for (int v = versions; v > 0; v--) {
+      InternalKey key(user_key, 10 * v, kTypeValue);
+      builder.Add(key.Encode(), user_key);
+      plain_builder.Add(key.Encode(), user_key);
+    }
+  }
+  std::string data = builder.Finish().ToString();
+  std::string plain_data = plain_builder.Finish().ToString();
+  ASSERT_GT(data.size(), plain_data.size());
+
+  BlockContents contents;
+  contents.data = data;
+  contents.cachable = false;
+  contents.heap_allocated = false;
+  Block block(contents);
+  contents.data = plain_data;
+  Block plain_block(contents);
+
+  // Iteration is unchanged.
+  Iterator* iter = block.NewIterator(&icmp);
+  Iterator* plain_iter = plain_block.NewIterator(&icmp);
+  int n = 0;
+  for (iter->SeekToFirst(), plain_iter->SeekToFirst(); plain_iter->Valid();
+       iter->Next(), plain_iter->Next()) {
+    ASSERT_TRUE(iter->Valid());
+    ASSERT_EQ(plain_iter->key().ToString(), iter->key().ToString());
+    n++;
+  }
+  ASSERT_TRUE(!iter->Valid());
+  ASSERT_GE(n, 100);
+  delete iter;
+  delete plain_iter;
+
+  // Point lookups agree with Seek() whenever the user key is present.
+  for (int i = 0; i < 201; i++) {
+    char user_key[16];
+    std::snprintf(user_key, sizeof(user_key), "k%04d", i);
+    for (SequenceNumber seq = 5; seq <= 35; seq += 10) {
+      InternalKey target(user_key, seq, kValueTypeForSeek);
+      Iterator* get_iter = block.NewIteratorForGet(&icmp, target.Encode());
+      iter = block.NewIterator(&icmp);
+      iter->Seek(target.Encode());
+      if (iter->Valid() && ExtractUserKey(iter->key()) == Slice(user_key)) {
+        ASSERT_EQ(0, i % 2);
+        ASSERT_TRUE(get_iter->Valid());
+        ASSERT_EQ(iter->key().ToString(), get_iter->key().ToString());
+        ASSERT_EQ(iter->value().ToString(), get_iter->value().ToString());
+      } else if (get_iter->Valid()) {
+        ASSERT_NE(Slice(user_key), ExtractUserKey(get_iter->key()));
+      }
+      ASSERT_LEVELDB_OK(get_iter->status());
+      delete get_iter;
+      delete iter;
+    }
+  }
+}
+
 // Test the empty key
 TEST_F(Harness, SimpleEmptyKey) {
   for (int i = 0; i < kNumTestArgs; i++) {
@@ -784,15 +902,111 @@ TEST(TableTest, ApproximateOffsetOfPlain) {
   ASSERT_TRUE(Between(c.ApproximateOffsetOf("xyz"), 610000, 612000));
 }
 
-static bool SnappyCompressionSupported() {
+TEST(TableTest, IndexBlockInBlockCache) {
+  std::unique_ptr<Cache> cache(NewLRUCache(1 << 20, 0.5));
+  TableConstructor c(BytewiseComparator());
+  for (int i = 0; i < 200; i++) {
+    char key[16];
+    std::snprintf(key, sizeof(key), "k%04d", i);
+    c.Add(key, std::string(20, 'v'));
+  }
+  std::vector<std::string> keys;
+  KVMap kvmap;
+  Options options;
+  options.block_size = 256;
+  options.compression = kNoCompression;
+  options.block_cache = cache.get();
+  options.cache_index_and_filter_blocks = true;
+  c.Finish(options, &keys, &kvmap);
+
+  // Opening the table only charges its index block to the cache.
+  const size_t index_charge = cache->TotalCharge();
+  ASSERT_GT(index_charge, 0);
+  ASSERT_LT(index_charge, 1000);
+
+  // Once evicted, the index block is read back from the file.
+  cache->Prune();
+  ASSERT_EQ(0, cache->TotalCharge());
+  Iterator* iter = c.NewIterator();
+  iter->SeekToFirst();
+  for (const auto& kvp : kvmap) {
+    ASSERT_TRUE(iter->Valid());
+    ASSERT_EQ(kvp.first, iter->key().ToString());
+    ASSERT_EQ(kvp.second, iter->value().ToString());
+    iter->Next();
+  }
+  ASSERT_TRUE(!iter->Valid());
+  ASSERT_LEVELDB_OK(iter->status());
+  delete iter;
+  ASSERT_GT(cache->TotalCharge(), index_charge);
+  ASSERT_TRUE(Between(c.ApproximateOffsetOf("k0100"), 2000, 4000));
+}
+
+TEST(TableTest, UncompressedBlocksReadInPlace) {
+  StringSink sink;
+  Options options;
+  options.block_size = 256;
+  options.compression = kNoCompression;
+  TableBuilder builder(options, &sink);
+  for (int i = 0; i < 200; i++) {
+    char key[16];
+    std::snprintf(key, sizeof(key), "k%04d", i);
+    builder.Add(key, std::string(100, 'a' + i % 26));
+  }
+  ASSERT_LEVELDB_OK(builder.Finish());
+
+  std::unique_ptr<Cache> cache(NewLRUCache(1 << 20));
+  Options table_options;
+  table_options.block_cache = cache.get();
+  StringSource source(sink.contents(), /*in_place=*/true);
+  Table* table;
+  ASSERT_LEVELDB_OK(
+      Table::Open(table_options, &source, source.Size(), &table));
+
+  // Values point straight into the file and no block is cached.
+  Iterator* iter = table->NewIterator(ReadOptions());
+  int count = 0;
+  for (iter->SeekToFirst(); iter->Valid(); iter->Next()) {
+    ASSERT_EQ(std::string(100, 'a' + count % 26), iter->value().ToString());
+    ASSERT_GE(iter->value().data(), source.data());
+    ASSERT_LT(iter->value().data(), source.data() + source.Size());
+    count++;
+  }
+  ASSERT_EQ(200, count);
+  ASSERT_LEVELDB_OK(iter->status());
+  delete iter;
+  ASSERT_EQ(0, cache->TotalCharge());
+  delete table;
+}
+
+static bool CompressionSupported(CompressionType type) {
   std::string out;
   Slice in = "aaaaaaaaaaaaaaaaaaaaaaaaaaaaaaa";
-  return port::Snappy_Compress(in.data(), in.size(), &out);
+  switch (type) {
+    case kSnappyCompression:
+      return port::Snappy_Compress(in.data(), in.size(), &out);
+    case kZstdCompression:
+      return port::Zstd_Compress(/*level=*/1, in.data(), in.size(), &out);
+    case kLZ4Compression:
+      return port::LZ4_Compress(in.data(), in.size(), &out);
+    default:
+      return true;
+  }
 }
 
-TEST(TableTest, ApproximateOffsetOfCompressed) {
-  if (!SnappyCompressionSupported())
-    GTEST_SKIP() << "skipping compression tests";
+class CompressionTableTest
+    : public ::testing::TestWithParam<CompressionType> {};
+
+INSTANTIATE_TEST_SUITE_P(CompressionTests, CompressionTableTest,
+                         ::testing::Values(kSnappyCompression,
+                                           kZstdCompression,
+                                           kLZ4Compression));
+
+TEST_P(CompressionTableTest, ApproximateOffsetOfCompressed) {
+  CompressionType type = GetParam();
+  if (!CompressionSupported(type)) {
+    GTEST_SKIP() << "skipping compression test: " << type;
+  }
 
   Random rnd(301);
   TableConstructor c(BytewiseComparator());
@@ -805,7 +1019,7 @@ TEST(TableTest, ApproximateOffsetOfCompressed) {
   KVMap kvmap;
   Options options;
   options.block_size = 1024;
-  options.compression = kSnappyCompression;
+  options.compression = type;
   c.Finish(options, &keys, &kvmap);
 
   // Expected upper and lower bounds of space used by compressible strings.
@@ -824,4 +1038,58 @@ TEST(TableTest, ApproximateOffsetOfCompressed) {
   ASSERT_TRUE(Between(c.ApproximateOffsetOf("xyz"), 2 * min_z, 2 * max_z));
 }
 
+TEST_P(CompressionTableTest, UnsupportedCompressionStoredUncompressed) {
+  CompressionType type = GetParam();
+  if (CompressionSupported(type)) {
+    GTEST_SKIP() << "compression supported: " << type;
+  }
+
+  // Blocks fall back to no compression, so the table stays readable.
+  Random rnd(301);
+  TableConstructor c(BytewiseComparator());
+  std::string tmp;
+  c.Add("k01", test::CompressibleString(&rnd, 0.25, 10000, &tmp));
+  c.Add("k02", "hello");
+  std::vector<std::string> keys;
+  KVMap kvmap;
+  Options options;
+  options.block_size = 1024;
+  options.compression = type;
+  c.Finish(options, &keys, &kvmap);
+  ASSERT_TRUE(Between(c.ApproximateOffsetOf("k02"), 10000, 11000));
+
+  Iterator* iter = c.NewIterator();
+  iter->SeekToFirst();
+  ASSERT_TRUE(iter->Valid());
+  ASSERT_EQ("k01", iter->key().ToString());
+  ASSERT_EQ(tmp, iter->value().ToString());
+  iter->Next();
+  ASSERT_TRUE(iter->Valid());
+  ASSERT_EQ("hello", iter->value().ToString());
+  delete iter;
+}
+
+TEST(TableTest, CorruptLZ4BlockLength) {
+  if (!CompressionSupported(kLZ4Compression)) {
+    GTEST_SKIP() << "skipping compression test: " << kLZ4Compression;
+  }
+
+  // Build a block that claims to uncompress to almost 4GB.
+  std::string block;
+  ASSERT_TRUE(port::LZ4_Compress("hello", 5, &block));
+  const size_t n = block.size();
+  EncodeFixed32(&block[0], 0xfffffff0u);
+  block.push_back(static_cast<char>(kLZ4Compression));
+  PutFixed32(&block, crc32c::Mask(crc32c::Value(block.data(), n + 1)));
+
+  StringSource source(block);
+  BlockHandle handle;
+  handle.set_offset(0);
+  handle.set_size(n);
+  ReadOptions options;
+  options.verify_checksums = true;
+  BlockContents contents;
+  ASSERT_TRUE(ReadBlock(&source, options, handle, &contents).IsCorruption());
+}
+
 }  // namespace leveldb
@@ -4,17 +4,109 @@
 
 #include "util/arena.h"
 
+#if defined(LEVELDB_PLATFORM_POSIX)
+#include <sys/mman.h>
+#endif  // defined(LEVELDB_PLATFORM_POSIX)
+
+#include "util/mutexlock.h"
+
 namespace leveldb {
 
 static const int kBlockSize = 4096;
 
-Arena::Arena()
-    : alloc_ptr_(nullptr), alloc_bytes_remaining_(0), memory_usage_(0) {}
+namespace {
+
+// Returns a region of "bytes" bytes backed by huge pages if possible,
+// or nullptr on failure.
+char* NewRegion(size_t bytes) {
+#if defined(LEVELDB_PLATFORM_POSIX)
+  void* base = MAP_FAILED;
+#if defined(MAP_HUGETLB)
+  // Explicit huge pages are only available if the administrator reserved
+  // some, so fall back to regular pages that may be promoted by the kernel.
+  base = ::mmap(nullptr, bytes, PROT_READ | PROT_WRITE,
+                MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+#endif  // defined(MAP_HUGETLB)
+  if (base == MAP_FAILED) {
+    base = ::mmap(nullptr, bytes, PROT_READ | PROT_WRITE,
+                  MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (base == MAP_FAILED) {
+      return nullptr;
+    }
+#if defined(MADV_HUGEPAGE)
+    ::madvise(base, bytes, MADV_HUGEPAGE);
+#endif  // defined(MADV_HUGEPAGE)
+  }
+  return reinterpret_cast<char*>(base);
+#else
+  return new char[bytes];
+#endif  // defined(LEVELDB_PLATFORM_POSIX)
+}
+
+void DeleteRegion(char* region, size_t bytes) {
+#if defined(LEVELDB_PLATFORM_POSIX)
+  ::munmap(region, bytes);
+#else
+  (void)bytes;
+  delete[] region;
+#endif  // defined(LEVELDB_PLATFORM_POSIX)
+}
+
+}  // namespace
+
+// Regions are sized in whole huge pages.
+static const size_t kHugePageSize = 2 << 20;
+
+ArenaRegionPool::ArenaRegionPool(size_t region_bytes, int max_free_regions)
+    : region_bytes_((region_bytes + kHugePageSize - 1) & ~(kHugePageSize - 1)),
+      max_free_regions_(max_free_regions) {}
+
+ArenaRegionPool::~ArenaRegionPool() {
+  for (char* region : free_regions_) {
+    DeleteRegion(region, region_bytes_);
+  }
+}
+
+char* ArenaRegionPool::Acquire() {
+  {
+    MutexLock l(&mu_);
+    if (!free_regions_.empty()) {
+      char* region = free_regions_.back();
+      free_regions_.pop_back();
+      return region;
+    }
+  }
+  return NewRegion(region_bytes_);
+}
+
+void ArenaRegionPool::Release(char* region) {
+  {
+    MutexLock l(&mu_);
+    if (free_regions_.size() < static_cast<size_t>(max_free_regions_)) {
+      free_regions_.push_back(region);
+      return;
+    }
+  }
+  DeleteRegion(region, region_bytes_);
+}
+
+Arena::Arena() : Arena(nullptr) {}
+
+Arena::Arena(ArenaRegionPool* region_pool)
+    : alloc_ptr_(nullptr),
+      alloc_bytes_remaining_(0),
+      region_pool_(region_pool),
+      region_(nullptr),
+      region_used_(0),
+      memory_usage_(0) {}
 
 Arena::~Arena() {
   for (size_t i = 0; i < blocks_.size(); i++) {
     delete[] blocks_[i];
   }
+  if (region_ != nullptr) {
+    region_pool_->Release(region_);
+  }
 }
 
 char* Arena::AllocateFallback(size_t bytes) {
@@ -56,6 +148,23 @@ char* Arena::AllocateAligned(size_t bytes) {
 }
 
 char* Arena::AllocateNewBlock(size_t block_bytes) {
+  if (region_pool_ != nullptr) {
+    if (region_ == nullptr && region_used_ == 0) {
+      region_ = region_pool_->Acquire();
+      if (region_ == nullptr) {
+        region_used_ = region_pool_->region_bytes();  // Do not retry
+      }
+    }
+    // Keep carved blocks aligned like the ones returned by new[].
+    const size_t align = alignof(std::max_align_t);
+    const size_t start = (region_used_ + align - 1) & ~(align - 1);
+    if (region_ != nullptr &&
+        start + block_bytes <= region_pool_->region_bytes()) {
+      region_used_ = start + block_bytes;
+      memory_usage_.fetch_add(block_bytes, std::memory_order_relaxed);
+      return region_ + start;
+    }
+  }
   char* result = new char[block_bytes];
   blocks_.push_back(result);
   memory_usage_.fetch_add(block_bytes + sizeof(char*),
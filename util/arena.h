@@ -11,12 +11,53 @@
 #include <cstdint>
 #include <vector>
 
+#include "port/port.h"
+#include "port/thread_annotations.h"
+
 namespace leveldb {
 
+// A source of large contiguous memory regions, all of the same size.
+// Regions are backed by huge pages where the platform supports them,
+// which cuts the TLB misses of walking a large memtable.  Up to
+// "max_free_regions" released regions are kept for reuse instead of
+// being returned to the operating system.
+//
+// Thread-safe.
+class ArenaRegionPool {
+ public:
+  ArenaRegionPool(size_t region_bytes, int max_free_regions);
+
+  ArenaRegionPool(const ArenaRegionPool&) = delete;
+  ArenaRegionPool& operator=(const ArenaRegionPool&) = delete;
+
+  ~ArenaRegionPool();
+
+  // Returns a region of region_bytes() bytes, or nullptr if none could
+  // be allocated.
+  char* Acquire();
+
+  // Returns a region obtained from Acquire() to the pool.
+  void Release(char* region);
+
+  size_t region_bytes() const { return region_bytes_; }
+
+ private:
+  const size_t region_bytes_;
+  const int max_free_regions_;
+  port::Mutex mu_;
+  std::vector<char*> free_regions_ GUARDED_BY(mu_);
+};
+
 class Arena {
  public:
   Arena();
 
+  // Carve blocks out of a single region taken from "*region_pool" until
+  // it is exhausted, then fall back to the heap.  The region is returned
+  // to the pool when the arena is destroyed, so "*region_pool" must
+  // outlive the arena.
+  explicit Arena(ArenaRegionPool* region_pool);
+
   Arena(const Arena&) = delete;
   Arena& operator=(const Arena&) = delete;
 
@@ -45,6 +86,11 @@ class Arena {
   // Array of new[] allocated memory blocks
   std::vector<char*> blocks_;
 
+  // Region from which blocks are carved before using new[], if any
+  ArenaRegionPool* const region_pool_;
+  char* region_;
+  size_t region_used_;
+
   // Total memory usage of the arena.
   //
   // TODO(costan): This member is accessed via atomics, but the others are
@@ -11,9 +11,8 @@ namespace leveldb {
 
 TEST(ArenaTest, Empty) { Arena arena; }
 
-TEST(ArenaTest, Simple) {
+static void TestArena(Arena* arena) {
   std::vector<std::pair<size_t, char*>> allocated;
-  Arena arena;
   const int N = 100000;
   size_t bytes = 0;
   Random rnd(301);
@@ -32,9 +31,9 @@ TEST(ArenaTest, Simple) {
     }
     char* r;
     if (rnd.OneIn(10)) {
-      r = arena.AllocateAligned(s);
+      r = arena->AllocateAligned(s);
     } else {
-      r = arena.Allocate(s);
+      r = arena->Allocate(s);
     }
 
     for (size_t b = 0; b < s; b++) {
@@ -43,9 +42,9 @@ TEST(ArenaTest, Simple) {
     }
     bytes += s;
     allocated.push_back(std::make_pair(s, r));
-    ASSERT_GE(arena.MemoryUsage(), bytes);
+    ASSERT_GE(arena->MemoryUsage(), bytes);
     if (i > N / 10) {
-      ASSERT_LE(arena.MemoryUsage(), bytes * 1.10);
+      ASSERT_LE(arena->MemoryUsage(), bytes * 1.10);
     }
   }
   for (size_t i = 0; i < allocated.size(); i++) {
@@ -58,4 +57,33 @@ TEST(ArenaTest, Simple) {
   }
 }
 
+TEST(ArenaTest, Simple) {
+  Arena arena;
+  TestArena(&arena);
+}
+
+TEST(ArenaTest, Region) {
+  // Smaller than the bytes allocated by TestArena(), so that the arena
+  // has to fall back to the heap.
+  ArenaRegionPool pool(1 << 20, 1);
+  ASSERT_EQ(size_t{2} << 20, pool.region_bytes());
+  {
+    Arena arena(&pool);
+    TestArena(&arena);
+  }
+
+  // The region released by the arena is handed out again.
+  char* region = pool.Acquire();
+  ASSERT_TRUE(region != nullptr);
+  region[0] = 'x';
+  region[pool.region_bytes() - 1] = 'y';
+  pool.Release(region);
+  ASSERT_EQ(region, pool.Acquire());
+  char* other = pool.Acquire();
+  ASSERT_TRUE(other != nullptr);
+  ASSERT_NE(region, other);
+  pool.Release(region);
+  pool.Release(other);  // Pool is full; unmapped
+}
+
 }  // namespace leveldb
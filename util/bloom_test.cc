@@ -2,6 +2,8 @@
 // Use of this source code is governed by a BSD-style license that can be
 // found in the LICENSE file. See the AUTHORS file for names of contributors.
 
+#include <memory>
+
 #include "gtest/gtest.h"
 #include "leveldb/filter_policy.h"
 #include "util/coding.h"
@@ -20,6 +22,7 @@ static Slice Key(int i, char* buffer) {
 class BloomTest : public testing::Test {
  public:
   BloomTest() : policy_(NewBloomFilterPolicy(10)) {}
+  explicit BloomTest(const FilterPolicy* policy) : policy_(policy) {}
 
   ~BloomTest() { delete policy_; }
 
@@ -151,4 +154,163 @@ TEST_F(BloomTest, VaryingLengths) {
 
 // Different bits-per-byte
 
+class BlockedBloomTest : public BloomTest {
+ public:
+  BlockedBloomTest() : BloomTest(NewBlockedBloomFilterPolicy(10)) {}
+};
+
+TEST_F(BlockedBloomTest, EmptyFilter) {
+  ASSERT_TRUE(!Matches("hello"));
+  ASSERT_TRUE(!Matches("world"));
+}
+
+TEST_F(BlockedBloomTest, Small) {
+  Add("hello");
+  Add("world");
+  ASSERT_TRUE(Matches("hello"));
+  ASSERT_TRUE(Matches("world"));
+  ASSERT_TRUE(!Matches("x"));
+  ASSERT_TRUE(!Matches("foo"));
+}
+
+TEST_F(BlockedBloomTest, VaryingLengths) {
+  char buffer[sizeof(int)];
+
+  int mediocre_filters = 0;
+  int good_filters = 0;
+
+  for (int length = 1; length <= 10000; length = NextLength(length)) {
+    Reset();
+    for (int i = 0; i < length; i++) {
+      Add(Key(i, buffer));
+    }
+    Build();
+
+    // Rounded up to whole 64-byte blocks
+    ASSERT_EQ(0, FilterSize() % 64);
+    ASSERT_LE(FilterSize(), static_cast<size_t>((length * 10 / 8) + 64))
+        << length;
+
+    for (int i = 0; i < length; i++) {
+      ASSERT_TRUE(Matches(Key(i, buffer)))
+          << "Length " << length << "; key " << i;
+    }
+
+    double rate = FalsePositiveRate();
+    if (kVerbose >= 1) {
+      std::fprintf(stderr,
+                   "False positives: %5.2f%% @ length = %6d ; bytes = %6d\n",
+                   rate * 100.0, length, static_cast<int>(FilterSize()));
+    }
+    ASSERT_LE(rate, 0.025);  // Must not be over 2.5%
+    if (rate > 0.015)
+      mediocre_filters++;  // Allowed, but not too often
+    else
+      good_filters++;
+  }
+  if (kVerbose >= 1) {
+    std::fprintf(stderr, "Filters: %d good, %d mediocre\n", good_filters,
+                 mediocre_filters);
+  }
+  ASSERT_LE(mediocre_filters, good_filters / 5);
+}
+
+class RibbonTest : public BloomTest {
+ public:
+  RibbonTest() : BloomTest(NewRibbonFilterPolicy(10)) {}
+};
+
+TEST_F(RibbonTest, EmptyFilter) {
+  ASSERT_TRUE(!Matches("hello"));
+  ASSERT_TRUE(!Matches("world"));
+}
+
+TEST_F(RibbonTest, Small) {
+  Add("hello");
+  Add("world");
+  ASSERT_TRUE(Matches("hello"));
+  ASSERT_TRUE(Matches("world"));
+  ASSERT_TRUE(!Matches("x"));
+  ASSERT_TRUE(!Matches("foo"));
+}
+
+TEST_F(RibbonTest, VaryingLengths) {
+  char buffer[sizeof(int)];
+
+  int mediocre_filters = 0;
+  int good_filters = 0;
+
+  for (int length = 1; length <= 10000; length = NextLength(length)) {
+    Reset();
+    for (int i = 0; i < length; i++) {
+      Add(Key(i, buffer));
+    }
+    Add(Key(0, buffer));  // Duplicates are allowed
+    Build();
+
+    // Never larger than a bloom filter, and well under 8 bits per key
+    // once there are enough keys to amortize the last block.
+    ASSERT_LE(FilterSize(), static_cast<size_t>((length * 10 / 8) + 40))
+        << length;
+    if (length >= 1000) {
+      ASSERT_LE(FilterSize(), static_cast<size_t>(length)) << length;
+    }
+
+    for (int i = 0; i < length; i++) {
+      ASSERT_TRUE(Matches(Key(i, buffer)))
+          << "Length " << length << "; key " << i;
+    }
+
+    double rate = FalsePositiveRate();
+    if (kVerbose >= 1) {
+      std::fprintf(stderr,
+                   "False positives: %5.2f%% @ length = %6d ; bytes = %6d\n",
+                   rate * 100.0, length, static_cast<int>(FilterSize()));
+    }
+    ASSERT_LE(rate, 0.02);  // Must not be over 2%
+    if (rate > 0.0125)
+      mediocre_filters++;  // Allowed, but not too often
+    else
+      good_filters++;
+  }
+  if (kVerbose >= 1) {
+    std::fprintf(stderr, "Filters: %d good, %d mediocre\n", good_filters,
+                 mediocre_filters);
+  }
+  ASSERT_LE(mediocre_filters, good_filters / 5);
+}
+
+TEST(RibbonFilterTest, CompatibleWithBloomFilters) {
+  std::unique_ptr<const FilterPolicy> bloom(NewBloomFilterPolicy(10));
+  std::unique_ptr<const FilterPolicy> ribbon(NewRibbonFilterPolicy(10));
+  ASSERT_EQ(std::string(bloom->Name()), ribbon->Name());
+
+  char buffer[sizeof(int)];
+  std::vector<std::string> keys;
+  for (int i = 0; i < 5000; i++) {
+    keys.push_back(Key(i, buffer).ToString());
+  }
+  const std::vector<Slice> slices(keys.begin(), keys.end());
+  std::string bloom_filter, ribbon_filter;
+  bloom->CreateFilter(slices.data(), slices.size(), &bloom_filter);
+  ribbon->CreateFilter(slices.data(), slices.size(), &ribbon_filter);
+  ASSERT_LT(ribbon_filter.size(), bloom_filter.size() * 8 / 10);
+
+  // Bloom filters are read by the ribbon policy as by the bloom policy.
+  for (const Slice& key : slices) {
+    ASSERT_TRUE(ribbon->KeyMayMatch(key, bloom_filter));
+  }
+  int false_positives = 0;
+  for (int i = 0; i < 10000; i++) {
+    const Slice key = Key(i + 1000000000, buffer);
+    ASSERT_EQ(bloom->KeyMayMatch(key, bloom_filter),
+              ribbon->KeyMayMatch(key, bloom_filter));
+    false_positives += ribbon->KeyMayMatch(key, ribbon_filter);
+  }
+  ASSERT_LE(false_positives, 200);
+
+  // Ribbon filters match everything for the bloom policy.
+  ASSERT_TRUE(bloom->KeyMayMatch(Key(1000000000, buffer), ribbon_filter));
+}
+
 }  // namespace leveldb
@@ -7,6 +7,7 @@
 #include <cassert>
 #include <cstdio>
 #include <cstdlib>
+#include <initializer_list>
 
 #include "port/port.h"
 #include "port/thread_annotations.h"
@@ -17,6 +18,12 @@ namespace leveldb {
 
 Cache::~Cache() {}
 
+Cache::Handle* Cache::Insert(const Slice& key, void* value, size_t charge,
+                             void (*deleter)(const Slice& key, void* value),
+                             Priority priority) {
+  return Insert(key, value, charge, deleter);
+}
+
 namespace {
 
 // LRU cache implementation
@@ -34,9 +41,14 @@ namespace {
 //   removed the check, elements that would otherwise be on this list could be
 //   left as disconnected singleton lists.)
 // - LRU:  contains the items not currently referenced by clients, in LRU order
+// - high-priority LRU:  like LRU, but for items inserted at Cache::kHigh,
+//   up to a total charge of high_pri_capacity_.  When it grows past that,
+//   its oldest items are moved to the newest end of the LRU list.
 // Elements are moved between these lists by the Ref() and Unref() methods,
 // when they detect an element in the cache acquiring or losing its only
-// external reference.
+// external reference.  Eviction takes the oldest item of the LRU list, and
+// the oldest item of the high-priority LRU list only once the former is
+// empty.
 
 // An entry is a variable length heap-allocated structure.  Entries
 // are kept in a circular doubly linked list ordered by access time.
@@ -49,6 +61,8 @@ struct LRUHandle {
   size_t charge;  // TODO(opt): Only allow uint32_t?
   size_t key_length;
   bool in_cache;     // Whether entry is in the cache.
+  bool high_pri;     // Whether entry was inserted at Cache::kHigh.
+  bool in_high_pool;  // Whether entry is on the high-priority LRU list.
   uint32_t refs;     // References, including cache reference, if present.
   uint32_t hash;     // Hash of key(); used for fast sharding and comparisons
   char key_data[1];  // Beginning of key
@@ -154,12 +168,16 @@ class LRUCache {
   ~LRUCache();
 
   // Separate from constructor so caller can easily make an array of LRUCache
-  void SetCapacity(size_t capacity) { capacity_ = capacity; }
+  void SetCapacity(size_t capacity, size_t high_pri_capacity) {
+    capacity_ = capacity;
+    high_pri_capacity_ = high_pri_capacity;
+  }
 
   // Like Cache methods, but with an extra "hash" parameter.
   Cache::Handle* Insert(const Slice& key, uint32_t hash, void* value,
                         size_t charge,
-                        void (*deleter)(const Slice& key, void* value));
+                        void (*deleter)(const Slice& key, void* value),
+                        Cache::Priority priority);
   Cache::Handle* Lookup(const Slice& key, uint32_t hash);
   void Release(Cache::Handle* handle);
   void Erase(const Slice& key, uint32_t hash);
@@ -172,22 +190,29 @@ class LRUCache {
  private:
   void LRU_Remove(LRUHandle* e);
   void LRU_Append(LRUHandle* list, LRUHandle* e);
+  void LRU_Insert(LRUHandle* e) EXCLUSIVE_LOCKS_REQUIRED(mutex_);
   void Ref(LRUHandle* e);
   void Unref(LRUHandle* e);
   bool FinishErase(LRUHandle* e) EXCLUSIVE_LOCKS_REQUIRED(mutex_);
 
   // Initialized before use.
   size_t capacity_;
+  size_t high_pri_capacity_;
 
   // mutex_ protects the following state.
   mutable port::Mutex mutex_;
   size_t usage_ GUARDED_BY(mutex_);
+  size_t high_pri_usage_ GUARDED_BY(mutex_);  // Charge of lru_high_ entries
 
   // Dummy head of LRU list.
   // lru.prev is newest entry, lru.next is oldest entry.
   // Entries have refs==1 and in_cache==true.
   LRUHandle lru_ GUARDED_BY(mutex_);
 
+  // Dummy head of high-priority LRU list.
+  // Entries have refs==1, in_cache==true and in_high_pool==true.
+  LRUHandle lru_high_ GUARDED_BY(mutex_);
+
   // Dummy head of in-use list.
   // Entries are in use by clients, and have refs >= 2 and in_cache==true.
   LRUHandle in_use_ GUARDED_BY(mutex_);
@@ -195,28 +220,33 @@ class LRUCache {
   HandleTable table_ GUARDED_BY(mutex_);
 };
 
-LRUCache::LRUCache() : capacity_(0), usage_(0) {
+LRUCache::LRUCache()
+    : capacity_(0), high_pri_capacity_(0), usage_(0), high_pri_usage_(0) {
   // Make empty circular linked lists.
   lru_.next = &lru_;
   lru_.prev = &lru_;
+  lru_high_.next = &lru_high_;
+  lru_high_.prev = &lru_high_;
   in_use_.next = &in_use_;
   in_use_.prev = &in_use_;
 }
 
 LRUCache::~LRUCache() {
   assert(in_use_.next == &in_use_);  // Error if caller has an unreleased handle
-  for (LRUHandle* e = lru_.next; e != &lru_;) {
-    LRUHandle* next = e->next;
-    assert(e->in_cache);
-    e->in_cache = false;
-    assert(e->refs == 1);  // Invariant of lru_ list.
-    Unref(e);
-    e = next;
+  for (LRUHandle* list : {&lru_, &lru_high_}) {
+    for (LRUHandle* e = list->next; e != list;) {
+      LRUHandle* next = e->next;
+      assert(e->in_cache);
+      e->in_cache = false;
+      assert(e->refs == 1);  // Invariant of lru_ and lru_high_ lists.
+      Unref(e);
+      e = next;
+    }
   }
 }
 
 void LRUCache::Ref(LRUHandle* e) {
-  if (e->refs == 1 && e->in_cache) {  // If on lru_ list, move to in_use_ list.
+  if (e->refs == 1 && e->in_cache) {  // If on an LRU list, move to in_use_.
     LRU_Remove(e);
     LRU_Append(&in_use_, e);
   }
@@ -231,15 +261,19 @@ void LRUCache::Unref(LRUHandle* e) {
     (*e->deleter)(e->key(), e->value);
     free(e);
   } else if (e->in_cache && e->refs == 1) {
-    // No longer in use; move to lru_ list.
+    // No longer in use; move to an LRU list.
     LRU_Remove(e);
-    LRU_Append(&lru_, e);
+    LRU_Insert(e);
   }
 }
 
 void LRUCache::LRU_Remove(LRUHandle* e) {
   e->next->prev = e->prev;
   e->prev->next = e->next;
+  if (e->in_high_pool) {
+    e->in_high_pool = false;
+    high_pri_usage_ -= e->charge;
+  }
 }
 
 void LRUCache::LRU_Append(LRUHandle* list, LRUHandle* e) {
@@ -250,6 +284,22 @@ void LRUCache::LRU_Append(LRUHandle* list, LRUHandle* e) {
   e->next->prev = e;
 }
 
+void LRUCache::LRU_Insert(LRUHandle* e) {
+  if (!e->high_pri || high_pri_capacity_ == 0) {
+    LRU_Append(&lru_, e);
+    return;
+  }
+  LRU_Append(&lru_high_, e);
+  e->in_high_pool = true;
+  high_pri_usage_ += e->charge;
+  // Make room by moving the oldest entries out of the pool.
+  while (high_pri_usage_ > high_pri_capacity_) {
+    LRUHandle* old = lru_high_.next;
+    LRU_Remove(old);
+    LRU_Append(&lru_, old);
+  }
+}
+
 Cache::Handle* LRUCache::Lookup(const Slice& key, uint32_t hash) {
   MutexLock l(&mutex_);
   LRUHandle* e = table_.Lookup(key, hash);
@@ -267,7 +317,8 @@ void LRUCache::Release(Cache::Handle* handle) {
 Cache::Handle* LRUCache::Insert(const Slice& key, uint32_t hash, void* value,
                                 size_t charge,
                                 void (*deleter)(const Slice& key,
-                                                void* value)) {
+                                                void* value),
+                                Cache::Priority priority) {
   MutexLock l(&mutex_);
 
   LRUHandle* e =
@@ -278,6 +329,8 @@ Cache::Handle* LRUCache::Insert(const Slice& key, uint32_t hash, void* value,
   e->key_length = key.size();
   e->hash = hash;
   e->in_cache = false;
+  e->high_pri = (priority == Cache::kHigh);
+  e->in_high_pool = false;
   e->refs = 1;  // for the returned handle.
   std::memcpy(e->key_data, key.data(), key.size());
 
@@ -291,8 +344,9 @@ Cache::Handle* LRUCache::Insert(const Slice& key, uint32_t hash, void* value,
     // next is read by key() in an assert, so it must be initialized
     e->next = nullptr;
   }
-  while (usage_ > capacity_ && lru_.next != &lru_) {
-    LRUHandle* old = lru_.next;
+  while (usage_ > capacity_ &&
+         (lru_.next != &lru_ || lru_high_.next != &lru_high_)) {
+    LRUHandle* old = (lru_.next != &lru_) ? lru_.next : lru_high_.next;
     assert(old->refs == 1);
     bool erased = FinishErase(table_.Remove(old->key(), old->hash));
     if (!erased) {  // to avoid unused variable when compiled NDEBUG
@@ -323,12 +377,14 @@ void LRUCache::Erase(const Slice& key, uint32_t hash) {
 
 void LRUCache::Prune() {
   MutexLock l(&mutex_);
-  while (lru_.next != &lru_) {
-    LRUHandle* e = lru_.next;
-    assert(e->refs == 1);
-    bool erased = FinishErase(table_.Remove(e->key(), e->hash));
-    if (!erased) {  // to avoid unused variable when compiled NDEBUG
-      assert(erased);
+  for (LRUHandle* list : {&lru_, &lru_high_}) {
+    while (list->next != list) {
+      LRUHandle* e = list->next;
+      assert(e->refs == 1);
+      bool erased = FinishErase(table_.Remove(e->key(), e->hash));
+      if (!erased) {  // to avoid unused variable when compiled NDEBUG
+        assert(erased);
+      }
     }
   }
 }
@@ -349,17 +405,26 @@ class ShardedLRUCache : public Cache {
   static uint32_t Shard(uint32_t hash) { return hash >> (32 - kNumShardBits); }
 
  public:
-  explicit ShardedLRUCache(size_t capacity) : last_id_(0) {
+  ShardedLRUCache(size_t capacity, double high_pri_pool_ratio) : last_id_(0) {
+    assert(high_pri_pool_ratio >= 0 && high_pri_pool_ratio <= 1);
     const size_t per_shard = (capacity + (kNumShards - 1)) / kNumShards;
+    const size_t high_pri_per_shard =
+        static_cast<size_t>(per_shard * high_pri_pool_ratio);
     for (int s = 0; s < kNumShards; s++) {
-      shard_[s].SetCapacity(per_shard);
+      shard_[s].SetCapacity(per_shard, high_pri_per_shard);
     }
   }
   ~ShardedLRUCache() override {}
   Handle* Insert(const Slice& key, void* value, size_t charge,
                  void (*deleter)(const Slice& key, void* value)) override {
+    return Insert(key, value, charge, deleter, kLow);
+  }
+  Handle* Insert(const Slice& key, void* value, size_t charge,
+                 void (*deleter)(const Slice& key, void* value),
+                 Priority priority) override {
     const uint32_t hash = HashSlice(key);
-    return shard_[Shard(hash)].Insert(key, hash, value, charge, deleter);
+    return shard_[Shard(hash)].Insert(key, hash, value, charge, deleter,
+                                      priority);
   }
   Handle* Lookup(const Slice& key) override {
     const uint32_t hash = HashSlice(key);
@@ -396,6 +461,10 @@ class ShardedLRUCache : public Cache {
 
 }  // end anonymous namespace
 
-Cache* NewLRUCache(size_t capacity) { return new ShardedLRUCache(capacity); }
+Cache* NewLRUCache(size_t capacity) { return new ShardedLRUCache(capacity, 0); }
+
+Cache* NewLRUCache(size_t capacity, double high_pri_pool_ratio) {
+  return new ShardedLRUCache(capacity, high_pri_pool_ratio);
+}
 
 }  // namespace leveldb
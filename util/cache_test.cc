@@ -54,6 +54,11 @@ class CacheTest : public testing::Test {
                                    &CacheTest::Deleter));
   }
 
+  void InsertHighPriority(int key, int value, int charge = 1) {
+    cache_->Release(cache_->Insert(EncodeKey(key), EncodeValue(value), charge,
+                                   &CacheTest::Deleter, Cache::kHigh));
+  }
+
   Cache::Handle* InsertAndReturnHandle(int key, int value, int charge = 1) {
     return cache_->Insert(EncodeKey(key), EncodeValue(value), charge,
                           &CacheTest::Deleter);
@@ -213,6 +218,37 @@ TEST_F(CacheTest, Prune) {
   ASSERT_EQ(-1, Lookup(2));
 }
 
+TEST_F(CacheTest, HighPriorityPool) {
+  delete cache_;
+  cache_ = NewLRUCache(kCacheSize, 0.5);
+
+  // High priority entries that fit in the pool outlive any number of
+  // low priority ones.
+  for (int i = 0; i < 50; i++) {
+    InsertHighPriority(i, 100 + i);
+  }
+  for (int i = 0; i < 2 * kCacheSize; i++) {
+    Insert(1000 + i, 2000 + i);
+  }
+  for (int i = 0; i < 50; i++) {
+    ASSERT_EQ(100 + i, Lookup(i));
+  }
+
+  // Beyond the pool, high priority entries age out like the others.
+  for (int i = 0; i < 2 * kCacheSize; i++) {
+    InsertHighPriority(5000 + i, 6000 + i);
+  }
+  int cached = 0;
+  for (int i = 0; i < 2 * kCacheSize; i++) {
+    if (Lookup(5000 + i) >= 0) {
+      cached++;
+    }
+  }
+  ASSERT_LE(cached, kCacheSize + kCacheSize / 10);
+  ASSERT_EQ(-1, Lookup(5000));
+  ASSERT_EQ(6000 + 2 * kCacheSize - 1, Lookup(5000 + 2 * kCacheSize - 1));
+}
+
 TEST_F(CacheTest, ZeroSizeCache) {
   delete cache_;
   cache_ = NewLRUCache(0);
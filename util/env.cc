@@ -22,6 +22,13 @@ Status Env::NewAppendableFile(const std::string& fname, WritableFile** result) {
   return Status::NotSupported("NewAppendableFile", fname);
 }
 
+Status Env::ReuseWritableFile(const std::string& fname,
+                              const std::string& old_fname,
+                              WritableFile** result) {
+  *result = nullptr;
+  return Status::NotSupported("ReuseWritableFile", fname);
+}
+
 Status Env::RemoveDir(const std::string& dirname) { return DeleteDir(dirname); }
 Status Env::DeleteDir(const std::string& dirname) { return RemoveDir(dirname); }
 
@@ -32,8 +39,16 @@ SequentialFile::~SequentialFile() = default;
 
 RandomAccessFile::~RandomAccessFile() = default;
 
+bool RandomAccessFile::ReadsInPlace() const { return false; }
+
 WritableFile::~WritableFile() = default;
 
+Status WritableFile::Preallocate(uint64_t size) { return Status::OK(); }
+
+void WritableFile::SyncAsync(SyncCallback done, void* arg) {
+  done(arg, Sync());
+}
+
 Logger::~Logger() = default;
 
 FileLock::~FileLock() = default;
@@ -27,6 +27,7 @@
 #include <thread>
 #include <type_traits>
 #include <utility>
+#include <vector>
 
 #include "leveldb/env.h"
 #include "leveldb/slice.h"
@@ -36,6 +37,11 @@
 #include "util/env_posix_test_helper.h"
 #include "util/posix_logger.h"
 
+#if HAVE_IO_URING
+#include <linux/io_uring.h>
+#include <sys/syscall.h>
+#endif  // HAVE_IO_URING
+
 namespace leveldb {
 
 namespace {
@@ -49,6 +55,9 @@ constexpr const int kDefaultMmapLimit = (sizeof(void*) >= 8) ? 1000 : 0;
 // Can be set using EnvPosixTestHelper::SetReadOnlyMMapLimit().
 int g_mmap_limit = kDefaultMmapLimit;
 
+// Can be set using EnvPosixTestHelper::SetUseIoUring().
+std::atomic<bool> g_use_io_uring{true};
+
 // Common flags defined for all posix open operations
 #if defined(HAVE_O_CLOEXEC)
 constexpr const int kOpenBaseFlags = O_CLOEXEC;
@@ -267,6 +276,8 @@ class PosixMmapReadableFile final : public RandomAccessFile {
     return Status::OK();
   }
 
+  bool ReadsInPlace() const override { return true; }
+
  private:
   char* const mmap_base_;
   const size_t length_;
@@ -274,14 +285,30 @@ class PosixMmapReadableFile final : public RandomAccessFile {
   const std::string filename_;
 };
 
+// Runs the syncs started by PosixWritableFile::SyncAsync().
+//
+// Implementations are thread-safe.
+class PosixSyncer {
+ public:
+  virtual ~PosixSyncer() = default;
+
+  // Sync the data of "fd" and then call "done(arg, status)".  "filename"
+  // is only used to describe errors.  Both must stay valid until "done"
+  // has been called.
+  virtual void Sync(int fd, const std::string* filename,
+                    WritableFile::SyncCallback done, void* arg) = 0;
+};
+
 class PosixWritableFile final : public WritableFile {
  public:
-  PosixWritableFile(std::string filename, int fd)
+  // "syncer" may be nullptr, in which case SyncAsync() syncs inline.
+  PosixWritableFile(std::string filename, int fd, PosixSyncer* syncer)
       : pos_(0),
         fd_(fd),
         is_manifest_(IsManifest(filename)),
         filename_(std::move(filename)),
-        dirname_(Dirname(filename_)) {}
+        dirname_(Dirname(filename_)),
+        syncer_(syncer) {}
 
   ~PosixWritableFile() override {
     if (fd_ >= 0) {
@@ -331,6 +358,18 @@ class PosixWritableFile final : public WritableFile {
 
   Status Flush() override { return FlushBuffer(); }
 
+  Status Preallocate(uint64_t size) override {
+#if HAVE_FALLOCATE
+    // FALLOC_FL_KEEP_SIZE reserves the blocks without making them part of
+    // the file, so readers never see the preallocated range.
+    if (::fallocate(fd_, FALLOC_FL_KEEP_SIZE, 0, static_cast<off_t>(size)) !=
+        0) {
+      return PosixError(filename_, errno);
+    }
+#endif  // HAVE_FALLOCATE
+    return Status::OK();
+  }
+
   Status Sync() override {
     // Ensure new files referred to by the manifest are in the filesystem.
     //
@@ -350,7 +389,26 @@ class PosixWritableFile final : public WritableFile {
     return SyncFd(fd_, filename_);
   }
 
+  void SyncAsync(SyncCallback done, void* arg) override {
+    if (syncer_ == nullptr || is_manifest_) {
+      // Manifest syncs also sync the directory and are rare enough not to
+      // be worth overlapping.
+      done(arg, Sync());
+      return;
+    }
+
+    Status status = FlushBuffer();
+    if (!status.ok()) {
+      done(arg, status);
+      return;
+    }
+    syncer_->Sync(fd_, &filename_, done, arg);
+  }
+
  private:
+  friend class ThreadPosixSyncer;
+  friend class IoUringPosixSyncer;
+
   Status FlushBuffer() {
     Status status = WriteUnbuffered(buf_, pos_);
     pos_ = 0;
@@ -462,7 +520,248 @@ class PosixWritableFile final : public WritableFile {
   const bool is_manifest_;  // True if the file's name starts with MANIFEST.
   const std::string filename_;
   const std::string dirname_;  // The directory of filename_.
+  PosixSyncer* const syncer_;
+};
+
+// Syncs files on a dedicated background thread.  The syncs queued while
+// the thread is busy are handled as one batch, and a file that appears
+// several times in a batch is only synced once.
+class ThreadPosixSyncer final : public PosixSyncer {
+ public:
+  ThreadPosixSyncer() : cv_(&mu_), started_thread_(false) {}
+
+  void Sync(int fd, const std::string* filename,
+            WritableFile::SyncCallback done, void* arg) override {
+    mu_.Lock();
+    if (!started_thread_) {
+      started_thread_ = true;
+      std::thread sync_thread(ThreadPosixSyncer::ThreadEntryPoint, this);
+      sync_thread.detach();
+    }
+    if (queue_.empty()) {
+      cv_.Signal();
+    }
+    queue_.push_back(Request{fd, filename, done, arg});
+    mu_.Unlock();
+  }
+
+ private:
+  struct Request {
+    int fd;
+    const std::string* filename;
+    WritableFile::SyncCallback done;
+    void* arg;
+  };
+
+  static void ThreadEntryPoint(ThreadPosixSyncer* syncer) {
+    syncer->ThreadMain();
+  }
+
+  void ThreadMain() {
+    std::vector<Request> batch;
+    std::vector<std::pair<int, Status>> synced;
+    while (true) {
+      mu_.Lock();
+      while (queue_.empty()) {
+        cv_.Wait();
+      }
+      batch.swap(queue_);
+      mu_.Unlock();
+
+      // Every request in the batch was queued before any of its syncs
+      // started, so one sync per file covers all of them.
+      synced.clear();
+      for (const Request& request : batch) {
+        Status status;
+        bool found = false;
+        for (const auto& entry : synced) {
+          if (entry.first == request.fd) {
+            status = entry.second;
+            found = true;
+            break;
+          }
+        }
+        if (!found) {
+          status = PosixWritableFile::SyncFd(request.fd, *request.filename);
+          synced.emplace_back(request.fd, status);
+        }
+        request.done(request.arg, status);
+      }
+      batch.clear();
+    }
+  }
+
+  port::Mutex mu_;
+  port::CondVar cv_ GUARDED_BY(mu_);
+  bool started_thread_ GUARDED_BY(mu_);
+  std::vector<Request> queue_ GUARDED_BY(mu_);
+};
+
+#if HAVE_IO_URING
+// Submits fdatasync() requests to an io_uring instance and completes them
+// from a dedicated reaper thread.  The rings are driven through the raw
+// system calls, so liburing is not required.
+class IoUringPosixSyncer final : public PosixSyncer {
+ public:
+  // Returns nullptr if the kernel does not support io_uring.
+  static IoUringPosixSyncer* Open(unsigned entries) {
+    struct ::io_uring_params params;
+    std::memset(&params, 0, sizeof(params));
+    const int ring_fd =
+        static_cast<int>(::syscall(__NR_io_uring_setup, entries, &params));
+    if (ring_fd < 0) {
+      return nullptr;
+    }
+
+    const size_t sq_ring_size =
+        params.sq_off.array + params.sq_entries * sizeof(unsigned);
+    const size_t cq_ring_size =
+        params.cq_off.cqes + params.cq_entries * sizeof(struct ::io_uring_cqe);
+    const size_t sqes_size = params.sq_entries * sizeof(struct ::io_uring_sqe);
+    void* sq_ring =
+        ::mmap(nullptr, sq_ring_size, PROT_READ | PROT_WRITE,
+               MAP_SHARED | MAP_POPULATE, ring_fd, IORING_OFF_SQ_RING);
+    void* cq_ring =
+        ::mmap(nullptr, cq_ring_size, PROT_READ | PROT_WRITE,
+               MAP_SHARED | MAP_POPULATE, ring_fd, IORING_OFF_CQ_RING);
+    void* sqes = ::mmap(nullptr, sqes_size, PROT_READ | PROT_WRITE,
+                        MAP_SHARED | MAP_POPULATE, ring_fd, IORING_OFF_SQES);
+    if (sq_ring == MAP_FAILED || cq_ring == MAP_FAILED || sqes == MAP_FAILED) {
+      if (sq_ring != MAP_FAILED) ::munmap(sq_ring, sq_ring_size);
+      if (cq_ring != MAP_FAILED) ::munmap(cq_ring, cq_ring_size);
+      if (sqes != MAP_FAILED) ::munmap(sqes, sqes_size);
+      ::close(ring_fd);
+      return nullptr;
+    }
+
+    // The syncer lives as long as the Env, so the rings are never unmapped.
+    IoUringPosixSyncer* syncer = new IoUringPosixSyncer(
+        ring_fd, params, static_cast<char*>(sq_ring),
+        static_cast<char*>(cq_ring), static_cast<struct ::io_uring_sqe*>(sqes));
+    std::thread reaper_thread(IoUringPosixSyncer::ReaperEntryPoint, syncer);
+    reaper_thread.detach();
+    return syncer;
+  }
+
+  void Sync(int fd, const std::string* filename,
+            WritableFile::SyncCallback done, void* arg) override {
+    Request* request = new Request{filename, done, arg};
+
+    mu_.Lock();
+    // Bounding the requests in flight keeps both rings from overflowing.
+    while (in_flight_ >= sq_entries_) {
+      space_cv_.Wait();
+    }
+    // Only the thread holding mu_ moves the submission tail.
+    const unsigned tail = *sq_tail_;
+    const unsigned index = tail & sq_mask_;
+    struct ::io_uring_sqe* sqe = &sqes_[index];
+    std::memset(sqe, 0, sizeof(*sqe));
+    sqe->opcode = IORING_OP_FSYNC;
+    sqe->fd = fd;
+    sqe->fsync_flags = IORING_FSYNC_DATASYNC;
+    sqe->user_data = reinterpret_cast<uintptr_t>(request);
+    sq_array_[index] = index;
+    __atomic_store_n(sq_tail_, tail + 1, __ATOMIC_RELEASE);
+
+    int submitted;
+    do {
+      submitted = static_cast<int>(
+          ::syscall(__NR_io_uring_enter, ring_fd_, 1, 0, 0, nullptr, 0));
+    } while (submitted < 0 && errno == EINTR);
+    if (submitted < 0) {
+      // The kernel did not take the entry; withdraw it and sync inline.
+      __atomic_store_n(sq_tail_, tail, __ATOMIC_RELEASE);
+      mu_.Unlock();
+      delete request;
+      done(arg, PosixWritableFile::SyncFd(fd, *filename));
+      return;
+    }
+    in_flight_++;
+    mu_.Unlock();
+  }
+
+ private:
+  struct Request {
+    const std::string* filename;
+    WritableFile::SyncCallback done;
+    void* arg;
+  };
+
+  IoUringPosixSyncer(int ring_fd, const struct ::io_uring_params& params,
+                     char* sq_ring, char* cq_ring, struct ::io_uring_sqe* sqes)
+      : ring_fd_(ring_fd),
+        sq_entries_(params.sq_entries),
+        sq_mask_(*reinterpret_cast<unsigned*>(sq_ring +
+                                              params.sq_off.ring_mask)),
+        sq_tail_(reinterpret_cast<unsigned*>(sq_ring + params.sq_off.tail)),
+        sq_array_(reinterpret_cast<unsigned*>(sq_ring + params.sq_off.array)),
+        sqes_(sqes),
+        cq_mask_(*reinterpret_cast<unsigned*>(cq_ring +
+                                              params.cq_off.ring_mask)),
+        cq_head_(reinterpret_cast<unsigned*>(cq_ring + params.cq_off.head)),
+        cq_tail_(reinterpret_cast<unsigned*>(cq_ring + params.cq_off.tail)),
+        cqes_(reinterpret_cast<struct ::io_uring_cqe*>(cq_ring +
+                                                       params.cq_off.cqes)),
+        space_cv_(&mu_),
+        in_flight_(0) {}
+
+  static void ReaperEntryPoint(IoUringPosixSyncer* syncer) {
+    syncer->ReaperMain();
+  }
+
+  void ReaperMain() {
+    while (true) {
+      // Only this thread moves the completion head.
+      const unsigned head = *cq_head_;
+      if (head == __atomic_load_n(cq_tail_, __ATOMIC_ACQUIRE)) {
+        // Errors such as EINTR are retried by the next iteration.
+        ::syscall(__NR_io_uring_enter, ring_fd_, 0, 1, IORING_ENTER_GETEVENTS,
+                  nullptr, 0);
+        continue;
+      }
+      const struct ::io_uring_cqe* cqe = &cqes_[head & cq_mask_];
+      Request* request = reinterpret_cast<Request*>(cqe->user_data);
+      const int result = cqe->res;
+      __atomic_store_n(cq_head_, head + 1, __ATOMIC_RELEASE);
+
+      mu_.Lock();
+      in_flight_--;
+      space_cv_.Signal();
+      mu_.Unlock();
+
+      request->done(request->arg,
+                    result < 0 ? PosixError(*request->filename, -result)
+                               : Status::OK());
+      delete request;
+    }
+  }
+
+  const int ring_fd_;
+  const unsigned sq_entries_;
+  const unsigned sq_mask_;
+  unsigned* const sq_tail_;
+  unsigned* const sq_array_;
+  struct ::io_uring_sqe* const sqes_;
+  const unsigned cq_mask_;
+  unsigned* const cq_head_;
+  unsigned* const cq_tail_;
+  struct ::io_uring_cqe* const cqes_;
+
+  port::Mutex mu_;
+  port::CondVar space_cv_ GUARDED_BY(mu_);
+  unsigned in_flight_ GUARDED_BY(mu_);
 };
+#endif  // HAVE_IO_URING
+
+// Returns nullptr if io_uring is not available.
+PosixSyncer* NewIoUringPosixSyncer() {
+#if HAVE_IO_URING
+  return IoUringPosixSyncer::Open(64);
+#else
+  return nullptr;
+#endif  // HAVE_IO_URING
+}
 
 int LockOrUnlock(int fd, bool lock) {
   errno = 0;
@@ -579,7 +878,7 @@ class PosixEnv : public Env {
       return PosixError(filename, errno);
     }
 
-    *result = new PosixWritableFile(filename, fd);
+    *result = new PosixWritableFile(filename, fd, syncer());
     return Status::OK();
   }
 
@@ -592,7 +891,25 @@ class PosixEnv : public Env {
       return PosixError(filename, errno);
     }
 
-    *result = new PosixWritableFile(filename, fd);
+    *result = new PosixWritableFile(filename, fd, syncer());
+    return Status::OK();
+  }
+
+  Status ReuseWritableFile(const std::string& filename,
+                           const std::string& old_filename,
+                           WritableFile** result) override {
+    if (::rename(old_filename.c_str(), filename.c_str()) != 0) {
+      *result = nullptr;
+      return PosixError(old_filename, errno);
+    }
+    // Without O_TRUNC, writes overwrite the old contents in place.
+    int fd = ::open(filename.c_str(), O_WRONLY | kOpenBaseFlags, 0644);
+    if (fd < 0) {
+      *result = nullptr;
+      return PosixError(filename, errno);
+    }
+
+    *result = new PosixWritableFile(filename, fd, syncer());
     return Status::OK();
   }
 
@@ -745,6 +1062,16 @@ class PosixEnv : public Env {
   }
 
  private:
+  // Returns the syncer for new files: io_uring when the kernel supports
+  // it, and a background thread otherwise.
+  PosixSyncer* syncer() {
+    if (io_uring_syncer_ != nullptr &&
+        g_use_io_uring.load(std::memory_order_relaxed)) {
+      return io_uring_syncer_;
+    }
+    return &thread_syncer_;
+  }
+
   void BackgroundThreadMain();
 
   static void BackgroundThreadEntryPoint(PosixEnv* env) {
@@ -775,6 +1102,8 @@ class PosixEnv : public Env {
   PosixLockTable locks_;  // Thread-safe.
   Limiter mmap_limiter_;  // Thread-safe.
   Limiter fd_limiter_;    // Thread-safe.
+  PosixSyncer* const io_uring_syncer_;  // Thread-safe.  May be nullptr.
+  ThreadPosixSyncer thread_syncer_;     // Thread-safe.
 };
 
 // Return the maximum number of concurrent mmaps.
@@ -809,7 +1138,8 @@ PosixEnv::PosixEnv()
     : background_work_cv_(&background_work_mutex_),
       started_background_thread_(false),
       mmap_limiter_(MaxMmaps()),
-      fd_limiter_(MaxOpenFiles()) {}
+      fd_limiter_(MaxOpenFiles()),
+      io_uring_syncer_(NewIoUringPosixSyncer()) {}
 
 void PosixEnv::Schedule(
     void (*background_work_function)(void* background_work_arg),
@@ -918,6 +1248,10 @@ void EnvPosixTestHelper::SetReadOnlyMMapLimit(int limit) {
   g_mmap_limit = limit;
 }
 
+void EnvPosixTestHelper::SetUseIoUring(bool use) {
+  g_use_io_uring.store(use, std::memory_order_relaxed);
+}
+
 Env* Env::Default() {
   static PosixDefaultEnv env_container;
   return env_container.env();
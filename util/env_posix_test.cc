@@ -176,6 +176,10 @@ class EnvPosixTest : public testing::Test {
     EnvPosixTestHelper::SetReadOnlyMMapLimit(mmap_limit);
   }
 
+  static void SetUseIoUring(bool use) {
+    EnvPosixTestHelper::SetUseIoUring(use);
+  }
+
   EnvPosixTest() : env_(Env::Default()) {}
 
   Env* env_;
@@ -212,6 +216,69 @@ TEST_F(EnvPosixTest, TestOpenOnRead) {
   ASSERT_LEVELDB_OK(env_->RemoveFile(test_file));
 }
 
+namespace {
+
+struct SyncAsyncState {
+  SyncAsyncState() : cv(&mu), pending(0), failures(0) {}
+
+  port::Mutex mu;
+  port::CondVar cv;
+  int pending;
+  int failures;
+};
+
+void SyncAsyncDone(void* arg, const Status& status) {
+  SyncAsyncState* state = reinterpret_cast<SyncAsyncState*>(arg);
+  state->mu.Lock();
+  if (!status.ok()) {
+    state->failures++;
+  }
+  state->pending--;
+  state->cv.SignalAll();
+  state->mu.Unlock();
+}
+
+}  // namespace
+
+TEST_F(EnvPosixTest, TestSyncAsync) {
+  std::string test_dir;
+  ASSERT_LEVELDB_OK(env_->GetTestDirectory(&test_dir));
+  const std::string test_file = test_dir + "/sync_async.txt";
+
+  // Exercise both io_uring, where the kernel supports it, and the
+  // background thread.
+  for (bool use_io_uring : {true, false}) {
+    SetUseIoUring(use_io_uring);
+    WritableFile* file;
+    ASSERT_LEVELDB_OK(env_->NewWritableFile(test_file, &file));
+
+    SyncAsyncState state;
+    const int kSyncs = 100;
+    for (int i = 0; i < kSyncs; i++) {
+      // Appends may overlap the syncs still in flight.
+      ASSERT_LEVELDB_OK(file->Append(std::string(1000, 'a' + (i % 26))));
+      state.mu.Lock();
+      state.pending++;
+      state.mu.Unlock();
+      file->SyncAsync(SyncAsyncDone, &state);
+    }
+    state.mu.Lock();
+    while (state.pending > 0) {
+      state.cv.Wait();
+    }
+    state.mu.Unlock();
+    ASSERT_EQ(0, state.failures);
+    ASSERT_LEVELDB_OK(file->Close());
+    delete file;
+
+    uint64_t size;
+    ASSERT_LEVELDB_OK(env_->GetFileSize(test_file, &size));
+    ASSERT_EQ(kSyncs * 1000, size);
+    ASSERT_LEVELDB_OK(env_->RemoveFile(test_file));
+  }
+  SetUseIoUring(true);
+}
+
 #if HAVE_O_CLOEXEC
 
 TEST_F(EnvPosixTest, TestCloseOnExecSequentialFile) {
@@ -259,6 +326,34 @@ TEST_F(EnvPosixTest, TestCloseOnExecRandomAccessFile) {
   ASSERT_LEVELDB_OK(env_->RemoveFile(file_path));
 }
 
+TEST_F(EnvPosixTest, TestMmapFilesReadInPlace) {
+  std::string test_dir;
+  ASSERT_LEVELDB_OK(env_->GetTestDirectory(&test_dir));
+  std::string file_path = test_dir + "/reads_in_place.txt";
+  ASSERT_LEVELDB_OK(WriteStringToFile(env_, "0123456789", file_path));
+
+  // The first kMMapLimit files are mmapped, the next one is not.
+  leveldb::RandomAccessFile* files[kMMapLimit + 1];
+  for (int i = 0; i <= kMMapLimit; i++) {
+    ASSERT_LEVELDB_OK(env_->NewRandomAccessFile(file_path, &files[i]));
+  }
+  char scratch[4];
+  Slice result;
+  for (int i = 0; i < kMMapLimit; i++) {
+    ASSERT_TRUE(files[i]->ReadsInPlace());
+    ASSERT_LEVELDB_OK(files[i]->Read(3, 4, &result, nullptr));
+    ASSERT_EQ("3456", result.ToString());
+  }
+  ASSERT_TRUE(!files[kMMapLimit]->ReadsInPlace());
+  ASSERT_LEVELDB_OK(files[kMMapLimit]->Read(3, 4, &result, scratch));
+  ASSERT_EQ("3456", result.ToString());
+
+  for (int i = 0; i <= kMMapLimit; i++) {
+    delete files[i];
+  }
+  ASSERT_LEVELDB_OK(env_->RemoveFile(file_path));
+}
+
 TEST_F(EnvPosixTest, TestCloseOnExecWritableFile) {
   std::unordered_set<int> open_fds;
   GetOpenFileDescriptors(&open_fds);
@@ -21,6 +21,10 @@ class EnvPosixTestHelper {
   // Set the maximum number of read-only files that will be mapped via mmap.
   // Must be called before creating an Env.
   static void SetReadOnlyMMapLimit(int limit);
+
+  // Set whether files opened from now on may use io_uring for
+  // WritableFile::SyncAsync(), rather than a background thread.
+  static void SetUseIoUring(bool use);
 };
 
 }  // namespace leveldb
@@ -230,4 +230,52 @@ TEST_F(EnvTest, ReopenAppendableFile) {
   env_->RemoveFile(test_file_name);
 }
 
+TEST_F(EnvTest, ReuseWritableFile) {
+  std::string test_dir;
+  ASSERT_LEVELDB_OK(env_->GetTestDirectory(&test_dir));
+  std::string old_file_name = test_dir + "/reuse_writable_file_old.txt";
+  std::string test_file_name = test_dir + "/reuse_writable_file.txt";
+  env_->RemoveFile(old_file_name);
+  env_->RemoveFile(test_file_name);
+
+  WritableFile* writable_file;
+  ASSERT_LEVELDB_OK(env_->NewWritableFile(old_file_name, &writable_file));
+  std::string data("hello world!");
+  ASSERT_LEVELDB_OK(writable_file->Append(data));
+  ASSERT_LEVELDB_OK(writable_file->Close());
+  delete writable_file;
+
+  ASSERT_LEVELDB_OK(
+      env_->ReuseWritableFile(test_file_name, old_file_name, &writable_file));
+  ASSERT_LEVELDB_OK(writable_file->Preallocate(1 << 20));
+  data = "HELLO";
+  ASSERT_LEVELDB_OK(writable_file->Append(data));
+  ASSERT_LEVELDB_OK(writable_file->Close());
+  delete writable_file;
+
+  ASSERT_TRUE(!env_->FileExists(old_file_name));
+  ASSERT_LEVELDB_OK(ReadFileToString(env_, test_file_name, &data));
+  ASSERT_EQ(std::string("HELLO world!"), data);
+  env_->RemoveFile(test_file_name);
+}
+
+TEST_F(EnvTest, PreallocateKeepsSize) {
+  std::string test_dir;
+  ASSERT_LEVELDB_OK(env_->GetTestDirectory(&test_dir));
+  std::string test_file_name = test_dir + "/preallocate_file.txt";
+  env_->RemoveFile(test_file_name);
+
+  WritableFile* writable_file;
+  ASSERT_LEVELDB_OK(env_->NewWritableFile(test_file_name, &writable_file));
+  ASSERT_LEVELDB_OK(writable_file->Preallocate(1 << 20));
+  ASSERT_LEVELDB_OK(writable_file->Append("42"));
+  ASSERT_LEVELDB_OK(writable_file->Close());
+  delete writable_file;
+
+  uint64_t size;
+  ASSERT_LEVELDB_OK(env_->GetFileSize(test_file_name, &size));
+  ASSERT_EQ(2, size);
+  env_->RemoveFile(test_file_name);
+}
+
 }  // namespace leveldb
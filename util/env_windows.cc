@@ -256,6 +256,8 @@ class WindowsMmapReadableFile : public RandomAccessFile {
     return Status::OK();
   }
 
+  bool ReadsInPlace() const override { return true; }
+
  private:
   char* const mmap_base_;
   const size_t length_;
@@ -0,0 +1,204 @@
+// Copyright (c) 2011 The LevelDB Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file. See the AUTHORS file for names of contributors.
+
+#include "leveldb/rate_limiter.h"
+
+#include <algorithm>
+#include <cassert>
+#include <deque>
+
+#include "leveldb/env.h"
+#include "port/port.h"
+#include "port/thread_annotations.h"
+#include "util/mutexlock.h"
+#include "util/rate_limiter.h"
+
+namespace leveldb {
+
+RateLimiter::~RateLimiter() = default;
+
+namespace {
+
+// Time between refills of the byte budget.
+constexpr uint64_t kRefillPeriodMicros = 100 * 1000;
+
+// Token-bucket rate limiter.
+//
+// The budget is refilled once per period.  Budget left unused at the end
+// of a period is discarded so that idle time does not turn into a burst.
+// Requests that do not fit in the remaining budget are queued by
+// priority.  One of the queued requests sleeps until the next refill and
+// then grants as many queued requests as the new budget allows, highest
+// priority first and in arrival order within a priority.
+class GenericRateLimiter : public RateLimiter {
+ public:
+  GenericRateLimiter(int64_t bytes_per_second, Env* env)
+      : env_(env),
+        bytes_per_second_(std::max<int64_t>(bytes_per_second, 1)),
+        available_bytes_(RefillBytes()),
+        next_refill_micros_(env->NowMicros() + kRefillPeriodMicros),
+        refilling_(false),
+        total_bytes_{0, 0} {}
+
+  ~GenericRateLimiter() override {
+    assert(queues_[kLow].empty());
+    assert(queues_[kHigh].empty());
+  }
+
+  void Request(size_t bytes, Priority pri) override;
+
+  void SetBytesPerSecond(int64_t bytes_per_second) override {
+    MutexLock l(&mutex_);
+    bytes_per_second_ = std::max<int64_t>(bytes_per_second, 1);
+  }
+
+  int64_t GetBytesPerSecond() const override {
+    MutexLock l(&mutex_);
+    return bytes_per_second_;
+  }
+
+  int64_t GetTotalBytesThrough(Priority pri) const override {
+    MutexLock l(&mutex_);
+    return total_bytes_[pri];
+  }
+
+ private:
+  struct Waiter {
+    explicit Waiter(port::Mutex* mu) : cv(mu), bytes(0), granted(false) {}
+
+    port::CondVar cv;
+    int64_t bytes;
+    bool granted;
+  };
+
+  int64_t RefillBytes() const EXCLUSIVE_LOCKS_REQUIRED(mutex_) {
+    return std::max<int64_t>(
+        bytes_per_second_ * static_cast<int64_t>(kRefillPeriodMicros) /
+            1000000,
+        1);
+  }
+
+  // Start a new period and grant the queued requests that fit in it.
+  void Refill() EXCLUSIVE_LOCKS_REQUIRED(mutex_);
+
+  Env* const env_;
+  mutable port::Mutex mutex_;
+  int64_t bytes_per_second_ GUARDED_BY(mutex_);
+  int64_t available_bytes_ GUARDED_BY(mutex_);
+  uint64_t next_refill_micros_ GUARDED_BY(mutex_);
+  bool refilling_ GUARDED_BY(mutex_);  // Is a waiter sleeping until a refill?
+  std::deque<Waiter*> queues_[kNumPriorities] GUARDED_BY(mutex_);
+  int64_t total_bytes_[kNumPriorities] GUARDED_BY(mutex_);
+};
+
+void GenericRateLimiter::Refill() {
+  next_refill_micros_ = env_->NowMicros() + kRefillPeriodMicros;
+  const int64_t refill_bytes = RefillBytes();
+  available_bytes_ = refill_bytes;
+  for (int pri = kHigh; pri >= kLow; pri--) {
+    std::deque<Waiter*>* queue = &queues_[pri];
+    while (!queue->empty()) {
+      Waiter* w = queue->front();
+      if (w->bytes > available_bytes_) {
+        // A request queued before the rate was lowered may not fit in a
+        // whole period; grant it one period to itself.
+        if (available_bytes_ < refill_bytes) {
+          return;  // Lower priorities must not overtake it
+        }
+        available_bytes_ = w->bytes;
+      }
+      available_bytes_ -= w->bytes;
+      w->granted = true;
+      w->cv.Signal();
+      queue->pop_front();
+    }
+  }
+}
+
+void GenericRateLimiter::Request(size_t bytes, Priority pri) {
+  assert(pri == kLow || pri == kHigh);
+  MutexLock l(&mutex_);
+  total_bytes_[pri] += bytes;
+  int64_t remaining = bytes;
+  while (remaining > 0) {
+    // Requests larger than one refill are granted in pieces.
+    const int64_t chunk = std::min(remaining, RefillBytes());
+    remaining -= chunk;
+
+    const bool queued = !queues_[kLow].empty() || !queues_[kHigh].empty();
+    if (!queued && env_->NowMicros() >= next_refill_micros_) {
+      Refill();
+    }
+    if (!queued && available_bytes_ >= chunk) {
+      available_bytes_ -= chunk;
+      continue;
+    }
+
+    Waiter w(&mutex_);
+    w.bytes = chunk;
+    queues_[pri].push_back(&w);
+    while (!w.granted) {
+      if (refilling_) {
+        w.cv.Wait();
+        continue;
+      }
+      // Sleep until the next refill on behalf of every waiter.
+      refilling_ = true;
+      const uint64_t now = env_->NowMicros();
+      if (next_refill_micros_ > now) {
+        mutex_.Unlock();
+        env_->SleepForMicroseconds(
+            static_cast<int>(next_refill_micros_ - now));
+        mutex_.Lock();
+      }
+      Refill();
+      refilling_ = false;
+      if (w.granted) {
+        // Hand the refill duty over to the next waiter, if any.
+        for (int p = kHigh; p >= kLow; p--) {
+          if (!queues_[p].empty()) {
+            queues_[p].front()->cv.Signal();
+            break;
+          }
+        }
+      }
+    }
+  }
+}
+
+class RateLimitedWritableFile : public WritableFile {
+ public:
+  RateLimitedWritableFile(WritableFile* base, RateLimiter* limiter,
+                          RateLimiter::Priority pri)
+      : base_(base), limiter_(limiter), pri_(pri) {}
+
+  ~RateLimitedWritableFile() override { delete base_; }
+
+  Status Append(const Slice& data) override {
+    limiter_->Request(data.size(), pri_);
+    return base_->Append(data);
+  }
+  Status Close() override { return base_->Close(); }
+  Status Flush() override { return base_->Flush(); }
+  Status Sync() override { return base_->Sync(); }
+
+ private:
+  WritableFile* const base_;
+  RateLimiter* const limiter_;
+  const RateLimiter::Priority pri_;
+};
+
+}  // namespace
+
+RateLimiter* NewGenericRateLimiter(int64_t bytes_per_second) {
+  return new GenericRateLimiter(bytes_per_second, Env::Default());
+}
+
+WritableFile* NewRateLimitedWritableFile(WritableFile* base,
+                                         RateLimiter* limiter,
+                                         RateLimiter::Priority pri) {
+  return new RateLimitedWritableFile(base, limiter, pri);
+}
+
+}  // namespace leveldb
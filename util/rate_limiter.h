@@ -0,0 +1,22 @@
+// Copyright (c) 2011 The LevelDB Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file. See the AUTHORS file for names of contributors.
+
+#ifndef STORAGE_LEVELDB_UTIL_RATE_LIMITER_H_
+#define STORAGE_LEVELDB_UTIL_RATE_LIMITER_H_
+
+#include "leveldb/env.h"
+#include "leveldb/rate_limiter.h"
+
+namespace leveldb {
+
+// Return a file that passes every write through "limiter" at priority
+// "pri" before forwarding it to "base".  The result takes ownership of
+// "base".
+WritableFile* NewRateLimitedWritableFile(WritableFile* base,
+                                         RateLimiter* limiter,
+                                         RateLimiter::Priority pri);
+
+}  // namespace leveldb
+
+#endif  // STORAGE_LEVELDB_UTIL_RATE_LIMITER_H_
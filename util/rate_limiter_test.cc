@@ -0,0 +1,95 @@
+// Copyright (c) 2011 The LevelDB Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file. See the AUTHORS file for names of contributors.
+
+#include "leveldb/rate_limiter.h"
+
+#include <atomic>
+#include <memory>
+
+#include "gtest/gtest.h"
+#include "leveldb/env.h"
+
+namespace leveldb {
+
+static const int64_t kKB = 1024;
+
+TEST(RateLimiterTest, BytesPerSecond) {
+  std::unique_ptr<RateLimiter> limiter(NewGenericRateLimiter(1000 * kKB));
+  ASSERT_EQ(1000 * kKB, limiter->GetBytesPerSecond());
+  limiter->SetBytesPerSecond(2000 * kKB);
+  ASSERT_EQ(2000 * kKB, limiter->GetBytesPerSecond());
+  limiter->SetBytesPerSecond(0);
+  ASSERT_EQ(1, limiter->GetBytesPerSecond());
+}
+
+TEST(RateLimiterTest, Rate) {
+  // Refills of 100KB every 100ms.
+  std::unique_ptr<RateLimiter> limiter(NewGenericRateLimiter(1000 * kKB));
+  Env* env = Env::Default();
+  const uint64_t start = env->NowMicros();
+  for (int i = 0; i < 10; i++) {
+    limiter->Request(50 * kKB, RateLimiter::kLow);
+  }
+  // The first refill is available immediately.  A single request larger
+  // than a refill is split across several.
+  limiter->Request(250 * kKB, RateLimiter::kHigh);
+  const uint64_t elapsed = env->NowMicros() - start;
+  ASSERT_GE(elapsed, 600000);
+  ASSERT_LE(elapsed, 5000000);
+  ASSERT_EQ(500 * kKB, limiter->GetTotalBytesThrough(RateLimiter::kLow));
+  ASSERT_EQ(250 * kKB, limiter->GetTotalBytesThrough(RateLimiter::kHigh));
+}
+
+namespace {
+
+struct RequestLoop {
+  RateLimiter* limiter;
+  RateLimiter::Priority pri;
+  int requests;
+  std::atomic<bool> done;
+};
+
+void RequestLoopBody(void* arg) {
+  RequestLoop* loop = reinterpret_cast<RequestLoop*>(arg);
+  for (int i = 0; i < loop->requests; i++) {
+    loop->limiter->Request(20 * kKB, loop->pri);
+  }
+  loop->done.store(true, std::memory_order_release);
+}
+
+}  // namespace
+
+TEST(RateLimiterTest, HighPriorityPreemptsLow) {
+  // Refills of 20KB every 100ms: one request per refill.
+  std::unique_ptr<RateLimiter> limiter(NewGenericRateLimiter(200 * kKB));
+  Env* env = Env::Default();
+
+  RequestLoop low;
+  low.limiter = limiter.get();
+  low.pri = RateLimiter::kLow;
+  low.requests = 15;
+  low.done.store(false, std::memory_order_release);
+  env->StartThread(RequestLoopBody, &low);
+  env->SleepForMicroseconds(150000);
+
+  // Arriving behind the low priority requests, the high priority ones
+  // are still served first.
+  RequestLoop high;
+  high.limiter = limiter.get();
+  high.pri = RateLimiter::kHigh;
+  high.requests = 3;
+  high.done.store(false, std::memory_order_release);
+  env->StartThread(RequestLoopBody, &high);
+  while (!high.done.load(std::memory_order_acquire)) {
+    env->SleepForMicroseconds(10000);
+  }
+  ASSERT_FALSE(low.done.load(std::memory_order_acquire));
+  while (!low.done.load(std::memory_order_acquire)) {
+    env->SleepForMicroseconds(10000);
+  }
+  ASSERT_EQ(300 * kKB, limiter->GetTotalBytesThrough(RateLimiter::kLow));
+  ASSERT_EQ(60 * kKB, limiter->GetTotalBytesThrough(RateLimiter::kHigh));
+}
+
+}  // namespace leveldb